@@ -4,11 +4,26 @@
 // Transforms and colors geometry.
 //***************************************************************************************
 
-cbuffer cbPerObject : register(b0)
+cbuffer cbPass : register(b0)
 {
-	float4x4 gWorldViewProj; 
+	float4x4 gViewProj; 
 };
 
+struct InstanceData
+{
+	uint ObjectIndex;
+};
+
+struct ObjectData
+{
+	float4x4 World;
+};
+
+// Objects of the current instanced batch, bound per batch as a root SRV.
+StructuredBuffer<InstanceData> gInstanceData : register(t0);
+// Constants of every object, only rewritten for objects that changed.
+StructuredBuffer<ObjectData> gObjectData : register(t1);
+
 struct VertexIn
 {
 	float3 PosL  : POSITION;
@@ -21,12 +36,13 @@ struct VertexOut
     float4 Color : COLOR;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout;
 	
-	// Transform to homogeneous clip space.
-	vout.PosH = mul(float4(vin.PosL, 1.0f), gWorldViewProj);
+	// Transform to world space, then to homogeneous clip space.
+	float4 posW = mul(float4(vin.PosL, 1.0f), gObjectData[gInstanceData[instanceID].ObjectIndex].World);
+	vout.PosH = mul(posW, gViewProj);
 	
 	// Just pass vertex color into the pixel shader.
     vout.Color = vin.Color;
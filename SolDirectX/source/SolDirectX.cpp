@@ -3,10 +3,15 @@
 
 #include "header/gfx/gfx_object.h"
 #include <iostream>
+#include "header/Common/JobSystem.h"
 #include "header/Window/LittleRendererWindow.h"
 
 int main()
 {
+	//每个物理核一个线程,共享末级缓存的核放在一起;主线程(更新线程)固定在第一个核上,
+	//避免帧时间因线程迁移和SMT争用而抖动。留出一个核给渲染线程,见FramePipeline
+	ConfigureDefaultJobSystem(0, ThreadPlacement::Compact, 1);
+	DefaultJobSystem();
 	//创建并初始化实例
 	auto instance = LittleFactory::Create<LittleGFXInstance>(true);
 	auto device = LittleFactory::Create<LittleGFXDevice>(instance->GetAdapter(0));
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+//Instruction set extensions available at run time. SIMD kernels are compiled
+//for several targets and pick their implementation from these flags.
+struct CpuFeatures
+{
+	bool SSE41 = false;
+	bool POPCNT = false;
+	bool AVX = false;
+	bool AVX2 = false;
+	bool FMA = false;
+	bool F16C = false;
+	bool BMI1 = false;
+	bool BMI2 = false;
+	bool AVX512F = false;
+	bool AVX512VL = false;
+
+	//Everything SOL_TARGET_AVX2 and SOL_TARGET_AVX512 let the compiler use,
+	//so the check to make before calling a function compiled for them.
+	bool Avx2Target() const { return AVX2 && FMA && F16C && BMI1 && BMI2 && POPCNT; }
+	bool Avx512Target() const { return Avx2Target() && AVX512F && AVX512VL; }
+
+	static const CpuFeatures& Get();
+};
+
+//MSVC accepts any intrinsic in any function, GCC/Clang need the target enabled
+//per function so that the rest of the program still runs on older CPUs.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SOL_TARGET_AVX2
+#define SOL_TARGET_AVX512
+#else
+#define SOL_TARGET_AVX2 __attribute__((target("avx2,fma,f16c,bmi,bmi2,popcnt")))
+#define SOL_TARGET_AVX512 __attribute__((target("avx512f,avx512vl,avx2,fma,f16c,bmi,bmi2,popcnt")))
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+inline uint32_t CountTrailingZeros(uint32_t value)
+{
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return index;
+}
+//__popcnt faults on CPUs without POPCNT, which x64 does not guarantee, and
+//PopCount is also called outside the SIMD targets. Count the bits in pairs,
+//nibbles and bytes instead, in baseline instructions.
+inline uint32_t PopCount(uint32_t value)
+{
+	value = value - (value >> 1 & 0x55555555u);
+	value = (value & 0x33333333u) + (value >> 2 & 0x33333333u);
+	value = (value + (value >> 4)) & 0x0F0F0F0Fu;
+	return value * 0x01010101u >> 24;
+}
+#else
+inline uint32_t CountTrailingZeros(uint32_t value)
+{
+	return (uint32_t)__builtin_ctz(value);
+}
+//GCC and Clang only emit POPCNT for this where the target allows it.
+inline uint32_t PopCount(uint32_t value)
+{
+	return (uint32_t)__builtin_popcount(value);
+}
+#endif
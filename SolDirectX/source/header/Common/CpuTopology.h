@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Which logical CPUs share a physical core, a last-level cache and a NUMA
+//node, read from /sys/devices/system/cpu on Linux and from
+//GetLogicalProcessorInformationEx on Windows. Only the CPUs the process may
+//run on are listed. Used to place the update thread, the render thread and
+//the job workers so they neither migrate nor share a core through SMT.
+
+struct LogicalCpu
+{
+	//The OS number: the Linux CPU number, or the number within the Windows processor group.
+	uint32_t Id = 0;
+	uint16_t Group = 0;
+	//Indices into CpuTopology::Cores and CpuTopology::Caches.
+	uint32_t Core = 0;
+	uint32_t Cache = 0;
+	uint32_t Package = 0;
+	uint32_t NumaNode = 0;
+	//0 for the first SMT thread of its core, 1 for its sibling, ...
+	uint32_t SmtIndex = 0;
+};
+
+struct CpuCore
+{
+	//Indices into CpuTopology::Cpus, first SMT thread first.
+	std::vector<uint32_t> Cpus;
+};
+
+//A last-level cache and the CPUs sharing it, e.g. an L3 slice of a CCX.
+struct CacheDomain
+{
+	uint32_t Level = 0;
+	uint64_t Bytes = 0;
+	std::vector<uint32_t> Cpus;
+};
+
+struct CpuTopology
+{
+	std::vector<LogicalCpu> Cpus;
+	std::vector<CpuCore> Cores;
+	std::vector<CacheDomain> Caches;
+	uint32_t Packages = 1;
+	uint32_t NumaNodes = 1;
+
+	//Probed once, on first use.
+	static const CpuTopology& Get();
+	//Reads the topology again. When the OS does not tell, every CPU is a core of its own.
+	static CpuTopology Probe();
+
+	std::string Describe() const;
+};
+
+//How the threads of a JobSystem are placed. Thread 0, the thread creating
+//the system (normally the main thread, which runs the update), gets the first
+//CPU of the plan.
+enum class ThreadPlacement
+{
+	//No affinity, the OS moves threads as it likes.
+	None,
+	//One thread per physical core, filling a NUMA node and a last-level cache
+	//before the next: threads working on the same frame data share an L3.
+	Compact,
+	//One thread per physical core, taking the last-level caches in turn: the
+	//most cache and memory bandwidth per thread.
+	Spread,
+	//Every logical CPU: the physical cores in Compact order, then their SMT siblings.
+	AllLogical,
+};
+
+const char* ThreadPlacementName(ThreadPlacement placement);
+
+//The number of threads a placement is meant for: physical cores for Compact
+//and Spread, logical CPUs otherwise.
+uint32_t PlacementThreadCount(const CpuTopology& topology, ThreadPlacement placement);
+
+//Indices into topology.Cpus for threads 0 to threadCount - 1. Threads beyond
+//the physical cores go on SMT siblings, beyond all CPUs the plan wraps
+//around. Empty for ThreadPlacement::None.
+std::vector<uint32_t> PlanThreadCpus(const CpuTopology& topology, ThreadPlacement placement, uint32_t threadCount);
+
+//Restricts the calling thread to one CPU; false when the OS refuses.
+bool PinCurrentThread(const LogicalCpu& cpu);
+//Lets the calling thread run on every CPU of the topology again.
+bool UnpinCurrentThread(const CpuTopology& topology);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "CpuTopology.h"
+#include "SpscQueue.h"
+
+//What FramePipeline measured since the last ResetStats().
+struct FramePipelineStats
+{
+	uint64_t Frames = 0;
+	//The update thread waiting in Acquire() for the render thread to hand a snapshot back.
+	double UpdateWaitMilliseconds = 0.0;
+	//The render thread waiting for a snapshot to be published.
+	double RenderIdleMilliseconds = 0.0;
+	//From Publish() until the render callback returned, summed and worst case.
+	double LatencyMilliseconds = 0.0;
+	double MaxLatencyMilliseconds = 0.0;
+	//Most snapshots published and not rendered yet, never above the snapshot count.
+	uint32_t MaxFramesAhead = 0;
+
+	double MeanLatencyMilliseconds() const { return Frames != 0 ? LatencyMilliseconds / Frames : 0.0; }
+};
+
+//Two stage frame pipeline: the update thread writes frame n + 1 into one
+//snapshot while a render thread records and submits frame n from another.
+//Snapshots are indices 0 to snapshotCount - 1 into whatever the caller keeps
+//per frame (frame resources, draw packets); they go to the render thread and
+//back through two SpscQueues, so each one belongs to exactly one thread at a
+//time and hands over with release/acquire ordering. 2 snapshots double
+//buffer, 3 triple buffer.
+//
+//Latency bound: Acquire() blocks until the render thread has finished a
+//snapshot, so the update thread is at most snapshotCount frames ahead of the
+//render thread, and a published frame waits behind at most
+//snapshotCount - 1 others before it is recorded.
+class FramePipeline
+{
+public:
+	//render(index) runs on the render thread for every published snapshot, in
+	//publishing order. The thread starts here and pins itself to renderCpu if
+	//given, e.g. a CPU the job system reserved (JobSystem::ReservedCpus()).
+	FramePipeline(uint32_t snapshotCount, std::function<void(uint32_t)> render,
+		const LogicalCpu* renderCpu = nullptr);
+	//Stop().
+	~FramePipeline();
+
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+
+	uint32_t SnapshotCount() const { return mSnapshotCount; }
+
+	//Update thread only. A snapshot the render thread is done with, the
+	//oldest first; blocks while all of them are published. Rethrows an
+	//exception the render callback threw.
+	uint32_t Acquire();
+	//Update thread only. Hands an acquired snapshot to the render thread.
+	void Publish(uint32_t index);
+	//Update thread only. Waits until every published snapshot is rendered,
+	//e.g. before resizing the swap chain the render thread presents to.
+	void Drain();
+	//Drains and joins the render thread; later calls do nothing.
+	void Stop();
+
+	const FramePipelineStats& Stats() const { return mStats; }
+	void ResetStats() { mStats = FramePipelineStats(); }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	//Written by the thread owning the snapshot at the time.
+	struct Slot
+	{
+		Clock::time_point Published;
+		double LatencyMilliseconds = 0.0;
+		double IdleMilliseconds = 0.0;
+		//What the render callback threw, rethrown by Acquire().
+		std::exception_ptr Failure;
+	};
+
+	static constexpr uint32_t StopIndex = ~0u;
+	static constexpr size_t QueueCapacity = 16;
+
+	void RenderMain();
+	//Takes one rendered snapshot back into mFree.
+	void Reclaim();
+
+	const uint32_t mSnapshotCount;
+	std::function<void(uint32_t)> mRender;
+	std::optional<LogicalCpu> mRenderCpu;
+	std::vector<Slot> mSlots;
+
+	SpscQueue<uint32_t, QueueCapacity> mPublished;
+	SpscQueue<uint32_t, QueueCapacity> mRendered;
+
+	//Update thread side.
+	std::deque<uint32_t> mFree;
+	uint32_t mInFlight = 0;
+	FramePipelineStats mStats;
+	std::exception_ptr mFailure;
+
+	std::thread mThread;
+};
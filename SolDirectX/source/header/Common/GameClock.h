@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+//Nanoseconds of a monotonic counter with an arbitrary origin:
+//QueryPerformanceCounter on Windows, std::chrono::steady_clock elsewhere.
+uint64_t HighResolutionNanoseconds();
+
+//Wall time between frames, read from an injectable source so the simulation
+//can run on a scripted clock, e.g. in EngineBench, and give the same result
+//on every run.
+class GameClock
+{
+public:
+	explicit GameClock(std::function<uint64_t()> nowNanoseconds = HighResolutionNanoseconds);
+
+	//Seconds since the last Tick(), or since construction or Reset() for the
+	//first one. A source going backwards counts as no time passing.
+	double Tick();
+	//Starts measuring from now again, e.g. after loading or a paused window.
+	void Reset();
+
+	double DeltaSeconds() const { return mDeltaSeconds; }
+	double TotalSeconds() const { return mTotalSeconds; }
+
+private:
+	std::function<uint64_t()> mNow;
+	uint64_t mLast = 0;
+	double mDeltaSeconds = 0.0;
+	double mTotalSeconds = 0.0;
+};
+
+//Turns variable frame times into fixed simulation steps (Glenn Fiedler,
+//"Fix Your Timestep!"): frame time is added to an accumulator and every whole
+//step in it is simulated, so the simulation does not depend on the frame
+//rate. What is left over, a fraction of a step, is Alpha(): the renderer
+//blends the last two simulation states with it instead of showing the
+//newest one early or late.
+//
+//If simulating a step takes longer than the step itself, every frame needs
+//more steps than the last one (the spiral of death). A frame runs at most
+//MaxStepsPerFrame steps; the rest of its backlog is dropped and the game
+//slows down instead of freezing.
+class FixedStepLoop
+{
+public:
+	explicit FixedStepLoop(double stepSeconds = 1.0 / 60.0, uint32_t maxStepsPerFrame = 8);
+
+	//Adds the time of a frame and gives back the number of steps to simulate now.
+	uint32_t Advance(double elapsedSeconds);
+
+	double StepSeconds() const { return mStepSeconds; }
+	uint32_t MaxStepsPerFrame() const { return mMaxStepsPerFrame; }
+	//How far the present is between the last simulated state (0) and the next one (1).
+	double Alpha() const { return mAccumulator / mStepSeconds; }
+	//Steps handed out so far, and steps the clamp dropped.
+	uint64_t Steps() const { return mSteps; }
+	uint64_t DroppedSteps() const { return mDroppedSteps; }
+
+private:
+	double mStepSeconds;
+	uint32_t mMaxStepsPerFrame;
+	double mAccumulator = 0.0;
+	uint64_t mSteps = 0;
+	uint64_t mDroppedSteps = 0;
+};
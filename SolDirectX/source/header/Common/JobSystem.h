@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CpuTopology.h"
+
+struct Job;
+
+//Counts the jobs run with it that have not finished yet. Wait() on it, or
+//start other jobs once it reaches zero with RunAfter(). A counter can be
+//reused once it is back at zero; it belongs to one JobSystem.
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	uint32_t Value() const { return (uint32_t)mState.load(std::memory_order_acquire); }
+
+private:
+	friend class JobSystem;
+
+	//Low 32 bits: unfinished jobs. High 32 bits: jobs still inside Finish(),
+	//so Wait() does not return while one of them can still touch the counter.
+	std::atomic<uint64_t> mState{ 0 };
+	//Jobs waiting for zero, an intrusive stack.
+	std::atomic<Job*> mWaiting{ nullptr };
+};
+
+//Fixed set of worker threads, one per core by default, that take jobs from
+//their own Chase-Lev deque: the owner pushes and pops at the bottom, idle
+//workers steal from the top of a random victim. The thread that creates the
+//system, the update thread in the engine, counts as thread 0 and owns a
+//deque too; other threads, such as the render thread, hand their
+//jobs in through a shared queue. Threads inside Wait() run jobs instead of
+//blocking, so jobs can start and wait for jobs of their own.
+class JobSystem
+{
+public:
+	//threadCount includes the creating thread; 0 means one per hardware thread,
+	//or PlacementThreadCount() less reservedThreads with a placement. With a
+	//placement every thread, the creating one included, is pinned to its CPU of
+	//PlanThreadCpus(), and the reservedThreads CPUs planned after them are kept
+	//free for threads outside the system, see ReservedCpus().
+	explicit JobSystem(uint32_t threadCount = 0, ThreadPlacement placement = ThreadPlacement::None,
+		uint32_t reservedThreads = 0);
+	//Every job has to be finished by then. Unpins the creating thread if it is the one destroying the system.
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	uint32_t ThreadCount() const { return (uint32_t)mDeques.size(); }
+	ThreadPlacement Placement() const { return mPlacement; }
+	//Indices into CpuTopology::Get().Cpus per thread, empty without placement.
+	const std::vector<uint32_t>& ThreadCpus() const { return mThreadCpus; }
+	//The CPUs kept for other threads, e.g. the render thread, to pin themselves
+	//to. They only overlap ThreadCpus() when the plan wraps around on a machine
+	//with too few cores.
+	const std::vector<uint32_t>& ReservedCpus() const { return mReservedCpus; }
+
+	//Queues work; counter, if any, is incremented now and decremented once work has run.
+	void Run(std::function<void()> work, JobCounter* counter = nullptr);
+	//Queues work once dependency is at zero, which may be right away.
+	void RunAfter(JobCounter& dependency, std::function<void()> work, JobCounter* counter = nullptr);
+	//Runs jobs on the calling thread until counter is at zero.
+	void Wait(JobCounter& counter);
+
+	//Runs body(chunkBegin, chunkEnd) over [begin, end) in chunks of minGrain
+	//elements, the last one possibly shorter, and returns when all are done.
+	//The grain adapts with lazy binary splitting: a thread keeps handing off
+	//half of its range while its own deque is empty, i.e. while someone took
+	//the last half, and works through it chunk by chunk otherwise. Balanced
+	//loops split about log(threads) times, uneven ones as often as needed.
+	void ParallelFor(size_t begin, size_t end, size_t minGrain, const std::function<void(size_t, size_t)>& body);
+
+private:
+	class Deque;
+
+	//This thread's deque, -1 for threads outside the system.
+	int ThreadIndex() const;
+	void Push(Job* job);
+	Job* FindJob(int threadIndex);
+	void Execute(Job* job);
+	void Finish(JobCounter* counter);
+	void Release(JobCounter& counter);
+	bool OwnQueueEmpty(int threadIndex);
+	void RunRange(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body,
+		JobCounter& counter);
+	void WorkerMain(uint32_t index);
+
+	std::vector<std::unique_ptr<Deque>> mDeques;
+	std::vector<std::thread> mWorkers;
+	std::thread::id mOwner;
+	ThreadPlacement mPlacement;
+	std::vector<uint32_t> mThreadCpus;
+	std::vector<uint32_t> mReservedCpus;
+	bool mOwnerPinned = false;
+
+	std::mutex mInjectedMutex;
+	std::deque<Job*> mInjected;
+	std::atomic<size_t> mInjectedCount{ 0 };
+
+	//Jobs queued and not taken yet; workers only sleep while it is zero.
+	std::atomic<int64_t> mQueued{ 0 };
+	std::atomic<uint32_t> mSleeping{ 0 };
+	std::mutex mSleepMutex;
+	std::condition_variable mWakeUp;
+	bool mQuit = false;
+};
+
+//The system ParallelFor and the engine stages run on, created on first use
+//by the thread that asks for it, normally the main thread.
+JobSystem& DefaultJobSystem();
+//Thread count, placement and reserved threads of DefaultJobSystem(); false
+//once it exists already.
+bool ConfigureDefaultJobSystem(uint32_t threadCount, ThreadPlacement placement, uint32_t reservedThreads = 0);
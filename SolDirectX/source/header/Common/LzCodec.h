@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//Byte-oriented LZ77 block codec in the spirit of LZ4: sequences of a token
+//(literal and match length nibbles), the literals and a 16-bit match offset.
+//There is no entropy stage, which keeps decoding at memory speed; use it for
+//data that is compressed once and decoded often.
+
+//Worst case size of the compressed form of size bytes.
+size_t LzCompressBound(size_t size);
+
+//Compresses src into dst, which must hold LzCompressBound(size) bytes.
+//Returns the compressed size.
+size_t LzCompress(const uint8_t* src, size_t size, uint8_t* dst);
+
+//Decompresses exactly dstSize bytes. Returns false on malformed input,
+//never reading or writing outside the given ranges.
+bool LzDecompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
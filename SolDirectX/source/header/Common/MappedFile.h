@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+//A whole file mapped into the address space. Pages are read in by the OS on
+//first touch, so nothing is copied until the data is used. The mapping is
+//copy-on-write: writes stay private to the process and never reach the file.
+//Shared by everything that points into it (see LoadMeshGeometry).
+class MappedFile
+{
+public:
+	//Returns null and sets error when the file cannot be opened or mapped.
+	static std::shared_ptr<MappedFile> Open(const std::string& path, std::string* error = nullptr);
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	uint8_t* Data() const { return mData; }
+	size_t Size() const { return mSize; }
+
+	//Asks the OS to start reading [offset, offset + size) ahead of use.
+	void Prefetch(size_t offset, size_t size) const;
+
+private:
+	MappedFile() = default;
+
+	uint8_t* mData = nullptr;
+	size_t mSize = 0;
+#if defined(_WIN32)
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#endif
+};
@@ -2,12 +2,19 @@
 
 #include <Windows.h>
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
 #include <cstdint>
+#include "MatrixBatch.h"
+#include "Random.h"
 
 class MathHelper {
 public:
+	//Uniform in [0, 1) from the generator of the calling thread, see Random.h.
 	static float RandF() {
-		return (float)(rand()) / (float)RAND_MAX;
+		return ThreadRandom().NextFloat();
+	}
+	static float RandF(float a, float b) {
+		return ThreadRandom().NextFloat(a, b);
 	}
 	static DirectX::XMFLOAT4X4 Identity4x4() {
 		static DirectX::XMFLOAT4X4 I(
@@ -18,4 +25,56 @@ public:
 		);
 		return I;
 	}
+
+	//Extracts the six frustum planes (left, right, bottom, top, near, far) from a
+	//view-projection matrix, for row vectors and D3D clip space (0 <= z <= w).
+	//Planes are normalized and their normals point into the frustum.
+	static void ExtractFrustumPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 planes[6]) {
+		DirectX::XMFLOAT4X4 m;
+		DirectX::XMStoreFloat4x4(&m, viewProj);
+		DirectX::XMVECTOR col[4];
+		for (int c = 0; c < 4; ++c) {
+			col[c] = DirectX::XMVectorSet(m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c]);
+		}
+
+		DirectX::XMVECTOR p[6] = {
+			DirectX::XMVectorAdd(col[3], col[0]),
+			DirectX::XMVectorSubtract(col[3], col[0]),
+			DirectX::XMVectorAdd(col[3], col[1]),
+			DirectX::XMVectorSubtract(col[3], col[1]),
+			col[2],
+			DirectX::XMVectorSubtract(col[3], col[2])
+		};
+		for (int i = 0; i < 6; ++i) {
+			DirectX::XMStoreFloat4(&planes[i], DirectX::XMPlaneNormalize(p[i]));
+		}
+	}
+
+	//Batch versions for arrays of matrices and boxes, running the SIMD kernels
+	//of MatrixBatch.h. Strides are in bytes, so the arrays may be members of
+	//larger structures (e.g. &items[0].World with sizeof(RenderItem)).
+	//transpose writes the results transposed, the way shader constants want them.
+	static void MultiplyMatrices(const DirectX::XMFLOAT4X4* src, size_t srcStride, DirectX::FXMMATRIX m,
+		DirectX::XMFLOAT4X4* dst, size_t dstStride, size_t count, bool transpose) {
+		DirectX::XMFLOAT4X4 stored;
+		DirectX::XMStoreFloat4x4(&stored, m);
+		::MultiplyMatrices(&src->m[0][0], srcStride, &stored.m[0][0], &dst->m[0][0], dstStride, count, transpose);
+	}
+	static void TransposeMatrices(const DirectX::XMFLOAT4X4* src, size_t srcStride,
+		DirectX::XMFLOAT4X4* dst, size_t dstStride, size_t count) {
+		::TransposeMatrices(&src->m[0][0], srcStride, &dst->m[0][0], dstStride, count);
+	}
+	//Normal matrices, the inverse transpose of the upper 3x3 of every matrix.
+	static void InverseTransposeMatrices(const DirectX::XMFLOAT4X4* src, size_t srcStride,
+		DirectX::XMFLOAT4X4* dst, size_t dstStride, size_t count, bool transpose) {
+		::InverseTransposeMatrices(&src->m[0][0], srcStride, &dst->m[0][0], dstStride, count, transpose);
+	}
+	//Axis-aligned world bounds like BoundingBox::Transform, for affine matrices;
+	//a worldStride of 0 uses one matrix for all boxes.
+	static void TransformBoxes(const DirectX::BoundingBox* boxes, size_t boxStride,
+		const DirectX::XMFLOAT4X4* worlds, size_t worldStride, DirectX::BoundingBox* dst, size_t count) {
+		static_assert(sizeof(DirectX::BoundingBox) == 6 * sizeof(float), "center and extents, packed");
+		::TransformAabbs(&boxes->Center.x, boxStride, &worlds->m[0][0], worldStride, &dst->Center.x,
+			sizeof(DirectX::BoundingBox), count);
+	}
 };
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+
+//Batch kernels over arrays of 4x4 matrices and boxes, for bulk transform
+//work such as filling constant or instance buffers. Matrices are 16 floats,
+//row-major with the row vector convention (the layout of DirectX::XMFLOAT4X4);
+//boxes are a center and extents of 3 floats each (DirectX::BoundingBox).
+//Every array is addressed with a stride in bytes, a multiple of 4, so the
+//kernels read straight out of larger structures and write straight into
+//constant buffers. Each kernel has AVX-512, AVX2/FMA and scalar versions;
+//the plain functions use the best one the CPU supports. Nothing here
+//depends on D3D, so the kernels build and run on Linux as well; MathHelper
+//wraps them for the DirectXMath types.
+
+enum class MatrixKernelLevel
+{
+	Scalar,
+	AVX2,
+	AVX512,
+};
+
+struct MatrixKernels
+{
+	void (*Multiply)(const float* src, size_t srcStride, const float m[16], float* dst, size_t dstStride,
+		size_t count, bool transpose);
+	void (*Transpose)(const float* src, size_t srcStride, float* dst, size_t dstStride, size_t count);
+	void (*InverseTranspose)(const float* src, size_t srcStride, float* dst, size_t dstStride,
+		size_t count, bool transpose);
+	void (*TransformAabbs)(const float* boxes, size_t boxStride, const float* matrices, size_t matrixStride,
+		float* dst, size_t dstStride, size_t count);
+};
+
+//The highest level the CPU supports.
+MatrixKernelLevel BestMatrixKernelLevel();
+//The kernels of one level, e.g. to compare them; the level has to be supported.
+const MatrixKernels& GetMatrixKernels(MatrixKernelLevel level);
+
+//dst[i] = src[i] * m, or its transpose, which is how shaders expect constants.
+void MultiplyMatrices(const float* src, size_t srcStride, const float m[16], float* dst, size_t dstStride,
+	size_t count, bool transpose);
+
+//dst[i] = transpose(src[i]).
+void TransposeMatrices(const float* src, size_t srcStride, float* dst, size_t dstStride, size_t count);
+
+//Normal matrices: the inverse transpose of the upper 3x3 of src[i] as a 4x4
+//without translation, or its transpose. Singular matrices give zero.
+void InverseTransposeMatrices(const float* src, size_t srcStride, float* dst, size_t dstStride,
+	size_t count, bool transpose);
+
+//World space bounds of boxes[i] transformed by matrices[i], which have to be
+//affine. A matrixStride of 0 applies one matrix to every box.
+void TransformAabbs(const float* boxes, size_t boxStride, const float* matrices, size_t matrixStride,
+	float* dst, size_t dstStride, size_t count);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+//Number of threads taking part in a ParallelFor, the calling thread included.
+uint32_t ParallelWorkerCount();
+
+//Splits [begin, end) into chunks of at least minGrain elements and runs
+//body(chunkBegin, chunkEnd) for each of them on the worker threads of
+//DefaultJobSystem(), see JobSystem::ParallelFor. The calling thread works on
+//chunks too and returns once all of them are done. Calls made from inside a
+//body are split among the threads as well, so a body must not hold a lock
+//across one: the waiting thread runs other chunks meanwhile.
+void ParallelFor(size_t begin, size_t end, size_t minGrain,
+	const std::function<void(size_t, size_t)>& body);
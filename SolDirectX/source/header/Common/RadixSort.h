@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Scratch memory for RadixSort64, kept around so that sorting every frame
+//does not allocate.
+struct RadixSortScratch
+{
+	std::vector<uint64_t> Keys;
+	std::vector<uint32_t> Values;
+	std::vector<size_t> Histograms;
+};
+
+//Stable LSD radix sort of 64-bit keys carrying a 32-bit payload, 11 bits per pass.
+//Every pass is split into blocks sorted in parallel; passes whose digit is the
+//same for every key are skipped, so keys with few used bits sort in few passes.
+void RadixSort64(uint64_t* keys, uint32_t* values, size_t count, RadixSortScratch& scratch);
+
+//The same sort without a payload, for keys that carry their own in the low bits.
+//Only the bits from firstBit up are sorted on. The sort is stable, so keys
+//whose low bits already grow with their position, such as an index, still
+//come out fully ordered, in fewer passes.
+void RadixSort64(uint64_t* keys, size_t count, RadixSortScratch& scratch, uint32_t firstBit = 0);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//Pseudo random numbers for simulation and procedural generation. Not for
+//anything security related.
+//
+//Random is a sequential generator (xoshiro256** by Blackman and Vigna)
+//whose state is derived from a seed and a stream number, so every job,
+//object or chunk can own an independent stream: keying streams by work item
+//instead of by thread keeps results reproducible at any thread count.
+//
+//The Fill functions are counter based instead: value i of a fill is a hash
+//of the seed and the counter first + i and depends on nothing else, so a
+//range split among any number of threads, in any chunks, produces exactly
+//the values of one call over the whole range. They run 8 values at a time
+//with AVX2 where available; the scalar versions fuse the same multiply-adds
+//(fmaf), so the results are bit-identical on every CPU as well.
+class Random
+{
+public:
+	explicit Random(uint64_t seed = 0, uint64_t stream = 0);
+
+	uint64_t NextU64();
+	uint32_t NextU32() { return (uint32_t)(NextU64() >> 32); }
+	//Uniform in [0, bound) without modulo bias (Lemire's method).
+	uint32_t NextBelow(uint32_t bound);
+	//Uniform in [0, 1), 24 random bits.
+	float NextFloat() { return (float)(NextU32() >> 8) * (1.0f / 16777216.0f); }
+	float NextFloat(float min, float max) { return min + NextFloat() * (max - min); }
+
+	//Advances by 2^128 values, for streams that may never overlap.
+	void Jump();
+
+private:
+	uint64_t mState[4];
+};
+
+//The generator of the calling thread. Threads get streams 0, 1, 2, ... of
+//the global seed in the order they first ask for one, so only the sequence
+//of a single thread is reproducible; parallel work should use streams or
+//fills of its own.
+Random& ThreadRandom();
+//Reseeds the global seed and the generator of the calling thread as stream 0.
+void SeedThreadRandom(uint64_t seed);
+
+//32 random bits for counter of the seed; the function behind the fills.
+uint32_t RandomHash(uint64_t seed, uint64_t counter);
+
+void FillRandomUint32(uint32_t* dst, size_t count, uint64_t seed, uint64_t first = 0);
+//Uniform in [min, max]; max itself only comes out through rounding.
+void FillRandomFloats(float* dst, size_t count, float min, float max, uint64_t seed, uint64_t first = 0);
+//Packed xyz triples uniform in the box [min, max]; value i uses the counters
+//3 * (first + i) to 3 * (first + i) + 2.
+void FillRandomVectors(float* dst, size_t count, const float min[3], const float max[3], uint64_t seed,
+	uint64_t first = 0);
+//Packed xyz triples uniform on the unit sphere, with the counters as above.
+void FillRandomUnitVectors(float* dst, size_t count, uint64_t seed, uint64_t first = 0);
+
+//Scalar versions, to compare the fills against.
+namespace RandomScalar {
+	void FillUint32(uint32_t* dst, size_t count, uint64_t seed, uint64_t first);
+	void FillFloats(float* dst, size_t count, float min, float max, uint64_t seed, uint64_t first);
+	void FillVectors(float* dst, size_t count, const float min[3], const float max[3], uint64_t seed, uint64_t first);
+	void FillUnitVectors(float* dst, size_t count, uint64_t seed, uint64_t first);
+}
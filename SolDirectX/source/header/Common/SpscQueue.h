@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+//Bounded ring buffer between exactly one producer thread and one consumer
+//thread, without locks: the producer only writes mTail, the consumer only
+//mHead, each on its own cache line. Either side keeps a copy of the other's
+//index and only reloads it when the ring looks full or empty, so a push or
+//pop normally touches no shared line but the slot. Push() and Pop() sleep
+//on the index through C++20 atomic wait instead of spinning.
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	SpscQueue() = default;
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	//Producer only. False when the queue is full.
+	bool TryPush(const T& value)
+	{
+		const size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mCachedHead == Capacity) {
+			mCachedHead = mHead.load(std::memory_order_acquire);
+			if (tail - mCachedHead == Capacity) {
+				return false;
+			}
+		}
+		mItems[tail & (Capacity - 1)] = value;
+		mTail.store(tail + 1, std::memory_order_release);
+		mTail.notify_one();
+		return true;
+	}
+
+	//Producer only. Waits while the queue is full.
+	void Push(const T& value)
+	{
+		while (!TryPush(value)) {
+			mHead.wait(mCachedHead, std::memory_order_acquire);
+		}
+	}
+
+	//Consumer only. False when the queue is empty.
+	bool TryPop(T& value)
+	{
+		const size_t head = mHead.load(std::memory_order_relaxed);
+		if (head == mCachedTail) {
+			mCachedTail = mTail.load(std::memory_order_acquire);
+			if (head == mCachedTail) {
+				return false;
+			}
+		}
+		value = mItems[head & (Capacity - 1)];
+		mHead.store(head + 1, std::memory_order_release);
+		mHead.notify_one();
+		return true;
+	}
+
+	//Consumer only. Waits while the queue is empty.
+	T Pop()
+	{
+		T value;
+		while (!TryPop(value)) {
+			mTail.wait(mCachedTail, std::memory_order_acquire);
+		}
+		return value;
+	}
+
+	//Exact on either side for what that side did, a snapshot otherwise.
+	size_t Size() const
+	{
+		return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+	}
+
+private:
+	//Consumer side.
+	alignas(64) std::atomic<size_t> mHead{ 0 };
+	size_t mCachedTail = 0;
+	//Producer side.
+	alignas(64) std::atomic<size_t> mTail{ 0 };
+	size_t mCachedHead = 0;
+	alignas(64) T mItems[Capacity];
+};
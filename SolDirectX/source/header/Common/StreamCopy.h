@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+//Copies into memory the CPU only writes, such as mapped upload heaps. Those
+//are write-combined: stores gather in a line sized buffer and go out over
+//the bus when it fills or gets flushed, so scattered, partial or read-back
+//writes each cost a bus transaction. The copies here write whole aligned
+//64 byte lines with non-temporal stores where they can, plain stores only
+//for the unaligned head and the tail, and end with a store fence so the
+//data is visible before the command list that reads it is submitted.
+//
+//On ordinary cached memory the stores bypass the caches as well, which is
+//what you want for large buffers nobody reads back; small copies that stay
+//in cache are faster with memcpy. Nothing here depends on D3D, so the
+//copies build and run on Linux.
+
+enum class StreamCopyLevel
+{
+	SSE2,
+	AVX2,
+};
+
+struct StreamCopyKernels
+{
+	void (*Copy)(void* dst, const void* src, size_t size);
+	void (*CopyStrided)(void* dst, size_t dstStride, const void* src, size_t srcStride, size_t elementSize,
+		size_t count);
+};
+
+//The highest level the CPU supports.
+StreamCopyLevel BestStreamCopyLevel();
+//The kernels of one level, e.g. to compare them; the level has to be supported.
+const StreamCopyKernels& GetStreamCopyKernels(StreamCopyLevel level);
+
+//memcpy with streaming stores. Keep dst 64 byte aligned to write whole lines.
+void StreamCopy(void* dst, const void* src, size_t size);
+
+//count elements of elementSize bytes, e.g. constants into a constant buffer
+//whose elements are padded to 256 bytes. When dst and dstStride are multiples
+//of 64 and the stride has room for it, the last line of every element is
+//written whole, the bytes after the element zeroed, so no partial lines reach
+//the bus; everything past that line up to the next element stays untouched.
+void StreamCopyStrided(void* dst, size_t dstStride, const void* src, size_t srcStride, size_t elementSize,
+	size_t count);
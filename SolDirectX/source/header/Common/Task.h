@@ -0,0 +1,335 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//Coroutine tasks for work that waits for the GPU, the disk or the next frame
+//without blocking a thread, so load and upload flows read top to bottom:
+//
+//	Task<void> LoadScenery(const std::string& path)
+//	{
+//		FileData file = co_await ReadFileAsync(path);
+//		...record the upload and signal fenceValue...
+//		co_await WaitForFence(fenceValue);
+//		...release the upload buffers...
+//	}
+//	scheduler.Spawn(LoadScenery("scenery.mesh"));
+//
+//A task starts when it is spawned or co_awaited by another task, and resumes
+//only inside TaskScheduler::Tick(), on the thread calling it, so task code
+//needs no locks against the frame. Coroutine frames come from pooled size
+//classes instead of the general heap.
+
+using TaskId = uint64_t;
+class TaskScheduler;
+
+//Frame memory of the promises: per thread free lists in 64 byte size classes
+//up to 4 KB; larger frames go to operator new.
+void* AllocateCoroutineFrame(size_t size);
+void FreeCoroutineFrame(void* frame, size_t size);
+
+//Of the calling thread.
+struct CoroutineFrameStats
+{
+	uint64_t Allocations = 0;
+	//Allocations served from a free list.
+	uint64_t Reused = 0;
+	//Allocations too large for the size classes.
+	uint64_t Large = 0;
+};
+CoroutineFrameStats GetCoroutineFrameStats();
+
+template<typename T = void>
+class Task;
+
+//What every task promise shares. Scheduler and Id are those of the spawned
+//task at the root of the chain; a task awaited by another inherits them.
+struct TaskPromiseBase
+{
+	static void* operator new(size_t size) { return AllocateCoroutineFrame(size); }
+	static void operator delete(void* frame, size_t size) { FreeCoroutineFrame(frame, size); }
+
+	//Resumes the awaiting task, if any, without growing the stack.
+	struct FinalAwaiter
+	{
+		bool await_ready() const noexcept { return false; }
+		template<typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+		{
+			std::coroutine_handle<> continuation = handle.promise().Continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+		void await_resume() const noexcept {}
+	};
+
+	std::suspend_always initial_suspend() const noexcept { return {}; }
+	FinalAwaiter final_suspend() const noexcept { return {}; }
+	void unhandled_exception() { Exception = std::current_exception(); }
+
+	void RethrowIfFailed() const
+	{
+		if (Exception) {
+			std::rethrow_exception(Exception);
+		}
+	}
+
+	TaskScheduler* Scheduler = nullptr;
+	TaskId Id = 0;
+	std::coroutine_handle<> Continuation;
+	std::exception_ptr Exception;
+};
+
+template<typename T>
+struct TaskPromise : TaskPromiseBase
+{
+	Task<T> get_return_object();
+
+	template<typename U>
+	void return_value(U&& value) { Value.emplace(std::forward<U>(value)); }
+
+	T TakeResult()
+	{
+		RethrowIfFailed();
+		return std::move(*Value);
+	}
+
+	std::optional<T> Value;
+};
+
+template<>
+struct TaskPromise<void> : TaskPromiseBase
+{
+	Task<void> get_return_object();
+	void return_void() const {}
+	void TakeResult() const { RethrowIfFailed(); }
+};
+
+//Owns its coroutine frame. co_await runs the task and gives back its result,
+//or rethrows its exception.
+template<typename T>
+class Task
+{
+public:
+	using promise_type = TaskPromise<T>;
+	using Handle = std::coroutine_handle<promise_type>;
+
+	Task() = default;
+	explicit Task(Handle handle) : mHandle(handle) {}
+	Task(Task&& rhs) noexcept : mHandle(std::exchange(rhs.mHandle, nullptr)) {}
+	Task& operator=(Task&& rhs) noexcept
+	{
+		if (this != &rhs) {
+			Reset();
+			mHandle = std::exchange(rhs.mHandle, nullptr);
+		}
+		return *this;
+	}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task() { Reset(); }
+
+	bool Done() const { return !mHandle || mHandle.done(); }
+	Handle GetHandle() const { return mHandle; }
+
+	bool await_ready() const noexcept { return false; }
+	template<typename Promise>
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> awaiting) noexcept
+	{
+		promise_type& promise = mHandle.promise();
+		promise.Scheduler = awaiting.promise().Scheduler;
+		promise.Id = awaiting.promise().Id;
+		promise.Continuation = awaiting;
+		return mHandle;
+	}
+	T await_resume() { return mHandle.promise().TakeResult(); }
+
+private:
+	void Reset()
+	{
+		if (mHandle) {
+			mHandle.destroy();
+			mHandle = nullptr;
+		}
+	}
+
+	Handle mHandle;
+};
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object()
+{
+	return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+	return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+//What ReadFileAsync() gives back.
+struct FileData
+{
+	bool Ok = false;
+	std::vector<uint8_t> Bytes;
+	std::string Error;
+};
+
+//Drives spawned tasks. One per thread that runs a frame loop, normally the
+//main thread; Spawn(), Cancel() and Tick() are called from that thread only.
+class TaskScheduler
+{
+public:
+	TaskScheduler() = default;
+	//Destroys the tasks still running, as Cancel() would.
+	~TaskScheduler();
+
+	TaskScheduler(const TaskScheduler&) = delete;
+	TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+	//Where WaitForFence() gets the completed fence value, e.g. from
+	//ID3D12Fence::GetCompletedValue(). Fences are polled once per Tick().
+	void SetFenceSource(std::function<uint64_t()> completedValue) { mFenceSource = std::move(completedValue); }
+
+	//Runs task right away up to its first suspension. An exception that
+	//escapes the task is rethrown here or from the Tick() that resumed it.
+	TaskId Spawn(Task<void> task);
+	//Destroys the task where it is suspended: the destructors of its locals
+	//and of every task it awaits run, it never resumes. A task cancelling
+	//itself is destroyed at its next suspension. Finished tasks are ignored.
+	void Cancel(TaskId id);
+	//Finished, failed or cancelled.
+	bool Finished(TaskId id) const { return mTasks.find(id) == mTasks.end(); }
+	size_t RunningTasks() const { return mTasks.size(); }
+
+	//Resumes, in this order: tasks whose file read completed, in completion
+	//order; tasks whose fence was reached, lowest value first and in waiting
+	//order for equal values; tasks waiting for the next frame, in waiting
+	//order. A task that waits again during Tick() resumes in a later Tick().
+	void Tick();
+	uint64_t FrameIndex() const { return mFrameIndex; }
+
+	//Behind the awaitables below.
+	void WaitFrame(TaskId id, std::coroutine_handle<> handle);
+	//False if the fence is reached already and the task goes on.
+	bool WaitFence(TaskId id, std::coroutine_handle<> handle, uint64_t value);
+	void ReadFile(TaskId id, std::coroutine_handle<> handle, const std::string& path, FileData* result);
+
+private:
+	struct Root
+	{
+		Task<void> Body;
+		bool Running = false;
+		bool CancelRequested = false;
+	};
+
+	struct Waiter
+	{
+		TaskId Id;
+		std::coroutine_handle<> Handle;
+		uint64_t Value;
+	};
+
+	struct FileRead
+	{
+		TaskId Id;
+		std::coroutine_handle<> Handle;
+		std::string Path;
+		FileData Data;
+		//Only written when the task is still alive, see Tick().
+		FileData* Result;
+	};
+
+	//One thread reading files in request order, so blocking reads never sit
+	//on the job workers. Shared with the thread, which may outlive a read's task.
+	struct FileReader
+	{
+		std::mutex Mutex;
+		std::condition_variable WakeUp;
+		std::deque<std::unique_ptr<FileRead>> Requests;
+		std::vector<std::unique_ptr<FileRead>> Completed;
+		bool Quit = false;
+	};
+
+	void Resume(TaskId id, std::coroutine_handle<> handle);
+
+	std::unordered_map<TaskId, std::unique_ptr<Root>> mTasks;
+	TaskId mNextId = 1;
+	uint64_t mFrameIndex = 0;
+	std::exception_ptr mFailure;
+
+	std::vector<Waiter> mFrameWaiters;
+	std::vector<Waiter> mFenceWaiters;
+	std::function<uint64_t()> mFenceSource;
+
+	std::shared_ptr<FileReader> mFileReader;
+	std::thread mFileThread;
+};
+
+//co_await NextFrame(): resumes in the next Tick().
+struct NextFrameAwaiter
+{
+	bool await_ready() const noexcept { return false; }
+	template<typename Promise>
+	void await_suspend(std::coroutine_handle<Promise> handle)
+	{
+		handle.promise().Scheduler->WaitFrame(handle.promise().Id, handle);
+	}
+	void await_resume() const noexcept {}
+};
+
+inline NextFrameAwaiter NextFrame()
+{
+	return {};
+}
+
+//co_await WaitForFence(value): resumes once the fence source reports value.
+struct FenceAwaiter
+{
+	bool await_ready() const noexcept { return false; }
+	template<typename Promise>
+	bool await_suspend(std::coroutine_handle<Promise> handle)
+	{
+		return handle.promise().Scheduler->WaitFence(handle.promise().Id, handle, Value);
+	}
+	void await_resume() const noexcept {}
+
+	uint64_t Value;
+};
+
+inline FenceAwaiter WaitForFence(uint64_t value)
+{
+	return { value };
+}
+
+//co_await ReadFileAsync(path): the whole file, read on the scheduler's file thread.
+struct FileAwaiter
+{
+	bool await_ready() const noexcept { return false; }
+	template<typename Promise>
+	void await_suspend(std::coroutine_handle<Promise> handle)
+	{
+		handle.promise().Scheduler->ReadFile(handle.promise().Id, handle, Path, &Result);
+	}
+	FileData await_resume() { return std::move(Result); }
+
+	std::string Path;
+	FileData Result;
+};
+
+inline FileAwaiter ReadFileAsync(std::string path)
+{
+	return { std::move(path), {} };
+}
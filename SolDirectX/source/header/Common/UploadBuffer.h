@@ -1,11 +1,13 @@
 #pragma once
 
 #include "../d3dUtil.h"
+#include "StreamCopy.h"
 
 template<typename T>
 class UploadBuffer {
 public:
 	UploadBuffer(ID3D12Device* device, UINT elementCount, bool isConstantBuffer) :
+		mElementCount(elementCount),
 		mIsConstantBuffer(isConstantBuffer)
 	{
 		mElementByteSize = sizeof(T);
@@ -43,14 +45,30 @@ public:
 		return mUploadBuffer.Get();
 	}
 
+	UINT ElementCount()const
+	{
+		return mElementCount;
+	}
+
+	//The mapped memory is write-combined: never read it back, and write it in
+	//whole lines with streaming stores instead of memcpy.
 	void CopyData(int elementIndex, const T& data)
 	{
-		memcpy(&mMappedData[elementIndex * mElementByteSize], &data, sizeof(T));
+		StreamCopy(&mMappedData[elementIndex * mElementByteSize], &data, sizeof(T));
+	}
+
+	//count consecutive elements at once, with a single fence at the end.
+	void CopyData(int firstElement, const T* data, int count)
+	{
+		assert(firstElement >= 0 && count >= 0 && (UINT)(firstElement + count) <= mElementCount);
+		StreamCopyStrided(&mMappedData[firstElement * mElementByteSize], mElementByteSize, data, sizeof(T),
+			sizeof(T), count);
 	}
 
 private:
 	Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
 	BYTE* mMappedData = nullptr;
 	UINT mElementByteSize = 0;
+	UINT mElementCount = 0;
 	bool mIsConstantBuffer = false;
 };
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//Lossless codecs for index and vertex buffers, used by compressed mesh files.
+//
+//Indices: every triangle starts with a code byte. A triangle that shares an
+//edge with one of the 16 most recent edges (strips, fans and most of what
+//the vertex cache optimizer emits) stores which edge, where it starts in the
+//triangle and the third vertex; other triangles store all three vertices. A
+//vertex is either the next one never referenced before, which costs nothing
+//more, or a zigzag varint delta to the last vertex that was stored explicitly.
+//
+//Vertices: blocks of VertexCodecBlockSize vertices are transposed into byte
+//planes (byte k of every vertex), where neighbouring vertices of a mesh in
+//cache order differ by small amounts. The zigzagged byte deltas are stored in
+//groups of 16 with 0, 2, 4 or 8 bits each, picked per group by a 2-bit header
+//- a fixed-length prefix code that SSE2 unpacks without branching per byte.
+//Any stride up to VertexCodecMaxStride works; multiples of 4 take the fast
+//transposition path.
+
+const size_t VertexCodecBlockSize = 256;
+const size_t VertexCodecMaxStride = 256;
+
+//Worst case encoded sizes.
+size_t IndexCodecBound(size_t indexCount);
+size_t VertexCodecBound(size_t vertexCount, size_t stride);
+
+//Encodes a triangle list, indexCount must be a multiple of 3. dst must hold
+//IndexCodecBound(indexCount) bytes. Returns the encoded size.
+size_t EncodeIndexBuffer(const uint32_t* indices, size_t indexCount, uint8_t* dst);
+
+//Decodes exactly indexCount indices. Returns false on malformed input and, for
+//16-bit output, on indices that do not fit; never reads outside src.
+bool DecodeIndexBuffer(const uint8_t* src, size_t srcSize, uint32_t* dst, size_t indexCount);
+bool DecodeIndexBuffer(const uint8_t* src, size_t srcSize, uint16_t* dst, size_t indexCount);
+
+//Encodes vertexCount interleaved vertices of stride bytes. dst must hold
+//VertexCodecBound(vertexCount, stride) bytes. Returns the encoded size.
+size_t EncodeVertexBuffer(const uint8_t* vertices, size_t vertexCount, size_t stride, uint8_t* dst);
+
+//Decodes exactly vertexCount vertices. Returns false on malformed input,
+//never reading outside src.
+bool DecodeVertexBuffer(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t vertexCount, size_t stride);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "VertexFormat.h"
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//A range of triangles of a MeshData drawn on its own, the CPU side
+//counterpart of SubmeshGeometry.
+struct MeshPart
+{
+	std::string Name;
+	uint32_t IndexStart = 0;
+	uint32_t IndexCount = 0;
+	int32_t BaseVertex = 0;
+
+	//Levels of detail follow the part they simplify, sharing its vertices.
+	//LodError is their object space deviation from that part.
+	uint32_t Lod = 0;
+	float LodError = 0.0f;
+
+	//Range of the part's clusters in MeshData::Meshlets, see BuildMeshlets.
+	uint32_t MeshletStart = 0;
+	uint32_t MeshletCount = 0;
+};
+
+//A cluster of triangles of a part with a bounded number of vertices. Its
+//triangles are contiguous in the index buffer, so a culled set of meshlets
+//is still drawn with plain indexed draws; the local vertex list and 8-bit
+//triangle indices are the layout mesh shaders consume.
+struct Meshlet
+{
+	//Relative to the IndexStart of the part.
+	uint32_t IndexStart = 0;
+	uint32_t TriangleCount = 0;
+	//Into MeshData::MeshletVertices and MeshData::MeshletTriangles (3 per triangle).
+	uint32_t VertexStart = 0;
+	uint32_t VertexCount = 0;
+	uint32_t TriangleStart = 0;
+
+	//Object space bounding sphere.
+	float Center[3] = { 0.0f, 0.0f, 0.0f };
+	float Radius = 0.0f;
+	//Every triangle faces away from a viewer at p when
+	//dot(Center - p, ConeAxis) >= ConeCutoff * |Center - p| + Radius.
+	//ConeCutoff is 1 when the normals spread too far for the test to ever pass.
+	float ConeAxis[3] = { 0.0f, 0.0f, 1.0f };
+	float ConeCutoff = 1.0f;
+};
+
+//Mesh data in system memory, independent of D3D so that offline tools can
+//use it as well. Vertices are interleaved as described by Format, the
+//position always comes first; indices form a triangle list.
+//Quantized meshes carry the dequantization of their positions; processing
+//that reads positions (optimization, LODs, meshlets) runs before quantizing.
+struct MeshData
+{
+	std::string Name;
+	uint32_t VertexStride = 0;
+	VertexFormat Format;
+	PositionDequantization Dequantization;
+	std::vector<uint8_t> Vertices;
+	std::vector<uint32_t> Indices;
+	std::vector<MeshPart> Parts;
+
+	std::vector<Meshlet> Meshlets;
+	//Vertices of every meshlet as index buffer values.
+	std::vector<uint32_t> MeshletVertices;
+	std::vector<uint8_t> MeshletTriangles;
+
+	uint32_t VertexCount() const { return VertexStride ? (uint32_t)(Vertices.size() / VertexStride) : 0; }
+	//16-bit indices suffice when every index of every part stays below 0xFFFF,
+	//the strip cut value.
+	bool Fits16BitIndices() const
+	{
+		for (const MeshPart& part : Parts) {
+			for (uint32_t i = 0; i < part.IndexCount; ++i) {
+				if (Indices[part.IndexStart + i] >= 0xFFFF) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+	const float* Position(uint32_t vertex) const
+	{
+		assert(Format.Position == PositionFormat::Float3);
+		return reinterpret_cast<const float*>(Vertices.data() + (size_t)vertex * VertexStride);
+	}
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "MeshData.h"
+
+//Binary mesh container, laid out so that a memory-mapped file can be handed
+//to the GPU uploader without any parsing or copying:
+//
+//  MeshFileHeader | part table | vertices | indices | meshlets | meshlet vertices | meshlet triangles
+//
+//Every stream starts at a multiple of MeshFileAlignment from the start of the
+//file and is stored exactly as the renderer consumes it: interleaved vertices
+//in their final format, indices already narrowed to 16 bits when they fit.
+//Part bounds are precomputed so loading never decodes a vertex.
+//With MeshFileCompressed the vertex and index streams are stored with the
+//GeometryCodec instead; they are decoded into the upload buffers, trading
+//the zero copy load for a fraction of the IO.
+//All values are little endian.
+const uint32_t MeshFileMagic = 0x4D4C4F53; //"SOLM"
+const uint32_t MeshFileVersion = 2;
+const uint32_t MeshFileAlignment = 64;
+const uint32_t MeshFileNameLength = 64;
+
+//MeshFileHeader::Flags
+const uint32_t MeshFileCompressed = 1;
+
+enum MeshFileStream : uint32_t
+{
+	MeshFileStreamParts,
+	MeshFileStreamVertices,
+	MeshFileStreamIndices,
+	MeshFileStreamMeshlets,
+	MeshFileStreamMeshletVertices,
+	MeshFileStreamMeshletTriangles,
+	MeshFileStreamCount
+};
+
+struct MeshFileRange
+{
+	uint64_t Offset;
+	uint64_t Size;
+};
+
+struct MeshFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t Flags;
+	uint32_t Reserved;
+	uint64_t FileSize;
+	char Name[MeshFileNameLength];
+
+	uint32_t VertexCount;
+	uint32_t VertexStride;
+	uint8_t PositionFormat;
+	uint8_t NormalFormat;
+	uint8_t ColorFormat;
+	//2 or 4 bytes.
+	uint8_t IndexSize;
+	uint32_t IndexCount;
+	uint32_t PartCount;
+	uint32_t MeshletCount;
+	float DequantizationScale[3];
+	float DequantizationBias[3];
+
+	MeshFileRange Streams[MeshFileStreamCount];
+};
+
+struct MeshFilePart
+{
+	char Name[MeshFileNameLength];
+	uint32_t IndexStart;
+	uint32_t IndexCount;
+	int32_t BaseVertex;
+	uint32_t Lod;
+	float LodError;
+	uint32_t MeshletStart;
+	uint32_t MeshletCount;
+	float BoundsMin[3];
+	float BoundsMax[3];
+	uint32_t Reserved[3];
+};
+
+static_assert(sizeof(MeshFileHeader) == 232, "the header layout is part of the file format");
+static_assert(sizeof(MeshFilePart) == 128, "the part layout is part of the file format");
+static_assert(sizeof(Meshlet) == 52, "meshlets are stored as they are in memory");
+
+//Writes mesh in its current vertex format, with compressed vertex and index
+//streams if compress is set. Returns false and sets error when the file
+//cannot be written or a name does not fit.
+bool WriteMeshFile(const MeshData& mesh, const std::string& path, bool compress, std::string* error = nullptr);
+
+//Read-only access to a mesh file in memory (usually a MappedFile). Open()
+//validates the header, that every stream, part and meshlet lies inside the
+//data and that stored indices address existing vertices; afterwards the
+//accessors point straight into it.
+class MeshFileView
+{
+public:
+	bool Open(const void* data, size_t size, std::string* error = nullptr);
+
+	const MeshFileHeader& Header() const { return *mHeader; }
+	std::string Name() const;
+	VertexFormat Format() const;
+	PositionDequantization Dequantization() const;
+
+	//Offset of a stream from the start of the data and its size in bytes.
+	const MeshFileRange& Stream(MeshFileStream stream) const { return mHeader->Streams[stream]; }
+	const uint8_t* StreamData(MeshFileStream stream) const { return mData + Stream(stream).Offset; }
+
+	const MeshFilePart* Parts() const { return reinterpret_cast<const MeshFilePart*>(StreamData(MeshFileStreamParts)); }
+	uint32_t PartCount() const { return mHeader->PartCount; }
+	MeshPart Part(uint32_t part) const;
+	const Meshlet* Meshlets() const { return reinterpret_cast<const Meshlet*>(StreamData(MeshFileStreamMeshlets)); }
+	uint32_t MeshletCount() const { return mHeader->MeshletCount; }
+
+	//Whether the vertex and index streams are compressed; if not, they can be
+	//used in place.
+	bool Compressed() const { return (mHeader->Flags & MeshFileCompressed) != 0; }
+	//Sizes of the vertex and index buffers, VertexCount * VertexStride and
+	//IndexCount * IndexSize bytes.
+	uint64_t VertexBytes() const { return (uint64_t)mHeader->VertexCount * mHeader->VertexStride; }
+	uint64_t IndexBytes() const { return (uint64_t)mHeader->IndexCount * mHeader->IndexSize; }
+	//Copy the vertex or index buffer to dst, which holds VertexBytes() or
+	//IndexBytes(), decoding it if compressed. False if the compressed data is
+	//corrupt or decodes to indices outside the vertex buffer.
+	bool ReadVertices(void* dst) const;
+	bool ReadIndices(void* dst) const;
+
+	//Copies the whole mesh out of the file, indices widened to 32 bits.
+	bool ToMeshData(MeshData& mesh, std::string* error = nullptr) const;
+
+private:
+	const uint8_t* mData = nullptr;
+	const MeshFileHeader* mHeader = nullptr;
+};
+
+//Reads a mesh file with plain file IO into mesh, for tools and comparisons.
+bool ReadMeshFile(const std::string& path, MeshData& mesh, std::string* error = nullptr);
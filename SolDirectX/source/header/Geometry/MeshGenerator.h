@@ -0,0 +1,17 @@
+#pragma once
+
+#include "MeshData.h"
+
+//Procedural meshes in float formats with a single part, used by the demo and
+//as converter inputs. Triangles wind clockwise seen from outside, like the
+//rest of the renderer expects.
+
+//The colored cube of the demo: 8 shared corners with position and color.
+//Named "boxGeo" with the part "box".
+MeshData CreateBox(float halfExtent = 1.0f);
+
+//UV sphere with position, normal and a color derived from the normal.
+MeshData CreateSphere(float radius, uint32_t slices, uint32_t stacks);
+
+//Grid in the xz plane centered at the origin with position, normal and color.
+MeshData CreateGrid(float width, float depth, uint32_t rows, uint32_t columns);
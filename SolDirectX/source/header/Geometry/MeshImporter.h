@@ -0,0 +1,54 @@
+#pragma once
+
+#include "MeshData.h"
+
+struct MeshImportOptions
+{
+	//Merge identical vertices. Without it every triangle corner of an OBJ
+	//becomes a vertex of its own.
+	bool Weld = true;
+	//OBJ text is split into chunks of about this size parsed in parallel.
+	size_t ChunkBytes = 1024 * 1024;
+};
+
+struct MeshImportStats
+{
+	uint64_t FileBytes = 0;
+	uint64_t Triangles = 0;
+	//Vertices before and after welding: triangle corners for OBJ, the
+	//accessor vertices for glTF.
+	uint64_t SourceVertices = 0;
+	uint64_t Vertices = 0;
+	double ParseMilliseconds = 0.0;
+	double WeldMilliseconds = 0.0;
+	double Milliseconds = 0.0;
+};
+
+//Importers producing float meshes (float3 position, float3 normal and float4
+//color when the source has them) with 32-bit indices and BaseVertex 0, ready
+//for ProcessMesh; BuildMeshGeometry and WriteMeshFile narrow the indices to
+//16 bits whenever the welded vertex count allows it.
+//They return false and set error on unreadable or malformed input.
+
+//Wavefront OBJ: v (with optional r g b), vn and f, polygons are fanned into
+//triangles, negative indices are supported. Every o/g starts a new part.
+//Texture coordinates, materials, lines and points are ignored. The text is
+//parsed in parallel chunks split at line ends.
+bool ImportObj(const std::string& path, MeshData& mesh, const MeshImportOptions& options = MeshImportOptions(),
+	MeshImportStats* stats = nullptr, std::string* error = nullptr);
+
+//glTF 2.0, .gltf (with embedded or external buffers) or .glb. Every triangle
+//primitive of every mesh becomes a part "<mesh>_<primitive>" (made unique, see
+//MakePartNamesUnique, as mesh names may repeat) and is decoded
+//in parallel; POSITION, NORMAL and COLOR_0 are read in any valid component
+//type. Meshes are imported in their own space, node transforms are not applied.
+bool ImportGltf(const std::string& path, MeshData& mesh, const MeshImportOptions& options = MeshImportOptions(),
+	MeshImportStats* stats = nullptr, std::string* error = nullptr);
+
+//Part names key the DrawArgs, so importers give repeated names a "_<n>"
+//suffix, skipping suffixed names the source already uses.
+void MakePartNamesUnique(MeshData& mesh);
+
+//Picks the importer from the file extension.
+bool ImportMesh(const std::string& path, MeshData& mesh, const MeshImportOptions& options = MeshImportOptions(),
+	MeshImportStats* stats = nullptr, std::string* error = nullptr);
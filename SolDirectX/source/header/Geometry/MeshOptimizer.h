@@ -0,0 +1,57 @@
+#pragma once
+
+#include "MeshData.h"
+
+//Post-transform vertex cache efficiency of a triangle list, simulated with a FIFO cache.
+//ACMR: vertex shader invocations per triangle (0.5 at best for large grids, 3 at worst).
+//ATVR: invocations per referenced vertex (1 is optimal).
+struct VertexCacheStats
+{
+	float Acmr = 0.0f;
+	float Atvr = 0.0f;
+};
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+	uint32_t cacheSize = 16);
+
+//Reorders the triangles for the post-transform cache with Forsyth's linear-speed
+//algorithm (an LRU cache model of 32 entries, scores favouring recently used
+//vertices and vertices with few remaining triangles).
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+//Reorders clusters of a cache optimized triangle list so that outward facing
+//clusters come first and hide what lies behind them (Sander et al., "Fast
+//Triangle Reordering for Vertex Locality and Reduced Overdraw"). Clusters are
+//split where the cache restarts anyway, and inside those wherever the ACMR so
+//far is within threshold of the cluster's, so the cache cost stays bounded.
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const uint8_t* vertices, size_t vertexStride,
+	size_t vertexCount, uint32_t cacheSize = 16, float threshold = 1.05f);
+
+//Reorders the vertices in the order the indices first use them and remaps the
+//indices. Unreferenced vertices are dropped; returns the new vertex count.
+size_t OptimizeVertexFetch(uint8_t* vertices, size_t vertexStride, size_t vertexCount,
+	uint32_t* indices, size_t indexCount);
+
+//Merges bitwise identical vertices. remap receives the new index of every
+//vertex; the unique vertices keep the order of their first occurrence and
+//are compacted to the front of vertices. Vertices are hashed in parallel and
+//matched in parallel per hash partition, the result does not depend on the
+//thread count. Returns the unique vertex count.
+size_t WeldVertices(uint8_t* vertices, size_t vertexStride, size_t vertexCount, uint32_t* remap);
+
+struct MeshOptimizeOptions
+{
+	bool Overdraw = true;
+	float OverdrawThreshold = 1.05f;
+	uint32_t CacheSize = 16;
+};
+
+struct MeshOptimizeStats
+{
+	VertexCacheStats Before;
+	VertexCacheStats After;
+};
+
+//Runs all passes on every part of mesh, the parts in parallel. Triangles stay
+//inside their part; afterwards the indices are absolute and every BaseVertex is 0.
+MeshOptimizeStats OptimizeMesh(MeshData& mesh, const MeshOptimizeOptions& options = MeshOptimizeOptions());
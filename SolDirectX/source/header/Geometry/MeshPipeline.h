@@ -0,0 +1,33 @@
+#pragma once
+
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+
+struct MeshProcessOptions
+{
+	bool GenerateLods = true;
+	LodChainOptions Lods;
+	bool Optimize = true;
+	MeshOptimizeOptions Optimizer;
+	bool BuildMeshlets = true;
+	MeshletOptions Meshlets;
+	//Vertex format of the result.
+	VertexFormat Format = { PositionFormat::Unorm16x4, NormalFormat::Oct16, ColorFormat::Unorm8x4 };
+};
+
+struct MeshProcessStats
+{
+	LodChainStats Lods;
+	MeshOptimizeStats Optimize;
+	uint32_t MeshletCount = 0;
+	uint32_t SourceStride = 0;
+	uint32_t Stride = 0;
+	double Milliseconds = 0.0;
+};
+
+//The offline preparation of a float mesh shared by the renderer and the mesh
+//converter: LOD chain, vertex cache/overdraw/fetch optimization, meshlets,
+//then quantization into options.Format. The float passes run on mesh in
+//place, result receives the quantized copy.
+MeshProcessStats ProcessMesh(MeshData& mesh, const MeshProcessOptions& options, MeshData& result);
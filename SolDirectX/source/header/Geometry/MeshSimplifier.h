@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MeshData.h"
+#include <cfloat>
+
+//Simplifies a triangle list by edge collapses ordered by the quadric error
+//metric (Garland and Heckbert, "Surface Simplification Using Quadric Error
+//Metrics"). Vertices only ever collapse onto other existing vertices, so the
+//result indexes the original vertex buffer. Collapses run in passes: every
+//pass evaluates all edges, sorts them by cost and applies the cheapest ones
+//that do not touch each other, which keeps the result deterministic.
+//Open borders are held in place by constraint planes; vertices sharing their
+//position with another vertex (attribute seams) are never moved.
+//
+//indices are absolute into vertices, whose float3 position comes first.
+//Stops at targetIndexCount or before a collapse would exceed targetError
+//(object space distance). Returns the index count written to destination,
+//which must hold indexCount indices; resultError receives the error reached.
+size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+	const uint8_t* vertices, size_t vertexStride, size_t vertexCount,
+	size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+struct LodChainOptions
+{
+	//Levels generated below full detail at most.
+	uint32_t MaxLevels = 4;
+	//Triangle count of every level relative to the previous one.
+	float Ratio = 0.5f;
+	//Levels less detailed than this (object space) are not generated.
+	float MaxError = FLT_MAX;
+	//The chain stops once a level keeps more than this fraction of the
+	//triangles of the previous one.
+	float MinReduction = 0.85f;
+};
+
+struct LodChainStats
+{
+	//Per level, full detail first, summed over the parts.
+	std::vector<uint32_t> LevelTriangles;
+	std::vector<float> LevelErrors;
+};
+
+//Appends a chain of simplified levels for every part of mesh: each level
+//becomes a part of its own named "<part>_lod<level>" that directly follows
+//its source part. Levels are simplified from the full detail part, in
+//parallel; errors grow monotonically along a chain. Needs float positions,
+//so run it before quantizing.
+LodChainStats GenerateLodChain(MeshData& mesh, const LodChainOptions& options = LodChainOptions());
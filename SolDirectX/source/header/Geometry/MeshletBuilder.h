@@ -0,0 +1,22 @@
+#pragma once
+
+#include "MeshData.h"
+
+struct MeshletOptions
+{
+	//64 vertices and 124 triangles fit the output limits of mesh shaders on
+	//every vendor (124 * 3 byte indices stay below 384 bytes).
+	uint32_t MaxVertices = 64;
+	uint32_t MaxTriangles = 124;
+	//Parts are split into blocks of this many triangles built in parallel.
+	uint32_t BlockTriangles = 16 * 1024;
+};
+
+//Splits every part of mesh into meshlets and reorders the part's triangles
+//so that each meshlet is a contiguous index range. Meshlets grow greedily
+//from a seed over adjacent triangles, preferring those that add the fewest
+//vertices and bend the normal cone the least; seeds follow the existing
+//triangle order, so run it after OptimizeMesh (which would undo it).
+//Blocks of triangles are clustered in parallel, the output does not depend
+//on the thread count. Needs float positions.
+void BuildMeshlets(MeshData& mesh, const MeshletOptions& options = MeshletOptions());
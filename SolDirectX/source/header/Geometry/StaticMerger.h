@@ -0,0 +1,50 @@
+#pragma once
+
+#include "MeshData.h"
+
+//One placement of a part of a static mesh. World is row-major and transforms
+//row vectors, the memory layout of DirectX::XMFLOAT4X4.
+struct StaticInstance
+{
+	const MeshData* Mesh = nullptr;
+	uint32_t Part = 0;
+	float World[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+};
+
+struct StaticMergeOptions
+{
+	//Limits of one batch. Instances are never split, so a single instance
+	//above a limit becomes a batch of its own. 65535 vertices keep every
+	//batch addressable with 16-bit indices.
+	uint32_t MaxBatchTriangles = 16 * 1024;
+	uint32_t MaxBatchVertices = 0xFFFF;
+	//Longest side of the bounds of the instance centers in a batch, 0 for no
+	//limit. Smaller batches cull tighter at the cost of more draws.
+	float MaxBatchExtent = 0.0f;
+	//Prefix of the part names, followed by the batch number.
+	std::string PartPrefix = "static";
+};
+
+struct StaticMergeStats
+{
+	uint32_t Instances = 0;
+	uint32_t Batches = 0;
+	uint32_t Triangles = 0;
+	uint32_t Vertices = 0;
+	uint32_t LargestBatchTriangles = 0;
+	double Milliseconds = 0.0;
+};
+
+//Bakes static instances into world space and merges them into one mesh.
+//Instances are split into spatially compact batches (median cuts along the
+//longest axis of their centers until a batch fits the limits), and every
+//batch becomes one part of result, so it is drawn with a single draw and
+//culled by the bounds of its part. Positions are transformed by World,
+//normals by its inverse transpose; mirroring transforms flip the winding
+//back to clockwise. Only the vertices a part references are copied.
+//Every source mesh has to be in the same float format (run before
+//quantizing); result gets that format and no LODs or meshlets, see
+//ProcessMesh. Batches are written in parallel; the output does not depend
+//on the thread count.
+StaticMergeStats MergeStaticMeshes(const StaticInstance* instances, size_t count, const StaticMergeOptions& options,
+	MeshData& result);
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+//Attribute encodings of a vertex. Vertices store position, normal and color
+//in this order, tightly packed; attributes set to None are left out.
+enum class PositionFormat : uint8_t
+{
+	Float3,
+	//Four halves in [-1,1] around the center of the mesh bounds, w = 1.
+	Half4,
+	//Four 16-bit unorms spanning the mesh bounds, w = 1.
+	Unorm16x4,
+};
+
+enum class NormalFormat : uint8_t
+{
+	None,
+	Float3,
+	//Octahedral encoding in two 16-bit snorms.
+	Oct16,
+};
+
+enum class ColorFormat : uint8_t
+{
+	None,
+	Float4,
+	Unorm8x4,
+};
+
+struct VertexFormat
+{
+	PositionFormat Position = PositionFormat::Float3;
+	NormalFormat Normal = NormalFormat::None;
+	ColorFormat Color = ColorFormat::None;
+
+	static uint32_t Size(PositionFormat format) { return format == PositionFormat::Float3 ? 12 : 8; }
+	static uint32_t Size(NormalFormat format)
+	{
+		return format == NormalFormat::Float3 ? 12 : (format == NormalFormat::Oct16 ? 4 : 0);
+	}
+	static uint32_t Size(ColorFormat format)
+	{
+		return format == ColorFormat::Float4 ? 16 : (format == ColorFormat::Unorm8x4 ? 4 : 0);
+	}
+
+	uint32_t PositionOffset() const { return 0; }
+	uint32_t NormalOffset() const { return Size(Position); }
+	uint32_t ColorOffset() const { return NormalOffset() + Size(Normal); }
+	uint32_t Stride() const { return ColorOffset() + Size(Color); }
+
+	bool IsFloat() const
+	{
+		return Position == PositionFormat::Float3 && Normal != NormalFormat::Oct16 && Color != ColorFormat::Unorm8x4;
+	}
+
+	bool operator==(const VertexFormat& other) const
+	{
+		return Position == other.Position && Normal == other.Normal && Color == other.Color;
+	}
+	bool operator!=(const VertexFormat& other) const { return !(*this == other); }
+};
+
+//Maps stored positions back to object space: p = stored * Scale + Bias.
+//Renderers fold this into the world matrix instead of decoding in the shader.
+struct PositionDequantization
+{
+	float Scale[3] = { 1.0f, 1.0f, 1.0f };
+	float Bias[3] = { 0.0f, 0.0f, 0.0f };
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "MeshData.h"
+
+//Batch kernels converting interleaved float attributes to packed encodings.
+//Sources and destinations are strided (bytes between vertices), so they run
+//directly on whole vertex arrays. AVX2/F16C versions convert two vertices
+//per instruction (eight normals with gathers); the SSE2 versions run on any
+//x64 CPU. The implementation is picked at run time.
+
+//float3 -> 4 x unorm16: stored = (p - Bias) / Scale.
+void EncodePositionsUnorm16(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+	size_t count, const PositionDequantization& dequantization);
+//float3 -> 4 x half: stored = (p - Bias) / Scale.
+void EncodePositionsHalf(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+	size_t count, const PositionDequantization& dequantization);
+//float4 in [0,1] -> RGBA8 unorm.
+void EncodeColorsUnorm8(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t count);
+//Unit float3 -> octahedral 2 x snorm16.
+void EncodeNormalsOct16(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t count);
+
+//Dequantization that maps the bounds of the mesh positions onto the range of format.
+PositionDequantization ComputeDequantization(const MeshData& mesh, PositionFormat format);
+
+//Converts a float mesh (src.Format.IsFloat()) into format. Attributes the
+//source lacks get defaults (white, +z); attributes format lacks are dropped.
+//Indices, parts and meshlets are copied unchanged.
+void QuantizeMesh(const MeshData& src, const VertexFormat& format, MeshData& dst);
+
+//Object space position of a vertex of a mesh in any format.
+void DecodePosition(const MeshData& mesh, uint32_t vertex, float position[3]);
+//Object space bounds of the vertices referenced by part, zero for empty parts.
+void ComputePartBounds(const MeshData& mesh, const MeshPart& part, float boundsMin[3], float boundsMax[3]);
+
+float HalfToFloat(uint16_t value);
+uint16_t FloatToHalf(float value);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "RenderItem.h"
+#include "../Geometry/MeshData.h"
+#include "../Geometry/MeshFile.h"
+
+struct ClusterCullStats
+{
+	UINT Objects = 0;
+	UINT Clusters = 0;
+	UINT FrustumCulled = 0;
+	UINT BackfaceCulled = 0;
+	UINT Ranges = 0;
+	UINT64 Triangles = 0;
+	UINT64 VisibleTriangles = 0;
+	double Milliseconds = 0.0;
+
+	float CulledPercent() const
+	{
+		return Clusters ? 100.0f * (FrustumCulled + BackfaceCulled) / Clusters : 0.0f;
+	}
+};
+
+//Culls the meshlets of an object against the view frustum and rejects the
+//ones whose normal cone faces away from the camera, then returns the index
+//ranges of the remaining ones, merging neighbours. The tests run in object
+//space (frustum planes of world * viewProj, camera moved by the inverse
+//world), 4 meshlets at a time over structure-of-arrays bounds.
+//Usage per frame: BeginFrame() -> Cull() for every object; not thread safe.
+class ClusterCuller
+{
+public:
+	//Registers the meshlets of every part of mesh, which geo was built from.
+	//Ranges are resolved against the submesh when culling, so the submeshes
+	//may be moved into a GeometryPool afterwards.
+	void AddMesh(const MeshData& mesh, const MeshGeometry& geo);
+	//Registers the meshlets of a mesh file geo was loaded from.
+	void AddMesh(const MeshFileView& file, const MeshGeometry& geo);
+	UINT ClusterCount(const SubmeshGeometry* submesh) const;
+
+	void BeginFrame();
+	//Appends the visible index ranges of submesh drawn with world to ranges.
+	void Cull(const SubmeshGeometry& submesh, DirectX::FXMMATRIX world, DirectX::CXMMATRIX viewProj,
+		DirectX::FXMVECTOR eyePosition, std::vector<IndexRange>& ranges);
+
+	const ClusterCullStats& Stats() const { return mStats; }
+
+private:
+	void AddPart(const MeshGeometry& geo, const std::string& name, const Meshlet* meshlets, UINT meshletCount);
+
+	struct ClusterBlock
+	{
+		UINT First = 0;
+		UINT Count = 0;
+	};
+
+	std::unordered_map<const SubmeshGeometry*, ClusterBlock> mBlocks;
+
+	//Every block starts at a multiple of 4 and is padded with clusters that
+	//fail the frustum test.
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mRadius;
+	std::vector<float> mAxisX;
+	std::vector<float> mAxisY;
+	std::vector<float> mAxisZ;
+	std::vector<float> mCutoff;
+	std::vector<UINT> mIndexStart;
+	std::vector<UINT> mIndexCount;
+
+	ClusterCullStats mStats;
+};
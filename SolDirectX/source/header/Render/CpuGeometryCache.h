@@ -0,0 +1,107 @@
+#pragma once
+
+#include "../d3dUtil.h"
+#include <list>
+#include <mutex>
+
+//What is kept of the system memory copies of a mesh once it is on the GPU.
+enum class CpuRetention
+{
+	//Keep the blobs, for meshes that CPU queries (picking, collision) read all the time.
+	Keep,
+	//Keep them compressed; Acquire() decompresses them into a bounded LRU cache.
+	Compressed,
+	//Release them, the GPU copy is all there is.
+	Drop,
+};
+
+struct CpuGeometryStats
+{
+	UINT KeptMeshes = 0;
+	UINT CompressedMeshes = 0;
+	UINT DroppedMeshes = 0;
+
+	//Blobs of Keep meshes.
+	UINT64 KeptBytes = 0;
+	//Compressed copies, and what they decompress to.
+	UINT64 CompressedBytes = 0;
+	UINT64 UncompressedBytes = 0;
+	//Decompressed copies held by the LRU cache.
+	UINT64 CacheBytes = 0;
+	UINT64 CacheBudgetBytes = 0;
+	//System memory released by Drop and Compressed meshes.
+	UINT64 ReleasedBytes = 0;
+
+	UINT64 CacheHits = 0;
+	UINT64 CacheMisses = 0;
+	UINT64 Evictions = 0;
+
+	UINT64 TotalBytes() const { return KeptBytes + CompressedBytes + CacheBytes; }
+};
+
+//System memory copies of a mesh handed out by CpuGeometryCache::Acquire.
+//Holding them keeps the blobs alive even if the cache evicts them meanwhile.
+struct CpuGeometry
+{
+	Microsoft::WRL::ComPtr<ID3DBlob> Vertices;
+	Microsoft::WRL::ComPtr<ID3DBlob> Indices;
+
+	explicit operator bool() const { return Vertices != nullptr && Indices != nullptr; }
+};
+
+//Owns the system memory copies of meshes after upload, following a retention
+//policy per mesh, and accounts for the CPU memory they use. Compressed meshes
+//store both buffers with the GeometryCodec (LzCodec for layouts it does not
+//take); the decompressed copies live in an LRU cache whose size is bounded by
+//a budget (a single mesh larger than the budget is decompressed for the
+//caller but not cached).
+//Thread safe; Acquire may be called from any thread.
+class CpuGeometryCache
+{
+public:
+	static const UINT64 DefaultBudgetBytes = 32ull << 20;
+
+	explicit CpuGeometryCache(UINT64 budgetBytes = DefaultBudgetBytes);
+	CpuGeometryCache(const CpuGeometryCache& rhs) = delete;
+	CpuGeometryCache& operator=(const CpuGeometryCache& rhs) = delete;
+
+	//Applies policy to the system memory copies of geo: Compressed and Drop
+	//clear VertexBufferCPU/IndexBufferCPU. Call once the upload has executed.
+	void Retain(MeshGeometry& geo, CpuRetention policy);
+	//Forgets geo and its cached copies.
+	void Remove(const MeshGeometry& geo);
+
+	//The system memory copies of geo: its blobs for Keep, a cached decompressed
+	//copy for Compressed, nothing for Drop and unknown meshes.
+	CpuGeometry Acquire(const MeshGeometry& geo);
+	CpuRetention Policy(const MeshGeometry& geo) const;
+
+	void SetBudget(UINT64 budgetBytes);
+	CpuGeometryStats Stats() const;
+
+private:
+	struct Entry
+	{
+		CpuRetention Policy = CpuRetention::Keep;
+		CpuGeometry Kept;
+		std::vector<uint8_t> CompressedVertices;
+		std::vector<uint8_t> CompressedIndices;
+		UINT64 VertexBytes = 0;
+		UINT64 IndexBytes = 0;
+
+		//Decompressed copy, valid while InCache; Lru points at the mesh in mLru.
+		CpuGeometry Cached;
+		bool InCache = false;
+		std::list<const MeshGeometry*>::iterator Lru;
+	};
+
+	void Evict(UINT64 budgetBytes);
+	void Uncache(Entry& entry);
+
+	mutable std::mutex mMutex;
+	std::unordered_map<const MeshGeometry*, Entry> mEntries;
+	//Most recently used first.
+	std::list<const MeshGeometry*> mLru;
+	UINT64 mBudgetBytes;
+	CpuGeometryStats mStats;
+};
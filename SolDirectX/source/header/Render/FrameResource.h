@@ -0,0 +1,63 @@
+#pragma once
+
+#include "InstanceBatcher.h"
+
+struct PassConstants
+{
+	DirectX::XMFLOAT4X4 ViewProj = MathHelper::Identity4x4();
+};
+
+//Per-object data read by the vertex shader from a StructuredBuffer, indexed
+//by RenderItem::ObjCBIndex. The world matrix includes the dequantization of
+//the positions and is stored transposed, like the constant buffers.
+struct ObjectConstants
+{
+	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+};
+
+//What the CPU wrote into the frame resource of one frame. Objects and pass
+//constants are only written while dirty; the rest of the frame's buffers
+//still holds the data from NumFrameResources frames ago, which is current.
+struct ConstantUploadStats
+{
+	UINT Objects = 0;
+	UINT ObjectsWritten = 0;
+	UINT PassesWritten = 0;
+	UINT Instances = 0;
+	UINT64 BytesWritten = 0;
+	//Bytes the frame would have written uploading every object and the pass.
+	UINT64 BytesWithoutTracking = 0;
+	double Milliseconds = 0.0;
+};
+
+//Stores the resources needed for the CPU to build the command lists for a
+//frame. The CPU fills the resource of frame n while the GPU may still be
+//drawing frames n - 1 and n - 2 from theirs; Fence is the fence value that
+//marks the commands up to the last frame that used this resource.
+struct FrameResource
+{
+public:
+	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT instanceCount, UINT drawListCount);
+	FrameResource(const FrameResource& rhs) = delete;
+	FrameResource& operator=(const FrameResource& rhs) = delete;
+
+	//We cannot reset the allocator until the GPU is done processing the
+	//commands. So each frame needs their own allocator.
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
+	//One per command list DrawQueue::Submit records in parallel, since an
+	//allocator must not be recorded into from two threads at once.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>> DrawListAllocs;
+
+	//We cannot update a buffer until the GPU is done processing the commands
+	//that reference it. So each frame needs their own buffers.
+	std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
+	std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectBuffer = nullptr;
+	std::unique_ptr<UploadBuffer<InstanceData>> InstanceBuffer = nullptr;
+
+	//The sorted draw packets of the frame, built by Update() and recorded by
+	//Draw() on the render thread. Each frame needs its own so the next Update()
+	//can build while this one is recorded.
+	DrawQueue Draws;
+
+	UINT64 Fence = 0;
+};
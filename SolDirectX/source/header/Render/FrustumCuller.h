@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../d3dUtil.h"
+
+struct FrustumCullStats
+{
+	UINT Tested = 0;
+	UINT Visible = 0;
+	double Milliseconds = 0.0;
+};
+
+//Culls objects against the six planes of the view frustum.
+//World-space bounds are kept as structure-of-arrays (AABB center/extents plus a
+//bounding sphere radius around the same center) so that 8 objects are tested
+//per iteration with AVX, 4 with SSE. Blocks of objects are culled in parallel
+//and the result is a compact, sorted list of visible object indices.
+class FrustumCuller
+{
+public:
+	void Resize(UINT objectCount);
+	UINT Size() const { return mObjectCount; }
+
+	//Bounds of an object given its local-space box and world matrix.
+	void SetBounds(UINT index, const DirectX::BoundingBox& localBounds, DirectX::FXMMATRIX world);
+	//Bounds already in world space; the sphere is the one enclosing the box.
+	void SetBounds(UINT index, const DirectX::BoundingBox& worldBounds);
+
+	void Cull(DirectX::FXMMATRIX viewProj, std::vector<UINT>& visible);
+
+	const FrustumCullStats& Stats() const { return mStats; }
+
+private:
+	void SetBounds(UINT index, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extents, float radius);
+
+	UINT mObjectCount = 0;
+
+	//Padded to a multiple of 8 with objects that never pass the test.
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mExtentX;
+	std::vector<float> mExtentY;
+	std::vector<float> mExtentZ;
+	std::vector<float> mRadius;
+
+	std::vector<UINT> mBlockVisible;
+	std::vector<UINT> mBlockCounts;
+
+	FrustumCullStats mStats;
+};
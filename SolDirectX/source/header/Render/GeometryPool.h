@@ -0,0 +1,109 @@
+#pragma once
+
+#include "../d3dUtil.h"
+
+struct GeometryPoolStats
+{
+	UINT Arenas = 0;
+	UINT Meshes = 0;
+	UINT64 CapacityBytes = 0;
+	UINT64 UsedBytes = 0;
+	UINT64 FreeBytes = 0;
+	//Free bytes outside the largest free range of each arena.
+	UINT64 FragmentedBytes = 0;
+	UINT Compactions = 0;
+	UINT64 BytesMoved = 0;
+};
+
+//Shared vertex and index buffers for many meshes.
+//Meshes are suballocated from a few large default-heap buffers ("arenas"),
+//one set per vertex stride and index format. A registered MeshGeometry points
+//its VertexBufferGPU/IndexBufferGPU at the arena and its submeshes carry the
+//arena offsets in BaseVertexLocation/StartIndexLocation, so all meshes of an
+//arena are drawn with the same VB/IB binding.
+//Removing meshes leaves holes; Compact() packs the survivors into fresh
+//buffers on the GPU and rebases their submeshes. An allocation that does not
+//fit compacts an arena with enough free space before a new arena is created.
+class GeometryPool
+{
+public:
+	static const UINT64 DefaultVertexArenaBytes = 64ull << 20;
+	static const UINT64 DefaultIndexArenaBytes = 32ull << 20;
+
+	GeometryPool(ID3D12Device* device,
+		UINT64 vertexArenaBytes = DefaultVertexArenaBytes,
+		UINT64 indexArenaBytes = DefaultIndexArenaBytes);
+	GeometryPool(const GeometryPool& rhs) = delete;
+	GeometryPool& operator=(const GeometryPool& rhs) = delete;
+
+	//Uploads the system memory copies of geo, whose submesh locations are
+	//relative to its own buffers. The uploaders are kept in geo until the
+	//command list has executed, as with d3dUtil::CreateDefaultBuffer.
+	void AddMesh(MeshGeometry& geo, ID3D12GraphicsCommandList* cmdList);
+	//Frees the ranges of geo and makes its submesh locations relative again.
+	void RemoveMesh(MeshGeometry& geo);
+
+	//Packs every arena whose fragmented share of the free space is at least
+	//minFragmentation. Returns the number of arenas compacted.
+	UINT Compact(ID3D12GraphicsCommandList* cmdList, float minFragmentation = 0.25f);
+	//Buffers replaced by compaction stay alive until the GPU is done with the
+	//copies; call after the command list was executed and waited for.
+	void ReleaseRetiredBuffers();
+
+	GeometryPoolStats Stats() const;
+
+private:
+	struct FreeRange
+	{
+		UINT64 Offset;
+		UINT64 Count;
+	};
+
+	struct Arena
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Buffer;
+		bool IsIndex = false;
+		UINT Stride = 0;
+		DXGI_FORMAT IndexFormat = DXGI_FORMAT_UNKNOWN;
+		UINT64 Capacity = 0;
+		UINT64 Used = 0;
+		D3D12_RESOURCE_STATES State = D3D12_RESOURCE_STATE_COMMON;
+		//Sorted by offset, adjacent ranges are always merged.
+		std::vector<FreeRange> FreeRanges;
+	};
+
+	struct Allocation
+	{
+		UINT Arena = UINT_MAX;
+		UINT64 Offset = 0;
+		UINT64 Count = 0;
+	};
+
+	struct MeshEntry
+	{
+		Allocation Vertices;
+		Allocation Indices;
+	};
+
+	Allocation Allocate(bool isIndex, UINT stride, DXGI_FORMAT indexFormat, UINT64 count,
+		ID3D12GraphicsCommandList* cmdList);
+	bool AllocateFromArena(UINT arenaIndex, UINT64 count, Allocation& allocation);
+	void Free(const Allocation& allocation);
+	UINT CreateArena(bool isIndex, UINT stride, DXGI_FORMAT indexFormat, UINT64 capacity);
+	void CompactArena(UINT arenaIndex, ID3D12GraphicsCommandList* cmdList);
+	void Transition(Arena& arena, D3D12_RESOURCE_STATES state, ID3D12GraphicsCommandList* cmdList);
+	static D3D12_RESOURCE_STATES ReadState(const Arena& arena);
+	void BindMesh(MeshGeometry& geo, const MeshEntry& entry);
+	void RebaseSubmeshes(MeshGeometry& geo, INT64 vertexDelta, INT64 indexDelta);
+
+	ID3D12Device* mDevice;
+	UINT64 mVertexArenaBytes;
+	UINT64 mIndexArenaBytes;
+
+	std::vector<Arena> mArenas;
+	std::unordered_map<MeshGeometry*, MeshEntry> mMeshes;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mRetiredBuffers;
+
+	UINT mCompactions = 0;
+	UINT64 mBytesMoved = 0;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "RenderItem.h"
+#include "../Common/UploadBuffer.h"
+#include "DrawQueue.h"
+
+//Per-instance data read by the vertex shader through a StructuredBuffer: the
+//object whose constants the instance uses. The constants themselves stay in
+//the object buffer and are only rewritten when the object changes, so a frame
+//only writes 4 bytes per visible instance.
+struct InstanceData
+{
+	UINT ObjectIndex = 0;
+};
+
+//One instanced draw: every queued item sharing mesh, submesh and PSO.
+struct InstanceBatch
+{
+	MeshGeometry* Geo = nullptr;
+	const SubmeshGeometry* Submesh = nullptr;
+	ID3D12PipelineState* PSO = nullptr;
+
+	//Range of this batch inside the instance buffer.
+	UINT StartInstance = 0;
+	UINT InstanceCount = 0;
+
+	//Index ranges drawn instead of the whole submesh, one draw each.
+	UINT FirstRange = 0;
+	UINT RangeCount = 0;
+};
+
+struct InstanceBatchStats
+{
+	UINT Instances = 0;
+	UINT DrawsRequested = 0;
+	UINT DrawsIssued = 0;
+	UINT DrawsSaved = 0;
+};
+
+//Collects the draws of a frame and groups the ones sharing mesh, submesh and
+//PSO into a single DrawIndexedInstanced call.
+//Usage per frame: Begin() -> Add() for every item -> Build() -> Submit().
+class InstanceBatcher
+{
+public:
+	void Begin();
+
+	//The item is referenced, not copied, so it has to stay alive until Build().
+	//submesh replaces item.Submesh when given, e.g. by one of its levels of detail.
+	void Add(const RenderItem& item, const SubmeshGeometry* submesh = nullptr);
+	//Draws only the given ranges of submesh, e.g. its visible clusters. The
+	//ranges are copied; the item gets a batch of its own.
+	void AddRanges(const RenderItem& item, const SubmeshGeometry* submesh, const IndexRange* ranges, UINT rangeCount);
+
+	//Groups the queued items and writes the object index of every instance
+	//into instanceBuffer in a single pass, batch after batch.
+	void Build(UploadBuffer<InstanceData>& instanceBuffer);
+
+	//Pushes one instanced draw packet per batch into the draw queue. Each packet
+	//points the instance root SRV at its batch's range of instanceBufferAddress.
+	void Submit(DrawQueue& queue, D3D12_GPU_DESCRIPTOR_HANDLE materialTable,
+		D3D12_GPU_VIRTUAL_ADDRESS instanceBufferAddress) const;
+
+	const std::vector<InstanceBatch>& Batches() const { return mBatches; }
+	const InstanceBatchStats& Stats() const { return mStats; }
+
+private:
+	struct BatchKey
+	{
+		const MeshGeometry* Geo;
+		const SubmeshGeometry* Submesh;
+		const ID3D12PipelineState* PSO;
+
+		bool operator==(const BatchKey& rhs) const
+		{
+			return Geo == rhs.Geo && Submesh == rhs.Submesh && PSO == rhs.PSO;
+		}
+	};
+
+	struct BatchKeyHash
+	{
+		size_t operator()(const BatchKey& key) const
+		{
+			size_t h = std::hash<const void*>()(key.Geo);
+			h ^= std::hash<const void*>()(key.Submesh) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			h ^= std::hash<const void*>()(key.PSO) + 0x9e3779b9 + (h << 6) + (h >> 2);
+			return h;
+		}
+	};
+
+	std::vector<const RenderItem*> mItems;
+	std::vector<const SubmeshGeometry*> mItemSubmeshes;
+	//Per item: first range and range count, 0 ranges draws the whole submesh.
+	std::vector<std::pair<UINT, UINT>> mItemRanges;
+	std::vector<IndexRange> mRanges;
+	std::vector<UINT> mItemBatch;
+	std::vector<UINT> mBatchCursor;
+	//Instances are laid out here first and go to the mapped buffer in one copy.
+	std::vector<InstanceData> mInstanceData;
+	std::vector<InstanceBatch> mBatches;
+	std::unordered_map<BatchKey, UINT, BatchKeyHash> mBatchLookup;
+
+	InstanceBatchStats mStats;
+};
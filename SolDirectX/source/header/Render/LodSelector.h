@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../d3dUtil.h"
+
+struct LodSelectStats
+{
+	static const UINT MaxLevels = 8;
+
+	UINT Objects = 0;
+	UINT Switches = 0;
+	UINT ObjectsPerLevel[MaxLevels] = {};
+	UINT64 FullDetailTriangles = 0;
+	UINT64 DrawnTriangles = 0;
+	double Milliseconds = 0.0;
+
+	UINT64 SavedTriangles() const { return FullDetailTriangles - DrawnTriangles; }
+	float SavedPercent() const
+	{
+		return FullDetailTriangles ? 100.0f * SavedTriangles() / FullDetailTriangles : 0.0f;
+	}
+};
+
+//Picks the level of detail of every object from the screen space error of
+//its levels: the object space error of a level, scaled by the object and
+//projected at the distance of the nearest point of the bounding sphere.
+//The coarsest level below ErrorThreshold pixels is drawn. To keep objects
+//near the threshold from flickering between two levels, a coarser level is
+//only switched to once it is below ErrorThreshold * (1 - Hysteresis).
+class LodSelector
+{
+public:
+	void Resize(UINT objectCount);
+
+	//submesh must outlive the selector; its Lods are the selectable levels.
+	void SetObject(UINT index, const SubmeshGeometry& submesh, DirectX::FXMMATRIX world);
+	void SetProjection(float fovY, UINT viewportHeight);
+
+	//Updates the levels of the given objects, the others keep theirs.
+	void Select(DirectX::FXMVECTOR eyePosition, const std::vector<UINT>& objects);
+
+	UINT Level(UINT index) const { return mLevels[index]; }
+	//The submesh to draw for an object at its current level.
+	const SubmeshGeometry* Submesh(UINT index) const
+	{
+		UINT level = mLevels[index];
+		return level == 0 ? mSubmeshes[index] : mSubmeshes[index]->Lods[level - 1];
+	}
+
+	const LodSelectStats& Stats() const { return mStats; }
+
+	float ErrorThreshold = 1.0f;
+	float Hysteresis = 0.25f;
+
+private:
+	std::vector<const SubmeshGeometry*> mSubmeshes;
+	std::vector<DirectX::XMFLOAT4> mSpheres;
+	//Largest scale of the world matrix, object space errors grow with it.
+	std::vector<float> mScales;
+	std::vector<BYTE> mLevels;
+
+	//Pixels covered by one world unit at distance 1.
+	float mPixelsPerUnit = 1.0f;
+
+	LodSelectStats mStats;
+};
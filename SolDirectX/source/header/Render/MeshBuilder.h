@@ -0,0 +1,30 @@
+#pragma once
+
+#include "../d3dUtil.h"
+#include "../Geometry/MeshData.h"
+#include "../Geometry/MeshFile.h"
+#include "../Common/MappedFile.h"
+
+//Creates a MeshGeometry from CPU mesh data: the system memory copies are
+//filled in and every part becomes a DrawArgs entry with its bounds. Indices
+//are stored as 16-bit whenever every vertex they can address fits. Parts
+//that are levels of detail are linked into the Lods of their source part.
+//The GPU buffers are created by GeometryPool::AddMesh.
+std::unique_ptr<MeshGeometry> BuildMeshGeometry(const MeshData& mesh);
+
+//Creates a MeshGeometry straight from a mesh file mapped into memory, with
+//the same DrawArgs as BuildMeshGeometry. The system memory copies are blobs
+//over the vertex and index streams of the mapping, which they keep alive, so
+//GeometryPool::AddMesh reads the pages of the file directly into the upload
+//buffers. Compressed streams are decoded into blobs of their own instead;
+//nullptr if they are corrupt. view must have been opened on file->Data().
+std::unique_ptr<MeshGeometry> LoadMeshGeometry(const std::shared_ptr<MappedFile>& file, const MeshFileView& view);
+
+//Input elements of the vertex format. Unorm16 positions and RGBA8 colors are
+//expanded by the input assembler; octahedral normals arrive as a float2 in
+//[-1,1] and are decoded in the shader.
+void BuildInputLayout(const VertexFormat& format, std::vector<D3D12_INPUT_ELEMENT_DESC>& layout);
+
+DXGI_FORMAT ToDxgiFormat(PositionFormat format);
+DXGI_FORMAT ToDxgiFormat(NormalFormat format);
+DXGI_FORMAT ToDxgiFormat(ColorFormat format);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../d3dUtil.h"
+
+struct OcclusionCullStats
+{
+	UINT Occluders = 0;
+	UINT OccluderTriangles = 0;
+	UINT Tested = 0;
+	UINT Occluded = 0;
+	double RasterMilliseconds = 0.0;
+	double TestMilliseconds = 0.0;
+
+	float CulledPercent() const { return Tested ? 100.0f * Occluded / Tested : 0.0f; }
+	double Milliseconds() const { return RasterMilliseconds + TestMilliseconds; }
+};
+
+//Software occlusion culling on the CPU.
+//A few large occluders are rasterized into a low resolution depth buffer,
+//4 pixels at a time with SSE, keeping the nearest depth per pixel. Every
+//8x8 tile also stores its farthest depth, so an occludee box is rejected
+//tile by tile and only the tiles it is not clearly behind are tested per
+//pixel. Tile rows are rasterized in parallel, each by one thread, and the
+//occludees are tested in parallel against the finished buffer.
+//Depth follows the D3D convention: z/w in [0,1], smaller is nearer.
+class OcclusionCuller
+{
+public:
+	static const UINT TileSize = 8;
+
+	//Resolution of the depth buffer, rounded up to whole tiles.
+	void SetResolution(UINT width, UINT height);
+	UINT Width() const { return mWidth; }
+	UINT Height() const { return mHeight; }
+
+	void Resize(UINT objectCount);
+	void SetBounds(UINT index, const DirectX::BoundingBox& localBounds, DirectX::FXMMATRIX world);
+
+	//Picks the candidates covering the most screen space, judged by the
+	//size of their bounds over the distance to the eye.
+	void SelectOccluders(const std::vector<UINT>& candidates, DirectX::FXMVECTOR eyePos,
+		UINT maxCount, std::vector<UINT>& occluders) const;
+
+	void BeginFrame(DirectX::FXMMATRIX viewProj);
+	//Triangle list in local space, three positions per triangle, clockwise
+	//front faces as in the default rasterizer state. Back faces and
+	//triangles crossing the near plane are skipped.
+	void AddOccluder(const DirectX::XMFLOAT3* positions, UINT triangleCount, DirectX::FXMMATRIX world);
+	void RasterizeOccluders();
+
+	//Keeps the candidates that are not hidden behind the occluders.
+	void Cull(const std::vector<UINT>& candidates, std::vector<UINT>& visible);
+
+	const OcclusionCullStats& Stats() const { return mStats; }
+
+private:
+	//Edge functions and depth plane in screen space, evaluated at pixel centers.
+	struct Triangle
+	{
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		float ZA, ZB, ZC;
+		int MinX, MaxX, MinY, MaxY;
+	};
+
+	void RasterizeTileRow(UINT tileRow);
+	bool IsOccluded(const DirectX::BoundingBox& worldBounds) const;
+
+	UINT mWidth = 0;
+	UINT mHeight = 0;
+	UINT mTilesX = 0;
+	UINT mTilesY = 0;
+	std::vector<float> mDepth;
+	std::vector<float> mTileMaxDepth;
+
+	DirectX::XMFLOAT4X4 mViewProj;
+	std::vector<Triangle> mTriangles;
+	std::vector<DirectX::BoundingBox> mWorldBounds;
+	std::vector<uint8_t> mVisibleFlags;
+
+	OcclusionCullStats mStats;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../d3dUtil.h"
+#include "../Common/MathHelper.h"
+
+//Number of frames the CPU may run ahead of the GPU; each has its own copy of
+//the data written per frame, see FrameResource.h.
+const int NumFrameResources = 3;
+
+//Lightweight structure that stores the parameters needed to draw a shape.
+//It does not own anything: geometry and PSO are owned by the renderer.
+struct RenderItem
+{
+	//World matrix of the shape that describes the object's local space
+	//relative to the world space.
+	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+
+	//Dirty flag indicating the object data has changed and we need to update
+	//the object buffer. Because every FrameResource has its own object buffer,
+	//the update has to reach each of them: whoever modifies the object sets
+	//NumFramesDirty = NumFrameResources.
+	int NumFramesDirty = NumFrameResources;
+
+	//Index into the object buffers of the frame resources for this render item.
+	UINT ObjCBIndex = 0;
+
+	MeshGeometry* Geo = nullptr;
+	const SubmeshGeometry* Submesh = nullptr;
+	ID3D12PipelineState* PSO = nullptr;
+};
+
+//A range of a submesh's indices drawn on its own, e.g. its visible clusters.
+struct IndexRange
+{
+	UINT StartIndex = 0;
+	UINT IndexCount = 0;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "InstanceBatcher.h"
+#include "FrustumCuller.h"
+#include "GeometryPool.h"
+#include "../Geometry/MeshData.h"
+
+struct StaticBatchStats
+{
+	UINT Batches = 0;
+	UINT Visible = 0;
+	UINT64 Triangles = 0;
+	UINT64 VisibleTriangles = 0;
+	double Milliseconds = 0.0;
+};
+
+//Static geometry baked into world space by MergeStaticMeshes. Every part of
+//the merged mesh is a batch of many objects drawn with one draw call. All
+//batches are one object whose world is the identity, so its constants (the
+//dequantization of the positions) are uploaded once by the owner like those
+//of any render item and never become dirty again; the single instance index
+//pointing at them is written when the batches are built. The batches are the
+//unit of culling: each is tested against the frustum by its world space
+//bounds. Culling their meshlets as well would split every batch back into
+//many range draws, so merged meshes are built without meshlets.
+//Usage: Build() once -> Cull() and Submit() every frame.
+class StaticBatches
+{
+public:
+	//mesh is the merged mesh after ProcessMesh. The geometry is uploaded
+	//into pool with cmdList, drawn with pso; objectIndex is the slot of the
+	//batches' constants in the object buffers.
+	void Build(ID3D12Device* device, const MeshData& mesh, ID3D12PipelineState* pso, GeometryPool& pool,
+		ID3D12GraphicsCommandList* cmdList, UINT objectIndex);
+
+	void Cull(DirectX::CXMMATRIX viewProj);
+
+	//One packet per visible batch.
+	void Submit(DrawQueue& queue, D3D12_GPU_DESCRIPTOR_HANDLE materialTable) const;
+
+	MeshGeometry* Geometry() const { return mGeo.get(); }
+	//The object all batches share, for writing its constants.
+	RenderItem& Item() { return mItem; }
+	const StaticBatchStats& Stats() const { return mStats; }
+
+private:
+	std::unique_ptr<MeshGeometry> mGeo;
+	ID3D12PipelineState* mPSO = nullptr;
+	std::vector<const SubmeshGeometry*> mBatches;
+	RenderItem mItem;
+	std::unique_ptr<UploadBuffer<InstanceData>> mInstance;
+
+	FrustumCuller mCuller;
+	std::vector<UINT> mVisible;
+
+	StaticBatchStats mStats;
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "../d3dUtil.h"
+#include <cfloat>
+
+//32-byte node so that two siblings share a cache line.
+//Internal node: LeftFirst is the left child, the right child is LeftFirst + 1.
+//Leaf: LeftFirst is the first entry in the primitive index list.
+struct BvhNode
+{
+	DirectX::XMFLOAT3 BoundsMin;
+	UINT LeftFirst;
+	DirectX::XMFLOAT3 BoundsMax;
+	UINT PrimCount;
+
+	bool IsLeaf() const { return PrimCount != 0; }
+};
+
+struct BvhRayHit
+{
+	UINT Primitive = UINT_MAX;
+	float Distance = FLT_MAX;
+
+	bool Hit() const { return Primitive != UINT_MAX; }
+};
+
+//Bounding volume hierarchy over primitive AABBs, built with binned SAH.
+//Large nodes are binned in parallel and the subtrees below them are built
+//in parallel, then spliced into one flat, depth-first-ish node array.
+//Moving primitives are handled with an incremental refit of the touched
+//paths; RefitOrRebuild() rebuilds once the refitted tree got too expensive.
+class Bvh
+{
+public:
+	void Build(const DirectX::BoundingBox* primBounds, UINT primCount);
+
+	//Records the new bounds of a moved primitive. Takes effect on Refit().
+	void UpdatePrimitive(UINT prim, const DirectX::BoundingBox& bounds);
+	void Refit();
+	//Refits, and rebuilds instead when the SAH cost grew past RebuildCostRatio
+	//of the cost right after the last build.
+	bool RefitOrRebuild();
+
+	//Appends the primitives whose bounds intersect the frustum of viewProj.
+	void QueryFrustum(DirectX::FXMMATRIX viewProj, std::vector<UINT>& result) const;
+
+	//Closest hit along the ray. intersect(prim, origin, dir, maxDistance, distance)
+	//tests the actual primitive and returns true with distance < maxDistance on a hit.
+	template<typename IntersectFn>
+	BvhRayHit Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDistance,
+		IntersectFn&& intersect) const;
+
+	float SahCost() const;
+	UINT NodeCount() const { return (UINT)mNodes.size(); }
+	UINT PrimCount() const { return (UINT)mPrimMin.size(); }
+	const std::vector<BvhNode>& Nodes() const { return mNodes; }
+
+	static constexpr float RebuildCostRatio = 1.5f;
+	//Deeper nodes are turned into leaves, which bounds the traversal stacks.
+	static const UINT MaxDepth = 64;
+
+private:
+	struct BuildTask
+	{
+		UINT Node;
+		UINT Begin;
+		UINT End;
+		UINT Depth;
+	};
+
+	void BuildRange(std::vector<BvhNode>& nodes, const BuildTask& task, bool parallel,
+		std::vector<BuildTask>& pending);
+	void RefitNode(UINT nodeIndex);
+	bool RayBox(const BvhNode& node, const float origin[3], const float invDir[3], float maxDistance, float& tNear) const;
+
+	std::vector<BvhNode> mNodes;
+	std::vector<UINT> mParents;
+	std::vector<UINT> mPrimIndices;
+	std::vector<UINT> mPrimLeaf;
+	std::vector<DirectX::XMFLOAT3> mPrimMin;
+	std::vector<DirectX::XMFLOAT3> mPrimMax;
+	std::vector<DirectX::XMFLOAT3> mPrimCentroid;
+
+	std::vector<UINT> mDirtyPrims;
+	float mBuildCost = 0.0f;
+};
+
+template<typename IntersectFn>
+BvhRayHit Bvh::Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDistance,
+	IntersectFn&& intersect) const
+{
+	BvhRayHit hit;
+	if (mNodes.empty()) {
+		return hit;
+	}
+
+	DirectX::XMFLOAT3 o, d;
+	DirectX::XMStoreFloat3(&o, origin);
+	DirectX::XMStoreFloat3(&d, dir);
+	const float org[3] = { o.x, o.y, o.z };
+	const float invDir[3] = {
+		d.x != 0.0f ? 1.0f / d.x : FLT_MAX,
+		d.y != 0.0f ? 1.0f / d.y : FLT_MAX,
+		d.z != 0.0f ? 1.0f / d.z : FLT_MAX
+	};
+
+	float closest = maxDistance;
+	float tRoot;
+	if (!RayBox(mNodes[0], org, invDir, closest, tRoot)) {
+		return hit;
+	}
+
+	UINT stack[MaxDepth];
+	UINT stackSize = 0;
+	UINT nodeIndex = 0;
+	for (;;) {
+		const BvhNode& node = mNodes[nodeIndex];
+		if (node.IsLeaf()) {
+			for (UINT i = 0; i < node.PrimCount; ++i) {
+				UINT prim = mPrimIndices[node.LeftFirst + i];
+				float distance;
+				if (intersect(prim, origin, dir, closest, distance) && distance < closest) {
+					closest = distance;
+					hit.Primitive = prim;
+					hit.Distance = distance;
+				}
+			}
+		}
+		else {
+			//Visit the nearer child first, the farther one may be skipped later.
+			UINT left = node.LeftFirst;
+			UINT right = left + 1;
+			float tLeft, tRight;
+			bool hitLeft = RayBox(mNodes[left], org, invDir, closest, tLeft);
+			bool hitRight = RayBox(mNodes[right], org, invDir, closest, tRight);
+			if (hitLeft && hitRight) {
+				if (tRight < tLeft) {
+					std::swap(left, right);
+				}
+				assert(stackSize < MaxDepth);
+				stack[stackSize++] = right;
+				nodeIndex = left;
+				continue;
+			}
+			if (hitLeft || hitRight) {
+				nodeIndex = hitLeft ? left : right;
+				continue;
+			}
+		}
+
+		//Nodes pushed earlier may lie beyond the closest hit found since.
+		bool found = false;
+		while (stackSize != 0 && !found) {
+			nodeIndex = stack[--stackSize];
+			float tNear;
+			found = RayBox(mNodes[nodeIndex], org, invDir, closest, tNear);
+		}
+		if (!found) {
+			break;
+		}
+	}
+	return hit;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Bvh.h"
+
+//Triangle-level ray queries against the system memory copy of a submesh.
+//The triangles are kept in their own BVH, so a pick costs a few dozen
+//triangle tests even for large meshes. Positions are read from the first
+//float3 of every vertex, as in all vertex formats of this project.
+class MeshRaycaster
+{
+public:
+	void Build(const MeshGeometry& geo, const SubmeshGeometry& submesh);
+	//Builds from copies of the vertex and index buffers of geo, for meshes
+	//whose system memory copies are not kept (see CpuGeometryCache).
+	void Build(const MeshGeometry& geo, const SubmeshGeometry& submesh, ID3DBlob* vertices, ID3DBlob* indices);
+
+	//Ray in the local space of the mesh; dir has to be normalized.
+	bool Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR dir, float maxDistance, float& distance) const;
+
+	UINT TriangleCount() const { return (UINT)mPositions.size() / 3; }
+	//Triangle list in local space, three positions per triangle.
+	const std::vector<DirectX::XMFLOAT3>& Positions() const { return mPositions; }
+
+private:
+	std::vector<DirectX::XMFLOAT3> mPositions;
+	Bvh mBvh;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//Handle of a node, stable for as long as the node lives.
+typedef uint32_t TransformId;
+const TransformId InvalidTransform = UINT32_MAX;
+
+struct TransformUpdateStats
+{
+	uint32_t Nodes = 0;
+	uint32_t Levels = 0;
+	//Nodes whose world matrix was recomputed, the rest was skipped as static.
+	uint32_t Updated = 0;
+	double Milliseconds = 0.0;
+};
+
+//Scene graph transforms for a large number of nodes.
+//Local translation, rotation (quaternion) and scale and the affine world
+//matrices are stored as structure-of-arrays, ordered by hierarchy depth: all
+//parents of a level are finished before the level starts, so every level is
+//updated in parallel blocks of 4 nodes at a time with SSE, reading the world
+//matrices of the parents above it. A node is recomputed when its local
+//transform was set or its parent's world changed during the same Update();
+//untouched subtrees are skipped block by block, and a level without set
+//nodes below an unchanged level is skipped as a whole.
+//Matrices use the row vector convention of DirectXMath (world = S * R * T *
+//parentWorld) and are passed as 16 row-major floats; the module does not
+//depend on D3D, so the tools can measure it.
+//Structural changes (Create/Destroy) only mark the order stale, the next
+//Update() sorts the nodes again. Not thread safe.
+class TransformSystem
+{
+public:
+	TransformSystem();
+
+	//New node with an identity local transform, a root without parent.
+	TransformId Create(TransformId parent = InvalidTransform);
+	//Destroys the node together with all of its descendants.
+	void Destroy(TransformId id);
+	bool IsAlive(TransformId id) const;
+
+	//rotation is a unit quaternion (x, y, z, w).
+	void SetLocal(TransformId id, const float translation[3], const float rotation[4], const float scale[3]);
+	void SetTranslation(TransformId id, const float translation[3]);
+
+	//Recomputes the world matrices of the nodes that changed.
+	void Update();
+
+	//World matrix as of the last Update().
+	void GetWorld(TransformId id, float world[16]) const;
+	//Whether the last Update() recomputed the world matrix of the node.
+	bool Changed(TransformId id) const { return mChanged[mSlotOfId[id]] != 0; }
+
+	//Writes transpose(world * viewProj) of every node in ids to dst, one
+	//matrix every stride bytes, the layout shader constants expect. Blocks
+	//of nodes are written in parallel, every matrix with full 16-byte stores
+	//in address order, which suits write-combined upload memory.
+	void WriteWorldViewProj(const float viewProj[16], const TransformId* ids, size_t count,
+		void* dst, size_t stride) const;
+	//Writes transpose(world), e.g. into an instance buffer.
+	void WriteWorld(const TransformId* ids, size_t count, void* dst, size_t stride) const;
+
+	size_t Size() const { return mIdOfSlot.size() - 1; }
+	const TransformUpdateStats& Stats() const { return mStats; }
+
+private:
+	void SortByDepth();
+	void MarkDirty(uint32_t slot, TransformId id);
+	void WriteMatrices(const float* viewProj, const TransformId* ids, size_t count, void* dst, size_t stride) const;
+
+	//Per slot, in depth order. Slot 0 is a hidden root with an identity world
+	//at depth 0, the parent of every root, so no node lacks a parent.
+	std::vector<float> mTx, mTy, mTz;
+	std::vector<float> mQx, mQy, mQz, mQw;
+	std::vector<float> mSx, mSy, mSz;
+	//Rows 0-2 of the world matrix (the 3x3 part) and row 3 (the translation).
+	std::vector<float> mWorld[12];
+	std::vector<uint32_t> mParent;
+	std::vector<uint8_t> mDirty;
+	std::vector<uint8_t> mChanged;
+	std::vector<uint32_t> mIdOfSlot;
+	//Slot range of every depth, level d is [mLevelStart[d], mLevelStart[d + 1]).
+	std::vector<uint32_t> mLevelStart;
+
+	//Per id; InvalidTransform for free ids.
+	std::vector<uint32_t> mSlotOfId;
+	std::vector<uint32_t> mDepthOfId;
+	std::vector<TransformId> mFreeIds;
+	//Ids destroyed since the last sort, their subtrees go with them.
+	std::vector<uint8_t> mDestroyed;
+	//Per depth: nodes set since the last update, and whether any world of
+	//the level changed in the last one (so its flags need clearing).
+	std::vector<uint32_t> mLevelDirty;
+	std::vector<uint8_t> mLevelChanged;
+	bool mOrderStale = false;
+
+	TransformUpdateStats mStats;
+};
@@ -2,55 +2,159 @@
 #include "../gfx/gfx_object.h"
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
+#include "../Common/JobSystem.h"
+#include "../Common/ParallelFor.h"
+#include "../Common/FramePipeline.h"
+#include "../Common/GameClock.h"
+#include "../Common/Task.h"
+#include "../Render/InstanceBatcher.h"
+#include "../Render/FrameResource.h"
+#include "../Render/FrustumCuller.h"
+#include "../Render/GeometryPool.h"
+#include "../Render/MeshBuilder.h"
+#include "../Render/CpuGeometryCache.h"
+#include "../Geometry/MeshPipeline.h"
+#include "../Geometry/MeshGenerator.h"
+#include "../Geometry/VertexQuantizer.h"
+#include "../Render/OcclusionCuller.h"
+#include "../Render/LodSelector.h"
+#include "../Render/ClusterCuller.h"
+#include "../Render/StaticBatches.h"
+#include "../Geometry/StaticMerger.h"
+#include "../Scene/Bvh.h"
+#include "../Scene/MeshRaycaster.h"
+#include "../Scene/TransformSystem.h"
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 using namespace DirectX::PackedVector;
 
-struct Vertex
-{
-	XMFLOAT3 Pos;
-	XMFLOAT4 Color;
-};
-
-struct ObjectConstants
-{
-	XMFLOAT4X4 WorldViewProj = MathHelper::Identity4x4();
-};
-
 class LittleRendererWindow final : public LittleGFXWindow
 {
 public:
 	virtual bool Initialize(const wchar_t* title, LittleGFXDevice* device, bool enableVsync) override;
 public:
-	virtual void Update() override;
+	virtual void Update(double elapsedSeconds) override;
 	virtual void Draw() override;
 	virtual void Run() override;
+	virtual void OnResize() override;
+	virtual void OnMouseDown(WPARAM btnState, int x, int y) override;
 
 	void BuildDescriptorHeaps();
-	void BuildConstantBuffers();
+	void BuildFrameResources();
 	void BuildRootSignature();
 	void BuildShadersAndInputLayout();
 	void BuildBoxGeometry();
 	void BuildPSO();
+	void BuildRenderItems();
+	void BuildStaticScenery();
+	//Releases what the initialization commands uploaded from, once the GPU is past fence.
+	Task<void> FinishInitialUploads(UINT64 fence);
+
+	//Advances the simulated state by one fixed step.
+	void StepSimulation(float stepSeconds);
+	void UpdateCamera();
+	void UpdateObjectConstants();
+	void UpdatePassConstants();
+
+	//Picks the ground and pillars, from their compressed system memory copies.
+	bool RaycastScenery(FXMVECTOR origin, FXMVECTOR dir, float maxDistance, float& distance);
+
+	void LogRenderStats();
+	void LogCpuGeometryStats();
 
 private:
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
 	ComPtr<ID3D12DescriptorHeap> mCbvHeap = nullptr;
-	std::unique_ptr<UploadBuffer<ObjectConstants>> mObjectCB = nullptr;
+	//Runs the load and upload tasks, resumed at the start of every Update().
+	TaskScheduler mScheduler;
+	std::vector<std::unique_ptr<FrameResource>> mFrameResources;
+	//Frame resources are the snapshots of the pipeline: Update() fills one on
+	//the main thread while the render thread records Draw() from another.
+	std::unique_ptr<FramePipeline> mPipeline;
+	//Owned by the main thread.
+	FrameResource* mCurrFrameResource = nullptr;
+	int mCurrFrameResourceIndex = 0;
+	//Owned by the render thread: the frame resource Draw() records.
+	FrameResource* mDrawFrameResource = nullptr;
+	//The draw queue is recorded into these in parallel, after mCommandList
+	//cleared the targets. Up to one per job system thread, MaxDrawLists at most.
+	std::vector<ComPtr<ID3D12GraphicsCommandList>> mDrawLists;
+	//Frames whose pass constants still have to be written, like RenderItem::NumFramesDirty.
+	int mPassFramesDirty = NumFrameResources;
+	ConstantUploadStats mUploadStats;
+	//A run of dirty objects with consecutive indices, written in one copy.
+	std::vector<ObjectConstants> mObjectRun;
+	UINT mObjectRunStart = 0;
 
+	std::unique_ptr<GeometryPool> mGeometryPool = nullptr;
 	std::unique_ptr<MeshGeometry> mBoxGeo = nullptr;
+	//System memory copies of the meshes once they are uploaded.
+	CpuGeometryCache mCpuGeometry;
 
 	ComPtr<ID3DBlob> mvsByteCode = nullptr;
 	ComPtr<ID3DBlob> mpsByteCode = nullptr;
 
+	//Vertex format on the GPU: 8-byte positions and 4-byte colors instead of 28 bytes.
+	VertexFormat mVertexFormat = { PositionFormat::Unorm16x4, NormalFormat::None, ColorFormat::Unorm8x4 };
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 	ComPtr<ID3D12PipelineState> mPSO = nullptr;
 
-	XMFLOAT4X4 mWorld = MathHelper::Identity4x4();
+	//All boxes of the scene, drawn through the instance batcher. Their world
+	//matrices come from the transform system, one node per box below the grid.
+	std::vector<RenderItem> mRitems;
+	TransformSystem mTransforms;
+	TransformId mGridTransform = InvalidTransform;
+	std::vector<TransformId> mBoxTransforms;
+	FrustumCuller mFrustumCuller;
+	std::vector<UINT> mVisibleRitems;
+	OcclusionCuller mOcclusionCuller;
+	std::vector<UINT> mOccluders;
+	std::vector<UINT> mUnoccludedRitems;
+	LodSelector mLodSelector;
+	ClusterCuller mClusterCuller;
+	std::vector<IndexRange> mClusterRanges;
+	InstanceBatcher mInstanceBatcher;
+	//Ground tiles and pillars below the boxes, merged into a few batches.
+	StaticBatches mStaticBatches;
+
+	//World space bounds of the boxes for picking, refined per triangle by the raycasters.
+	Bvh mSceneBvh;
+	std::unordered_map<const SubmeshGeometry*, MeshRaycaster> mMeshRaycasters;
+
+	static const UINT BoxGridSize = 16;
+	static const UINT MaxInstanceCount = BoxGridSize * BoxGridSize * BoxGridSize;
+	//Every box and the static scenery.
+	static const UINT MaxObjectCount = MaxInstanceCount + 1;
+	static const UINT MaxOccluderCount = 64;
+	static constexpr UINT MaxDrawLists = 8;
+	static const UINT OcclusionBufferDownscale = 2;
+	static const UINT StatsLogInterval = 300;
+	static const UINT SceneryGridSize = 24;
+	//Written by MeshConverter --box, see tools/MeshConverter.
+	static constexpr const char* BoxMeshPath = "D:\\Github\\SolDirectx_Demo\\SolDirectX\\res\\box.solmesh";
+	UINT64 mFrameCount = 0;
+
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
+	XMFLOAT4X4 mViewProj = MathHelper::Identity4x4();
+	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
+	//The view is only rebuilt when the camera moved or the projection changed.
+	bool mCameraDirty = true;
 
-	float mTheta = 1.5f * XM_PI;
-	float mPhi = XM_PIDIV4;
-	float mRadius = 5.0f;
+	//The camera orbits the grid in spherical coordinates.
+	struct OrbitState
+	{
+		float Theta = 1.5f * XM_PI;
+		float Phi = XM_PIDIV4;
+		float Radius = 100.0f;
+	};
+	//The simulation runs in fixed steps on the game clock; the camera is drawn
+	//between the last two simulated states.
+	GameClock mClock;
+	FixedStepLoop mFixedStep;
+	OrbitState mPrevOrbit;
+	OrbitState mOrbit;
+	OrbitState mRenderOrbit;
+	//Radians per second.
+	static constexpr float OrbitSpeed = 0.1f;
 };
\ No newline at end of file
@@ -96,6 +96,11 @@ struct SubmeshGeometry {
     //Bounding box of the geometry defined by this submesh.
     //This is used in later chapters of the book.
     DirectX::BoundingBox Bounds;
+
+    //Coarser levels of detail of this submesh, sharing its vertices, finest
+    //first. LodError is the object space deviation of a level from full detail.
+    std::vector<const SubmeshGeometry*> Lods;
+    float LodError = 0.0f;
 };
 
 struct MeshGeometry {
@@ -119,6 +124,18 @@ struct MeshGeometry {
     DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
     UINT IndexBufferByteSize = 0;
 
+    //Encoding of the position at the start of every vertex, and the
+    //dequantization object space = stored * PositionScale + PositionBias.
+    DXGI_FORMAT PositionFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+    DirectX::XMFLOAT3 PositionScale = { 1.0f, 1.0f, 1.0f };
+    DirectX::XMFLOAT3 PositionBias = { 0.0f, 0.0f, 0.0f };
+
+    //Where the mesh starts inside the shared buffers of a GeometryPool, in
+    //vertices and indices. Submesh locations already include these offsets;
+    //subtract them to address the system memory copies.
+    INT PoolBaseVertex = 0;
+    UINT PoolStartIndex = 0;
+
     //A MeshGeometry may store multiple geometries in one vertex/index buffer.
     //Use this container to define the Submesh geometries so we can draw the
     //Submeshes individually.
@@ -144,6 +161,31 @@ struct MeshGeometry {
         return ibv;
     }
 
+    //Object space position of a vertex in the system memory copy.
+    DirectX::XMVECTOR LoadPosition(UINT vertex) const
+    {
+        return LoadPosition(VertexBufferCPU->GetBufferPointer(), vertex);
+    }
+
+    //Object space position of a vertex in a copy of the vertex buffer, such
+    //as one handed out by CpuGeometryCache.
+    DirectX::XMVECTOR LoadPosition(const void* vertices, UINT vertex) const
+    {
+        const BYTE* p = reinterpret_cast<const BYTE*>(vertices) + (size_t)vertex * VertexByteStride;
+        DirectX::XMVECTOR stored;
+        switch (PositionFormat) {
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            stored = DirectX::PackedVector::XMLoadHalf4(reinterpret_cast<const DirectX::PackedVector::XMHALF4*>(p));
+            break;
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+            stored = DirectX::PackedVector::XMLoadUShortN4(reinterpret_cast<const DirectX::PackedVector::XMUSHORTN4*>(p));
+            break;
+        default:
+            return DirectX::XMLoadFloat3(reinterpret_cast<const DirectX::XMFLOAT3*>(p));
+        }
+        return DirectX::XMVectorMultiplyAdd(stored, DirectX::XMLoadFloat3(&PositionScale), DirectX::XMLoadFloat3(&PositionBias));
+    }
+
     void DIsposeUploaders()
     {
         VertexBufferUploader = nullptr;
@@ -67,12 +67,10 @@ protected:
     uint32_t swapchainFlags;
 
     virtual void OnResize();
-    virtual void Update(/*可以加入时间*/) = 0;
+    //elapsedSeconds: 距上一帧的真实时间
+    virtual void Update(double elapsedSeconds) = 0;
     virtual void Draw() = 0;
 
-    virtual void OnMouseDown(WPARAM btnState, int x, int y) {}
-    virtual void OnMouseUp(WPARAM btnState, int x, int y) {}
-    virtual void OnMouseMove(WPARAM btnState, int x, int y) {}
 protected:
     void CreateRtvAndDsvDescriptorHeaps();
     bool InitDirect3D();
@@ -8,12 +8,21 @@
 
 class LittleWindow
 {
+	//WindowProcedure forwards input messages to the main window.
+	friend LRESULT CALLBACK WindowProcedure(HWND window, UINT msg, WPARAM wp, LPARAM lp);
+
 public:
 	bool Initialize(const wchar_t* title);
 	virtual void Run() = 0;
 	bool Destroy();
 
 protected:
+	virtual void OnMouseDown(WPARAM btnState, int x, int y) {}
+	virtual void OnMouseUp(WPARAM btnState, int x, int y) {}
+	virtual void OnMouseMove(WPARAM btnState, int x, int y) {}
+
+	static LittleWindow* mMainWindow;
+
 	std::wstring title;
 	UINT32 width;
 	UINT32 height;
@@ -0,0 +1,77 @@
+#include "../../header/Common/CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace {
+	void QueryCpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuidex(info, (int)leaf, (int)subleaf);
+		for (int i = 0; i < 4; ++i) {
+			regs[i] = (uint32_t)info[i];
+		}
+#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+
+	uint64_t QueryXcr0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((uint64_t)edx << 32) | eax;
+#endif
+	}
+
+	CpuFeatures Detect()
+	{
+		CpuFeatures features;
+		uint32_t regs[4];
+
+		QueryCpuid(0, 0, regs);
+		uint32_t maxLeaf = regs[0];
+		if (maxLeaf < 1) {
+			return features;
+		}
+
+		QueryCpuid(1, 0, regs);
+		uint32_t ecx1 = regs[2];
+		features.SSE41 = (ecx1 >> 19) & 1;
+		features.POPCNT = (ecx1 >> 23) & 1;
+
+		//AVX state has to be enabled by the OS as well, not only supported by the CPU.
+		bool osxsave = (ecx1 >> 27) & 1;
+		uint64_t xcr0 = osxsave ? QueryXcr0() : 0;
+		bool osAvx = (xcr0 & 0x6) == 0x6;
+		bool osAvx512 = (xcr0 & 0xE6) == 0xE6;
+
+		features.AVX = osAvx && ((ecx1 >> 28) & 1);
+		features.FMA = features.AVX && ((ecx1 >> 12) & 1);
+		features.F16C = features.AVX && ((ecx1 >> 29) & 1);
+
+		if (maxLeaf >= 7) {
+			QueryCpuid(7, 0, regs);
+			uint32_t ebx7 = regs[1];
+			features.AVX2 = features.AVX && ((ebx7 >> 5) & 1);
+			features.BMI1 = (ebx7 >> 3) & 1;
+			features.BMI2 = (ebx7 >> 8) & 1;
+			features.AVX512F = osAvx512 && ((ebx7 >> 16) & 1);
+			features.AVX512VL = features.AVX512F && ((ebx7 >> 31) & 1);
+		}
+		return features;
+	}
+}
+
+const CpuFeatures& CpuFeatures::Get()
+{
+	static const CpuFeatures features = Detect();
+	return features;
+}
@@ -0,0 +1,439 @@
+#include "../../header/Common/CpuTopology.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <numeric>
+#include <thread>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+namespace {
+	//What the OS says about one logical CPU, before numbering cores and caches.
+	struct RawCpu
+	{
+		uint32_t Id = 0;
+		uint16_t Group = 0;
+		uint64_t CoreKey = 0;
+		uint32_t Package = 0;
+		uint32_t NumaNode = 0;
+		std::string CacheKey;
+		uint32_t CacheLevel = 0;
+		uint64_t CacheBytes = 0;
+	};
+
+	CpuTopology Build(std::vector<RawCpu> raw)
+	{
+		std::sort(raw.begin(), raw.end(), [](const RawCpu& a, const RawCpu& b) {
+			return a.Group != b.Group ? a.Group < b.Group : a.Id < b.Id;
+		});
+
+		CpuTopology topology;
+		std::map<std::pair<uint32_t, uint64_t>, uint32_t> coreIndex;
+		std::map<std::string, uint32_t> cacheIndex;
+		std::map<uint32_t, uint32_t> packages, nodes;
+		for (const RawCpu& r : raw) {
+			LogicalCpu cpu;
+			cpu.Id = r.Id;
+			cpu.Group = r.Group;
+			cpu.Package = packages.emplace(r.Package, (uint32_t)packages.size()).first->second;
+			cpu.NumaNode = nodes.emplace(r.NumaNode, (uint32_t)nodes.size()).first->second;
+
+			auto core = coreIndex.emplace(std::make_pair(r.Package, r.CoreKey), (uint32_t)topology.Cores.size());
+			if (core.second) {
+				topology.Cores.emplace_back();
+			}
+			cpu.Core = core.first->second;
+			cpu.SmtIndex = (uint32_t)topology.Cores[cpu.Core].Cpus.size();
+			topology.Cores[cpu.Core].Cpus.push_back((uint32_t)topology.Cpus.size());
+
+			auto cache = cacheIndex.emplace(r.CacheKey, (uint32_t)topology.Caches.size());
+			if (cache.second) {
+				CacheDomain domain;
+				domain.Level = r.CacheLevel;
+				domain.Bytes = r.CacheBytes;
+				topology.Caches.push_back(domain);
+			}
+			cpu.Cache = cache.first->second;
+			topology.Caches[cpu.Cache].Cpus.push_back((uint32_t)topology.Cpus.size());
+
+			topology.Cpus.push_back(cpu);
+		}
+		topology.Packages = std::max<uint32_t>(1, (uint32_t)packages.size());
+		topology.NumaNodes = std::max<uint32_t>(1, (uint32_t)nodes.size());
+		return topology;
+	}
+
+	//Every CPU a core of its own in one package, cache and node.
+	std::vector<RawCpu> Unknown()
+	{
+		std::vector<RawCpu> raw(std::max(1u, std::thread::hardware_concurrency()));
+		for (uint32_t i = 0; i < raw.size(); ++i) {
+			raw[i].Id = i;
+			raw[i].CoreKey = i;
+			raw[i].CacheKey = "unknown";
+		}
+		return raw;
+	}
+
+#if defined(_WIN32)
+	std::vector<RawCpu> ProbeRaw()
+	{
+		DWORD length = 0;
+		GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+		std::vector<uint8_t> buffer(length);
+		auto* first = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+		if (length == 0 || !GetLogicalProcessorInformationEx(RelationAll, first, &length)) {
+			return Unknown();
+		}
+
+		struct Domain
+		{
+			GROUP_AFFINITY Mask;
+			uint32_t Value;
+			uint32_t Level;
+			uint64_t Bytes;
+		};
+		std::vector<RawCpu> raw;
+		std::vector<Domain> packages, nodes, caches;
+		uint32_t coreCount = 0;
+		for (size_t offset = 0; offset < length;) {
+			auto* info = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+			offset += info->Size;
+			switch (info->Relationship) {
+			case RelationProcessorCore:
+				for (WORD g = 0; g < info->Processor.GroupCount; ++g) {
+					const GROUP_AFFINITY& mask = info->Processor.GroupMask[g];
+					for (uint32_t bit = 0; bit < sizeof(KAFFINITY) * 8; ++bit) {
+						if (mask.Mask & ((KAFFINITY)1 << bit)) {
+							RawCpu cpu;
+							cpu.Id = bit;
+							cpu.Group = mask.Group;
+							cpu.CoreKey = coreCount;
+							raw.push_back(cpu);
+						}
+					}
+				}
+				coreCount++;
+				break;
+			case RelationProcessorPackage:
+				for (WORD g = 0; g < info->Processor.GroupCount; ++g) {
+					packages.push_back({ info->Processor.GroupMask[g], (uint32_t)packages.size(), 0, 0 });
+				}
+				break;
+			case RelationNumaNode:
+				nodes.push_back({ info->NumaNode.GroupMask, info->NumaNode.NodeNumber, 0, 0 });
+				break;
+			case RelationCache:
+				if (info->Cache.Type == CacheUnified || info->Cache.Type == CacheData) {
+					caches.push_back({ info->Cache.GroupMask, (uint32_t)caches.size(), info->Cache.Level,
+						info->Cache.CacheSize });
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		auto contains = [](const GROUP_AFFINITY& mask, const RawCpu& cpu) {
+			return mask.Group == cpu.Group && (mask.Mask & ((KAFFINITY)1 << cpu.Id)) != 0;
+		};
+		for (RawCpu& cpu : raw) {
+			for (const Domain& package : packages) {
+				if (contains(package.Mask, cpu)) {
+					cpu.Package = package.Value;
+				}
+			}
+			for (const Domain& node : nodes) {
+				if (contains(node.Mask, cpu)) {
+					cpu.NumaNode = node.Value;
+				}
+			}
+			cpu.CacheKey = "none";
+			for (const Domain& cache : caches) {
+				if (contains(cache.Mask, cpu) && cache.Level > cpu.CacheLevel) {
+					cpu.CacheLevel = cache.Level;
+					cpu.CacheBytes = cache.Bytes;
+					cpu.CacheKey = std::to_string(cache.Value);
+				}
+			}
+		}
+
+		//Only the CPUs of the process mask, for the group this thread is in.
+		GROUP_AFFINITY current = {};
+		DWORD_PTR processMask = 0, systemMask = 0;
+		if (GetThreadGroupAffinity(GetCurrentThread(), &current) &&
+			GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) && processMask != 0) {
+			raw.erase(std::remove_if(raw.begin(), raw.end(), [&](const RawCpu& cpu) {
+				return cpu.Group == current.Group && (processMask & ((DWORD_PTR)1 << cpu.Id)) == 0;
+			}), raw.end());
+		}
+		return raw.empty() ? Unknown() : raw;
+	}
+#else
+	//The first line of a sysfs file, empty if it does not exist.
+	std::string ReadLine(const std::string& path)
+	{
+		std::string line;
+		FILE* file = fopen(path.c_str(), "r");
+		if (file == nullptr) {
+			return line;
+		}
+		char buffer[4096];
+		if (fgets(buffer, sizeof(buffer), file) != nullptr) {
+			line = buffer;
+			while (!line.empty() && (line.back() == '\n' || line.back() == ' ')) {
+				line.pop_back();
+			}
+		}
+		fclose(file);
+		return line;
+	}
+
+	//"0-3,8,10-11"
+	std::vector<uint32_t> ParseList(const std::string& list)
+	{
+		std::vector<uint32_t> values;
+		size_t position = 0;
+		while (position < list.size()) {
+			size_t end = list.find(',', position);
+			if (end == std::string::npos) {
+				end = list.size();
+			}
+			std::string range = list.substr(position, end - position);
+			size_t dash = range.find('-');
+			uint32_t first = (uint32_t)strtoul(range.c_str(), nullptr, 10);
+			uint32_t last = dash == std::string::npos ? first : (uint32_t)strtoul(range.c_str() + dash + 1, nullptr, 10);
+			for (uint32_t value = first; value <= last; ++value) {
+				values.push_back(value);
+			}
+			position = end + 1;
+		}
+		return values;
+	}
+
+	//"32K", "8192K", "32M"
+	uint64_t ParseSize(const std::string& text)
+	{
+		uint64_t size = strtoull(text.c_str(), nullptr, 10);
+		if (text.find('K') != std::string::npos) {
+			size <<= 10;
+		}
+		else if (text.find('M') != std::string::npos) {
+			size <<= 20;
+		}
+		return size;
+	}
+
+	std::vector<RawCpu> ProbeRaw()
+	{
+		const std::string root = "/sys/devices/system/cpu/";
+		std::vector<uint32_t> online = ParseList(ReadLine(root + "online"));
+		if (online.empty()) {
+			return Unknown();
+		}
+
+		std::map<uint32_t, uint32_t> nodeOf;
+		for (uint32_t node : ParseList(ReadLine("/sys/devices/system/node/online"))) {
+			for (uint32_t cpu : ParseList(ReadLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"))) {
+				nodeOf[cpu] = node;
+			}
+		}
+
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		const bool knowAllowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+		std::vector<RawCpu> raw;
+		for (uint32_t id : online) {
+			if (knowAllowed && id < CPU_SETSIZE && !CPU_ISSET(id, &allowed)) {
+				continue;
+			}
+			const std::string cpuPath = root + "cpu" + std::to_string(id) + "/";
+			RawCpu cpu;
+			cpu.Id = id;
+			std::string coreId = ReadLine(cpuPath + "topology/core_id");
+			cpu.CoreKey = coreId.empty() ? id : strtoull(coreId.c_str(), nullptr, 10);
+			cpu.Package = (uint32_t)strtoul(ReadLine(cpuPath + "topology/physical_package_id").c_str(), nullptr, 10);
+			cpu.NumaNode = nodeOf.count(id) ? nodeOf[id] : 0;
+
+			//The highest data or unified cache level is the last-level cache;
+			//the CPUs sharing it identify the domain.
+			cpu.CacheKey = "package " + std::to_string(cpu.Package);
+			for (int index = 0;; ++index) {
+				const std::string cachePath = cpuPath + "cache/index" + std::to_string(index) + "/";
+				std::string level = ReadLine(cachePath + "level");
+				if (level.empty()) {
+					break;
+				}
+				if (ReadLine(cachePath + "type") == "Instruction") {
+					continue;
+				}
+				uint32_t value = (uint32_t)strtoul(level.c_str(), nullptr, 10);
+				if (value > cpu.CacheLevel) {
+					cpu.CacheLevel = value;
+					cpu.CacheBytes = ParseSize(ReadLine(cachePath + "size"));
+					cpu.CacheKey = ReadLine(cachePath + "shared_cpu_list");
+				}
+			}
+			raw.push_back(cpu);
+		}
+		return raw.empty() ? Unknown() : raw;
+	}
+#endif
+}
+
+const CpuTopology& CpuTopology::Get()
+{
+	static const CpuTopology topology = Probe();
+	return topology;
+}
+
+CpuTopology CpuTopology::Probe()
+{
+	return Build(ProbeRaw());
+}
+
+std::string CpuTopology::Describe() const
+{
+	char text[256];
+	uint32_t maxSmt = 0;
+	for (const CpuCore& core : Cores) {
+		maxSmt = std::max(maxSmt, (uint32_t)core.Cpus.size());
+	}
+	uint64_t cacheBytes = Caches.empty() ? 0 : Caches[0].Bytes;
+	uint32_t cacheLevel = Caches.empty() ? 0 : Caches[0].Level;
+	snprintf(text, sizeof(text), "%zu logical CPUs, %zu cores (SMT %u), %zu L%u caches of %llu KB, %u packages, %u NUMA nodes",
+		Cpus.size(), Cores.size(), maxSmt, Caches.size(), cacheLevel, (unsigned long long)(cacheBytes >> 10),
+		Packages, NumaNodes);
+	return text;
+}
+
+const char* ThreadPlacementName(ThreadPlacement placement)
+{
+	switch (placement) {
+	case ThreadPlacement::Compact: return "compact";
+	case ThreadPlacement::Spread: return "spread";
+	case ThreadPlacement::AllLogical: return "all logical";
+	default: return "none";
+	}
+}
+
+uint32_t PlacementThreadCount(const CpuTopology& topology, ThreadPlacement placement)
+{
+	if (placement == ThreadPlacement::Compact || placement == ThreadPlacement::Spread) {
+		return std::max<uint32_t>(1, (uint32_t)topology.Cores.size());
+	}
+	return std::max<uint32_t>(1, (uint32_t)topology.Cpus.size());
+}
+
+std::vector<uint32_t> PlanThreadCpus(const CpuTopology& topology, ThreadPlacement placement, uint32_t threadCount)
+{
+	std::vector<uint32_t> plan;
+	if (placement == ThreadPlacement::None || topology.Cpus.empty()) {
+		return plan;
+	}
+
+	//Physical cores by NUMA node, package and cache, i.e. neighbours next to each other.
+	auto firstCpu = [&topology](uint32_t core) -> const LogicalCpu& {
+		return topology.Cpus[topology.Cores[core].Cpus[0]];
+	};
+	std::vector<uint32_t> cores(topology.Cores.size());
+	std::iota(cores.begin(), cores.end(), 0u);
+	std::stable_sort(cores.begin(), cores.end(), [&](uint32_t a, uint32_t b) {
+		const LogicalCpu& x = firstCpu(a);
+		const LogicalCpu& y = firstCpu(b);
+		if (x.NumaNode != y.NumaNode) {
+			return x.NumaNode < y.NumaNode;
+		}
+		if (x.Package != y.Package) {
+			return x.Package < y.Package;
+		}
+		return x.Cache < y.Cache;
+	});
+
+	if (placement == ThreadPlacement::Spread) {
+		//One core of every cache in turn, each cache's cores still in order.
+		std::vector<std::vector<uint32_t>> byCache(topology.Caches.size());
+		for (uint32_t core : cores) {
+			byCache[firstCpu(core).Cache].push_back(core);
+		}
+		cores.clear();
+		for (size_t round = 0; cores.size() < topology.Cores.size(); ++round) {
+			for (const std::vector<uint32_t>& cacheCores : byCache) {
+				if (round < cacheCores.size()) {
+					cores.push_back(cacheCores[round]);
+				}
+			}
+		}
+	}
+
+	//The first thread of every core, then the second ones, ...
+	std::vector<uint32_t> slots;
+	for (uint32_t smt = 0; slots.size() < topology.Cpus.size(); ++smt) {
+		for (uint32_t core : cores) {
+			if (smt < topology.Cores[core].Cpus.size()) {
+				slots.push_back(topology.Cores[core].Cpus[smt]);
+			}
+		}
+	}
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		plan.push_back(slots[i % slots.size()]);
+	}
+	return plan;
+}
+
+#if defined(_WIN32)
+
+bool PinCurrentThread(const LogicalCpu& cpu)
+{
+	GROUP_AFFINITY affinity = {};
+	affinity.Mask = (KAFFINITY)1 << cpu.Id;
+	affinity.Group = cpu.Group;
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
+bool UnpinCurrentThread(const CpuTopology& topology)
+{
+	//A thread only ever runs in one processor group.
+	GROUP_AFFINITY affinity = {};
+	if (!GetThreadGroupAffinity(GetCurrentThread(), &affinity)) {
+		return false;
+	}
+	affinity.Mask = 0;
+	for (const LogicalCpu& cpu : topology.Cpus) {
+		if (cpu.Group == affinity.Group) {
+			affinity.Mask |= (KAFFINITY)1 << cpu.Id;
+		}
+	}
+	return affinity.Mask != 0 && SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
+#else
+
+bool PinCurrentThread(const LogicalCpu& cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu.Id, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+bool UnpinCurrentThread(const CpuTopology& topology)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (const LogicalCpu& cpu : topology.Cpus) {
+		CPU_SET(cpu.Id, &set);
+	}
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+#endif
@@ -0,0 +1,118 @@
+#include "../../header/Common/FramePipeline.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+	template<typename Clock>
+	double MillisecondsSince(typename Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+}
+
+FramePipeline::FramePipeline(uint32_t snapshotCount, std::function<void(uint32_t)> render,
+	const LogicalCpu* renderCpu)
+	: mSnapshotCount(std::clamp<uint32_t>(snapshotCount, 1, (uint32_t)QueueCapacity))
+	, mRender(std::move(render))
+	, mSlots(mSnapshotCount)
+{
+	if (renderCpu != nullptr) {
+		mRenderCpu = *renderCpu;
+	}
+	for (uint32_t i = 0; i < mSnapshotCount; ++i) {
+		mFree.push_back(i);
+	}
+	mThread = std::thread([this]() { RenderMain(); });
+}
+
+FramePipeline::~FramePipeline()
+{
+	Stop();
+}
+
+uint32_t FramePipeline::Acquire()
+{
+	if (mFree.empty()) {
+		auto start = Clock::now();
+		Reclaim();
+		mStats.UpdateWaitMilliseconds += MillisecondsSince<Clock>(start);
+	}
+	if (mFailure) {
+		std::rethrow_exception(std::exchange(mFailure, nullptr));
+	}
+	uint32_t index = mFree.front();
+	mFree.pop_front();
+	return index;
+}
+
+void FramePipeline::Publish(uint32_t index)
+{
+	mSlots[index].Published = Clock::now();
+	mInFlight++;
+	mStats.MaxFramesAhead = std::max(mStats.MaxFramesAhead, mInFlight);
+	//Never more than mSnapshotCount <= QueueCapacity entries, this does not wait.
+	mPublished.Push(index);
+}
+
+void FramePipeline::Drain()
+{
+	while (mInFlight != 0) {
+		Reclaim();
+	}
+}
+
+void FramePipeline::Stop()
+{
+	if (!mThread.joinable()) {
+		return;
+	}
+	Drain();
+	mPublished.Push(StopIndex);
+	mThread.join();
+}
+
+void FramePipeline::Reclaim()
+{
+	uint32_t index = mRendered.Pop();
+	mInFlight--;
+	Slot& slot = mSlots[index];
+	mStats.Frames++;
+	mStats.LatencyMilliseconds += slot.LatencyMilliseconds;
+	mStats.MaxLatencyMilliseconds = std::max(mStats.MaxLatencyMilliseconds, slot.LatencyMilliseconds);
+	mStats.RenderIdleMilliseconds += slot.IdleMilliseconds;
+	if (slot.Failure && !mFailure) {
+		mFailure = slot.Failure;
+	}
+	slot.Failure = nullptr;
+	mFree.push_back(index);
+}
+
+void FramePipeline::RenderMain()
+{
+	if (mRenderCpu) {
+		PinCurrentThread(*mRenderCpu);
+	}
+	bool failed = false;
+	for (;;) {
+		auto idleStart = Clock::now();
+		uint32_t index = mPublished.Pop();
+		if (index == StopIndex) {
+			return;
+		}
+		Slot& slot = mSlots[index];
+		slot.IdleMilliseconds = MillisecondsSince<Clock>(idleStart);
+
+		//After a failure the snapshots only go back, Acquire() rethrows.
+		if (!failed) {
+			try {
+				mRender(index);
+			}
+			catch (...) {
+				slot.Failure = std::current_exception();
+				failed = true;
+			}
+		}
+		slot.LatencyMilliseconds = MillisecondsSince<Clock>(slot.Published);
+		mRendered.Push(index);
+	}
+}
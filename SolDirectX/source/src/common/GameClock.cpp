@@ -0,0 +1,81 @@
+#include "../../header/Common/GameClock.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <chrono>
+#endif
+
+#if defined(_WIN32)
+
+uint64_t HighResolutionNanoseconds()
+{
+	static const int64_t frequency = []() {
+		LARGE_INTEGER value;
+		QueryPerformanceFrequency(&value);
+		return (int64_t)value.QuadPart;
+	}();
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	//Whole seconds and the rest apart: counter * 10^9 overflows after minutes at a 10 MHz frequency.
+	const uint64_t ticks = (uint64_t)counter.QuadPart;
+	return ticks / frequency * 1000000000ull + ticks % frequency * 1000000000ull / frequency;
+}
+
+#else
+
+uint64_t HighResolutionNanoseconds()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
+
+GameClock::GameClock(std::function<uint64_t()> nowNanoseconds)
+	: mNow(std::move(nowNanoseconds))
+{
+	mLast = mNow();
+}
+
+double GameClock::Tick()
+{
+	const uint64_t now = mNow();
+	mDeltaSeconds = now > mLast ? (double)(now - mLast) * 1e-9 : 0.0;
+	mLast = std::max(mLast, now);
+	mTotalSeconds += mDeltaSeconds;
+	return mDeltaSeconds;
+}
+
+void GameClock::Reset()
+{
+	mLast = mNow();
+	mDeltaSeconds = 0.0;
+}
+
+FixedStepLoop::FixedStepLoop(double stepSeconds, uint32_t maxStepsPerFrame)
+	: mStepSeconds(stepSeconds > 0.0 ? stepSeconds : 1.0 / 60.0)
+	, mMaxStepsPerFrame(std::max(1u, maxStepsPerFrame))
+{
+}
+
+uint32_t FixedStepLoop::Advance(double elapsedSeconds)
+{
+	mAccumulator += std::max(0.0, elapsedSeconds);
+	const double whole = std::floor(mAccumulator / mStepSeconds);
+	//Rounding can leave the rest a hair outside [0, step).
+	mAccumulator = std::clamp(mAccumulator - whole * mStepSeconds, 0.0, std::nextafter(mStepSeconds, 0.0));
+
+	uint64_t steps = (uint64_t)whole;
+	if (steps > mMaxStepsPerFrame) {
+		mDroppedSteps += steps - mMaxStepsPerFrame;
+		steps = mMaxStepsPerFrame;
+	}
+	mSteps += steps;
+	return (uint32_t)steps;
+}
@@ -0,0 +1,427 @@
+#include "../../header/Common/JobSystem.h"
+#include <algorithm>
+
+struct Job
+{
+	std::function<void()> Work;
+	JobCounter* Counter = nullptr;
+	//Next job waiting on the same counter.
+	Job* Next = nullptr;
+};
+
+namespace {
+	const uint64_t LeavingJob = 1ull << 32;
+
+	struct WorkerThread
+	{
+		const JobSystem* System = nullptr;
+		int Index = -1;
+	};
+	thread_local WorkerThread tWorker;
+
+	//Finished jobs are kept per thread and reused, so most jobs do not allocate
+	//beyond what their std::function needs.
+	struct JobPool
+	{
+		std::vector<Job*> Free;
+
+		~JobPool()
+		{
+			for (Job* job : Free) {
+				delete job;
+			}
+		}
+	};
+	thread_local JobPool tJobPool;
+
+	Job* AllocateJob(std::function<void()>&& work, JobCounter* counter)
+	{
+		Job* job = nullptr;
+		if (!tJobPool.Free.empty()) {
+			job = tJobPool.Free.back();
+			tJobPool.Free.pop_back();
+		}
+		else {
+			job = new Job();
+		}
+		job->Work = std::move(work);
+		job->Counter = counter;
+		job->Next = nullptr;
+		return job;
+	}
+
+	void RecycleJob(Job* job)
+	{
+		job->Work = nullptr;
+		if (tJobPool.Free.size() < 1024) {
+			tJobPool.Free.push_back(job);
+		}
+		else {
+			delete job;
+		}
+	}
+
+	//xorshift32 for picking victims; ThreadRandom() is left alone so the
+	//workers do not shift the streams of the other threads.
+	uint32_t NextVictim()
+	{
+		thread_local uint32_t state = (uint32_t)std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+}
+
+//Chase-Lev deque with a fixed capacity, in the C11 formulation of Le, Pop,
+//Cohen and Zappa Nardelli ("Correct and Efficient Work-Stealing for Weak
+//Memory Models"). Only the owner calls Push() and Pop(), anyone Steal().
+class JobSystem::Deque
+{
+public:
+	static const int64_t Capacity = 4096;
+
+	bool Push(Job* job)
+	{
+		int64_t bottom = mBottom.load(std::memory_order_relaxed);
+		int64_t top = mTop.load(std::memory_order_acquire);
+		if (bottom - top >= Capacity) {
+			return false;
+		}
+		mJobs[bottom & (Capacity - 1)].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		mBottom.store(bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	Job* Pop()
+	{
+		int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+		mBottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = mTop.load(std::memory_order_relaxed);
+		if (top > bottom) {
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+		Job* job = mJobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+		if (top == bottom) {
+			//The last job: race the thieves for it.
+			if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				job = nullptr;
+			}
+			mBottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	Job* Steal()
+	{
+		int64_t top = mTop.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t bottom = mBottom.load(std::memory_order_acquire);
+		if (top >= bottom) {
+			return nullptr;
+		}
+		Job* job = mJobs[top & (Capacity - 1)].load(std::memory_order_relaxed);
+		if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			//Lost to the owner or another thief.
+			return nullptr;
+		}
+		return job;
+	}
+
+	bool Empty() const
+	{
+		return mBottom.load(std::memory_order_relaxed) <= mTop.load(std::memory_order_relaxed);
+	}
+
+private:
+	alignas(64) std::atomic<int64_t> mTop{ 0 };
+	alignas(64) std::atomic<int64_t> mBottom{ 0 };
+	alignas(64) std::atomic<Job*> mJobs[Capacity];
+};
+
+JobSystem::JobSystem(uint32_t threadCount, ThreadPlacement placement, uint32_t reservedThreads)
+	: mOwner(std::this_thread::get_id())
+	, mPlacement(placement)
+{
+	const CpuTopology& topology = CpuTopology::Get();
+	if (threadCount == 0 && placement == ThreadPlacement::None) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	else if (threadCount == 0) {
+		const uint32_t planned = PlacementThreadCount(topology, placement);
+		threadCount = planned > reservedThreads ? planned - reservedThreads : 1;
+	}
+	mThreadCpus = PlanThreadCpus(topology, placement, threadCount + reservedThreads);
+	if (!mThreadCpus.empty()) {
+		mReservedCpus.assign(mThreadCpus.begin() + threadCount, mThreadCpus.end());
+		mThreadCpus.resize(threadCount);
+		mOwnerPinned = PinCurrentThread(topology.Cpus[mThreadCpus[0]]);
+	}
+	for (uint32_t i = 0; i < threadCount; ++i) {
+		mDeques.push_back(std::make_unique<Deque>());
+	}
+	for (uint32_t i = 1; i < threadCount; ++i) {
+		mWorkers.emplace_back([this, i]() { WorkerMain(i); });
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mQuit = true;
+	}
+	mWakeUp.notify_all();
+	for (std::thread& worker : mWorkers) {
+		worker.join();
+	}
+	if (mOwnerPinned && std::this_thread::get_id() == mOwner) {
+		UnpinCurrentThread(CpuTopology::Get());
+	}
+}
+
+int JobSystem::ThreadIndex() const
+{
+	if (tWorker.System == this) {
+		return tWorker.Index;
+	}
+	return std::this_thread::get_id() == mOwner ? 0 : -1;
+}
+
+void JobSystem::Run(std::function<void()> work, JobCounter* counter)
+{
+	if (counter != nullptr) {
+		counter->mState.fetch_add(1, std::memory_order_relaxed);
+	}
+	Push(AllocateJob(std::move(work), counter));
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> work, JobCounter* counter)
+{
+	if (counter != nullptr) {
+		counter->mState.fetch_add(1, std::memory_order_relaxed);
+	}
+	Job* job = AllocateJob(std::move(work), counter);
+	job->Next = dependency.mWaiting.load(std::memory_order_relaxed);
+	while (!dependency.mWaiting.compare_exchange_weak(job->Next, job)) {
+	}
+	//If the dependency reached zero before the job was in its list, nobody
+	//else is going to release it.
+	if ((uint32_t)dependency.mState.load() == 0) {
+		Release(dependency);
+	}
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	const int threadIndex = ThreadIndex();
+	while (counter.mState.load(std::memory_order_acquire) != 0) {
+		if (Job* job = FindJob(threadIndex)) {
+			Execute(job);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::Push(Job* job)
+{
+	const int threadIndex = ThreadIndex();
+	mQueued.fetch_add(1);
+	if (threadIndex >= 0) {
+		if (!mDeques[threadIndex]->Push(job)) {
+			//Full: thousands of jobs are waiting already, so doing this one
+			//right now does not cost any parallelism.
+			mQueued.fetch_sub(1);
+			Execute(job);
+			return;
+		}
+	}
+	else {
+		std::lock_guard<std::mutex> lock(mInjectedMutex);
+		mInjected.push_back(job);
+		mInjectedCount.store(mInjected.size(), std::memory_order_release);
+	}
+
+	if (mSleeping.load() != 0) {
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mWakeUp.notify_one();
+	}
+}
+
+Job* JobSystem::FindJob(int threadIndex)
+{
+	Job* job = threadIndex >= 0 ? mDeques[threadIndex]->Pop() : nullptr;
+
+	if (job == nullptr && mInjectedCount.load(std::memory_order_acquire) != 0) {
+		std::lock_guard<std::mutex> lock(mInjectedMutex);
+		if (!mInjected.empty()) {
+			job = mInjected.front();
+			mInjected.pop_front();
+			mInjectedCount.store(mInjected.size(), std::memory_order_release);
+		}
+	}
+
+	if (job == nullptr) {
+		const uint32_t threadCount = ThreadCount();
+		const uint32_t first = NextVictim() % threadCount;
+		for (uint32_t i = 0; i < threadCount && job == nullptr; ++i) {
+			uint32_t victim = (first + i) % threadCount;
+			if ((int)victim != threadIndex) {
+				job = mDeques[victim]->Steal();
+			}
+		}
+	}
+
+	if (job != nullptr) {
+		mQueued.fetch_sub(1);
+	}
+	return job;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->Work();
+	JobCounter* counter = job->Counter;
+	RecycleJob(job);
+	Finish(counter);
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	if (counter == nullptr) {
+		return;
+	}
+	//Count down and mark this job as leaving in one step; the counter must
+	//outlive the mark, not just the count.
+	uint64_t old = counter->mState.fetch_add(LeavingJob - 1);
+	if ((uint32_t)old == 1) {
+		Release(*counter);
+	}
+	counter->mState.fetch_sub(LeavingJob, std::memory_order_release);
+}
+
+void JobSystem::Release(JobCounter& counter)
+{
+	Job* job = counter.mWaiting.exchange(nullptr);
+	while (job != nullptr) {
+		Job* next = job->Next;
+		job->Next = nullptr;
+		Push(job);
+		job = next;
+	}
+}
+
+bool JobSystem::OwnQueueEmpty(int threadIndex)
+{
+	return threadIndex >= 0 ? mDeques[threadIndex]->Empty() : mInjectedCount.load(std::memory_order_relaxed) == 0;
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t minGrain,
+	const std::function<void(size_t, size_t)>& body)
+{
+	if (begin >= end) {
+		return;
+	}
+	minGrain = std::max<size_t>(1, minGrain);
+	if (ThreadCount() == 1 || end - begin <= minGrain) {
+		body(begin, end);
+		return;
+	}
+
+	JobCounter counter;
+	RunRange(begin, end, minGrain, body, counter);
+	Wait(counter);
+}
+
+void JobSystem::RunRange(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body,
+	JobCounter& counter)
+{
+	const int threadIndex = ThreadIndex();
+	while (end - begin > grain) {
+		if (end - begin >= 2 * grain && OwnQueueEmpty(threadIndex)) {
+			size_t middle = begin + (end - begin) / 2;
+			Run([this, middle, end, grain, &body, &counter]() { RunRange(middle, end, grain, body, counter); }, &counter);
+			end = middle;
+		}
+		else {
+			body(begin, begin + grain);
+			begin += grain;
+		}
+	}
+	body(begin, end);
+}
+
+void JobSystem::WorkerMain(uint32_t index)
+{
+	tWorker.System = this;
+	tWorker.Index = (int)index;
+	if (!mThreadCpus.empty()) {
+		PinCurrentThread(CpuTopology::Get().Cpus[mThreadCpus[index]]);
+	}
+	for (;;) {
+		Job* job = FindJob((int)index);
+		//Spin a little before sleeping, new jobs tend to come in bursts.
+		for (int spin = 0; job == nullptr && spin < 64; ++spin) {
+			std::this_thread::yield();
+			job = FindJob((int)index);
+		}
+		if (job != nullptr) {
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		mSleeping.fetch_add(1);
+		mWakeUp.wait(lock, [this]() { return mQuit || mQueued.load() > 0; });
+		mSleeping.fetch_sub(1);
+		if (mQuit) {
+			return;
+		}
+	}
+}
+
+namespace {
+	struct DefaultConfiguration
+	{
+		std::mutex Mutex;
+		bool Created = false;
+		uint32_t ThreadCount = 0;
+		ThreadPlacement Placement = ThreadPlacement::None;
+		uint32_t ReservedThreads = 0;
+	};
+
+	DefaultConfiguration& DefaultConfig()
+	{
+		static DefaultConfiguration config;
+		return config;
+	}
+}
+
+JobSystem& DefaultJobSystem()
+{
+	static JobSystem jobs = []() {
+		DefaultConfiguration& config = DefaultConfig();
+		std::lock_guard<std::mutex> lock(config.Mutex);
+		config.Created = true;
+		return JobSystem(config.ThreadCount, config.Placement, config.ReservedThreads);
+	}();
+	return jobs;
+}
+
+bool ConfigureDefaultJobSystem(uint32_t threadCount, ThreadPlacement placement, uint32_t reservedThreads)
+{
+	DefaultConfiguration& config = DefaultConfig();
+	std::lock_guard<std::mutex> lock(config.Mutex);
+	if (config.Created) {
+		return false;
+	}
+	config.ThreadCount = threadCount;
+	config.Placement = placement;
+	config.ReservedThreads = reservedThreads;
+	return true;
+}
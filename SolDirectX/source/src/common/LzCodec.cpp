@@ -0,0 +1,168 @@
+#include "../../header/Common/LzCodec.h"
+#include <cstring>
+#include <vector>
+
+namespace {
+	const size_t MinMatch = 4;
+	const size_t MaxOffset = 65535;
+	//The last bytes of a block are always literals, so matches never run into
+	//the end and the decoder can copy in 8-byte steps.
+	const size_t LastLiterals = 8;
+	const uint32_t HashBits = 14;
+
+	uint32_t Read32(const uint8_t* p)
+	{
+		uint32_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t Hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HashBits);
+	}
+
+	uint8_t* WriteLength(uint8_t* out, size_t length)
+	{
+		for (; length >= 255; length -= 255) {
+			*out++ = 255;
+		}
+		*out++ = (uint8_t)length;
+		return out;
+	}
+
+	uint8_t* WriteSequence(uint8_t* out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+	{
+		uint8_t* token = out++;
+		*token = (uint8_t)((literalCount >= 15 ? 15 : literalCount) << 4);
+		if (literalCount >= 15) {
+			out = WriteLength(out, literalCount - 15);
+		}
+		if (literalCount != 0) {
+			memcpy(out, literals, literalCount);
+			out += literalCount;
+		}
+		if (matchLength == 0) {
+			return out;
+		}
+
+		*out++ = (uint8_t)offset;
+		*out++ = (uint8_t)(offset >> 8);
+		size_t length = matchLength - MinMatch;
+		*token |= (uint8_t)(length >= 15 ? 15 : length);
+		if (length >= 15) {
+			out = WriteLength(out, length - 15);
+		}
+		return out;
+	}
+
+	bool ReadLength(const uint8_t*& in, const uint8_t* end, size_t& length)
+	{
+		uint8_t byte;
+		do {
+			if (in == end) {
+				return false;
+			}
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+}
+
+size_t LzCompressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t LzCompress(const uint8_t* src, size_t size, uint8_t* dst)
+{
+	uint8_t* out = dst;
+	size_t anchor = 0;
+	if (size > LastLiterals + MinMatch) {
+		std::vector<uint32_t> table((size_t)1 << HashBits, 0);
+		const size_t limit = size - LastLiterals - MinMatch;
+		size_t position = 1;
+		table[Hash(Read32(src))] = 0;
+		while (position < limit) {
+			const uint32_t sequence = Read32(src + position);
+			const uint32_t hash = Hash(sequence);
+			const size_t candidate = table[hash];
+			table[hash] = (uint32_t)position;
+			if (position - candidate > MaxOffset || Read32(src + candidate) != sequence) {
+				//Skip faster through data that does not compress.
+				position += 1 + ((position - anchor) >> 6);
+				continue;
+			}
+
+			size_t length = MinMatch;
+			while (position + length < size - LastLiterals && src[candidate + length] == src[position + length]) {
+				++length;
+			}
+			out = WriteSequence(out, src + anchor, position - anchor, position - candidate, length);
+			position += length;
+			anchor = position;
+			if (position < limit) {
+				table[Hash(Read32(src + position - 2))] = (uint32_t)(position - 2);
+			}
+		}
+	}
+	out = WriteSequence(out, src + anchor, size - anchor, 0, 0);
+	return (size_t)(out - dst);
+}
+
+bool LzDecompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+	const uint8_t* in = src;
+	const uint8_t* inEnd = src + srcSize;
+	uint8_t* out = dst;
+	uint8_t* outEnd = dst + dstSize;
+	while (in < inEnd) {
+		const uint8_t token = *in++;
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !ReadLength(in, inEnd, literalCount)) {
+			return false;
+		}
+		if (literalCount > (size_t)(inEnd - in) || literalCount > (size_t)(outEnd - out)) {
+			return false;
+		}
+		if (literalCount != 0) {
+			memcpy(out, in, literalCount);
+			in += literalCount;
+			out += literalCount;
+		}
+		if (in == inEnd) {
+			//The last sequence has literals only.
+			break;
+		}
+
+		if (inEnd - in < 2) {
+			return false;
+		}
+		const size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+		in += 2;
+		size_t length = token & 15;
+		if (length == 15 && !ReadLength(in, inEnd, length)) {
+			return false;
+		}
+		length += MinMatch;
+		if (offset == 0 || offset > (size_t)(out - dst) || length > (size_t)(outEnd - out)) {
+			return false;
+		}
+
+		const uint8_t* match = out - offset;
+		if (offset >= 8 && (size_t)(outEnd - out) >= length + 8) {
+			//8-byte steps may write past the match, which the room checked above allows.
+			for (size_t i = 0; i < length; i += 8) {
+				memcpy(out + i, match + i, 8);
+			}
+		}
+		else {
+			for (size_t i = 0; i < length; ++i) {
+				out[i] = match[i];
+			}
+		}
+		out += length;
+	}
+	return out == outEnd;
+}
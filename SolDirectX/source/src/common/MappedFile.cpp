@@ -0,0 +1,134 @@
+#include "../../header/Common/MappedFile.h"
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace {
+	void SetError(std::string* error, const std::string& message)
+	{
+		if (error != nullptr) {
+			*error = message;
+		}
+	}
+}
+
+#if defined(_WIN32)
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path, std::string* error)
+{
+	std::shared_ptr<MappedFile> file(new MappedFile());
+	file->mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file->mFile == INVALID_HANDLE_VALUE) {
+		file->mFile = nullptr;
+		SetError(error, "cannot open " + path + " (error " + std::to_string(GetLastError()) + ")");
+		return nullptr;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file->mFile, &size) || size.QuadPart == 0) {
+		SetError(error, path + " is empty");
+		return nullptr;
+	}
+	file->mSize = (size_t)size.QuadPart;
+
+	file->mMapping = CreateFileMappingA(file->mFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (file->mMapping == nullptr) {
+		SetError(error, "cannot map " + path + " (error " + std::to_string(GetLastError()) + ")");
+		return nullptr;
+	}
+	file->mData = static_cast<uint8_t*>(MapViewOfFile(file->mMapping, FILE_MAP_COPY, 0, 0, 0));
+	if (file->mData == nullptr) {
+		SetError(error, "cannot map " + path + " (error " + std::to_string(GetLastError()) + ")");
+		return nullptr;
+	}
+	return file;
+}
+
+MappedFile::~MappedFile()
+{
+	if (mData != nullptr) {
+		UnmapViewOfFile(mData);
+	}
+	if (mMapping != nullptr) {
+		CloseHandle(mMapping);
+	}
+	if (mFile != nullptr) {
+		CloseHandle(mFile);
+	}
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const
+{
+	if (offset >= mSize) {
+		return;
+	}
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = mData + offset;
+	range.NumberOfBytes = std::min(size, mSize - offset);
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path, std::string* error)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		SetError(error, "cannot open " + path + ": " + strerror(errno));
+		return nullptr;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		SetError(error, path + " is empty");
+		close(fd);
+		return nullptr;
+	}
+
+	//The mapping keeps the file referenced, the descriptor is not needed any more.
+	void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		SetError(error, "cannot map " + path + ": " + strerror(errno));
+		return nullptr;
+	}
+
+	std::shared_ptr<MappedFile> file(new MappedFile());
+	file->mData = static_cast<uint8_t*>(data);
+	file->mSize = (size_t)info.st_size;
+	return file;
+}
+
+MappedFile::~MappedFile()
+{
+	if (mData != nullptr) {
+		munmap(mData, mSize);
+	}
+}
+
+void MappedFile::Prefetch(size_t offset, size_t size) const
+{
+	if (offset >= mSize) {
+		return;
+	}
+	//madvise wants a page aligned start.
+	const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t begin = offset / pageSize * pageSize;
+	size_t end = offset + std::min(size, mSize - offset);
+	madvise(mData + begin, end - begin, MADV_WILLNEED);
+}
+
+#endif
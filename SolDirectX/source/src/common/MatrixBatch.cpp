@@ -0,0 +1,427 @@
+#include "../../header/Common/MatrixBatch.h"
+#include "../../header/Common/CpuFeatures.h"
+#include <immintrin.h>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+	const float* At(const float* base, size_t stride, size_t i)
+	{
+		return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(base) + i * stride);
+	}
+
+	float* At(float* base, size_t stride, size_t i)
+	{
+		return reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(base) + i * stride);
+	}
+
+	//Scalar versions, also the reference for the others.
+
+	void MultiplyScalar(const float* src, size_t srcStride, const float m[16], float* dst, size_t dstStride,
+		size_t count, bool transpose)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			const float* a = At(src, srcStride, i);
+			float r[16];
+			for (int row = 0; row < 4; ++row) {
+				for (int c = 0; c < 4; ++c) {
+					r[4 * row + c] = a[4 * row] * m[c] + a[4 * row + 1] * m[4 + c] +
+						a[4 * row + 2] * m[8 + c] + a[4 * row + 3] * m[12 + c];
+				}
+			}
+			float* out = At(dst, dstStride, i);
+			for (int row = 0; row < 4; ++row) {
+				for (int c = 0; c < 4; ++c) {
+					out[4 * row + c] = transpose ? r[4 * c + row] : r[4 * row + c];
+				}
+			}
+		}
+	}
+
+	void TransposeScalar(const float* src, size_t srcStride, float* dst, size_t dstStride, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			const float* a = At(src, srcStride, i);
+			float r[16];
+			for (int k = 0; k < 16; ++k) {
+				r[k] = a[4 * (k & 3) + (k >> 2)];
+			}
+			float* out = At(dst, dstStride, i);
+			for (int k = 0; k < 16; ++k) {
+				out[k] = r[k];
+			}
+		}
+	}
+
+	//The rows of the inverse transpose of a 3x3 are the cross products of
+	//its other two rows, divided by the determinant.
+	void InverseTransposeScalar(const float* src, size_t srcStride, float* dst, size_t dstStride,
+		size_t count, bool transpose)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			const float* a = At(src, srcStride, i);
+			float r[16] = {
+				a[5] * a[10] - a[6] * a[9], a[6] * a[8] - a[4] * a[10], a[4] * a[9] - a[5] * a[8], 0.0f,
+				a[9] * a[2] - a[10] * a[1], a[10] * a[0] - a[8] * a[2], a[8] * a[1] - a[9] * a[0], 0.0f,
+				a[1] * a[6] - a[2] * a[5], a[2] * a[4] - a[0] * a[6], a[0] * a[5] - a[1] * a[4], 0.0f,
+				0.0f, 0.0f, 0.0f, 1.0f,
+			};
+			const float det = a[0] * r[0] + a[1] * r[1] + a[2] * r[2];
+			const float scale = det != 0.0f ? 1.0f / det : 0.0f;
+			for (int k = 0; k < 12; ++k) {
+				r[k] *= scale;
+			}
+			float* out = At(dst, dstStride, i);
+			for (int row = 0; row < 4; ++row) {
+				for (int c = 0; c < 4; ++c) {
+					out[4 * row + c] = transpose ? r[4 * c + row] : r[4 * row + c];
+				}
+			}
+		}
+	}
+
+	//Arvo's method: the new center is the transformed center, the new extents
+	//the extents through the absolute values of the 3x3 part.
+	void TransformAabbsScalar(const float* boxes, size_t boxStride, const float* matrices, size_t matrixStride,
+		float* dst, size_t dstStride, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			const float* box = At(boxes, boxStride, i);
+			const float* m = At(matrices, matrixStride, i);
+			float r[6];
+			for (int k = 0; k < 3; ++k) {
+				r[k] = box[0] * m[k] + box[1] * m[4 + k] + box[2] * m[8 + k] + m[12 + k];
+				r[3 + k] = box[3] * fabsf(m[k]) + box[4] * fabsf(m[4 + k]) + box[5] * fabsf(m[8 + k]);
+			}
+			float* out = At(dst, dstStride, i);
+			for (int k = 0; k < 6; ++k) {
+				out[k] = r[k];
+			}
+		}
+	}
+
+	//AVX2: two rows of a matrix per register, the rows of m repeated in both
+	//halves so every row is four broadcasts and fused multiply-adds.
+
+	//Transposes a matrix held as rows 0-1 and rows 2-3 in place.
+	SOL_TARGET_AVX2 void Transpose2x8(__m256& r01, __m256& r23)
+	{
+		const __m256i low = _mm256_setr_epi32(0, 4, 0, 4, 1, 5, 1, 5);
+		const __m256i high = _mm256_setr_epi32(2, 6, 2, 6, 3, 7, 3, 7);
+		__m256 t01 = _mm256_blend_ps(_mm256_permutevar8x32_ps(r01, low), _mm256_permutevar8x32_ps(r23, low), 0xCC);
+		__m256 t23 = _mm256_blend_ps(_mm256_permutevar8x32_ps(r01, high), _mm256_permutevar8x32_ps(r23, high), 0xCC);
+		r01 = t01;
+		r23 = t23;
+	}
+
+	SOL_TARGET_AVX2 __m256 MultiplyRows(__m256 a, __m256 b0, __m256 b1, __m256 b2, __m256 b3)
+	{
+		__m256 r = _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0x00), b0);
+		r = _mm256_fmadd_ps(_mm256_shuffle_ps(a, a, 0x55), b1, r);
+		r = _mm256_fmadd_ps(_mm256_shuffle_ps(a, a, 0xAA), b2, r);
+		return _mm256_fmadd_ps(_mm256_shuffle_ps(a, a, 0xFF), b3, r);
+	}
+
+	template <bool Transposed>
+	SOL_TARGET_AVX2 void MultiplyLoopAVX2(const float* src, size_t srcStride, const float m[16], float* dst,
+		size_t dstStride, size_t count)
+	{
+		const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m));
+		const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 4));
+		const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 8));
+		const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 12));
+		for (size_t i = 0; i < count; ++i) {
+			const float* a = At(src, srcStride, i);
+			__m256 r01 = MultiplyRows(_mm256_loadu_ps(a), b0, b1, b2, b3);
+			__m256 r23 = MultiplyRows(_mm256_loadu_ps(a + 8), b0, b1, b2, b3);
+			if (Transposed) {
+				Transpose2x8(r01, r23);
+			}
+			float* out = At(dst, dstStride, i);
+			_mm256_storeu_ps(out, r01);
+			_mm256_storeu_ps(out + 8, r23);
+		}
+	}
+
+	SOL_TARGET_AVX2 void MultiplyAVX2(const float* src, size_t srcStride, const float m[16], float* dst,
+		size_t dstStride, size_t count, bool transpose)
+	{
+		if (transpose) {
+			MultiplyLoopAVX2<true>(src, srcStride, m, dst, dstStride, count);
+		}
+		else {
+			MultiplyLoopAVX2<false>(src, srcStride, m, dst, dstStride, count);
+		}
+	}
+
+	SOL_TARGET_AVX2 void TransposeAVX2(const float* src, size_t srcStride, float* dst, size_t dstStride, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			const float* a = At(src, srcStride, i);
+			__m256 r01 = _mm256_loadu_ps(a);
+			__m256 r23 = _mm256_loadu_ps(a + 8);
+			Transpose2x8(r01, r23);
+			float* out = At(dst, dstStride, i);
+			_mm256_storeu_ps(out, r01);
+			_mm256_storeu_ps(out + 8, r23);
+		}
+	}
+
+	//a.yzx * b.zxy - a.zxy * b.yzx in every 128-bit lane; w means nothing.
+	SOL_TARGET_AVX2 __m256 Cross(__m256 a, __m256 b)
+	{
+		__m256 ayzx = _mm256_permute_ps(a, _MM_SHUFFLE(3, 0, 2, 1));
+		__m256 bzxy = _mm256_permute_ps(b, _MM_SHUFFLE(3, 1, 0, 2));
+		__m256 azxy = _mm256_permute_ps(a, _MM_SHUFFLE(3, 1, 0, 2));
+		__m256 byzx = _mm256_permute_ps(b, _MM_SHUFFLE(3, 0, 2, 1));
+		return _mm256_fmsub_ps(ayzx, bzxy, _mm256_mul_ps(azxy, byzx));
+	}
+
+	SOL_TARGET_AVX2 __m256 LoadRows(const float* a, const float* b)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)), _mm_loadu_ps(b), 1);
+	}
+
+	SOL_TARGET_AVX2 void StoreRows(__m256 rows, float* a, float* b)
+	{
+		_mm_storeu_ps(a, _mm256_castps256_ps128(rows));
+		_mm_storeu_ps(b, _mm256_extractf128_ps(rows, 1));
+	}
+
+	//Two matrices at a time, one per 128-bit lane.
+	SOL_TARGET_AVX2 void InverseTransposeAVX2(const float* src, size_t srcStride, float* dst, size_t dstStride,
+		size_t count, bool transpose)
+	{
+		const __m256 row3 = _mm256_setr_ps(0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		const __m256 xyz = _mm256_castsi256_ps(_mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2) {
+			const float* a = At(src, srcStride, i);
+			const float* b = At(src, srcStride, i + 1);
+			__m256 a0 = LoadRows(a, b);
+			__m256 a1 = LoadRows(a + 4, b + 4);
+			__m256 a2 = LoadRows(a + 8, b + 8);
+			__m256 c0 = Cross(a1, a2);
+			__m256 c1 = Cross(a2, a0);
+			__m256 c2 = Cross(a0, a1);
+			//Dot product over xyz, broadcast into the lane.
+			__m256 det = _mm256_dp_ps(a0, c0, 0x7F);
+			__m256 singular = _mm256_cmp_ps(det, _mm256_setzero_ps(), _CMP_EQ_OQ);
+			__m256 scale = _mm256_andnot_ps(singular, _mm256_div_ps(_mm256_set1_ps(1.0f), det));
+			c0 = _mm256_and_ps(_mm256_mul_ps(c0, scale), xyz);
+			c1 = _mm256_and_ps(_mm256_mul_ps(c1, scale), xyz);
+			c2 = _mm256_and_ps(_mm256_mul_ps(c2, scale), xyz);
+			__m256 c3 = row3;
+			if (transpose) {
+				__m256 t0 = _mm256_unpacklo_ps(c0, c1);
+				__m256 t1 = _mm256_unpacklo_ps(c2, c3);
+				__m256 t2 = _mm256_unpackhi_ps(c0, c1);
+				__m256 t3 = _mm256_unpackhi_ps(c2, c3);
+				c0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+				c1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+				c2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+				c3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+			}
+			float* outA = At(dst, dstStride, i);
+			float* outB = At(dst, dstStride, i + 1);
+			StoreRows(c0, outA, outB);
+			StoreRows(c1, outA + 4, outB + 4);
+			StoreRows(c2, outA + 8, outB + 8);
+			StoreRows(c3, outA + 12, outB + 12);
+		}
+		InverseTransposeScalar(At(src, srcStride, i), srcStride, At(dst, dstStride, i), dstStride, count - i, transpose);
+	}
+
+	//One box at a time: the center times the rows and the extents times the
+	//absolute rows, with the coordinates broadcast.
+	SOL_TARGET_AVX2 void TransformAabbsAVX2(const float* boxes, size_t boxStride, const float* matrices,
+		size_t matrixStride, float* dst, size_t dstStride, size_t count)
+	{
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		for (size_t i = 0; i < count; ++i) {
+			const float* box = At(boxes, boxStride, i);
+			const float* m = At(matrices, matrixStride, i);
+			__m128 m0 = _mm_loadu_ps(m);
+			__m128 m1 = _mm_loadu_ps(m + 4);
+			__m128 m2 = _mm_loadu_ps(m + 8);
+			__m128 center = _mm_fmadd_ps(_mm_broadcast_ss(box), m0, _mm_loadu_ps(m + 12));
+			center = _mm_fmadd_ps(_mm_broadcast_ss(box + 1), m1, center);
+			center = _mm_fmadd_ps(_mm_broadcast_ss(box + 2), m2, center);
+			__m128 extents = _mm_mul_ps(_mm_broadcast_ss(box + 3), _mm_and_ps(m0, absMask));
+			extents = _mm_fmadd_ps(_mm_broadcast_ss(box + 4), _mm_and_ps(m1, absMask), extents);
+			extents = _mm_fmadd_ps(_mm_broadcast_ss(box + 5), _mm_and_ps(m2, absMask), extents);
+			//Three floats each, the output may be packed or alias the boxes.
+			float* out = At(dst, dstStride, i);
+			_mm_storel_pi(reinterpret_cast<__m64*>(out), center);
+			_mm_store_ss(out + 2, _mm_movehl_ps(center, center));
+			_mm_storel_pi(reinterpret_cast<__m64*>(out + 3), extents);
+			_mm_store_ss(out + 5, _mm_movehl_ps(extents, extents));
+		}
+	}
+
+	//AVX-512: a whole matrix per register; the transposes are one permute.
+
+	template <bool Transposed>
+	SOL_TARGET_AVX512 void MultiplyLoopAVX512(const float* src, size_t srcStride, const float m[16], float* dst,
+		size_t dstStride, size_t count)
+	{
+		const __m512 b0 = _mm512_broadcast_f32x4(_mm_loadu_ps(m));
+		const __m512 b1 = _mm512_broadcast_f32x4(_mm_loadu_ps(m + 4));
+		const __m512 b2 = _mm512_broadcast_f32x4(_mm_loadu_ps(m + 8));
+		const __m512 b3 = _mm512_broadcast_f32x4(_mm_loadu_ps(m + 12));
+		const __m512i transposeIndex = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+		for (size_t i = 0; i < count; ++i) {
+			__m512 a = _mm512_loadu_ps(At(src, srcStride, i));
+			__m512 r = _mm512_mul_ps(_mm512_permute_ps(a, 0x00), b0);
+			r = _mm512_fmadd_ps(_mm512_permute_ps(a, 0x55), b1, r);
+			r = _mm512_fmadd_ps(_mm512_permute_ps(a, 0xAA), b2, r);
+			r = _mm512_fmadd_ps(_mm512_permute_ps(a, 0xFF), b3, r);
+			if (Transposed) {
+				r = _mm512_permutexvar_ps(transposeIndex, r);
+			}
+			_mm512_storeu_ps(At(dst, dstStride, i), r);
+		}
+	}
+
+	SOL_TARGET_AVX512 void MultiplyAVX512(const float* src, size_t srcStride, const float m[16], float* dst,
+		size_t dstStride, size_t count, bool transpose)
+	{
+		if (transpose) {
+			MultiplyLoopAVX512<true>(src, srcStride, m, dst, dstStride, count);
+		}
+		else {
+			MultiplyLoopAVX512<false>(src, srcStride, m, dst, dstStride, count);
+		}
+	}
+
+	SOL_TARGET_AVX512 void TransposeAVX512(const float* src, size_t srcStride, float* dst, size_t dstStride,
+		size_t count)
+	{
+		const __m512i transposeIndex = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+		for (size_t i = 0; i < count; ++i) {
+			__m512 a = _mm512_loadu_ps(At(src, srcStride, i));
+			_mm512_storeu_ps(At(dst, dstStride, i), _mm512_permutexvar_ps(transposeIndex, a));
+		}
+	}
+
+	//Lane k of row r of matrix k, for four matrices.
+	SOL_TARGET_AVX512 __m512 LoadRow4(const float* src, size_t srcStride, size_t i, int row)
+	{
+		__m512 rows = _mm512_castps128_ps512(_mm_loadu_ps(At(src, srcStride, i) + 4 * row));
+		rows = _mm512_insertf32x4(rows, _mm_loadu_ps(At(src, srcStride, i + 1) + 4 * row), 1);
+		rows = _mm512_insertf32x4(rows, _mm_loadu_ps(At(src, srcStride, i + 2) + 4 * row), 2);
+		return _mm512_insertf32x4(rows, _mm_loadu_ps(At(src, srcStride, i + 3) + 4 * row), 3);
+	}
+
+	SOL_TARGET_AVX512 void StoreRow4(__m512 rows, float* dst, size_t dstStride, size_t i, int row)
+	{
+		_mm_storeu_ps(At(dst, dstStride, i) + 4 * row, _mm512_castps512_ps128(rows));
+		_mm_storeu_ps(At(dst, dstStride, i + 1) + 4 * row, _mm512_extractf32x4_ps(rows, 1));
+		_mm_storeu_ps(At(dst, dstStride, i + 2) + 4 * row, _mm512_extractf32x4_ps(rows, 2));
+		_mm_storeu_ps(At(dst, dstStride, i + 3) + 4 * row, _mm512_extractf32x4_ps(rows, 3));
+	}
+
+	SOL_TARGET_AVX512 __m512 Cross512(__m512 a, __m512 b)
+	{
+		__m512 ayzx = _mm512_permute_ps(a, _MM_SHUFFLE(3, 0, 2, 1));
+		__m512 bzxy = _mm512_permute_ps(b, _MM_SHUFFLE(3, 1, 0, 2));
+		__m512 azxy = _mm512_permute_ps(a, _MM_SHUFFLE(3, 1, 0, 2));
+		__m512 byzx = _mm512_permute_ps(b, _MM_SHUFFLE(3, 0, 2, 1));
+		return _mm512_fmsub_ps(ayzx, bzxy, _mm512_mul_ps(azxy, byzx));
+	}
+
+	//Four matrices at a time, one per 128-bit lane, as in the AVX2 version.
+	SOL_TARGET_AVX512 void InverseTransposeAVX512(const float* src, size_t srcStride, float* dst, size_t dstStride,
+		size_t count, bool transpose)
+	{
+		const __m512 row3 = _mm512_broadcast_f32x4(_mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+		const __mmask16 xyz = 0x7777;
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m512 a0 = LoadRow4(src, srcStride, i, 0);
+			__m512 a1 = LoadRow4(src, srcStride, i, 1);
+			__m512 a2 = LoadRow4(src, srcStride, i, 2);
+			__m512 c0 = Cross512(a1, a2);
+			__m512 c1 = Cross512(a2, a0);
+			__m512 c2 = Cross512(a0, a1);
+			__m512 d = _mm512_mul_ps(a0, c0);
+			__m512 det = _mm512_add_ps(_mm512_add_ps(_mm512_permute_ps(d, 0x00), _mm512_permute_ps(d, 0x55)),
+				_mm512_permute_ps(d, 0xAA));
+			__mmask16 regular = _mm512_cmp_ps_mask(det, _mm512_setzero_ps(), _CMP_NEQ_UQ);
+			__m512 scale = _mm512_maskz_div_ps(regular, _mm512_set1_ps(1.0f), det);
+			c0 = _mm512_maskz_mul_ps(xyz, c0, scale);
+			c1 = _mm512_maskz_mul_ps(xyz, c1, scale);
+			c2 = _mm512_maskz_mul_ps(xyz, c2, scale);
+			__m512 c3 = row3;
+			if (transpose) {
+				__m512 t0 = _mm512_unpacklo_ps(c0, c1);
+				__m512 t1 = _mm512_unpacklo_ps(c2, c3);
+				__m512 t2 = _mm512_unpackhi_ps(c0, c1);
+				__m512 t3 = _mm512_unpackhi_ps(c2, c3);
+				c0 = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+				c1 = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+				c2 = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+				c3 = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+			}
+			StoreRow4(c0, dst, dstStride, i, 0);
+			StoreRow4(c1, dst, dstStride, i, 1);
+			StoreRow4(c2, dst, dstStride, i, 2);
+			StoreRow4(c3, dst, dstStride, i, 3);
+		}
+		InverseTransposeAVX2(At(src, srcStride, i), srcStride, At(dst, dstStride, i), dstStride, count - i, transpose);
+	}
+
+	const MatrixKernels Kernels[3] = {
+		{ MultiplyScalar, TransposeScalar, InverseTransposeScalar, TransformAabbsScalar },
+		{ MultiplyAVX2, TransposeAVX2, InverseTransposeAVX2, TransformAabbsAVX2 },
+		//Gathering sixteen strided boxes and scattering them back measured slower
+		//than the box at a time AVX2 kernel, so that one serves both levels.
+		{ MultiplyAVX512, TransposeAVX512, InverseTransposeAVX512, TransformAabbsAVX2 },
+	};
+
+	const MatrixKernels& Best()
+	{
+		static const MatrixKernels& best = Kernels[(int)BestMatrixKernelLevel()];
+		return best;
+	}
+}
+
+MatrixKernelLevel BestMatrixKernelLevel()
+{
+	const CpuFeatures& cpu = CpuFeatures::Get();
+	if (cpu.Avx512Target()) {
+		return MatrixKernelLevel::AVX512;
+	}
+	if (cpu.Avx2Target()) {
+		return MatrixKernelLevel::AVX2;
+	}
+	return MatrixKernelLevel::Scalar;
+}
+
+const MatrixKernels& GetMatrixKernels(MatrixKernelLevel level)
+{
+	return Kernels[(int)level];
+}
+
+void MultiplyMatrices(const float* src, size_t srcStride, const float m[16], float* dst, size_t dstStride,
+	size_t count, bool transpose)
+{
+	Best().Multiply(src, srcStride, m, dst, dstStride, count, transpose);
+}
+
+void TransposeMatrices(const float* src, size_t srcStride, float* dst, size_t dstStride, size_t count)
+{
+	Best().Transpose(src, srcStride, dst, dstStride, count);
+}
+
+void InverseTransposeMatrices(const float* src, size_t srcStride, float* dst, size_t dstStride,
+	size_t count, bool transpose)
+{
+	Best().InverseTranspose(src, srcStride, dst, dstStride, count, transpose);
+}
+
+void TransformAabbs(const float* boxes, size_t boxStride, const float* matrices, size_t matrixStride,
+	float* dst, size_t dstStride, size_t count)
+{
+	Best().TransformAabbs(boxes, boxStride, matrices, matrixStride, dst, dstStride, count);
+}
@@ -0,0 +1,13 @@
+#include "../../header/Common/ParallelFor.h"
+#include "../../header/Common/JobSystem.h"
+
+uint32_t ParallelWorkerCount()
+{
+	return DefaultJobSystem().ThreadCount();
+}
+
+void ParallelFor(size_t begin, size_t end, size_t minGrain,
+	const std::function<void(size_t, size_t)>& body)
+{
+	DefaultJobSystem().ParallelFor(begin, end, minGrain, body);
+}
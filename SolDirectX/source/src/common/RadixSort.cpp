@@ -0,0 +1,146 @@
+#include "../../header/Common/RadixSort.h"
+#include "../../header/Common/ParallelFor.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	const uint32_t RadixBits = 11;
+	const uint32_t RadixSize = 1u << RadixBits;
+	const uint32_t PassCount = (64 + RadixBits - 1) / RadixBits;
+
+	//Below this many keys per block, threading costs more than it saves.
+	const size_t MinKeysPerBlock = 16 * 1024;
+}
+
+//values is ignored when HasValues is false, so the keys-only sort moves
+//8 bytes per key and pass instead of 12.
+template<bool HasValues>
+static void RadixSort64Impl(uint64_t* keys, uint32_t* values, size_t count, uint32_t firstBit,
+	RadixSortScratch& scratch)
+{
+	if (count < 2) {
+		return;
+	}
+
+	size_t blockCount = std::min<size_t>(ParallelWorkerCount(), (count + MinKeysPerBlock - 1) / MinKeysPerBlock);
+	blockCount = std::max<size_t>(1, blockCount);
+	size_t blockSize = (count + blockCount - 1) / blockCount;
+
+	scratch.Keys.resize(count);
+	if (HasValues) {
+		scratch.Values.resize(count);
+	}
+	const uint32_t passCount = (64 - firstBit + RadixBits - 1) / RadixBits;
+	scratch.Histograms.assign(blockCount * RadixSize * PassCount, 0);
+
+	//Count every digit of every pass in one read over the keys. The totals do
+	//not depend on the order of the keys, so they tell which passes are no-ops.
+	ParallelFor(0, blockCount, 1, [&](size_t firstBlock, size_t lastBlock) {
+		for (size_t block = firstBlock; block < lastBlock; ++block) {
+			size_t* histogram = &scratch.Histograms[block * RadixSize * PassCount];
+			size_t begin = block * blockSize;
+			size_t end = std::min(count, begin + blockSize);
+			for (size_t i = begin; i < end; ++i) {
+				uint64_t key = keys[i];
+				for (uint32_t pass = 0; pass < passCount; ++pass) {
+					histogram[pass * RadixSize + ((key >> (firstBit + pass * RadixBits)) & (RadixSize - 1))]++;
+				}
+			}
+		}
+	});
+
+	bool passNeeded[PassCount];
+	for (uint32_t pass = 0; pass < passCount; ++pass) {
+		passNeeded[pass] = true;
+		for (uint32_t digit = 0; digit < RadixSize; ++digit) {
+			size_t total = 0;
+			for (size_t block = 0; block < blockCount; ++block) {
+				total += scratch.Histograms[(block * PassCount + pass) * RadixSize + digit];
+			}
+			if (total == count) {
+				passNeeded[pass] = false;
+				break;
+			}
+			if (total != 0) {
+				break;
+			}
+		}
+	}
+
+	uint64_t* srcKeys = keys;
+	uint32_t* srcValues = values;
+	uint64_t* dstKeys = scratch.Keys.data();
+	uint32_t* dstValues = HasValues ? scratch.Values.data() : nullptr;
+
+	std::vector<size_t> offsets(blockCount * RadixSize);
+	bool firstPass = true;
+	for (uint32_t pass = 0; pass < passCount; ++pass) {
+		if (!passNeeded[pass]) {
+			continue;
+		}
+		uint32_t shift = firstBit + pass * RadixBits;
+
+		//Block histograms of this digit for the current key order.
+		//The first executed pass can reuse the counts from above.
+		if (!firstPass) {
+			ParallelFor(0, blockCount, 1, [&](size_t firstBlock, size_t lastBlock) {
+				for (size_t block = firstBlock; block < lastBlock; ++block) {
+					size_t* histogram = &scratch.Histograms[(block * PassCount + pass) * RadixSize];
+					std::fill(histogram, histogram + RadixSize, 0);
+					size_t begin = block * blockSize;
+					size_t end = std::min(count, begin + blockSize);
+					for (size_t i = begin; i < end; ++i) {
+						histogram[(srcKeys[i] >> shift) & (RadixSize - 1)]++;
+					}
+				}
+			});
+		}
+
+		//Exclusive prefix sum in (digit, block) order keeps the sort stable.
+		size_t running = 0;
+		for (uint32_t digit = 0; digit < RadixSize; ++digit) {
+			for (size_t block = 0; block < blockCount; ++block) {
+				offsets[block * RadixSize + digit] = running;
+				running += scratch.Histograms[(block * PassCount + pass) * RadixSize + digit];
+			}
+		}
+
+		ParallelFor(0, blockCount, 1, [&](size_t firstBlock, size_t lastBlock) {
+			for (size_t block = firstBlock; block < lastBlock; ++block) {
+				size_t* offset = &offsets[block * RadixSize];
+				size_t begin = block * blockSize;
+				size_t end = std::min(count, begin + blockSize);
+				for (size_t i = begin; i < end; ++i) {
+					uint64_t key = srcKeys[i];
+					size_t dst = offset[(key >> shift) & (RadixSize - 1)]++;
+					dstKeys[dst] = key;
+					if (HasValues) {
+						dstValues[dst] = srcValues[i];
+					}
+				}
+			}
+		});
+
+		std::swap(srcKeys, dstKeys);
+		std::swap(srcValues, dstValues);
+		firstPass = false;
+	}
+
+	//An odd number of executed passes leaves the result in the scratch buffers.
+	if (srcKeys != keys) {
+		std::memcpy(keys, srcKeys, count * sizeof(uint64_t));
+		if (HasValues) {
+			std::memcpy(values, srcValues, count * sizeof(uint32_t));
+		}
+	}
+}
+
+void RadixSort64(uint64_t* keys, uint32_t* values, size_t count, RadixSortScratch& scratch)
+{
+	RadixSort64Impl<true>(keys, values, count, 0, scratch);
+}
+
+void RadixSort64(uint64_t* keys, size_t count, RadixSortScratch& scratch, uint32_t firstBit)
+{
+	RadixSort64Impl<false>(keys, nullptr, count, std::min<uint32_t>(firstBit, 63), scratch);
+}
@@ -0,0 +1,477 @@
+#include "../../header/Common/Random.h"
+#include "../../header/Common/CpuFeatures.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace {
+	uint64_t SplitMix64(uint64_t& state)
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	uint64_t RotateLeft(uint64_t x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+	//C. Wellons' integer hashes (lowbias32 and triple32), both bijections.
+	uint32_t LowBias32(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x21F0AAADu;
+		x ^= x >> 15;
+		x *= 0xD35A2D97u;
+		return x ^ (x >> 15);
+	}
+
+	uint32_t Triple32(uint32_t x)
+	{
+		x ^= x >> 17;
+		x *= 0xED5AD4BBu;
+		x ^= x >> 11;
+		x *= 0xAC4C1B51u;
+		x ^= x >> 15;
+		x *= 0x31848BABu;
+		return x ^ (x >> 14);
+	}
+
+	//The seed turned into the keys of the hash. The high half of a counter
+	//only changes every 2^32 values, so it is folded into a key once per
+	//block and the SIMD lanes hash 32-bit counters.
+	struct HashKey
+	{
+		uint32_t Low;
+		uint32_t High;
+
+		explicit HashKey(uint64_t seed)
+		{
+			uint64_t state = seed;
+			uint64_t key = SplitMix64(state);
+			Low = (uint32_t)key;
+			High = (uint32_t)(key >> 32);
+		}
+
+		uint32_t Block(uint32_t counterHigh) const { return LowBias32(counterHigh ^ High); }
+	};
+
+	//For a fixed seed and block this is a bijection of the low counter, so no
+	//value repeats within 2^32 draws.
+	uint32_t Hash(const HashKey& key, uint32_t block, uint32_t counterLow)
+	{
+		return Triple32(LowBias32(counterLow ^ key.Low) ^ block);
+	}
+
+	uint32_t Hash(const HashKey& key, uint64_t counter)
+	{
+		return Hash(key, key.Block((uint32_t)(counter >> 32)), (uint32_t)counter);
+	}
+
+	float UnitFloat(uint32_t bits)
+	{
+		return (float)(bits >> 8) * (1.0f / 16777216.0f);
+	}
+
+	const float QuarterPi = 0.785398163f;
+	const float SqrtHalf = 0.707106781f;
+
+	//A point on the unit sphere from two hashes: z from the first, the angle
+	//around z from the second, whose top 2 bits pick the quadrant and the
+	//next 24 the angle inside it. Sine and cosine are short polynomials on
+	//[-pi/4, pi/4), then rotated by pi/4 and the quadrant.
+	//Multiply-adds are fused exactly where the AVX2 version fuses them, so
+	//both give the same bits.
+	void UnitVector(uint32_t zBits, uint32_t angleBits, float out[3])
+	{
+		float z = 1.0f - (UnitFloat(zBits) + UnitFloat(zBits));
+		float r = sqrtf(std::max(0.0f, fmaf(-z, z, 1.0f)));
+		float fraction = (float)((angleBits >> 6) & 0xFFFFFF);
+		float a = fmaf(fraction, 1.0f / 16777216.0f, -0.5f) * (2.0f * QuarterPi);
+		float a2 = a * a;
+		float s = fmaf(a2, 1.0f / 362880.0f, -1.0f / 5040.0f);
+		s = fmaf(a2, s, 1.0f / 120.0f);
+		s = fmaf(a2, s, -1.0f / 6.0f);
+		s = fmaf(a * a2, s, a);
+		float c = fmaf(a2, 1.0f / 40320.0f, -1.0f / 720.0f);
+		c = fmaf(a2, c, 1.0f / 24.0f);
+		c = fmaf(a2, c, -0.5f);
+		c = fmaf(a2, c, 1.0f);
+		float x = (c - s) * SqrtHalf;
+		float y = (c + s) * SqrtHalf;
+		uint32_t quadrant = angleBits >> 30;
+		if (quadrant & 1) {
+			std::swap(x, y);
+		}
+		if ((quadrant ^ (quadrant >> 1)) & 1) {
+			x = -x;
+		}
+		if (quadrant & 2) {
+			y = -y;
+		}
+		out[0] = x * r;
+		out[1] = y * r;
+		out[2] = z;
+	}
+
+	//AVX2 versions, 8 counters at a time. A group of 8 whose counters cross a
+	//2^32 block boundary goes the scalar way.
+
+	bool UseAVX2()
+	{
+		static const bool useAVX2 = CpuFeatures::Get().Avx2Target();
+		return useAVX2;
+	}
+
+	SOL_TARGET_AVX2 __m256i LowBias32AVX2(__m256i x)
+	{
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+		x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x21F0AAADu));
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+		x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0xD35A2D97u));
+		return _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+	}
+
+	SOL_TARGET_AVX2 __m256i Triple32AVX2(__m256i x)
+	{
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+		x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0xED5AD4BBu));
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 11));
+		x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0xAC4C1B51u));
+		x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+		x = _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x31848BABu));
+		return _mm256_xor_si256(x, _mm256_srli_epi32(x, 14));
+	}
+
+	SOL_TARGET_AVX2 __m256i HashAVX2(const HashKey& key, uint32_t block, __m256i counterLow)
+	{
+		__m256i x = LowBias32AVX2(_mm256_xor_si256(counterLow, _mm256_set1_epi32((int)key.Low)));
+		return Triple32AVX2(_mm256_xor_si256(x, _mm256_set1_epi32((int)block)));
+	}
+
+	SOL_TARGET_AVX2 __m256 UnitFloatAVX2(__m256i bits)
+	{
+		return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(bits, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+	}
+
+	//Whether counters first .. last all lie in one block; the block key if so.
+	bool SameBlock(const HashKey& key, uint64_t first, uint64_t last, uint32_t& block)
+	{
+		if ((first >> 32) != (last >> 32)) {
+			return false;
+		}
+		block = key.Block((uint32_t)(first >> 32));
+		return true;
+	}
+
+	//Hashes the 8 consecutive counters starting at counter.
+	SOL_TARGET_AVX2 bool Hash8AVX2(const HashKey& key, uint64_t counter, __m256i& bits)
+	{
+		uint32_t block;
+		if (!SameBlock(key, counter, counter + 7, block)) {
+			return false;
+		}
+		__m256i lanes = _mm256_add_epi32(_mm256_set1_epi32((int)(uint32_t)counter),
+			_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		bits = HashAVX2(key, block, lanes);
+		return true;
+	}
+
+	SOL_TARGET_AVX2 void FillUint32AVX2(uint32_t* dst, size_t count, uint64_t seed, uint64_t first)
+	{
+		const HashKey key(seed);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256i bits;
+			if (Hash8AVX2(key, first + i, bits)) {
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), bits);
+			}
+			else {
+				RandomScalar::FillUint32(dst + i, 8, seed, first + i);
+			}
+		}
+		RandomScalar::FillUint32(dst + i, count - i, seed, first + i);
+	}
+
+	SOL_TARGET_AVX2 void FillFloatsAVX2(float* dst, size_t count, float min, float max, uint64_t seed, uint64_t first)
+	{
+		const HashKey key(seed);
+		const __m256 base = _mm256_set1_ps(min);
+		const __m256 range = _mm256_set1_ps(max - min);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256i bits;
+			if (Hash8AVX2(key, first + i, bits)) {
+				_mm256_storeu_ps(dst + i, _mm256_fmadd_ps(UnitFloatAVX2(bits), range, base));
+			}
+			else {
+				RandomScalar::FillFloats(dst + i, 8, min, max, seed, first + i);
+			}
+		}
+		RandomScalar::FillFloats(dst + i, count - i, min, max, seed, first + i);
+	}
+
+	//Counter j of a vector fill is float j of the output, so 8 vectors are 24
+	//consecutive counters in three registers whose lanes cycle through x, y, z.
+	SOL_TARGET_AVX2 void FillVectorsAVX2(float* dst, size_t count, const float min[3], const float max[3],
+		uint64_t seed, uint64_t first)
+	{
+		const HashKey key(seed);
+		__m256 base[3];
+		__m256 range[3];
+		for (int r = 0; r < 3; ++r) {
+			float b[8], e[8];
+			for (int k = 0; k < 8; ++k) {
+				b[k] = min[(8 * r + k) % 3];
+				e[k] = max[(8 * r + k) % 3] - min[(8 * r + k) % 3];
+			}
+			base[r] = _mm256_loadu_ps(b);
+			range[r] = _mm256_loadu_ps(e);
+		}
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const uint64_t counter = 3 * (first + i);
+			uint32_t block;
+			if (!SameBlock(key, counter, counter + 23, block)) {
+				RandomScalar::FillVectors(dst + 3 * i, 8, min, max, seed, first + i);
+				continue;
+			}
+			for (int r = 0; r < 3; ++r) {
+				__m256i lanes = _mm256_add_epi32(_mm256_set1_epi32((int)(uint32_t)(counter + 8 * r)),
+					_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+				__m256 value = UnitFloatAVX2(HashAVX2(key, block, lanes));
+				_mm256_storeu_ps(dst + 3 * i + 8 * r, _mm256_fmadd_ps(value, range[r], base[r]));
+			}
+		}
+		RandomScalar::FillVectors(dst + 3 * i, count - i, min, max, seed, first + i);
+	}
+
+	//Interleaves 8 x, y and z into 24 packed floats. Output float p is
+	//component p % 3 of vector p / 3, so one permutation per output register
+	//serves all three inputs and blends pick the component.
+	SOL_TARGET_AVX2 void StoreXyz8(float* dst, __m256 x, __m256 y, __m256 z)
+	{
+		const __m256i index0 = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+		const __m256i index1 = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+		const __m256i index2 = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+		__m256 out0 = _mm256_blend_ps(_mm256_permutevar8x32_ps(x, index0), _mm256_permutevar8x32_ps(y, index0), 0x92);
+		out0 = _mm256_blend_ps(out0, _mm256_permutevar8x32_ps(z, index0), 0x24);
+		__m256 out1 = _mm256_blend_ps(_mm256_permutevar8x32_ps(x, index1), _mm256_permutevar8x32_ps(y, index1), 0x24);
+		out1 = _mm256_blend_ps(out1, _mm256_permutevar8x32_ps(z, index1), 0x49);
+		__m256 out2 = _mm256_blend_ps(_mm256_permutevar8x32_ps(x, index2), _mm256_permutevar8x32_ps(y, index2), 0x49);
+		out2 = _mm256_blend_ps(out2, _mm256_permutevar8x32_ps(z, index2), 0x92);
+		_mm256_storeu_ps(dst, out0);
+		_mm256_storeu_ps(dst + 8, out1);
+		_mm256_storeu_ps(dst + 16, out2);
+	}
+
+	SOL_TARGET_AVX2 void FillUnitVectorsAVX2(float* dst, size_t count, uint64_t seed, uint64_t first)
+	{
+		const HashKey key(seed);
+		const __m256i stride3 = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 scale = _mm256_set1_ps(1.0f / 16777216.0f);
+		const __m256 signBit = _mm256_set1_ps(-0.0f);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const uint64_t counter = 3 * (first + i);
+			uint32_t block;
+			if (!SameBlock(key, counter, counter + 22, block)) {
+				RandomScalar::FillUnitVectors(dst + 3 * i, 8, seed, first + i);
+				continue;
+			}
+			__m256i lanes = _mm256_add_epi32(_mm256_set1_epi32((int)(uint32_t)counter), stride3);
+			__m256i zBits = HashAVX2(key, block, lanes);
+			__m256i angleBits = HashAVX2(key, block, _mm256_add_epi32(lanes, _mm256_set1_epi32(1)));
+
+			__m256 z = _mm256_sub_ps(one, _mm256_add_ps(UnitFloatAVX2(zBits), UnitFloatAVX2(zBits)));
+			__m256 r = _mm256_sqrt_ps(_mm256_max_ps(_mm256_setzero_ps(), _mm256_fnmadd_ps(z, z, one)));
+			__m256 fraction = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(angleBits, 6),
+				_mm256_set1_epi32(0xFFFFFF)));
+			__m256 a = _mm256_mul_ps(_mm256_fmsub_ps(fraction, scale, _mm256_set1_ps(0.5f)),
+				_mm256_set1_ps(2.0f * QuarterPi));
+			__m256 a2 = _mm256_mul_ps(a, a);
+			__m256 s = _mm256_fmadd_ps(a2, _mm256_set1_ps(1.0f / 362880.0f), _mm256_set1_ps(-1.0f / 5040.0f));
+			s = _mm256_fmadd_ps(a2, s, _mm256_set1_ps(1.0f / 120.0f));
+			s = _mm256_fmadd_ps(a2, s, _mm256_set1_ps(-1.0f / 6.0f));
+			s = _mm256_fmadd_ps(_mm256_mul_ps(a, a2), s, a);
+			__m256 c = _mm256_fmadd_ps(a2, _mm256_set1_ps(1.0f / 40320.0f), _mm256_set1_ps(-1.0f / 720.0f));
+			c = _mm256_fmadd_ps(a2, c, _mm256_set1_ps(1.0f / 24.0f));
+			c = _mm256_fmadd_ps(a2, c, _mm256_set1_ps(-0.5f));
+			c = _mm256_fmadd_ps(a2, c, one);
+			__m256 x = _mm256_mul_ps(_mm256_sub_ps(c, s), _mm256_set1_ps(SqrtHalf));
+			__m256 y = _mm256_mul_ps(_mm256_add_ps(c, s), _mm256_set1_ps(SqrtHalf));
+
+			__m256i quadrant = _mm256_srli_epi32(angleBits, 30);
+			__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(1)),
+				_mm256_set1_epi32(1)));
+			__m256 swappedX = _mm256_blendv_ps(x, y, swap);
+			__m256 swappedY = _mm256_blendv_ps(y, x, swap);
+			__m256 negateX = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_xor_si256(quadrant,
+				_mm256_srli_epi32(quadrant, 1)), 31));
+			__m256 negateY = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(quadrant, 1), 31));
+			x = _mm256_mul_ps(_mm256_xor_ps(swappedX, _mm256_and_ps(negateX, signBit)), r);
+			y = _mm256_mul_ps(_mm256_xor_ps(swappedY, _mm256_and_ps(negateY, signBit)), r);
+			StoreXyz8(dst + 3 * i, x, y, z);
+		}
+		RandomScalar::FillUnitVectors(dst + 3 * i, count - i, seed, first + i);
+	}
+
+	std::atomic<uint64_t> gThreadSeed{ 0 };
+	std::atomic<uint64_t> gNextThreadStream{ 0 };
+}
+
+Random::Random(uint64_t seed, uint64_t stream)
+{
+	//Streams of one seed start at far apart points of SplitMix64's sequence.
+	uint64_t state = seed + stream * 0xD1B54A32D192ED03ull;
+	for (uint64_t& word : mState) {
+		word = SplitMix64(state);
+	}
+}
+
+uint64_t Random::NextU64()
+{
+	const uint64_t result = RotateLeft(mState[1] * 5, 7) * 9;
+	const uint64_t t = mState[1] << 17;
+	mState[2] ^= mState[0];
+	mState[3] ^= mState[1];
+	mState[1] ^= mState[2];
+	mState[0] ^= mState[3];
+	mState[2] ^= t;
+	mState[3] = RotateLeft(mState[3], 45);
+	return result;
+}
+
+uint32_t Random::NextBelow(uint32_t bound)
+{
+	uint64_t m = (uint64_t)NextU32() * bound;
+	uint32_t low = (uint32_t)m;
+	if (low < bound) {
+		const uint32_t threshold = (0u - bound) % bound;
+		while (low < threshold) {
+			m = (uint64_t)NextU32() * bound;
+			low = (uint32_t)m;
+		}
+	}
+	return (uint32_t)(m >> 32);
+}
+
+void Random::Jump()
+{
+	static const uint64_t JumpPolynomial[4] = {
+		0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull, 0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull
+	};
+	uint64_t jumped[4] = { 0, 0, 0, 0 };
+	for (uint64_t word : JumpPolynomial) {
+		for (int bit = 0; bit < 64; ++bit) {
+			if (word & (1ull << bit)) {
+				for (int k = 0; k < 4; ++k) {
+					jumped[k] ^= mState[k];
+				}
+			}
+			NextU64();
+		}
+	}
+	for (int k = 0; k < 4; ++k) {
+		mState[k] = jumped[k];
+	}
+}
+
+Random& ThreadRandom()
+{
+	thread_local Random random(gThreadSeed.load(), gNextThreadStream.fetch_add(1));
+	return random;
+}
+
+void SeedThreadRandom(uint64_t seed)
+{
+	gThreadSeed.store(seed);
+	gNextThreadStream.store(1);
+	ThreadRandom() = Random(seed, 0);
+}
+
+uint32_t RandomHash(uint64_t seed, uint64_t counter)
+{
+	return Hash(HashKey(seed), counter);
+}
+
+void RandomScalar::FillUint32(uint32_t* dst, size_t count, uint64_t seed, uint64_t first)
+{
+	const HashKey key(seed);
+	for (size_t i = 0; i < count; ++i) {
+		dst[i] = Hash(key, first + i);
+	}
+}
+
+void RandomScalar::FillFloats(float* dst, size_t count, float min, float max, uint64_t seed, uint64_t first)
+{
+	const HashKey key(seed);
+	for (size_t i = 0; i < count; ++i) {
+		dst[i] = fmaf(UnitFloat(Hash(key, first + i)), max - min, min);
+	}
+}
+
+void RandomScalar::FillVectors(float* dst, size_t count, const float min[3], const float max[3], uint64_t seed,
+	uint64_t first)
+{
+	const HashKey key(seed);
+	for (size_t i = 0; i < count; ++i) {
+		for (int k = 0; k < 3; ++k) {
+			dst[3 * i + k] = fmaf(UnitFloat(Hash(key, 3 * (first + i) + k)), max[k] - min[k], min[k]);
+		}
+	}
+}
+
+void RandomScalar::FillUnitVectors(float* dst, size_t count, uint64_t seed, uint64_t first)
+{
+	const HashKey key(seed);
+	for (size_t i = 0; i < count; ++i) {
+		const uint64_t counter = 3 * (first + i);
+		UnitVector(Hash(key, counter), Hash(key, counter + 1), dst + 3 * i);
+	}
+}
+
+void FillRandomUint32(uint32_t* dst, size_t count, uint64_t seed, uint64_t first)
+{
+	if (UseAVX2()) {
+		FillUint32AVX2(dst, count, seed, first);
+	}
+	else {
+		RandomScalar::FillUint32(dst, count, seed, first);
+	}
+}
+
+void FillRandomFloats(float* dst, size_t count, float min, float max, uint64_t seed, uint64_t first)
+{
+	if (UseAVX2()) {
+		FillFloatsAVX2(dst, count, min, max, seed, first);
+	}
+	else {
+		RandomScalar::FillFloats(dst, count, min, max, seed, first);
+	}
+}
+
+void FillRandomVectors(float* dst, size_t count, const float min[3], const float max[3], uint64_t seed,
+	uint64_t first)
+{
+	if (UseAVX2()) {
+		FillVectorsAVX2(dst, count, min, max, seed, first);
+	}
+	else {
+		RandomScalar::FillVectors(dst, count, min, max, seed, first);
+	}
+}
+
+void FillRandomUnitVectors(float* dst, size_t count, uint64_t seed, uint64_t first)
+{
+	if (UseAVX2()) {
+		FillUnitVectorsAVX2(dst, count, seed, first);
+	}
+	else {
+		RandomScalar::FillUnitVectors(dst, count, seed, first);
+	}
+}
@@ -0,0 +1,168 @@
+#include "../../header/Common/StreamCopy.h"
+#include "../../header/Common/CpuFeatures.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+	const size_t LineSize = 64;
+
+	using CopyLinesFunction = void (*)(uint8_t* dst, const uint8_t* src, size_t lines);
+
+	//dst is line aligned, src can be anything.
+	void CopyLinesSSE2(uint8_t* dst, const uint8_t* src, size_t lines)
+	{
+		for (size_t i = 0; i < lines; ++i, dst += LineSize, src += LineSize) {
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+			__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+		}
+	}
+
+	SOL_TARGET_AVX2 void CopyLinesAVX2(uint8_t* dst, const uint8_t* src, size_t lines)
+	{
+		for (size_t i = 0; i < lines; ++i, dst += LineSize, src += LineSize) {
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst), a);
+			_mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 32), b);
+		}
+	}
+
+	//Plain stores up to 16 byte alignment, 16 byte streams up to line alignment.
+	//Returns how many bytes that took.
+	size_t StreamHead(uint8_t* dst, const uint8_t* src, size_t size)
+	{
+		size_t head = std::min(size, (size_t)(0 - (uintptr_t)dst) & 15);
+		memcpy(dst, src, head);
+		while (head + 16 <= size && ((uintptr_t)(dst + head) & (LineSize - 1)) != 0) {
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + head),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + head)));
+			head += 16;
+		}
+		return head;
+	}
+
+	//16 byte streams while they fit, dst is 16 byte aligned; plain stores for the rest.
+	void StreamTail(uint8_t* dst, const uint8_t* src, size_t size)
+	{
+		size_t i = 0;
+		for (; i + 16 <= size; i += 16) {
+			_mm_stream_si128(reinterpret_cast<__m128i*>(dst + i),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+		}
+		memcpy(dst + i, src + i, size - i);
+	}
+
+	//Without the fence, so elements can be streamed one after another.
+	void StreamBytes(uint8_t* dst, const uint8_t* src, size_t size, CopyLinesFunction copyLines)
+	{
+		size_t head = StreamHead(dst, src, size);
+		size_t lines = (size - head) / LineSize;
+		copyLines(dst + head, src + head, lines);
+		size_t done = head + lines * LineSize;
+		StreamTail(dst + done, src + done, size - done);
+	}
+
+	void Copy(void* dst, const void* src, size_t size, CopyLinesFunction copyLines)
+	{
+		StreamBytes(static_cast<uint8_t*>(dst), static_cast<const uint8_t*>(src), size, copyLines);
+		_mm_sfence();
+	}
+
+	void CopyStrided(void* dst, size_t dstStride, const void* src, size_t srcStride, size_t elementSize,
+		size_t count, CopyLinesFunction copyLines)
+	{
+		uint8_t* d = static_cast<uint8_t*>(dst);
+		const uint8_t* s = static_cast<const uint8_t*>(src);
+		if (dstStride == elementSize && srcStride == elementSize) {
+			Copy(dst, src, elementSize * count, copyLines);
+			return;
+		}
+
+		const size_t fullLines = elementSize / LineSize;
+		const size_t rest = elementSize - fullLines * LineSize;
+		const bool wholeLines = ((uintptr_t)d & (LineSize - 1)) == 0 && dstStride % LineSize == 0 &&
+			(fullLines + (rest != 0 ? 1 : 0)) * LineSize <= dstStride;
+		if (!wholeLines) {
+			for (size_t i = 0; i < count; ++i) {
+				StreamBytes(d + i * dstStride, s + i * srcStride, elementSize, copyLines);
+			}
+			_mm_sfence();
+			return;
+		}
+
+		//The last partial line of every element goes through a zero padded copy.
+		alignas(64) uint8_t line[LineSize] = {};
+		for (size_t i = 0; i < count; ++i, d += dstStride, s += srcStride) {
+			copyLines(d, s, fullLines);
+			if (rest != 0) {
+				memcpy(line, s + fullLines * LineSize, rest);
+				copyLines(d + fullLines * LineSize, line, 1);
+			}
+		}
+		_mm_sfence();
+	}
+
+	void CopySSE2(void* dst, const void* src, size_t size)
+	{
+		Copy(dst, src, size, CopyLinesSSE2);
+	}
+
+	void CopyStridedSSE2(void* dst, size_t dstStride, const void* src, size_t srcStride, size_t elementSize,
+		size_t count)
+	{
+		CopyStrided(dst, dstStride, src, srcStride, elementSize, count, CopyLinesSSE2);
+	}
+
+	void CopyAVX2(void* dst, const void* src, size_t size)
+	{
+		Copy(dst, src, size, CopyLinesAVX2);
+	}
+
+	void CopyStridedAVX2(void* dst, size_t dstStride, const void* src, size_t srcStride, size_t elementSize,
+		size_t count)
+	{
+		CopyStrided(dst, dstStride, src, srcStride, elementSize, count, CopyLinesAVX2);
+	}
+
+	//A 64 byte line is one AVX-512 store, but the write-combining buffer fills
+	//the same with two AVX2 stores, so there is no AVX-512 level.
+	const StreamCopyKernels Kernels[2] = {
+		{ CopySSE2, CopyStridedSSE2 },
+		{ CopyAVX2, CopyStridedAVX2 },
+	};
+
+	const StreamCopyKernels& Best()
+	{
+		static const StreamCopyKernels& best = Kernels[(int)BestStreamCopyLevel()];
+		return best;
+	}
+}
+
+StreamCopyLevel BestStreamCopyLevel()
+{
+	return CpuFeatures::Get().Avx2Target() ? StreamCopyLevel::AVX2 : StreamCopyLevel::SSE2;
+}
+
+const StreamCopyKernels& GetStreamCopyKernels(StreamCopyLevel level)
+{
+	return Kernels[(int)level];
+}
+
+void StreamCopy(void* dst, const void* src, size_t size)
+{
+	Best().Copy(dst, src, size);
+}
+
+void StreamCopyStrided(void* dst, size_t dstStride, const void* src, size_t srcStride, size_t elementSize,
+	size_t count)
+{
+	Best().CopyStrided(dst, dstStride, src, srcStride, elementSize, count);
+}
@@ -0,0 +1,257 @@
+#include "../../header/Common/Task.h"
+#include <algorithm>
+#include <cstdio>
+#include <new>
+
+namespace {
+	const size_t FrameClassSize = 64;
+	const size_t FrameClassCount = 64;
+	//Frames kept per size class; beyond that they go back to the heap.
+	const size_t MaxFreeFrames = 1024;
+
+	struct FreeFrame
+	{
+		FreeFrame* Next;
+	};
+
+	struct FramePool
+	{
+		FreeFrame* Free[FrameClassCount] = {};
+		size_t FreeCount[FrameClassCount] = {};
+		CoroutineFrameStats Stats;
+
+		~FramePool()
+		{
+			for (FreeFrame* frame : Free) {
+				while (frame != nullptr) {
+					FreeFrame* next = frame->Next;
+					::operator delete(frame);
+					frame = next;
+				}
+			}
+		}
+	};
+	thread_local FramePool tFramePool;
+
+	FileData ReadWholeFile(const std::string& path)
+	{
+		FileData data;
+		FILE* file = fopen(path.c_str(), "rb");
+		if (file == nullptr) {
+			data.Error = "cannot open " + path;
+			return data;
+		}
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		if (size < 0) {
+			data.Error = "cannot read the size of " + path;
+		}
+		else {
+			data.Bytes.resize((size_t)size);
+			if (fread(data.Bytes.data(), 1, data.Bytes.size(), file) == data.Bytes.size()) {
+				data.Ok = true;
+			}
+			else {
+				data.Bytes.clear();
+				data.Error = "cannot read " + path;
+			}
+		}
+		fclose(file);
+		return data;
+	}
+}
+
+void* AllocateCoroutineFrame(size_t size)
+{
+	FramePool& pool = tFramePool;
+	pool.Stats.Allocations++;
+	size_t sizeClass = (size + FrameClassSize - 1) / FrameClassSize - 1;
+	if (sizeClass >= FrameClassCount) {
+		pool.Stats.Large++;
+		return ::operator new(size);
+	}
+	if (FreeFrame* frame = pool.Free[sizeClass]) {
+		pool.Free[sizeClass] = frame->Next;
+		pool.FreeCount[sizeClass]--;
+		pool.Stats.Reused++;
+		return frame;
+	}
+	return ::operator new((sizeClass + 1) * FrameClassSize);
+}
+
+void FreeCoroutineFrame(void* frame, size_t size)
+{
+	FramePool& pool = tFramePool;
+	size_t sizeClass = (size + FrameClassSize - 1) / FrameClassSize - 1;
+	if (sizeClass >= FrameClassCount || pool.FreeCount[sizeClass] >= MaxFreeFrames) {
+		::operator delete(frame);
+		return;
+	}
+	FreeFrame* free = static_cast<FreeFrame*>(frame);
+	free->Next = pool.Free[sizeClass];
+	pool.Free[sizeClass] = free;
+	pool.FreeCount[sizeClass]++;
+}
+
+CoroutineFrameStats GetCoroutineFrameStats()
+{
+	return tFramePool.Stats;
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	if (mFileThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mFileReader->Mutex);
+			mFileReader->Quit = true;
+		}
+		mFileReader->WakeUp.notify_all();
+		mFileThread.join();
+	}
+	mTasks.clear();
+}
+
+TaskId TaskScheduler::Spawn(Task<void> task)
+{
+	TaskId id = mNextId++;
+	TaskPromise<void>& promise = task.GetHandle().promise();
+	promise.Scheduler = this;
+	promise.Id = id;
+	std::coroutine_handle<> handle = task.GetHandle();
+
+	auto root = std::make_unique<Root>();
+	root->Body = std::move(task);
+	mTasks.emplace(id, std::move(root));
+	Resume(id, handle);
+
+	if (mFailure) {
+		std::rethrow_exception(std::exchange(mFailure, nullptr));
+	}
+	return id;
+}
+
+void TaskScheduler::Cancel(TaskId id)
+{
+	auto it = mTasks.find(id);
+	if (it == mTasks.end()) {
+		return;
+	}
+	if (it->second->Running) {
+		it->second->CancelRequested = true;
+		return;
+	}
+	//Waiters of the task stay queued and are skipped once they come up.
+	mTasks.erase(it);
+}
+
+void TaskScheduler::Resume(TaskId id, std::coroutine_handle<> handle)
+{
+	auto it = mTasks.find(id);
+	if (it == mTasks.end()) {
+		return;
+	}
+	Root* root = it->second.get();
+	root->Running = true;
+	handle.resume();
+	root->Running = false;
+
+	if (root->Body.Done() || root->CancelRequested) {
+		std::exception_ptr exception = root->Body.Done() ? root->Body.GetHandle().promise().Exception : nullptr;
+		if (exception && !mFailure) {
+			mFailure = exception;
+		}
+		//The task may have spawned others, which invalidates it.
+		mTasks.erase(id);
+	}
+}
+
+void TaskScheduler::Tick()
+{
+	mFrameIndex++;
+
+	if (mFileReader) {
+		std::vector<std::unique_ptr<FileRead>> completed;
+		{
+			std::lock_guard<std::mutex> lock(mFileReader->Mutex);
+			completed.swap(mFileReader->Completed);
+		}
+		for (std::unique_ptr<FileRead>& read : completed) {
+			//A cancelled task took the awaiter holding Result with it.
+			if (!Finished(read->Id)) {
+				*read->Result = std::move(read->Data);
+				Resume(read->Id, read->Handle);
+			}
+		}
+	}
+
+	if (mFenceSource && !mFenceWaiters.empty()) {
+		const uint64_t completed = mFenceSource();
+		auto firstWaiting = std::stable_partition(mFenceWaiters.begin(), mFenceWaiters.end(),
+			[completed](const Waiter& waiter) { return waiter.Value <= completed; });
+		std::vector<Waiter> reached(mFenceWaiters.begin(), firstWaiting);
+		mFenceWaiters.erase(mFenceWaiters.begin(), firstWaiting);
+		std::stable_sort(reached.begin(), reached.end(),
+			[](const Waiter& a, const Waiter& b) { return a.Value < b.Value; });
+		for (const Waiter& waiter : reached) {
+			Resume(waiter.Id, waiter.Handle);
+		}
+	}
+
+	std::vector<Waiter> frameWaiters;
+	frameWaiters.swap(mFrameWaiters);
+	for (const Waiter& waiter : frameWaiters) {
+		Resume(waiter.Id, waiter.Handle);
+	}
+
+	if (mFailure) {
+		std::rethrow_exception(std::exchange(mFailure, nullptr));
+	}
+}
+
+void TaskScheduler::WaitFrame(TaskId id, std::coroutine_handle<> handle)
+{
+	mFrameWaiters.push_back({ id, handle, 0 });
+}
+
+bool TaskScheduler::WaitFence(TaskId id, std::coroutine_handle<> handle, uint64_t value)
+{
+	if (mFenceSource && mFenceSource() >= value) {
+		return false;
+	}
+	mFenceWaiters.push_back({ id, handle, value });
+	return true;
+}
+
+void TaskScheduler::ReadFile(TaskId id, std::coroutine_handle<> handle, const std::string& path, FileData* result)
+{
+	if (!mFileReader) {
+		mFileReader = std::make_shared<FileReader>();
+		mFileThread = std::thread([reader = mFileReader]() {
+			std::unique_lock<std::mutex> lock(reader->Mutex);
+			for (;;) {
+				reader->WakeUp.wait(lock, [&]() { return reader->Quit || !reader->Requests.empty(); });
+				if (reader->Quit) {
+					return;
+				}
+				std::unique_ptr<FileRead> read = std::move(reader->Requests.front());
+				reader->Requests.pop_front();
+				lock.unlock();
+				read->Data = ReadWholeFile(read->Path);
+				lock.lock();
+				reader->Completed.push_back(std::move(read));
+			}
+		});
+	}
+
+	auto read = std::make_unique<FileRead>();
+	read->Id = id;
+	read->Handle = handle;
+	read->Path = path;
+	read->Result = result;
+	{
+		std::lock_guard<std::mutex> lock(mFileReader->Mutex);
+		mFileReader->Requests.push_back(std::move(read));
+	}
+	mFileReader->WakeUp.notify_one();
+}
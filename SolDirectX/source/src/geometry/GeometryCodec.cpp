@@ -0,0 +1,493 @@
+#include "../../header/Geometry/GeometryCodec.h"
+#include "../../header/Common/CpuFeatures.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+namespace {
+	const uint8_t IndexCodecVersion = 0xE0;
+	const uint8_t VertexCodecVersion = 0xA0;
+
+	//Index codec. Code byte of a triangle:
+	//  0ddddrrt  shares the edge d places back in the edge FIFO, the edge starts
+	//            at corner r of the triangle, t set if the third vertex is Next
+	//  10000abc  three vertices, a/b/c set if that corner is Next
+	const uint32_t EdgeFifoSize = 16;
+	const uint8_t ExplicitTriangle = 0x80;
+	const uint32_t NextCorner[5] = { 1, 2, 0, 1, 2 };
+
+	struct Edge
+	{
+		uint32_t From;
+		uint32_t To;
+	};
+
+	//The state encoder and decoder advance in lockstep.
+	struct IndexCodecState
+	{
+		Edge Fifo[EdgeFifoSize] = {};
+		uint32_t FifoHead = 0;
+		//One past the highest vertex seen so far.
+		uint32_t Next = 0;
+		uint32_t Last = 0;
+
+		const Edge& Recent(uint32_t distance) const
+		{
+			return Fifo[(FifoHead - 1 - distance) % EdgeFifoSize];
+		}
+
+		void Seen(uint32_t vertex)
+		{
+			Next = std::max(Next, vertex + 1);
+		}
+
+		//A neighbour runs along the shared edge the other way around.
+		void Push(const uint32_t triangle[3])
+		{
+			for (int k = 0; k < 3; ++k) {
+				Fifo[FifoHead % EdgeFifoSize] = { triangle[NextCorner[k]], triangle[k] };
+				++FifoHead;
+			}
+		}
+	};
+
+	uint32_t ZigZag(uint32_t delta)
+	{
+		return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+	}
+
+	uint32_t UnZigZag(uint32_t value)
+	{
+		return (value >> 1) ^ (0u - (value & 1));
+	}
+
+	uint8_t* WriteVarint(uint8_t* dst, uint32_t value)
+	{
+		while (value >= 0x80) {
+			*dst++ = (uint8_t)(value | 0x80);
+			value >>= 7;
+		}
+		*dst++ = (uint8_t)value;
+		return dst;
+	}
+
+	bool ReadVarint(const uint8_t*& src, const uint8_t* end, uint32_t& value)
+	{
+		value = 0;
+		for (uint32_t shift = 0; shift < 35; shift += 7) {
+			if (src == end) {
+				return false;
+			}
+			uint8_t byte = *src++;
+			value |= (uint32_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//Writes a vertex that is not Next.
+	uint8_t* WriteVertex(uint8_t* dst, IndexCodecState& state, uint32_t vertex)
+	{
+		dst = WriteVarint(dst, ZigZag(vertex - state.Last));
+		state.Last = vertex;
+		return dst;
+	}
+
+	bool ReadVertex(const uint8_t*& src, const uint8_t* end, IndexCodecState& state, bool next, uint32_t& vertex)
+	{
+		if (next) {
+			vertex = state.Next;
+		}
+		else {
+			uint32_t delta;
+			if (!ReadVarint(src, end, delta)) {
+				return false;
+			}
+			vertex = state.Last + UnZigZag(delta);
+			state.Last = vertex;
+		}
+		state.Seen(vertex);
+		return true;
+	}
+
+	template<typename T>
+	bool DecodeIndices(const uint8_t* src, size_t srcSize, T* dst, size_t indexCount)
+	{
+		if (indexCount % 3 != 0 || srcSize == 0 || src[0] != IndexCodecVersion) {
+			return false;
+		}
+		const uint8_t* p = src + 1;
+		const uint8_t* end = src + srcSize;
+		IndexCodecState state;
+		for (size_t i = 0; i < indexCount; i += 3) {
+			if (p == end) {
+				return false;
+			}
+			uint32_t code = *p++;
+			uint32_t triangle[3];
+			if ((code & ExplicitTriangle) != 0) {
+				if (code > (ExplicitTriangle | 7u)) {
+					return false;
+				}
+				for (int k = 0; k < 3; ++k) {
+					if (!ReadVertex(p, end, state, (code >> k & 1) != 0, triangle[k])) {
+						return false;
+					}
+				}
+			}
+			else {
+				uint32_t corner = code >> 1 & 3;
+				if (corner == 3) {
+					return false;
+				}
+				const Edge& edge = state.Recent(code >> 3);
+				triangle[corner] = edge.From;
+				triangle[NextCorner[corner]] = edge.To;
+				if (!ReadVertex(p, end, state, (code & 1) != 0, triangle[NextCorner[corner + 1]])) {
+					return false;
+				}
+			}
+			if (sizeof(T) < sizeof(uint32_t) && (triangle[0] | triangle[1] | triangle[2]) > 0xFFFFu) {
+				return false;
+			}
+			dst[i] = (T)triangle[0];
+			dst[i + 1] = (T)triangle[1];
+			dst[i + 2] = (T)triangle[2];
+			state.Push(triangle);
+		}
+		return p == end;
+	}
+
+	//Vertex codec. Per block and byte plane: a 2-bit mode per group of 16
+	//vertices, packed 4 to a byte, then the groups with 0/4/8/16 bytes each.
+	//2-bit deltas: value i in bits 2*(i/4) of byte i%4; 4-bit deltas: value i
+	//in nibble i/8 of byte i%8, which SSE2 unpacks with shifts and masks.
+	const size_t GroupSize = 16;
+	const size_t GroupsPerBlock = VertexCodecBlockSize / GroupSize;
+
+	const size_t GroupBytes[4] = { 0, 4, 8, 16 };
+
+	uint8_t ZigZag8(uint8_t delta)
+	{
+		return (uint8_t)((delta << 1) ^ (uint8_t)((int8_t)delta >> 7));
+	}
+
+	uint8_t* EncodeGroup(const uint8_t* deltas, uint32_t mode, uint8_t* dst)
+	{
+		switch (mode) {
+		case 1:
+			for (size_t j = 0; j < 4; ++j) {
+				dst[j] = (uint8_t)(deltas[j] | deltas[j + 4] << 2 | deltas[j + 8] << 4 | deltas[j + 12] << 6);
+			}
+			break;
+		case 2:
+			for (size_t j = 0; j < 8; ++j) {
+				dst[j] = (uint8_t)(deltas[j] | deltas[j + 8] << 4);
+			}
+			break;
+		case 3:
+			memcpy(dst, deltas, GroupSize);
+			break;
+		}
+		return dst + GroupBytes[mode];
+	}
+
+	__m128i DecodeGroup(const uint8_t* src, uint32_t mode)
+	{
+		switch (mode) {
+		case 1: {
+			int32_t packed;
+			memcpy(&packed, src, sizeof(packed));
+			__m128i bits = _mm_cvtsi32_si128(packed);
+			__m128i mask = _mm_set1_epi8(3);
+			__m128i values = _mm_and_si128(bits, mask);
+			values = _mm_or_si128(values, _mm_slli_si128(_mm_and_si128(_mm_srli_epi16(bits, 2), mask), 4));
+			values = _mm_or_si128(values, _mm_slli_si128(_mm_and_si128(_mm_srli_epi16(bits, 4), mask), 8));
+			return _mm_or_si128(values, _mm_slli_si128(_mm_and_si128(_mm_srli_epi16(bits, 6), mask), 12));
+		}
+		case 2: {
+			__m128i bits = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+			__m128i mask = _mm_set1_epi8(15);
+			return _mm_or_si128(_mm_and_si128(bits, mask), _mm_slli_si128(_mm_and_si128(_mm_srli_epi16(bits, 4), mask), 8));
+		}
+		case 3:
+			return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		default:
+			return _mm_setzero_si128();
+		}
+	}
+
+	//Zigzagged deltas to values: undo the zigzag, prefix sum in 4 steps and add
+	//the last value of the previous group, which previous holds in every byte.
+	__m128i IntegrateGroup(__m128i deltas, __m128i& previous)
+	{
+		__m128i half = _mm_and_si128(_mm_srli_epi16(deltas, 1), _mm_set1_epi8(0x7F));
+		__m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(deltas, _mm_set1_epi8(1)));
+		__m128i values = _mm_xor_si128(half, sign);
+		values = _mm_add_epi8(values, _mm_slli_si128(values, 1));
+		values = _mm_add_epi8(values, _mm_slli_si128(values, 2));
+		values = _mm_add_epi8(values, _mm_slli_si128(values, 4));
+		values = _mm_add_epi8(values, _mm_slli_si128(values, 8));
+		values = _mm_add_epi8(values, previous);
+
+		//Broadcast byte 15.
+		__m128i high = _mm_shufflehi_epi16(_mm_unpackhi_epi8(values, values), 0xFF);
+		previous = _mm_shuffle_epi32(high, 0xFF);
+		return values;
+	}
+
+	//Planes whose groups all have the same width - most of them in meshes in
+	//cache order - take a loop without per-group dispatch.
+	template<uint32_t Mode>
+	void DecodePlane(const uint8_t*& src, size_t groups, __m128i previous, uint8_t* plane)
+	{
+		for (size_t g = 0; g < groups; ++g) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(plane + g * GroupSize),
+				IntegrateGroup(DecodeGroup(src, Mode), previous));
+			src += GroupBytes[Mode];
+		}
+	}
+
+	void StoreUint32(uint8_t* dst, __m128i value)
+	{
+		int32_t bits = _mm_cvtsi128_si32(value);
+		memcpy(dst, &bits, sizeof(bits));
+	}
+
+	//Interleaves the byte planes of a block back into vertices, four planes at
+	//a time: 16 vertices of 4 planes become 16 4-byte stores.
+	void InterleaveBlock(const uint8_t* planes, size_t count, size_t stride, uint8_t* dst)
+	{
+		size_t k = 0;
+		for (; k + 4 <= stride; k += 4) {
+			const uint8_t* plane = planes + k * VertexCodecBlockSize;
+			for (size_t v = 0; v < count; v += GroupSize) {
+				__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + v));
+				__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + VertexCodecBlockSize + v));
+				__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + 2 * VertexCodecBlockSize + v));
+				__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane + 3 * VertexCodecBlockSize + v));
+				__m128i ab0 = _mm_unpacklo_epi8(a, b);
+				__m128i ab1 = _mm_unpackhi_epi8(a, b);
+				__m128i cd0 = _mm_unpacklo_epi8(c, d);
+				__m128i cd1 = _mm_unpackhi_epi8(c, d);
+				__m128i quads[4] = {
+					_mm_unpacklo_epi16(ab0, cd0), _mm_unpackhi_epi16(ab0, cd0),
+					_mm_unpacklo_epi16(ab1, cd1), _mm_unpackhi_epi16(ab1, cd1)
+				};
+
+				uint8_t* out = dst + v * stride + k;
+				size_t n = std::min(GroupSize, count - v);
+				if (n == GroupSize) {
+					for (int q = 0; q < 4; ++q) {
+						StoreUint32(out, quads[q]);
+						StoreUint32(out + stride, _mm_srli_si128(quads[q], 4));
+						StoreUint32(out + 2 * stride, _mm_srli_si128(quads[q], 8));
+						StoreUint32(out + 3 * stride, _mm_srli_si128(quads[q], 12));
+						out += 4 * stride;
+					}
+				}
+				else {
+					alignas(16) uint8_t tail[GroupSize * 4];
+					for (int q = 0; q < 4; ++q) {
+						_mm_store_si128(reinterpret_cast<__m128i*>(tail) + q, quads[q]);
+					}
+					for (size_t i = 0; i < n; ++i) {
+						memcpy(out + i * stride, tail + i * 4, 4);
+					}
+				}
+			}
+		}
+		for (; k < stride; ++k) {
+			const uint8_t* plane = planes + k * VertexCodecBlockSize;
+			for (size_t v = 0; v < count; ++v) {
+				dst[v * stride + k] = plane[v];
+			}
+		}
+	}
+}
+
+size_t IndexCodecBound(size_t indexCount)
+{
+	//A code byte and three 5-byte varints per triangle.
+	return 1 + indexCount / 3 * 16;
+}
+
+size_t VertexCodecBound(size_t vertexCount, size_t stride)
+{
+	const size_t blocks = (vertexCount + VertexCodecBlockSize - 1) / VertexCodecBlockSize;
+	return 1 + blocks * stride * ((GroupsPerBlock + 3) / 4 + GroupsPerBlock * GroupSize);
+}
+
+size_t EncodeIndexBuffer(const uint32_t* indices, size_t indexCount, uint8_t* dst)
+{
+	assert(indexCount % 3 == 0);
+	uint8_t* out = dst;
+	*out++ = IndexCodecVersion;
+
+	IndexCodecState state;
+	for (size_t i = 0; i + 3 <= indexCount; i += 3) {
+		const uint32_t triangle[3] = { indices[i], indices[i + 1], indices[i + 2] };
+
+		//Most recent edges first, they are the likeliest to match again.
+		uint32_t code = ExplicitTriangle;
+		for (uint32_t distance = 0; distance < EdgeFifoSize && code == ExplicitTriangle; ++distance) {
+			const Edge& edge = state.Recent(distance);
+			for (uint32_t corner = 0; corner < 3; ++corner) {
+				if (triangle[corner] == edge.From && triangle[NextCorner[corner]] == edge.To) {
+					code = distance << 3 | corner << 1;
+					break;
+				}
+			}
+		}
+
+		if (code != ExplicitTriangle) {
+			uint32_t third = triangle[NextCorner[(code >> 1 & 3) + 1]];
+			uint8_t* codeByte = out++;
+			if (third == state.Next) {
+				code |= 1;
+			}
+			else {
+				out = WriteVertex(out, state, third);
+			}
+			state.Seen(third);
+			*codeByte = (uint8_t)code;
+		}
+		else {
+			uint8_t* codeByte = out++;
+			for (uint32_t k = 0; k < 3; ++k) {
+				if (triangle[k] == state.Next) {
+					code |= 1u << k;
+				}
+				else {
+					out = WriteVertex(out, state, triangle[k]);
+				}
+				state.Seen(triangle[k]);
+			}
+			*codeByte = (uint8_t)code;
+		}
+		state.Push(triangle);
+	}
+	return (size_t)(out - dst);
+}
+
+bool DecodeIndexBuffer(const uint8_t* src, size_t srcSize, uint32_t* dst, size_t indexCount)
+{
+	return DecodeIndices(src, srcSize, dst, indexCount);
+}
+
+bool DecodeIndexBuffer(const uint8_t* src, size_t srcSize, uint16_t* dst, size_t indexCount)
+{
+	return DecodeIndices(src, srcSize, dst, indexCount);
+}
+
+size_t EncodeVertexBuffer(const uint8_t* vertices, size_t vertexCount, size_t stride, uint8_t* dst)
+{
+	assert(stride > 0 && stride <= VertexCodecMaxStride);
+	uint8_t* out = dst;
+	*out++ = VertexCodecVersion;
+
+	uint8_t last[VertexCodecMaxStride] = {};
+	uint8_t deltas[VertexCodecBlockSize];
+	for (size_t first = 0; first < vertexCount; first += VertexCodecBlockSize) {
+		const size_t count = std::min(VertexCodecBlockSize, vertexCount - first);
+		const size_t groups = (count + GroupSize - 1) / GroupSize;
+		const uint8_t* block = vertices + first * stride;
+		for (size_t k = 0; k < stride; ++k) {
+			uint8_t previous = last[k];
+			for (size_t v = 0; v < count; ++v) {
+				uint8_t value = block[v * stride + k];
+				deltas[v] = ZigZag8((uint8_t)(value - previous));
+				previous = value;
+			}
+			memset(deltas + count, 0, groups * GroupSize - count);
+			last[k] = previous;
+
+			//OR-ing the deltas keeps the highest bit of the largest one.
+			uint8_t* modes = out;
+			memset(modes, 0, (groups + 3) / 4);
+			out += (groups + 3) / 4;
+			for (size_t g = 0; g < groups; ++g) {
+				const uint8_t* group = deltas + g * GroupSize;
+				uint8_t bits = 0;
+				for (size_t i = 0; i < GroupSize; ++i) {
+					bits |= group[i];
+				}
+				uint32_t mode = bits == 0 ? 0 : bits < 4 ? 1 : bits < 16 ? 2 : 3;
+				modes[g / 4] |= (uint8_t)(mode << (g % 4 * 2));
+				out = EncodeGroup(group, mode, out);
+			}
+		}
+	}
+	return (size_t)(out - dst);
+}
+
+bool DecodeVertexBuffer(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t vertexCount, size_t stride)
+{
+	if (stride == 0 || stride > VertexCodecMaxStride || srcSize == 0 || src[0] != VertexCodecVersion) {
+		return false;
+	}
+	const uint8_t* p = src + 1;
+	const uint8_t* end = src + srcSize;
+
+	std::vector<uint8_t> planes(stride * VertexCodecBlockSize);
+	uint8_t last[VertexCodecMaxStride] = {};
+	for (size_t first = 0; first < vertexCount; first += VertexCodecBlockSize) {
+		const size_t count = std::min(VertexCodecBlockSize, vertexCount - first);
+		const size_t groups = (count + GroupSize - 1) / GroupSize;
+		const size_t modeBytes = (groups + 3) / 4;
+		for (size_t k = 0; k < stride; ++k) {
+			if ((size_t)(end - p) < modeBytes) {
+				return false;
+			}
+			const uint8_t* modes = p;
+			p += modeBytes;
+
+			//All modes of the plane in one word, GroupsPerBlock is 16.
+			uint32_t modeBits = 0;
+			memcpy(&modeBits, modes, modeBytes);
+			const uint32_t used = groups == GroupsPerBlock ? ~0u : (1u << groups * 2) - 1;
+			modeBits &= used;
+			const uint32_t low = modeBits & 0x55555555u;
+			const uint32_t high = modeBits >> 1 & 0x55555555u;
+			const size_t planeBytes = 4 * PopCount(low & ~high) + 8 * PopCount(high & ~low) + 16 * PopCount(low & high);
+			if ((size_t)(end - p) < planeBytes) {
+				return false;
+			}
+
+			const uint32_t firstMode = modeBits & 3;
+			const bool uniform = modeBits == (0x55555555u & used) * firstMode;
+
+			uint8_t* plane = planes.data() + k * VertexCodecBlockSize;
+			__m128i previous = _mm_set1_epi8((char)last[k]);
+			switch (uniform ? firstMode : 4) {
+			case 0:
+				DecodePlane<0>(p, groups, previous, plane);
+				break;
+			case 1:
+				DecodePlane<1>(p, groups, previous, plane);
+				break;
+			case 2:
+				DecodePlane<2>(p, groups, previous, plane);
+				break;
+			case 3:
+				DecodePlane<3>(p, groups, previous, plane);
+				break;
+			default:
+				for (size_t g = 0; g < groups; ++g, modeBits >>= 2) {
+					uint32_t mode = modeBits & 3;
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(plane + g * GroupSize),
+						IntegrateGroup(DecodeGroup(p, mode), previous));
+					p += GroupBytes[mode];
+				}
+				break;
+			}
+			last[k] = plane[count - 1];
+		}
+		InterleaveBlock(planes.data(), count, stride, dst + first * stride);
+	}
+	return p == end;
+}
@@ -0,0 +1,715 @@
+#include "../../header/Geometry/MeshImporter.h"
+#include "../../header/Geometry/MeshOptimizer.h"
+#include "../../header/Common/MappedFile.h"
+#include "../../header/Common/ParallelFor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	using Clock = std::chrono::high_resolution_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool Fail(std::string* error, const std::string& message)
+	{
+		if (error != nullptr) {
+			*error = message;
+		}
+		return false;
+	}
+
+	//SizeOr() of a member that is not a valid index or size.
+	const size_t InvalidSize = ~(size_t)0;
+
+	//Just enough JSON for glTF documents.
+	struct JsonValue
+	{
+		enum class Type { Null, Bool, Number, String, Array, Object };
+
+		Type Kind = Type::Null;
+		bool Bool = false;
+		double Number = 0.0;
+		std::string String;
+		std::vector<JsonValue> Items;
+		std::vector<std::pair<std::string, JsonValue>> Members;
+
+		const JsonValue* Find(const char* key) const
+		{
+			for (const auto& member : Members) {
+				if (member.first == key) {
+					return &member.second;
+				}
+			}
+			return nullptr;
+		}
+
+		//Member as a number, fallback when missing or of another type.
+		double NumberOr(const char* key, double fallback) const
+		{
+			const JsonValue* value = Find(key);
+			return value != nullptr && value->Kind == Type::Number ? value->Number : fallback;
+		}
+
+		//Member as an array index or byte count, fallback when missing or of
+		//another type, InvalidSize when negative, fractional or too large.
+		size_t SizeOr(const char* key, size_t fallback) const
+		{
+			const JsonValue* value = Find(key);
+			if (value == nullptr || value->Kind != Type::Number) {
+				return fallback;
+			}
+			const double number = value->Number;
+			return number >= 0.0 && number < 9007199254740992.0 && (double)(size_t)number == number ?
+				(size_t)number : InvalidSize;
+		}
+
+		const JsonValue* Item(const char* key, size_t index) const
+		{
+			const JsonValue* array = Find(key);
+			return array != nullptr && index < array->Items.size() ? &array->Items[index] : nullptr;
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* text, size_t size) : mP(text), mEnd(text + size) {}
+
+		bool Parse(JsonValue& value)
+		{
+			return ParseValue(value, 0) && (SkipSpaces(), mP == mEnd);
+		}
+
+	private:
+		static const int MaxDepth = 128;
+
+		void SkipSpaces()
+		{
+			while (mP < mEnd && (*mP == ' ' || *mP == '\t' || *mP == '\n' || *mP == '\r')) {
+				++mP;
+			}
+		}
+
+		bool Consume(const char* literal)
+		{
+			size_t length = strlen(literal);
+			if ((size_t)(mEnd - mP) < length || memcmp(mP, literal, length) != 0) {
+				return false;
+			}
+			mP += length;
+			return true;
+		}
+
+		bool ParseValue(JsonValue& value, int depth)
+		{
+			SkipSpaces();
+			if (mP == mEnd || depth > MaxDepth) {
+				return false;
+			}
+			switch (*mP) {
+			case '{':
+				value.Kind = JsonValue::Type::Object;
+				++mP;
+				SkipSpaces();
+				if (mP < mEnd && *mP == '}') {
+					++mP;
+					return true;
+				}
+				for (;;) {
+					std::string key;
+					SkipSpaces();
+					if (!ParseString(key)) {
+						return false;
+					}
+					SkipSpaces();
+					if (mP == mEnd || *mP++ != ':') {
+						return false;
+					}
+					value.Members.emplace_back(std::move(key), JsonValue());
+					if (!ParseValue(value.Members.back().second, depth + 1)) {
+						return false;
+					}
+					SkipSpaces();
+					if (mP < mEnd && *mP == ',') {
+						++mP;
+						continue;
+					}
+					return mP < mEnd && *mP++ == '}';
+				}
+			case '[':
+				value.Kind = JsonValue::Type::Array;
+				++mP;
+				SkipSpaces();
+				if (mP < mEnd && *mP == ']') {
+					++mP;
+					return true;
+				}
+				for (;;) {
+					value.Items.emplace_back();
+					if (!ParseValue(value.Items.back(), depth + 1)) {
+						return false;
+					}
+					SkipSpaces();
+					if (mP < mEnd && *mP == ',') {
+						++mP;
+						continue;
+					}
+					return mP < mEnd && *mP++ == ']';
+				}
+			case '"':
+				value.Kind = JsonValue::Type::String;
+				return ParseString(value.String);
+			case 't':
+				value.Kind = JsonValue::Type::Bool;
+				value.Bool = true;
+				return Consume("true");
+			case 'f':
+				value.Kind = JsonValue::Type::Bool;
+				return Consume("false");
+			case 'n':
+				return Consume("null");
+			default:
+				return ParseNumber(value);
+			}
+		}
+
+		bool ParseNumber(JsonValue& value)
+		{
+			//strtod needs a terminated string; numbers are short.
+			char buffer[64];
+			size_t length = 0;
+			while (mP + length < mEnd && length + 1 < sizeof(buffer) && strchr("+-0123456789.eE", mP[length]) != nullptr) {
+				buffer[length] = mP[length];
+				++length;
+			}
+			buffer[length] = '\0';
+			char* parsedEnd = nullptr;
+			value.Kind = JsonValue::Type::Number;
+			value.Number = strtod(buffer, &parsedEnd);
+			if (length == 0 || parsedEnd != buffer + length) {
+				return false;
+			}
+			mP += length;
+			return true;
+		}
+
+		void AppendUtf8(std::string& out, uint32_t code)
+		{
+			if (code < 0x80) {
+				out += (char)code;
+			}
+			else if (code < 0x800) {
+				out += (char)(0xC0 | (code >> 6));
+				out += (char)(0x80 | (code & 0x3F));
+			}
+			else if (code < 0x10000) {
+				out += (char)(0xE0 | (code >> 12));
+				out += (char)(0x80 | ((code >> 6) & 0x3F));
+				out += (char)(0x80 | (code & 0x3F));
+			}
+			else {
+				out += (char)(0xF0 | (code >> 18));
+				out += (char)(0x80 | ((code >> 12) & 0x3F));
+				out += (char)(0x80 | ((code >> 6) & 0x3F));
+				out += (char)(0x80 | (code & 0x3F));
+			}
+		}
+
+		bool ParseHex4(uint32_t& code)
+		{
+			if (mEnd - mP < 4) {
+				return false;
+			}
+			code = 0;
+			for (int i = 0; i < 4; ++i) {
+				char c = *mP++;
+				code <<= 4;
+				if (c >= '0' && c <= '9') code |= c - '0';
+				else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+				else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+				else return false;
+			}
+			return true;
+		}
+
+		bool ParseString(std::string& out)
+		{
+			if (mP == mEnd || *mP != '"') {
+				return false;
+			}
+			for (++mP; mP < mEnd;) {
+				char c = *mP++;
+				if (c == '"') {
+					return true;
+				}
+				if (c != '\\') {
+					out += c;
+					continue;
+				}
+				if (mP == mEnd) {
+					return false;
+				}
+				switch (*mP++) {
+				case '"': out += '"'; break;
+				case '\\': out += '\\'; break;
+				case '/': out += '/'; break;
+				case 'b': out += '\b'; break;
+				case 'f': out += '\f'; break;
+				case 'n': out += '\n'; break;
+				case 'r': out += '\r'; break;
+				case 't': out += '\t'; break;
+				case 'u': {
+					uint32_t code;
+					if (!ParseHex4(code)) {
+						return false;
+					}
+					//Surrogate pairs carry code points above the BMP.
+					uint32_t low;
+					if (code >= 0xD800 && code < 0xDC00 && Consume("\\u") && ParseHex4(low)) {
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+					AppendUtf8(out, code);
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+			return false;
+		}
+
+		const char* mP;
+		const char* mEnd;
+	};
+
+	bool DecodeBase64(const char* text, size_t length, std::vector<uint8_t>& out)
+	{
+		auto digit = [](char c) -> int {
+			if (c >= 'A' && c <= 'Z') return c - 'A';
+			if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+			if (c >= '0' && c <= '9') return c - '0' + 52;
+			if (c == '+') return 62;
+			if (c == '/') return 63;
+			return -1;
+		};
+		out.clear();
+		out.reserve(length / 4 * 3);
+		uint32_t bits = 0;
+		int bitCount = 0;
+		for (size_t i = 0; i < length && text[i] != '='; ++i) {
+			int value = digit(text[i]);
+			if (value < 0) {
+				return false;
+			}
+			bits = (bits << 6) | (uint32_t)value;
+			bitCount += 6;
+			if (bitCount >= 8) {
+				bitCount -= 8;
+				out.push_back((uint8_t)(bits >> bitCount));
+			}
+		}
+		return true;
+	}
+
+	//A buffer of the document: the BIN chunk of a .glb, a data URI or a file.
+	struct GltfBuffer
+	{
+		const uint8_t* Data = nullptr;
+		size_t Size = 0;
+		std::shared_ptr<MappedFile> File;
+		std::vector<uint8_t> Decoded;
+	};
+
+	//A resolved accessor: element i, component k lies at Data + i * Stride + k * ComponentSize.
+	struct GltfAccessor
+	{
+		const uint8_t* Data = nullptr;
+		size_t Count = 0;
+		size_t Stride = 0;
+		uint32_t ComponentType = 0;
+		uint32_t ComponentSize = 0;
+		uint32_t Components = 0;
+		bool Normalized = false;
+
+		float Read(size_t element, uint32_t component) const
+		{
+			const uint8_t* p = Data + element * Stride + component * ComponentSize;
+			switch (ComponentType) {
+			case 5120: { int8_t v; memcpy(&v, p, 1); return Normalized ? std::max(v / 127.0f, -1.0f) : v; }
+			case 5121: return Normalized ? *p / 255.0f : *p;
+			case 5122: { int16_t v; memcpy(&v, p, 2); return Normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+			case 5123: { uint16_t v; memcpy(&v, p, 2); return Normalized ? v / 65535.0f : v; }
+			case 5125: { uint32_t v; memcpy(&v, p, 4); return (float)v; }
+			default: { float v; memcpy(&v, p, 4); return v; }
+			}
+		}
+
+		uint32_t ReadIndex(size_t element) const
+		{
+			const uint8_t* p = Data + element * Stride;
+			switch (ComponentType) {
+			case 5121: return *p;
+			case 5123: { uint16_t v; memcpy(&v, p, 2); return v; }
+			default: { uint32_t v; memcpy(&v, p, 4); return v; }
+			}
+		}
+	};
+
+	uint32_t ComponentSize(uint32_t componentType)
+	{
+		switch (componentType) {
+		case 5120: case 5121: return 1;
+		case 5122: case 5123: return 2;
+		case 5125: case 5126: return 4;
+		default: return 0;
+		}
+	}
+
+	uint32_t ComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	bool ResolveAccessor(const JsonValue& document, const std::vector<GltfBuffer>& buffers, size_t index,
+		GltfAccessor& accessor)
+	{
+		const JsonValue* json = document.Item("accessors", index);
+		if (json == nullptr || json->Find("sparse") != nullptr) {
+			return false;
+		}
+		const JsonValue* type = json->Find("type");
+		accessor.ComponentType = (uint32_t)std::min<size_t>(json->SizeOr("componentType", 0), UINT32_MAX);
+		accessor.ComponentSize = ComponentSize(accessor.ComponentType);
+		accessor.Components = type != nullptr ? ComponentCount(type->String) : 0;
+		accessor.Count = json->SizeOr("count", 0);
+		const JsonValue* normalized = json->Find("normalized");
+		accessor.Normalized = normalized != nullptr && normalized->Bool;
+		if (accessor.ComponentSize == 0 || accessor.Components == 0 || accessor.Count == InvalidSize) {
+			return false;
+		}
+
+		const JsonValue* view = document.Item("bufferViews", json->SizeOr("bufferView", InvalidSize));
+		if (view == nullptr) {
+			return false;
+		}
+		const size_t bufferIndex = view->SizeOr("buffer", InvalidSize);
+		if (bufferIndex >= buffers.size()) {
+			return false;
+		}
+		const GltfBuffer& buffer = buffers[bufferIndex];
+		const size_t viewOffset = view->SizeOr("byteOffset", 0);
+		const size_t viewLength = view->SizeOr("byteLength", 0);
+		const size_t elementSize = (size_t)accessor.ComponentSize * accessor.Components;
+		accessor.Stride = view->SizeOr("byteStride", elementSize);
+		const size_t offset = json->SizeOr("byteOffset", 0);
+		if (viewOffset > buffer.Size || viewLength > buffer.Size - viewOffset || accessor.Stride < elementSize ||
+			accessor.Stride == InvalidSize) {
+			return false;
+		}
+		//The last element has to end inside the view, without overflowing on huge counts.
+		if (accessor.Count != 0 && (offset > viewLength || viewLength - offset < elementSize ||
+			accessor.Count - 1 > (viewLength - offset - elementSize) / accessor.Stride)) {
+			return false;
+		}
+		accessor.Data = buffer.Data + viewOffset + offset;
+		return true;
+	}
+
+	bool LoadBuffers(const JsonValue& document, const std::string& path, const uint8_t* binChunk, size_t binSize,
+		std::vector<GltfBuffer>& buffers, std::string* error)
+	{
+		const JsonValue* list = document.Find("buffers");
+		const size_t count = list != nullptr ? list->Items.size() : 0;
+		buffers.resize(count);
+		const size_t slash = path.find_last_of("/\\");
+		const std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+		for (size_t i = 0; i < count; ++i) {
+			const JsonValue& json = list->Items[i];
+			GltfBuffer& buffer = buffers[i];
+			const JsonValue* uri = json.Find("uri");
+			if (uri == nullptr) {
+				if (binChunk == nullptr) {
+					return Fail(error, path + ": buffer " + std::to_string(i) + " has no data");
+				}
+				buffer.Data = binChunk;
+				buffer.Size = binSize;
+			}
+			else if (uri->String.compare(0, 5, "data:") == 0) {
+				size_t comma = uri->String.find(',');
+				if (comma == std::string::npos || uri->String.rfind(";base64", comma) == std::string::npos ||
+					!DecodeBase64(uri->String.data() + comma + 1, uri->String.size() - comma - 1, buffer.Decoded)) {
+					return Fail(error, path + ": cannot decode the data URI of buffer " + std::to_string(i));
+				}
+				buffer.Data = buffer.Decoded.data();
+				buffer.Size = buffer.Decoded.size();
+			}
+			else {
+				buffer.File = MappedFile::Open(directory + uri->String, error);
+				if (buffer.File == nullptr) {
+					return false;
+				}
+				buffer.Data = buffer.File->Data();
+				buffer.Size = buffer.File->Size();
+			}
+			//byteLength may be smaller than the data (GLB pads its chunk).
+			buffer.Size = std::min(buffer.Size, json.SizeOr("byteLength", buffer.Size));
+		}
+		return true;
+	}
+
+	struct GltfPrimitive
+	{
+		std::string Name;
+		GltfAccessor Positions;
+		GltfAccessor Normals;
+		GltfAccessor Colors;
+		GltfAccessor Indices;
+		bool HasNormals = false;
+		bool HasColors = false;
+		bool HasIndices = false;
+		size_t VertexBase = 0;
+		size_t IndexBase = 0;
+
+		size_t IndexCount() const { return HasIndices ? Indices.Count : Positions.Count; }
+	};
+
+	std::string FileStem(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		size_t begin = slash == std::string::npos ? 0 : slash + 1;
+		size_t dot = path.find_last_of('.');
+		return path.substr(begin, dot != std::string::npos && dot > begin ? dot - begin : std::string::npos);
+	}
+
+	//Index of the primitive containing element of a prefix-summed range.
+	size_t FindPrimitive(const std::vector<size_t>& bases, size_t element)
+	{
+		return (size_t)(std::upper_bound(bases.begin(), bases.end(), element) - bases.begin()) - 1;
+	}
+}
+
+bool ImportGltf(const std::string& path, MeshData& mesh, const MeshImportOptions& options,
+	MeshImportStats* stats, std::string* error)
+{
+	auto start = Clock::now();
+	std::shared_ptr<MappedFile> file = MappedFile::Open(path, error);
+	if (file == nullptr) {
+		return false;
+	}
+
+	//A .glb is a 12-byte header followed by a JSON chunk and an optional BIN chunk.
+	const uint8_t* data = file->Data();
+	const char* json = reinterpret_cast<const char*>(data);
+	size_t jsonSize = file->Size();
+	const uint8_t* binChunk = nullptr;
+	size_t binSize = 0;
+	if (file->Size() >= 20 && memcmp(data, "glTF", 4) == 0) {
+		uint32_t header[5];
+		memcpy(header, data, sizeof(header));
+		if (header[1] != 2 || header[2] < 20 || header[2] > file->Size() || header[4] != 0x4E4F534A || header[3] > header[2] - 20) {
+			return Fail(error, path + ": invalid GLB header");
+		}
+		json = reinterpret_cast<const char*>(data + 20);
+		jsonSize = header[3];
+		const size_t binHeader = 20 + (size_t)jsonSize;
+		uint32_t chunk[2];
+		if (binHeader + 8 <= header[2] && (memcpy(chunk, data + binHeader, 8), chunk[1] == 0x004E4942) &&
+			chunk[0] <= header[2] - binHeader - 8) {
+			binChunk = data + binHeader + 8;
+			binSize = chunk[0];
+		}
+	}
+
+	JsonValue document;
+	if (!JsonParser(json, jsonSize).Parse(document) || document.Kind != JsonValue::Type::Object) {
+		return Fail(error, path + ": invalid JSON");
+	}
+	std::vector<GltfBuffer> buffers;
+	if (!LoadBuffers(document, path, binChunk, binSize, buffers, error)) {
+		return false;
+	}
+
+	//Collect the triangle primitives and where their vertices and indices go.
+	std::vector<GltfPrimitive> primitives;
+	size_t vertexCount = 0, indexCount = 0;
+	bool hasNormals = false, hasColors = false;
+	const JsonValue* meshes = document.Find("meshes");
+	for (size_t m = 0; meshes != nullptr && m < meshes->Items.size(); ++m) {
+		const JsonValue& jsonMesh = meshes->Items[m];
+		const JsonValue* name = jsonMesh.Find("name");
+		const std::string meshName = name != nullptr && !name->String.empty() ? name->String : "mesh" + std::to_string(m);
+		const JsonValue* list = jsonMesh.Find("primitives");
+		for (size_t p = 0; list != nullptr && p < list->Items.size(); ++p) {
+			const JsonValue& jsonPrimitive = list->Items[p];
+			const JsonValue* attributes = jsonPrimitive.Find("attributes");
+			if (jsonPrimitive.NumberOr("mode", 4) != 4 || attributes == nullptr) {
+				continue;
+			}
+
+			GltfPrimitive primitive;
+			primitive.Name = meshName + "_" + std::to_string(p);
+			const std::string where = path + ": primitive " + primitive.Name;
+			const size_t position = attributes->SizeOr("POSITION", InvalidSize);
+			if (!ResolveAccessor(document, buffers, position, primitive.Positions) ||
+				primitive.Positions.Components != 3 || primitive.Positions.ComponentType != 5126) {
+				return Fail(error, where + " has no valid float3 POSITION");
+			}
+			if (attributes->Find("NORMAL") != nullptr) {
+				primitive.HasNormals = ResolveAccessor(document, buffers, attributes->SizeOr("NORMAL", InvalidSize),
+					primitive.Normals) && primitive.Normals.Components == 3 &&
+					primitive.Normals.Count == primitive.Positions.Count;
+				if (!primitive.HasNormals) {
+					return Fail(error, where + " has an invalid NORMAL");
+				}
+			}
+			if (attributes->Find("COLOR_0") != nullptr) {
+				primitive.HasColors = ResolveAccessor(document, buffers, attributes->SizeOr("COLOR_0", InvalidSize),
+					primitive.Colors) && primitive.Colors.Components >= 3 &&
+					primitive.Colors.Count == primitive.Positions.Count;
+				if (!primitive.HasColors) {
+					return Fail(error, where + " has an invalid COLOR_0");
+				}
+			}
+			if (jsonPrimitive.Find("indices") != nullptr) {
+				primitive.HasIndices = ResolveAccessor(document, buffers, jsonPrimitive.SizeOr("indices", InvalidSize),
+					primitive.Indices) && primitive.Indices.Components == 1 && primitive.Indices.ComponentType != 5120 &&
+					primitive.Indices.ComponentType != 5122 && primitive.Indices.ComponentType != 5126;
+				if (!primitive.HasIndices) {
+					return Fail(error, where + " has invalid indices");
+				}
+			}
+			if (primitive.IndexCount() % 3 != 0 || primitive.Positions.Count == 0) {
+				return Fail(error, where + " is not a triangle list");
+			}
+
+			primitive.VertexBase = vertexCount;
+			primitive.IndexBase = indexCount;
+			vertexCount += primitive.Positions.Count;
+			indexCount += primitive.IndexCount();
+			hasNormals |= primitive.HasNormals;
+			hasColors |= primitive.HasColors;
+			primitives.push_back(std::move(primitive));
+		}
+	}
+	if (indexCount == 0) {
+		return Fail(error, path + ": no triangles");
+	}
+
+	mesh = MeshData();
+	mesh.Name = FileStem(path);
+	mesh.Format = { PositionFormat::Float3, hasNormals ? NormalFormat::Float3 : NormalFormat::None,
+		hasColors ? ColorFormat::Float4 : ColorFormat::None };
+	mesh.VertexStride = mesh.Format.Stride();
+	const size_t stride = mesh.VertexStride;
+	mesh.Vertices.resize(vertexCount * stride);
+	mesh.Indices.resize(indexCount);
+	for (const GltfPrimitive& primitive : primitives) {
+		MeshPart part;
+		part.Name = primitive.Name;
+		part.IndexStart = (uint32_t)primitive.IndexBase;
+		part.IndexCount = (uint32_t)primitive.IndexCount();
+		mesh.Parts.push_back(part);
+	}
+	MakePartNamesUnique(mesh);
+
+	std::vector<size_t> vertexBases, indexBases;
+	for (const GltfPrimitive& primitive : primitives) {
+		vertexBases.push_back(primitive.VertexBase);
+		indexBases.push_back(primitive.IndexBase);
+	}
+
+	//Vertices and indices are converted in parallel over the whole mesh, so a
+	//single large primitive is split as well. glTF is right-handed with
+	//counter-clockwise front faces: z is negated and, since the mirror leaves
+	//triangles counter-clockwise, their second and third index swap places to
+	//match the clockwise fronts of the renderer.
+	const size_t grain = 16 * 1024;
+	ParallelFor(0, vertexCount, grain, [&](size_t begin, size_t end) {
+		size_t p = FindPrimitive(vertexBases, begin);
+		for (size_t v = begin; v < end; ++v) {
+			while (v >= primitives[p].VertexBase + primitives[p].Positions.Count) {
+				++p;
+			}
+			const GltfPrimitive& primitive = primitives[p];
+			const size_t element = v - primitive.VertexBase;
+			float vertex[10];
+			vertex[0] = primitive.Positions.Read(element, 0);
+			vertex[1] = primitive.Positions.Read(element, 1);
+			vertex[2] = -primitive.Positions.Read(element, 2);
+			float* attribute = vertex + 3;
+			if (hasNormals) {
+				attribute[0] = primitive.HasNormals ? primitive.Normals.Read(element, 0) : 0.0f;
+				attribute[1] = primitive.HasNormals ? primitive.Normals.Read(element, 1) : 0.0f;
+				attribute[2] = primitive.HasNormals ? -primitive.Normals.Read(element, 2) : 1.0f;
+				attribute += 3;
+			}
+			if (hasColors) {
+				for (uint32_t k = 0; k < 4; ++k) {
+					attribute[k] = primitive.HasColors && k < primitive.Colors.Components ? primitive.Colors.Read(element, k) : 1.0f;
+				}
+			}
+			memcpy(mesh.Vertices.data() + v * stride, vertex, stride);
+		}
+	});
+
+	std::atomic<bool> outOfRange(false);
+	ParallelFor(0, indexCount, grain, [&](size_t begin, size_t end) {
+		size_t p = FindPrimitive(indexBases, begin);
+		for (size_t i = begin; i < end; ++i) {
+			while (i >= primitives[p].IndexBase + primitives[p].IndexCount()) {
+				++p;
+			}
+			const GltfPrimitive& primitive = primitives[p];
+			const size_t corner = i - primitive.IndexBase;
+			const size_t element = corner - corner % 3 + (3 - corner % 3) % 3;
+			uint32_t index = primitive.HasIndices ? primitive.Indices.ReadIndex(element) : (uint32_t)element;
+			if (index >= primitive.Positions.Count) {
+				outOfRange = true;
+				index = 0;
+			}
+			mesh.Indices[i] = (uint32_t)primitive.VertexBase + index;
+		}
+	});
+	if (outOfRange) {
+		return Fail(error, path + ": index out of range");
+	}
+	const double parseMilliseconds = MillisecondsSince(start);
+
+	auto weldStart = Clock::now();
+	size_t uniqueCount = vertexCount;
+	if (options.Weld) {
+		std::vector<uint32_t> remap(vertexCount);
+		uniqueCount = WeldVertices(mesh.Vertices.data(), stride, vertexCount, remap.data());
+		mesh.Vertices.resize(uniqueCount * stride);
+		ParallelFor(0, indexCount, grain, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				mesh.Indices[i] = remap[mesh.Indices[i]];
+			}
+		});
+	}
+
+	if (stats != nullptr) {
+		stats->FileBytes = file->Size();
+		for (const GltfBuffer& buffer : buffers) {
+			stats->FileBytes += buffer.File != nullptr ? buffer.File->Size() : 0;
+		}
+		stats->Triangles = indexCount / 3;
+		stats->SourceVertices = vertexCount;
+		stats->Vertices = uniqueCount;
+		stats->ParseMilliseconds = parseMilliseconds;
+		stats->WeldMilliseconds = MillisecondsSince(weldStart);
+		stats->Milliseconds = MillisecondsSince(start);
+	}
+	return true;
+}
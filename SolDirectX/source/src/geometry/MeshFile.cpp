@@ -0,0 +1,409 @@
+#include "../../header/Geometry/MeshFile.h"
+#include "../../header/Geometry/GeometryCodec.h"
+#include "../../header/Geometry/VertexQuantizer.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+	bool Fail(std::string* error, const std::string& message)
+	{
+		if (error != nullptr) {
+			*error = message;
+		}
+		return false;
+	}
+
+	uint64_t AlignUp(uint64_t value)
+	{
+		return (value + MeshFileAlignment - 1) / MeshFileAlignment * MeshFileAlignment;
+	}
+
+	bool CopyName(char (&destination)[MeshFileNameLength], const std::string& name)
+	{
+		memset(destination, 0, MeshFileNameLength);
+		if (name.size() >= MeshFileNameLength) {
+			return false;
+		}
+		memcpy(destination, name.data(), name.size());
+		return true;
+	}
+
+	std::string ReadName(const char (&name)[MeshFileNameLength])
+	{
+		return std::string(name, strnlen(name, MeshFileNameLength));
+	}
+
+	bool VertexInRange(const MeshFileHeader& header, uint32_t index, int32_t baseVertex)
+	{
+		int64_t vertex = (int64_t)index + baseVertex;
+		return vertex >= 0 && vertex < header.VertexCount;
+	}
+
+	//Whether every index of every part, offset by its BaseVertex, addresses a
+	//vertex. Indices no part draws are not looked at.
+	template<typename Index>
+	bool PartIndicesValid(const MeshFileHeader& header, const MeshFilePart* parts, const Index* indices)
+	{
+		for (uint32_t i = 0; i < header.PartCount; ++i) {
+			const MeshFilePart& part = parts[i];
+			if (part.IndexCount == 0) {
+				continue;
+			}
+			const Index* first = indices + part.IndexStart;
+			Index low = first[0], high = first[0];
+			for (uint32_t k = 1; k < part.IndexCount; ++k) {
+				low = std::min(low, first[k]);
+				high = std::max(high, first[k]);
+			}
+			if (!VertexInRange(header, low, part.BaseVertex) || !VertexInRange(header, high, part.BaseVertex)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//Whether the meshlets of every part stay inside the part's indices and the
+	//meshlet streams, and their local triangles and vertices address vertices.
+	bool PartMeshletsValid(const MeshFileHeader& header, const uint8_t* data)
+	{
+		const MeshFilePart* parts = reinterpret_cast<const MeshFilePart*>(data + header.Streams[MeshFileStreamParts].Offset);
+		const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(data + header.Streams[MeshFileStreamMeshlets].Offset);
+		const uint32_t* meshletVertices = reinterpret_cast<const uint32_t*>(
+			data + header.Streams[MeshFileStreamMeshletVertices].Offset);
+		const uint8_t* meshletTriangles = data + header.Streams[MeshFileStreamMeshletTriangles].Offset;
+		const uint64_t meshletVertexCount = header.Streams[MeshFileStreamMeshletVertices].Size / sizeof(uint32_t);
+		const uint64_t meshletTriangleBytes = header.Streams[MeshFileStreamMeshletTriangles].Size;
+
+		for (uint32_t i = 0; i < header.PartCount; ++i) {
+			const MeshFilePart& part = parts[i];
+			for (uint32_t m = part.MeshletStart; m < part.MeshletStart + part.MeshletCount; ++m) {
+				const Meshlet& meshlet = meshlets[m];
+				const uint64_t corners = 3ull * meshlet.TriangleCount;
+				if (meshlet.IndexStart + corners > part.IndexCount ||
+					(uint64_t)meshlet.VertexStart + meshlet.VertexCount > meshletVertexCount ||
+					meshlet.TriangleStart + corners > meshletTriangleBytes) {
+					return false;
+				}
+				for (uint64_t k = 0; k < corners; ++k) {
+					if (meshletTriangles[meshlet.TriangleStart + k] >= meshlet.VertexCount) {
+						return false;
+					}
+				}
+				for (uint32_t k = 0; k < meshlet.VertexCount; ++k) {
+					if (!VertexInRange(header, meshletVertices[meshlet.VertexStart + k], part.BaseVertex)) {
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+}
+
+bool WriteMeshFile(const MeshData& mesh, const std::string& path, bool compress, std::string* error)
+{
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.Magic = MeshFileMagic;
+	header.Version = MeshFileVersion;
+	header.Flags = compress ? MeshFileCompressed : 0;
+	if (!CopyName(header.Name, mesh.Name)) {
+		return Fail(error, "mesh name too long: " + mesh.Name);
+	}
+
+	header.VertexCount = mesh.VertexCount();
+	header.VertexStride = mesh.VertexStride;
+	header.PositionFormat = (uint8_t)mesh.Format.Position;
+	header.NormalFormat = (uint8_t)mesh.Format.Normal;
+	header.ColorFormat = (uint8_t)mesh.Format.Color;
+	header.IndexSize = mesh.Fits16BitIndices() ? 2 : 4;
+	header.IndexCount = (uint32_t)mesh.Indices.size();
+	header.PartCount = (uint32_t)mesh.Parts.size();
+	header.MeshletCount = (uint32_t)mesh.Meshlets.size();
+	for (int k = 0; k < 3; ++k) {
+		header.DequantizationScale[k] = mesh.Dequantization.Scale[k];
+		header.DequantizationBias[k] = mesh.Dequantization.Bias[k];
+	}
+
+	std::vector<MeshFilePart> parts(mesh.Parts.size());
+	for (size_t i = 0; i < mesh.Parts.size(); ++i) {
+		const MeshPart& part = mesh.Parts[i];
+		MeshFilePart& filePart = parts[i];
+		memset(&filePart, 0, sizeof(filePart));
+		if (!CopyName(filePart.Name, part.Name)) {
+			return Fail(error, "part name too long: " + part.Name);
+		}
+		filePart.IndexStart = part.IndexStart;
+		filePart.IndexCount = part.IndexCount;
+		filePart.BaseVertex = part.BaseVertex;
+		filePart.Lod = part.Lod;
+		filePart.LodError = part.LodError;
+		filePart.MeshletStart = part.MeshletStart;
+		filePart.MeshletCount = part.MeshletCount;
+		ComputePartBounds(mesh, part, filePart.BoundsMin, filePart.BoundsMax);
+	}
+
+	std::vector<uint16_t> indices16;
+	const void* indices = mesh.Indices.data();
+	if (header.IndexSize == 2) {
+		indices16.assign(mesh.Indices.begin(), mesh.Indices.end());
+		indices = indices16.data();
+	}
+
+	const void* streams[MeshFileStreamCount] = {
+		parts.data(), mesh.Vertices.data(), indices, mesh.Meshlets.data(),
+		mesh.MeshletVertices.data(), mesh.MeshletTriangles.data()
+	};
+	uint64_t sizes[MeshFileStreamCount] = {
+		parts.size() * sizeof(MeshFilePart),
+		mesh.Vertices.size(),
+		(uint64_t)mesh.Indices.size() * header.IndexSize,
+		mesh.Meshlets.size() * sizeof(Meshlet),
+		mesh.MeshletVertices.size() * sizeof(uint32_t),
+		mesh.MeshletTriangles.size()
+	};
+
+	std::vector<uint8_t> compressedVertices, compressedIndices;
+	if (compress) {
+		compressedVertices.resize(VertexCodecBound(mesh.VertexCount(), mesh.VertexStride));
+		compressedVertices.resize(EncodeVertexBuffer(mesh.Vertices.data(), mesh.VertexCount(), mesh.VertexStride,
+			compressedVertices.data()));
+		compressedIndices.resize(IndexCodecBound(mesh.Indices.size()));
+		compressedIndices.resize(EncodeIndexBuffer(mesh.Indices.data(), mesh.Indices.size(), compressedIndices.data()));
+		streams[MeshFileStreamVertices] = compressedVertices.data();
+		sizes[MeshFileStreamVertices] = compressedVertices.size();
+		streams[MeshFileStreamIndices] = compressedIndices.data();
+		sizes[MeshFileStreamIndices] = compressedIndices.size();
+	}
+	uint64_t offset = AlignUp(sizeof(MeshFileHeader));
+	for (uint32_t s = 0; s < MeshFileStreamCount; ++s) {
+		header.Streams[s].Offset = offset;
+		header.Streams[s].Size = sizes[s];
+		offset = AlignUp(offset + sizes[s]);
+	}
+	header.FileSize = offset;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return Fail(error, "cannot create " + path);
+	}
+	static const char padding[MeshFileAlignment] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	uint64_t written = sizeof(header);
+	for (uint32_t s = 0; s < MeshFileStreamCount; ++s) {
+		file.write(padding, (std::streamsize)(header.Streams[s].Offset - written));
+		file.write(static_cast<const char*>(streams[s]), (std::streamsize)sizes[s]);
+		written = header.Streams[s].Offset + sizes[s];
+	}
+	file.write(padding, (std::streamsize)(header.FileSize - written));
+	if (!file) {
+		return Fail(error, "cannot write " + path);
+	}
+	return true;
+}
+
+bool MeshFileView::Open(const void* data, size_t size, std::string* error)
+{
+	mData = nullptr;
+	mHeader = nullptr;
+
+	const MeshFileHeader* header = static_cast<const MeshFileHeader*>(data);
+	if (size < sizeof(MeshFileHeader) || header->Magic != MeshFileMagic) {
+		return Fail(error, "not a mesh file");
+	}
+	if (header->Version != MeshFileVersion) {
+		return Fail(error, "unsupported mesh file version " + std::to_string(header->Version));
+	}
+	if (header->FileSize != size) {
+		return Fail(error, "truncated mesh file");
+	}
+	if ((header->Flags & ~MeshFileCompressed) != 0) {
+		return Fail(error, "unknown mesh file flags");
+	}
+	if ((reinterpret_cast<uintptr_t>(data) & (alignof(MeshFileHeader) - 1)) != 0) {
+		return Fail(error, "mesh file data is misaligned");
+	}
+
+	if (header->PositionFormat > (uint8_t)PositionFormat::Unorm16x4 ||
+		header->NormalFormat > (uint8_t)NormalFormat::Oct16 ||
+		header->ColorFormat > (uint8_t)ColorFormat::Unorm8x4) {
+		return Fail(error, "unknown vertex format");
+	}
+	VertexFormat format = { (PositionFormat)header->PositionFormat, (NormalFormat)header->NormalFormat,
+		(ColorFormat)header->ColorFormat };
+	if (header->VertexStride != format.Stride() || (header->IndexSize != 2 && header->IndexSize != 4)) {
+		return Fail(error, "inconsistent vertex or index format");
+	}
+
+	const uint64_t expectedSizes[MeshFileStreamCount] = {
+		(uint64_t)header->PartCount * sizeof(MeshFilePart),
+		(uint64_t)header->VertexCount * header->VertexStride,
+		(uint64_t)header->IndexCount * header->IndexSize,
+		(uint64_t)header->MeshletCount * sizeof(Meshlet),
+		header->Streams[MeshFileStreamMeshletVertices].Size / sizeof(uint32_t) * sizeof(uint32_t),
+		header->Streams[MeshFileStreamMeshletTriangles].Size
+	};
+	//Compressed streams are checked when they are decoded.
+	const bool compressed = (header->Flags & MeshFileCompressed) != 0;
+	const uint64_t compressedBounds[MeshFileStreamCount] = {
+		0, VertexCodecBound(header->VertexCount, header->VertexStride), IndexCodecBound(header->IndexCount)
+	};
+	for (uint32_t s = 0; s < MeshFileStreamCount; ++s) {
+		const MeshFileRange& range = header->Streams[s];
+		bool sizeValid = compressed && compressedBounds[s] != 0 ?
+			range.Size != 0 && range.Size <= compressedBounds[s] : range.Size == expectedSizes[s];
+		if (range.Offset % MeshFileAlignment != 0 || range.Offset > size || range.Size > size - range.Offset ||
+			!sizeValid) {
+			return Fail(error, "corrupt stream table");
+		}
+	}
+
+	//Parts must stay inside the streams, so that nothing reads past the file later.
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	const MeshFilePart* parts = reinterpret_cast<const MeshFilePart*>(bytes + header->Streams[MeshFileStreamParts].Offset);
+	for (uint32_t i = 0; i < header->PartCount; ++i) {
+		const MeshFilePart& part = parts[i];
+		if ((uint64_t)part.IndexStart + part.IndexCount > header->IndexCount ||
+			(uint64_t)part.MeshletStart + part.MeshletCount > header->MeshletCount ||
+			(part.Lod != 0 && i == 0)) {
+			return Fail(error, "corrupt part table");
+		}
+	}
+	if (!PartMeshletsValid(*header, bytes)) {
+		return Fail(error, "corrupt meshlets");
+	}
+	//Compressed indices are checked by ReadIndices() once decoded.
+	const uint8_t* indices = bytes + header->Streams[MeshFileStreamIndices].Offset;
+	if (!compressed && !(header->IndexSize == 2 ?
+		PartIndicesValid(*header, parts, reinterpret_cast<const uint16_t*>(indices)) :
+		PartIndicesValid(*header, parts, reinterpret_cast<const uint32_t*>(indices)))) {
+		return Fail(error, "indices out of range");
+	}
+
+	mData = bytes;
+	mHeader = header;
+	return true;
+}
+
+std::string MeshFileView::Name() const
+{
+	return ReadName(mHeader->Name);
+}
+
+VertexFormat MeshFileView::Format() const
+{
+	return { (PositionFormat)mHeader->PositionFormat, (NormalFormat)mHeader->NormalFormat,
+		(ColorFormat)mHeader->ColorFormat };
+}
+
+PositionDequantization MeshFileView::Dequantization() const
+{
+	PositionDequantization dequantization;
+	for (int k = 0; k < 3; ++k) {
+		dequantization.Scale[k] = mHeader->DequantizationScale[k];
+		dequantization.Bias[k] = mHeader->DequantizationBias[k];
+	}
+	return dequantization;
+}
+
+MeshPart MeshFileView::Part(uint32_t part) const
+{
+	const MeshFilePart& filePart = Parts()[part];
+	MeshPart result;
+	result.Name = ReadName(filePart.Name);
+	result.IndexStart = filePart.IndexStart;
+	result.IndexCount = filePart.IndexCount;
+	result.BaseVertex = filePart.BaseVertex;
+	result.Lod = filePart.Lod;
+	result.LodError = filePart.LodError;
+	result.MeshletStart = filePart.MeshletStart;
+	result.MeshletCount = filePart.MeshletCount;
+	return result;
+}
+
+bool MeshFileView::ReadVertices(void* dst) const
+{
+	const MeshFileRange& range = Stream(MeshFileStreamVertices);
+	if (!Compressed()) {
+		memcpy(dst, StreamData(MeshFileStreamVertices), (size_t)range.Size);
+		return true;
+	}
+	return DecodeVertexBuffer(StreamData(MeshFileStreamVertices), (size_t)range.Size, static_cast<uint8_t*>(dst),
+		mHeader->VertexCount, mHeader->VertexStride);
+}
+
+bool MeshFileView::ReadIndices(void* dst) const
+{
+	const MeshFileRange& range = Stream(MeshFileStreamIndices);
+	if (!Compressed()) {
+		memcpy(dst, StreamData(MeshFileStreamIndices), (size_t)range.Size);
+		return true;
+	}
+	//Decoded indices are only known now, check them like Open() checks stored ones.
+	if (mHeader->IndexSize == 2) {
+		uint16_t* indices = static_cast<uint16_t*>(dst);
+		return DecodeIndexBuffer(StreamData(MeshFileStreamIndices), (size_t)range.Size, indices, mHeader->IndexCount) &&
+			PartIndicesValid(*mHeader, Parts(), indices);
+	}
+	uint32_t* indices = static_cast<uint32_t*>(dst);
+	return DecodeIndexBuffer(StreamData(MeshFileStreamIndices), (size_t)range.Size, indices, mHeader->IndexCount) &&
+		PartIndicesValid(*mHeader, Parts(), indices);
+}
+
+bool MeshFileView::ToMeshData(MeshData& mesh, std::string* error) const
+{
+	mesh.Name = Name();
+	mesh.Format = Format();
+	mesh.VertexStride = mHeader->VertexStride;
+	mesh.Dequantization = Dequantization();
+
+	mesh.Vertices.resize((size_t)VertexBytes());
+	mesh.Indices.resize(mHeader->IndexCount);
+	bool valid = ReadVertices(mesh.Vertices.data());
+	if (mHeader->IndexSize == 2) {
+		std::vector<uint16_t> indices16(mHeader->IndexCount);
+		valid = valid && ReadIndices(indices16.data());
+		mesh.Indices.assign(indices16.begin(), indices16.end());
+	}
+	else {
+		valid = valid && ReadIndices(mesh.Indices.data());
+	}
+	if (!valid) {
+		return Fail(error, "corrupt compressed geometry");
+	}
+
+	mesh.Parts.resize(mHeader->PartCount);
+	for (uint32_t i = 0; i < mHeader->PartCount; ++i) {
+		mesh.Parts[i] = Part(i);
+	}
+
+	mesh.Meshlets.assign(Meshlets(), Meshlets() + mHeader->MeshletCount);
+	const uint32_t* meshletVertices = reinterpret_cast<const uint32_t*>(StreamData(MeshFileStreamMeshletVertices));
+	mesh.MeshletVertices.assign(meshletVertices,
+		meshletVertices + Stream(MeshFileStreamMeshletVertices).Size / sizeof(uint32_t));
+	const uint8_t* meshletTriangles = StreamData(MeshFileStreamMeshletTriangles);
+	mesh.MeshletTriangles.assign(meshletTriangles,
+		meshletTriangles + Stream(MeshFileStreamMeshletTriangles).Size);
+	return true;
+}
+
+bool ReadMeshFile(const std::string& path, MeshData& mesh, std::string* error)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return Fail(error, "cannot open " + path);
+	}
+	std::vector<uint64_t> data(((size_t)file.tellg() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+	const size_t size = (size_t)file.tellg();
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char*>(data.data()), (std::streamsize)size)) {
+		return Fail(error, "cannot read " + path);
+	}
+
+	MeshFileView view;
+	if (!view.Open(data.data(), size, error)) {
+		return false;
+	}
+	return view.ToMeshData(mesh, error);
+}
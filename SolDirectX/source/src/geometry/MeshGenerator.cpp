@@ -0,0 +1,150 @@
+#include "../../header/Geometry/MeshGenerator.h"
+#include <cmath>
+#include <cstring>
+
+namespace {
+	void AppendVertex(MeshData& mesh, const float* attributes, size_t floatCount)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(attributes);
+		mesh.Vertices.insert(mesh.Vertices.end(), bytes, bytes + floatCount * sizeof(float));
+	}
+
+	void SetSinglePart(MeshData& mesh, const char* name)
+	{
+		MeshPart part;
+		part.Name = name;
+		part.IndexCount = (uint32_t)mesh.Indices.size();
+		mesh.Parts.assign(1, part);
+	}
+}
+
+MeshData CreateBox(float halfExtent)
+{
+	MeshData mesh;
+	mesh.Name = "boxGeo";
+	mesh.Format = { PositionFormat::Float3, NormalFormat::None, ColorFormat::Float4 };
+	mesh.VertexStride = mesh.Format.Stride();
+
+	//DirectX::Colors White, Black, Red, Green, Blue, Yellow, Cyan and Magenta.
+	const float h = halfExtent;
+	const float corners[8][7] = {
+		{ -h, -h, -h, 1.0f, 1.0f, 1.0f, 1.0f },
+		{ -h, +h, -h, 0.0f, 0.0f, 0.0f, 1.0f },
+		{ +h, +h, -h, 1.0f, 0.0f, 0.0f, 1.0f },
+		{ +h, -h, -h, 0.0f, 0.501960814f, 0.0f, 1.0f },
+		{ -h, -h, +h, 0.0f, 0.0f, 1.0f, 1.0f },
+		{ -h, +h, +h, 1.0f, 1.0f, 0.0f, 1.0f },
+		{ +h, +h, +h, 0.0f, 1.0f, 1.0f, 1.0f },
+		{ +h, -h, +h, 1.0f, 0.0f, 1.0f, 1.0f }
+	};
+	for (const float* corner : corners) {
+		AppendVertex(mesh, corner, 7);
+	}
+
+	mesh.Indices = {
+		// front face
+		0, 1, 2,
+		0, 2, 3,
+
+		// back face
+		4, 6, 5,
+		4, 7, 6,
+
+		// left face
+		4, 5, 1,
+		4, 1, 0,
+
+		// right face
+		3, 2, 6,
+		3, 6, 7,
+
+		// top face
+		1, 5, 6,
+		1, 6, 2,
+
+		// bottom face
+		4, 0, 3,
+		4, 3, 7
+	};
+	SetSinglePart(mesh, "box");
+	return mesh;
+}
+
+MeshData CreateSphere(float radius, uint32_t slices, uint32_t stacks)
+{
+	MeshData mesh;
+	mesh.Name = "sphereGeo";
+	mesh.Format = { PositionFormat::Float3, NormalFormat::Float3, ColorFormat::Float4 };
+	mesh.VertexStride = mesh.Format.Stride();
+
+	//Rings from the north pole to the south pole, the seam column is duplicated.
+	//Seam and pole copies get bitwise equal positions, which is how the
+	//simplifier and welding recognize them.
+	const float pi = 3.14159265f;
+	for (uint32_t stack = 0; stack <= stacks; ++stack) {
+		float phi = pi * stack / stacks;
+		float sinPhi = stack == 0 || stack == stacks ? 0.0f : sinf(phi);
+		float cosPhi = stack == 0 ? 1.0f : (stack == stacks ? -1.0f : cosf(phi));
+		for (uint32_t slice = 0; slice <= slices; ++slice) {
+			float theta = 2.0f * pi * (slice % slices) / slices;
+			float n[3] = { sinPhi * cosf(theta), cosPhi, sinPhi * sinf(theta) };
+			float vertex[10] = {
+				radius * n[0], radius * n[1], radius * n[2],
+				n[0], n[1], n[2],
+				0.5f + 0.5f * n[0], 0.5f + 0.5f * n[1], 0.5f + 0.5f * n[2], 1.0f
+			};
+			AppendVertex(mesh, vertex, 10);
+		}
+	}
+
+	const uint32_t ring = slices + 1;
+	mesh.Indices.reserve((size_t)slices * stacks * 6);
+	for (uint32_t stack = 0; stack < stacks; ++stack) {
+		for (uint32_t slice = 0; slice < slices; ++slice) {
+			uint32_t a = stack * ring + slice;
+			uint32_t b = a + ring;
+			//The poles collapse one triangle of each quad, leave it out.
+			if (stack != 0) {
+				mesh.Indices.insert(mesh.Indices.end(), { a, a + 1, b });
+			}
+			if (stack != stacks - 1) {
+				mesh.Indices.insert(mesh.Indices.end(), { a + 1, b + 1, b });
+			}
+		}
+	}
+	SetSinglePart(mesh, "sphere");
+	return mesh;
+}
+
+MeshData CreateGrid(float width, float depth, uint32_t rows, uint32_t columns)
+{
+	MeshData mesh;
+	mesh.Name = "gridGeo";
+	mesh.Format = { PositionFormat::Float3, NormalFormat::Float3, ColorFormat::Float4 };
+	mesh.VertexStride = mesh.Format.Stride();
+
+	for (uint32_t row = 0; row <= rows; ++row) {
+		float v = (float)row / rows;
+		for (uint32_t column = 0; column <= columns; ++column) {
+			float u = (float)column / columns;
+			float vertex[10] = {
+				(u - 0.5f) * width, 0.0f, (0.5f - v) * depth,
+				0.0f, 1.0f, 0.0f,
+				u, v, 1.0f - u, 1.0f
+			};
+			AppendVertex(mesh, vertex, 10);
+		}
+	}
+
+	const uint32_t line = columns + 1;
+	mesh.Indices.reserve((size_t)rows * columns * 6);
+	for (uint32_t row = 0; row < rows; ++row) {
+		for (uint32_t column = 0; column < columns; ++column) {
+			uint32_t a = row * line + column;
+			uint32_t b = a + line;
+			mesh.Indices.insert(mesh.Indices.end(), { a, a + 1, b, a + 1, b + 1, b });
+		}
+	}
+	SetSinglePart(mesh, "grid");
+	return mesh;
+}
@@ -0,0 +1,46 @@
+#include "../../header/Geometry/MeshImporter.h"
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+#include <unordered_set>
+
+void MakePartNamesUnique(MeshData& mesh)
+{
+	std::unordered_set<std::string> names;
+	for (const MeshPart& part : mesh.Parts) {
+		names.insert(part.Name);
+	}
+	//Every name keeps its first part; the next suffix to try per name.
+	std::unordered_map<std::string, uint32_t> nameCounts;
+	for (MeshPart& part : mesh.Parts) {
+		uint32_t& count = nameCounts[part.Name];
+		if (count++ == 0) {
+			continue;
+		}
+		std::string name = part.Name + "_" + std::to_string(count - 1);
+		while (!names.insert(name).second) {
+			name = part.Name + "_" + std::to_string(count++);
+		}
+		part.Name = name;
+	}
+}
+
+bool ImportMesh(const std::string& path, MeshData& mesh, const MeshImportOptions& options,
+	MeshImportStats* stats, std::string* error)
+{
+	size_t dot = path.find_last_of('.');
+	std::string extension = dot != std::string::npos ? path.substr(dot + 1) : std::string();
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+		[](char c) { return (char)tolower((unsigned char)c); });
+
+	if (extension == "obj") {
+		return ImportObj(path, mesh, options, stats, error);
+	}
+	if (extension == "gltf" || extension == "glb") {
+		return ImportGltf(path, mesh, options, stats, error);
+	}
+	if (error != nullptr) {
+		*error = path + ": unknown mesh file type";
+	}
+	return false;
+}
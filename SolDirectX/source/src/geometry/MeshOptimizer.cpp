@@ -0,0 +1,495 @@
+#include "../../header/Geometry/MeshOptimizer.h"
+#include "../../header/Common/ParallelFor.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	//Forsyth's scoring constants.
+	const int MaxCacheSize = 32;
+	const float CacheDecayPower = 1.5f;
+	const float LastTriangleScore = 0.75f;
+	const float ValenceBoostScale = 2.0f;
+	const float ValenceBoostPower = 0.5f;
+	const int ValenceTableSize = 64;
+
+	struct ScoreTables
+	{
+		float Cache[MaxCacheSize];
+		float Valence[ValenceTableSize];
+
+		ScoreTables()
+		{
+			for (int i = 0; i < MaxCacheSize; ++i) {
+				if (i < 3) {
+					//The last triangle's vertices score the same, whatever their order.
+					Cache[i] = LastTriangleScore;
+				}
+				else {
+					float scaler = 1.0f / (MaxCacheSize - 3);
+					Cache[i] = powf(1.0f - (i - 3) * scaler, CacheDecayPower);
+				}
+			}
+			Valence[0] = 0.0f;
+			for (int i = 1; i < ValenceTableSize; ++i) {
+				Valence[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+			}
+		}
+	};
+
+	const ScoreTables& GetScoreTables()
+	{
+		static const ScoreTables tables;
+		return tables;
+	}
+
+	float VertexScore(int cachePosition, uint32_t liveTriangles)
+	{
+		if (liveTriangles == 0) {
+			//No triangle needs this vertex anymore.
+			return -1.0f;
+		}
+		const ScoreTables& tables = GetScoreTables();
+		float score = cachePosition >= 0 ? tables.Cache[cachePosition] : 0.0f;
+		return score + (liveTriangles < ValenceTableSize ? tables.Valence[liveTriangles]
+			: ValenceBoostScale * powf((float)liveTriangles, -ValenceBoostPower));
+	}
+
+	//FIFO cache simulation: a vertex is a hit while fewer than cacheSize misses
+	//happened since it was loaded. Returns the number of misses per triangle.
+	class FifoCache
+	{
+	public:
+		FifoCache(size_t vertexCount, uint32_t cacheSize) :
+			mLoadedAt(vertexCount, 0),
+			mCacheSize(cacheSize),
+			mTime(cacheSize + 1)
+		{
+		}
+
+		void Reset()
+		{
+			//Pushing the clock ahead evicts everything without touching the array.
+			mTime += mCacheSize + 1;
+		}
+
+		uint32_t Triangle(const uint32_t* tri)
+		{
+			uint32_t misses = 0;
+			for (int i = 0; i < 3; ++i) {
+				uint32_t v = tri[i];
+				if (mTime - mLoadedAt[v] > mCacheSize) {
+					mLoadedAt[v] = mTime++;
+					misses++;
+				}
+			}
+			return misses;
+		}
+
+	private:
+		std::vector<uint64_t> mLoadedAt;
+		uint64_t mCacheSize;
+		uint64_t mTime;
+	};
+}
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+	uint32_t cacheSize)
+{
+	VertexCacheStats stats;
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return stats;
+	}
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> used(vertexCount, false);
+	size_t misses = 0;
+	size_t usedCount = 0;
+	for (size_t t = 0; t < triangleCount; ++t) {
+		misses += cache.Triangle(indices + 3 * t);
+		for (int i = 0; i < 3; ++i) {
+			uint32_t v = indices[3 * t + i];
+			if (!used[v]) {
+				used[v] = true;
+				usedCount++;
+			}
+		}
+	}
+	stats.Acmr = (float)misses / triangleCount;
+	stats.Atvr = (float)misses / usedCount;
+	return stats;
+}
+
+void OptimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	//Triangles using each vertex. The first liveTriangles[v] entries of a
+	//vertex's range are the triangles not emitted yet.
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < 3 * triangleCount; ++i) {
+		liveTriangles[indices[i]]++;
+	}
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	}
+	std::vector<uint32_t> adjacency(3 * triangleCount);
+	{
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; ++t) {
+			for (int i = 0; i < 3; ++i) {
+				adjacency[fill[indices[3 * t + i]]++] = (uint32_t)t;
+			}
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		vertexScore[v] = VertexScore(-1, liveTriangles[v]);
+	}
+	std::vector<float> triangleScore(triangleCount);
+	for (size_t t = 0; t < triangleCount; ++t) {
+		triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+	}
+	std::vector<bool> emitted(triangleCount, false);
+
+	std::vector<uint32_t> output;
+	output.reserve(3 * triangleCount);
+	uint32_t cache[MaxCacheSize + 3];
+	int cacheSize = 0;
+	size_t nextCandidate = 0;
+
+	int64_t best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+	for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+		if (best < 0) {
+			//Dead end: continue with the next triangle in input order.
+			while (emitted[nextCandidate]) {
+				nextCandidate++;
+			}
+			best = (int64_t)nextCandidate;
+		}
+
+		const uint32_t* tri = indices + 3 * best;
+		emitted[best] = true;
+		output.insert(output.end(), tri, tri + 3);
+
+		//Retire the triangle from its vertices' live lists.
+		for (int i = 0; i < 3; ++i) {
+			uint32_t v = tri[i];
+			uint32_t* list = adjacency.data() + adjacencyOffsets[v];
+			uint32_t* last = list + liveTriangles[v] - 1;
+			*std::find(list, last + 1, (uint32_t)best) = *last;
+			liveTriangles[v]--;
+		}
+
+		//The triangle's vertices move to the front of the LRU cache.
+		uint32_t newCache[MaxCacheSize + 3];
+		int newSize = 0;
+		for (int i = 0; i < 3; ++i) {
+			newCache[newSize++] = tri[i];
+		}
+		for (int i = 0; i < cacheSize; ++i) {
+			uint32_t v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2]) {
+				newCache[newSize++] = v;
+			}
+		}
+
+		//Rescore the cached vertices (and the ones that just fell out), then
+		//every live triangle around them; the best of those is emitted next.
+		for (int i = 0; i < newSize; ++i) {
+			uint32_t v = newCache[i];
+			cachePosition[v] = i < MaxCacheSize ? i : -1;
+			vertexScore[v] = VertexScore(cachePosition[v], liveTriangles[v]);
+		}
+		best = -1;
+		float bestScore = -FLT_MAX;
+		for (int i = 0; i < newSize; ++i) {
+			uint32_t v = newCache[i];
+			const uint32_t* list = adjacency.data() + adjacencyOffsets[v];
+			for (uint32_t j = 0; j < liveTriangles[v]; ++j) {
+				uint32_t t = list[j];
+				float score = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+				triangleScore[t] = score;
+				if (score > bestScore) {
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+
+		cacheSize = std::min(newSize, MaxCacheSize);
+		std::copy(newCache, newCache + cacheSize, cache);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void OptimizeOverdraw(uint32_t* indices, size_t indexCount, const uint8_t* vertices, size_t vertexStride,
+	size_t vertexCount, uint32_t cacheSize, float threshold)
+{
+	const size_t triangleCount = indexCount / 3;
+	if (triangleCount < 2) {
+		return;
+	}
+
+	//Hard boundaries: triangles missing all three vertices start over anyway.
+	std::vector<size_t> hardStarts;
+	{
+		FifoCache cache(vertexCount, cacheSize);
+		for (size_t t = 0; t < triangleCount; ++t) {
+			if (cache.Triangle(indices + 3 * t) == 3) {
+				hardStarts.push_back(t);
+			}
+		}
+		hardStarts.push_back(triangleCount);
+	}
+
+	//Soft boundaries: split a hard cluster once the part before the split is
+	//about as cache friendly as the whole cluster.
+	std::vector<size_t> clusterStarts;
+	FifoCache cache(vertexCount, cacheSize);
+	for (size_t h = 0; h + 1 < hardStarts.size(); ++h) {
+		size_t begin = hardStarts[h];
+		size_t end = hardStarts[h + 1];
+
+		cache.Reset();
+		size_t clusterMisses = 0;
+		for (size_t t = begin; t < end; ++t) {
+			clusterMisses += cache.Triangle(indices + 3 * t);
+		}
+		float clusterAcmr = (float)clusterMisses / (end - begin);
+
+		cache.Reset();
+		clusterStarts.push_back(begin);
+		size_t start = begin;
+		size_t misses = 0;
+		for (size_t t = begin; t < end; ++t) {
+			misses += cache.Triangle(indices + 3 * t);
+			if (t + 1 < end && (float)misses / (t + 1 - start) <= threshold * clusterAcmr) {
+				clusterStarts.push_back(t + 1);
+				start = t + 1;
+				misses = 0;
+				cache.Reset();
+			}
+		}
+	}
+	clusterStarts.push_back(triangleCount);
+
+	auto position = [&](uint32_t v) {
+		return reinterpret_cast<const float*>(vertices + (size_t)v * vertexStride);
+	};
+
+	//Sort key of a cluster: how far its centroid lies along its average
+	//normal, measured from the mesh centroid. Outer clusters are drawn first.
+	double meshCentroid[3] = { 0.0, 0.0, 0.0 };
+	for (size_t i = 0; i < 3 * triangleCount; ++i) {
+		const float* p = position(indices[i]);
+		meshCentroid[0] += p[0];
+		meshCentroid[1] += p[1];
+		meshCentroid[2] += p[2];
+	}
+	for (int c = 0; c < 3; ++c) {
+		meshCentroid[c] /= 3.0 * triangleCount;
+	}
+
+	const size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c) {
+		float centroid[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+		for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+			const float* p0 = position(indices[3 * t]);
+			const float* p1 = position(indices[3 * t + 1]);
+			const float* p2 = position(indices[3 * t + 2]);
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; ++k) {
+				//Area weighted, the cross product is already scaled by the area.
+				centroid[k] += (p0[k] + p1[k] + p2[k]) * (a / 3.0f);
+				normal[k] += n[k];
+			}
+			area += a;
+		}
+		float normalLength = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (area <= 0.0f || normalLength <= 0.0f) {
+			sortKeys[c] = 0.0f;
+			continue;
+		}
+		float key = 0.0f;
+		for (int k = 0; k < 3; ++k) {
+			key += (centroid[k] / area - (float)meshCentroid[k]) * normal[k] / normalLength;
+		}
+		sortKeys[c] = key;
+	}
+
+	std::vector<uint32_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c) {
+		order[c] = (uint32_t)c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(3 * triangleCount);
+	for (uint32_t c : order) {
+		output.insert(output.end(), indices + 3 * clusterStarts[c], indices + 3 * clusterStarts[c + 1]);
+	}
+	std::copy(output.begin(), output.end(), indices);
+}
+
+size_t OptimizeVertexFetch(uint8_t* vertices, size_t vertexStride, size_t vertexCount,
+	uint32_t* indices, size_t indexCount)
+{
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(vertexCount, unused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; ++i) {
+		uint32_t& target = remap[indices[i]];
+		if (target == unused) {
+			target = next++;
+		}
+		indices[i] = target;
+	}
+
+	std::vector<uint8_t> reordered((size_t)next * vertexStride);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		if (remap[v] != unused) {
+			memcpy(reordered.data() + (size_t)remap[v] * vertexStride, vertices + v * vertexStride, vertexStride);
+		}
+	}
+	memcpy(vertices, reordered.data(), reordered.size());
+	return next;
+}
+
+size_t WeldVertices(uint8_t* vertices, size_t vertexStride, size_t vertexCount, uint32_t* remap)
+{
+	assert(vertexStride % sizeof(uint32_t) == 0);
+	const size_t words = vertexStride / sizeof(uint32_t);
+	const size_t grain = 16 * 1024;
+
+	std::vector<uint64_t> hashes(vertexCount);
+	ParallelFor(0, vertexCount, grain, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; ++v) {
+			const uint8_t* vertex = vertices + v * vertexStride;
+			uint64_t hash = 0x9E3779B97F4A7C15ull;
+			for (size_t w = 0; w < words; ++w) {
+				uint32_t word;
+				memcpy(&word, vertex + w * sizeof(uint32_t), sizeof(word));
+				hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+				hash ^= hash >> 32;
+			}
+			hashes[v] = hash;
+		}
+	});
+
+	//Equal vertices share their partition, so the partitions are matched
+	//independently. Scattering keeps every partition in vertex order.
+	const uint32_t partitionBits = 6;
+	const size_t partitionCount = (size_t)1 << partitionBits;
+	std::vector<size_t> partitionStart(partitionCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		++partitionStart[(hashes[v] >> (64 - partitionBits)) + 1];
+	}
+	for (size_t p = 0; p < partitionCount; ++p) {
+		partitionStart[p + 1] += partitionStart[p];
+	}
+	std::vector<uint32_t> order(vertexCount);
+	std::vector<size_t> cursor(partitionStart.begin(), partitionStart.end() - 1);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		order[cursor[hashes[v] >> (64 - partitionBits)]++] = (uint32_t)v;
+	}
+
+	//first[v] is the first vertex equal to v.
+	std::vector<uint32_t> first(vertexCount);
+	ParallelFor(0, partitionCount, 1, [&](size_t begin, size_t end) {
+		std::vector<uint32_t> table;
+		for (size_t p = begin; p < end; ++p) {
+			const size_t count = partitionStart[p + 1] - partitionStart[p];
+			size_t tableSize = 16;
+			while (tableSize < 2 * count) {
+				tableSize *= 2;
+			}
+			const uint32_t empty = ~0u;
+			table.assign(tableSize, empty);
+			for (size_t i = partitionStart[p]; i < partitionStart[p + 1]; ++i) {
+				const uint32_t v = order[i];
+				size_t slot = (size_t)hashes[v] & (tableSize - 1);
+				for (;;) {
+					const uint32_t other = table[slot];
+					if (other == empty) {
+						table[slot] = v;
+						first[v] = v;
+						break;
+					}
+					if (hashes[other] == hashes[v] &&
+						memcmp(vertices + (size_t)other * vertexStride, vertices + (size_t)v * vertexStride, vertexStride) == 0) {
+						first[v] = other;
+						break;
+					}
+					slot = (slot + 1) & (tableSize - 1);
+				}
+			}
+		}
+	});
+
+	//Duplicates always come after their first occurrence, so compacting in
+	//place never overwrites a vertex that is still to be read.
+	uint32_t unique = 0;
+	for (size_t v = 0; v < vertexCount; ++v) {
+		if (first[v] == v) {
+			if (unique != v) {
+				memcpy(vertices + (size_t)unique * vertexStride, vertices + v * vertexStride, vertexStride);
+			}
+			remap[v] = unique++;
+		}
+		else {
+			remap[v] = remap[first[v]];
+		}
+	}
+	return unique;
+}
+
+MeshOptimizeStats OptimizeMesh(MeshData& mesh, const MeshOptimizeOptions& options)
+{
+	MeshOptimizeStats stats;
+	const size_t vertexCount = mesh.VertexCount();
+
+	//Make the indices absolute so that the passes see one vertex array.
+	for (MeshPart& part : mesh.Parts) {
+		for (uint32_t i = 0; i < part.IndexCount; ++i) {
+			mesh.Indices[part.IndexStart + i] += part.BaseVertex;
+		}
+		part.BaseVertex = 0;
+	}
+	stats.Before = AnalyzeVertexCache(mesh.Indices.data(), mesh.Indices.size(), vertexCount, options.CacheSize);
+
+	//Parts own disjoint index ranges and only read the vertices, so each one is a task of its own.
+	ParallelFor(0, mesh.Parts.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t p = begin; p < end; ++p) {
+			const MeshPart& part = mesh.Parts[p];
+			uint32_t* indices = mesh.Indices.data() + part.IndexStart;
+			OptimizeVertexCache(indices, part.IndexCount, vertexCount);
+			if (options.Overdraw) {
+				OptimizeOverdraw(indices, part.IndexCount, mesh.Vertices.data(), mesh.VertexStride,
+					vertexCount, options.CacheSize, options.OverdrawThreshold);
+			}
+		}
+	});
+
+	size_t newVertexCount = OptimizeVertexFetch(mesh.Vertices.data(), mesh.VertexStride, vertexCount,
+		mesh.Indices.data(), mesh.Indices.size());
+	mesh.Vertices.resize(newVertexCount * mesh.VertexStride);
+
+	stats.After = AnalyzeVertexCache(mesh.Indices.data(), mesh.Indices.size(), newVertexCount, options.CacheSize);
+	return stats;
+}
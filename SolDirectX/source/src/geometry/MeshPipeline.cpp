@@ -0,0 +1,28 @@
+#include "../../header/Geometry/MeshPipeline.h"
+#include "../../header/Geometry/VertexQuantizer.h"
+#include <chrono>
+
+MeshProcessStats ProcessMesh(MeshData& mesh, const MeshProcessOptions& options, MeshData& result)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	MeshProcessStats stats;
+	stats.SourceStride = mesh.VertexStride;
+	if (options.GenerateLods) {
+		stats.Lods = GenerateLodChain(mesh, options.Lods);
+	}
+	//Meshlets reorder triangles inside the cache optimized order, so they come after it.
+	if (options.Optimize) {
+		stats.Optimize = OptimizeMesh(mesh, options.Optimizer);
+	}
+	if (options.BuildMeshlets) {
+		BuildMeshlets(mesh, options.Meshlets);
+	}
+	QuantizeMesh(mesh, options.Format, result);
+	stats.MeshletCount = (uint32_t)result.Meshlets.size();
+	stats.Stride = result.VertexStride;
+
+	stats.Milliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+	return stats;
+}
@@ -0,0 +1,461 @@
+#include "../../header/Geometry/MeshSimplifier.h"
+#include "../../header/Common/ParallelFor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	struct Vector3
+	{
+		float X, Y, Z;
+	};
+
+	Vector3 operator-(const Vector3& a, const Vector3& b) { return { a.X - b.X, a.Y - b.Y, a.Z - b.Z }; }
+	float Dot(const Vector3& a, const Vector3& b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+	Vector3 Cross(const Vector3& a, const Vector3& b)
+	{
+		return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X };
+	}
+
+	//Sum of weighted squared distances to a set of planes, as the symmetric
+	//matrix A, vector b and constant c of p^T A p + 2 b^T p + c.
+	struct Quadric
+	{
+		float A00 = 0.0f, A11 = 0.0f, A22 = 0.0f;
+		float A01 = 0.0f, A02 = 0.0f, A12 = 0.0f;
+		float B0 = 0.0f, B1 = 0.0f, B2 = 0.0f;
+		float C = 0.0f;
+		float Weight = 0.0f;
+
+		//Plane n.p + d = 0 with unit normal n.
+		void AddPlane(const Vector3& n, float d, float weight)
+		{
+			A00 += weight * n.X * n.X;
+			A11 += weight * n.Y * n.Y;
+			A22 += weight * n.Z * n.Z;
+			A01 += weight * n.X * n.Y;
+			A02 += weight * n.X * n.Z;
+			A12 += weight * n.Y * n.Z;
+			B0 += weight * n.X * d;
+			B1 += weight * n.Y * d;
+			B2 += weight * n.Z * d;
+			C += weight * d * d;
+			Weight += weight;
+		}
+
+		void Add(const Quadric& q)
+		{
+			A00 += q.A00; A11 += q.A11; A22 += q.A22;
+			A01 += q.A01; A02 += q.A02; A12 += q.A12;
+			B0 += q.B0; B1 += q.B1; B2 += q.B2;
+			C += q.C;
+			Weight += q.Weight;
+		}
+
+		//Mean squared distance of p to the planes.
+		float Error(const Vector3& p) const
+		{
+			float rx = A00 * p.X + A01 * p.Y + A02 * p.Z;
+			float ry = A01 * p.X + A11 * p.Y + A12 * p.Z;
+			float rz = A02 * p.X + A12 * p.Y + A22 * p.Z;
+			float e = rx * p.X + ry * p.Y + rz * p.Z + 2.0f * (B0 * p.X + B1 * p.Y + B2 * p.Z) + C;
+			return Weight > 0.0f ? std::max(e, 0.0f) / Weight : 0.0f;
+		}
+	};
+
+	struct Collapse
+	{
+		float Cost;
+		uint32_t From;
+		uint32_t To;
+		//False when neither direction of the edge may collapse.
+		bool Valid;
+
+		bool operator<(const Collapse& rhs) const
+		{
+			if (Cost != rhs.Cost) {
+				return Cost < rhs.Cost;
+			}
+			return From != rhs.From ? From < rhs.From : To < rhs.To;
+		}
+	};
+
+	uint64_t EdgeKey(uint32_t a, uint32_t b)
+	{
+		return ((uint64_t)a << 32) | b;
+	}
+
+	//Triangles around every vertex, in compressed rows.
+	struct Adjacency
+	{
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Triangles;
+
+		void Build(const std::vector<uint32_t>& indices, size_t vertexCount)
+		{
+			Offsets.assign(vertexCount + 1, 0);
+			for (uint32_t index : indices) {
+				Offsets[index + 1]++;
+			}
+			for (size_t v = 0; v < vertexCount; ++v) {
+				Offsets[v + 1] += Offsets[v];
+			}
+			Triangles.resize(indices.size());
+			std::vector<uint32_t> cursor(Offsets.begin(), Offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); ++i) {
+				Triangles[cursor[indices[i]]++] = (uint32_t)(i / 3);
+			}
+		}
+	};
+
+	class Simplifier
+	{
+	public:
+		Simplifier(const uint32_t* indices, size_t indexCount, const uint8_t* vertices, size_t vertexStride,
+			size_t vertexCount)
+			: mIndices(indices, indices + indexCount), mVertexCount(vertexCount)
+		{
+			mPositions.resize(vertexCount);
+			for (size_t v = 0; v < vertexCount; ++v) {
+				memcpy(&mPositions[v], vertices + v * vertexStride, sizeof(Vector3));
+			}
+			FindSeams();
+			BuildQuadrics();
+		}
+
+		float Run(size_t targetIndexCount, float targetError)
+		{
+			const float maxCost = targetError < FLT_MAX ? targetError * targetError : FLT_MAX;
+			const size_t targetTriangles = targetIndexCount / 3;
+			float error = 0.0f;
+
+			while (mIndices.size() / 3 > targetTriangles) {
+				size_t triangles = mIndices.size() / 3;
+				float passError = 0.0f;
+				if (CollapsePass(triangles - targetTriangles, maxCost, passError) == 0) {
+					break;
+				}
+				error = std::max(error, passError);
+				RemoveDegenerates();
+			}
+			return sqrtf(error);
+		}
+
+		const std::vector<uint32_t>& Indices() const { return mIndices; }
+
+	private:
+		void FindSeams()
+		{
+			//Vertices sharing a position are attribute seams, sorted to find them.
+			std::vector<uint32_t> order(mVertexCount);
+			for (uint32_t v = 0; v < (uint32_t)mVertexCount; ++v) {
+				order[v] = v;
+			}
+			auto less = [this](uint32_t a, uint32_t b) {
+				const Vector3& pa = mPositions[a];
+				const Vector3& pb = mPositions[b];
+				if (pa.X != pb.X) return pa.X < pb.X;
+				if (pa.Y != pb.Y) return pa.Y < pb.Y;
+				if (pa.Z != pb.Z) return pa.Z < pb.Z;
+				return a < b;
+			};
+			std::sort(order.begin(), order.end(), less);
+
+			mLocked.assign(mVertexCount, 0);
+			for (size_t i = 1; i < order.size(); ++i) {
+				const Vector3& a = mPositions[order[i - 1]];
+				const Vector3& b = mPositions[order[i]];
+				if (a.X == b.X && a.Y == b.Y && a.Z == b.Z) {
+					mLocked[order[i - 1]] = 1;
+					mLocked[order[i]] = 1;
+				}
+			}
+		}
+
+		void BuildQuadrics()
+		{
+			mQuadrics.assign(mVertexCount, Quadric());
+			for (size_t t = 0; t < mIndices.size(); t += 3) {
+				const Vector3& p0 = mPositions[mIndices[t + 0]];
+				const Vector3& p1 = mPositions[mIndices[t + 1]];
+				const Vector3& p2 = mPositions[mIndices[t + 2]];
+				Vector3 n = Cross(p1 - p0, p2 - p0);
+				float length = sqrtf(Dot(n, n));
+				if (length == 0.0f) {
+					continue;
+				}
+				n = { n.X / length, n.Y / length, n.Z / length };
+				//Area weighted, so small triangles matter less.
+				float weight = 0.5f * length;
+				float d = -Dot(n, p0);
+				for (int k = 0; k < 3; ++k) {
+					mQuadrics[mIndices[t + k]].AddPlane(n, d, weight);
+				}
+			}
+
+			//Border edges get a plane through the edge, perpendicular to the triangle.
+			std::vector<uint64_t> edges = DirectedEdges();
+			for (size_t t = 0; t < mIndices.size(); t += 3) {
+				for (int k = 0; k < 3; ++k) {
+					uint32_t a = mIndices[t + k];
+					uint32_t b = mIndices[t + (k + 1) % 3];
+					if (std::binary_search(edges.begin(), edges.end(), EdgeKey(b, a))) {
+						continue;
+					}
+					const Vector3& pa = mPositions[a];
+					const Vector3& pb = mPositions[b];
+					const Vector3& pc = mPositions[mIndices[t + (k + 2) % 3]];
+					Vector3 edge = pb - pa;
+					Vector3 normal = Cross(edge, pc - pa);
+					Vector3 n = Cross(edge, normal);
+					float length = sqrtf(Dot(n, n));
+					if (length == 0.0f) {
+						continue;
+					}
+					n = { n.X / length, n.Y / length, n.Z / length };
+					float weight = BorderWeight * Dot(edge, edge);
+					float d = -Dot(n, pa);
+					mQuadrics[a].AddPlane(n, d, weight);
+					mQuadrics[b].AddPlane(n, d, weight);
+				}
+			}
+		}
+
+		std::vector<uint64_t> DirectedEdges() const
+		{
+			std::vector<uint64_t> edges;
+			edges.reserve(mIndices.size());
+			for (size_t t = 0; t < mIndices.size(); t += 3) {
+				for (int k = 0; k < 3; ++k) {
+					edges.push_back(EdgeKey(mIndices[t + k], mIndices[t + (k + 1) % 3]));
+				}
+			}
+			std::sort(edges.begin(), edges.end());
+			return edges;
+		}
+
+		//Collapsing from into to must not turn any remaining triangle around.
+		bool FlipsTriangle(uint32_t from, uint32_t to) const
+		{
+			const Vector3& target = mPositions[to];
+			for (uint32_t i = mAdjacency.Offsets[from]; i < mAdjacency.Offsets[from + 1]; ++i) {
+				const uint32_t* tri = &mIndices[3 * mAdjacency.Triangles[i]];
+				if (tri[0] == to || tri[1] == to || tri[2] == to) {
+					continue;
+				}
+				int k = tri[0] == from ? 0 : (tri[1] == from ? 1 : 2);
+				const Vector3& p1 = mPositions[tri[(k + 1) % 3]];
+				const Vector3& p2 = mPositions[tri[(k + 2) % 3]];
+				Vector3 before = Cross(p1 - mPositions[from], p2 - mPositions[from]);
+				Vector3 after = Cross(p1 - target, p2 - target);
+				float lengths = sqrtf(Dot(before, before) * Dot(after, after));
+				if (Dot(before, after) <= MinNormalCosine * lengths) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		size_t CollapsePass(size_t trianglesToRemove, float maxCost, float& passError)
+		{
+			mAdjacency.Build(mIndices, mVertexCount);
+
+			//Unique undirected edges; border edges are used in one direction only.
+			std::vector<uint64_t> directed = DirectedEdges();
+			std::vector<uint64_t> edges;
+			edges.reserve(directed.size());
+			for (uint64_t key : directed) {
+				uint32_t a = (uint32_t)(key >> 32);
+				uint32_t b = (uint32_t)key;
+				edges.push_back(EdgeKey(std::min(a, b), std::max(a, b)));
+			}
+			std::sort(edges.begin(), edges.end());
+			edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+			std::vector<uint8_t> border(mVertexCount, 0);
+			std::vector<uint8_t> borderEdge(edges.size(), 0);
+			for (size_t e = 0; e < edges.size(); ++e) {
+				uint32_t a = (uint32_t)(edges[e] >> 32);
+				uint32_t b = (uint32_t)edges[e];
+				if (!std::binary_search(directed.begin(), directed.end(), EdgeKey(a, b)) ||
+					!std::binary_search(directed.begin(), directed.end(), EdgeKey(b, a))) {
+					borderEdge[e] = 1;
+					border[a] = border[b] = 1;
+				}
+			}
+
+			//Cheapest allowed direction of every edge, evaluated in parallel.
+			std::vector<Collapse> collapses(edges.size());
+			ParallelFor(0, edges.size(), 1024, [&](size_t begin, size_t end) {
+				for (size_t e = begin; e < end; ++e) {
+					uint32_t a = (uint32_t)(edges[e] >> 32);
+					uint32_t b = (uint32_t)edges[e];
+					Quadric q = mQuadrics[a];
+					q.Add(mQuadrics[b]);
+					Collapse best = { FLT_MAX, a, b, false };
+					const uint32_t directions[2][2] = { { a, b }, { b, a } };
+					for (const auto& direction : directions) {
+						uint32_t from = direction[0];
+						//Border vertices only slide along the border.
+						if (mLocked[from] || (border[from] && !borderEdge[e])) {
+							continue;
+						}
+						float cost = q.Error(mPositions[direction[1]]);
+						if (!best.Valid || cost < best.Cost) {
+							best = { cost, from, direction[1], true };
+						}
+					}
+					collapses[e] = best;
+				}
+			});
+			//Edges neither of whose vertices may move stay as they are, whatever maxCost allows.
+			collapses.erase(std::remove_if(collapses.begin(), collapses.end(),
+				[](const Collapse& c) { return !c.Valid; }), collapses.end());
+			std::sort(collapses.begin(), collapses.end());
+
+			//A collapse changes the triangles around its vertex, so the rings of
+			//applied collapses are not touched again in this pass.
+			std::vector<uint8_t> touched(mVertexCount, 0);
+			mRemap.resize(mVertexCount);
+			for (uint32_t v = 0; v < (uint32_t)mVertexCount; ++v) {
+				mRemap[v] = v;
+			}
+
+			size_t applied = 0;
+			size_t removed = 0;
+			for (const Collapse& c : collapses) {
+				if (c.Cost > maxCost || removed >= trianglesToRemove) {
+					break;
+				}
+				if (touched[c.From] || touched[c.To] || FlipsTriangle(c.From, c.To)) {
+					continue;
+				}
+				for (uint32_t i = mAdjacency.Offsets[c.From]; i < mAdjacency.Offsets[c.From + 1]; ++i) {
+					const uint32_t* tri = &mIndices[3 * mAdjacency.Triangles[i]];
+					touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+					removed += (tri[0] == c.To || tri[1] == c.To || tri[2] == c.To) ? 1 : 0;
+				}
+				mRemap[c.From] = c.To;
+				mQuadrics[c.To].Add(mQuadrics[c.From]);
+				passError = std::max(passError, c.Cost);
+				++applied;
+			}
+			return applied;
+		}
+
+		void RemoveDegenerates()
+		{
+			size_t write = 0;
+			for (size_t t = 0; t < mIndices.size(); t += 3) {
+				uint32_t a = mRemap[mIndices[t + 0]];
+				uint32_t b = mRemap[mIndices[t + 1]];
+				uint32_t c = mRemap[mIndices[t + 2]];
+				if (a != b && b != c && c != a) {
+					mIndices[write++] = a;
+					mIndices[write++] = b;
+					mIndices[write++] = c;
+				}
+			}
+			mIndices.resize(write);
+		}
+
+		static constexpr float BorderWeight = 10.0f;
+		//Cosine of the largest rotation a collapse may cause to a triangle normal.
+		static constexpr float MinNormalCosine = 0.25f;
+
+		std::vector<uint32_t> mIndices;
+		size_t mVertexCount;
+		std::vector<Vector3> mPositions;
+		std::vector<Quadric> mQuadrics;
+		std::vector<uint8_t> mLocked;
+		std::vector<uint32_t> mRemap;
+		Adjacency mAdjacency;
+	};
+}
+
+size_t SimplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+	const uint8_t* vertices, size_t vertexStride, size_t vertexCount,
+	size_t targetIndexCount, float targetError, float* resultError)
+{
+	Simplifier simplifier(indices, indexCount, vertices, vertexStride, vertexCount);
+	float error = simplifier.Run(targetIndexCount, targetError);
+	const std::vector<uint32_t>& result = simplifier.Indices();
+	std::copy(result.begin(), result.end(), destination);
+	if (resultError) {
+		*resultError = error;
+	}
+	return result.size();
+}
+
+LodChainStats GenerateLodChain(MeshData& mesh, const LodChainOptions& options)
+{
+	assert(mesh.Format.Position == PositionFormat::Float3);
+	const size_t vertexCount = mesh.VertexCount();
+	const std::vector<MeshPart> parts = mesh.Parts;
+	const uint32_t levels = options.MaxLevels;
+
+	//Every level of every part is simplified from the full detail part, so
+	//all of them run in parallel and the order of completion does not matter.
+	struct Level
+	{
+		std::vector<uint32_t> Indices;
+		float Error = 0.0f;
+	};
+	std::vector<Level> results(parts.size() * levels);
+	ParallelFor(0, results.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t task = begin; task < end; ++task) {
+			const MeshPart& part = parts[task / levels];
+			uint32_t level = (uint32_t)(task % levels) + 1;
+
+			std::vector<uint32_t> source(part.IndexCount);
+			for (uint32_t i = 0; i < part.IndexCount; ++i) {
+				source[i] = mesh.Indices[part.IndexStart + i] + part.BaseVertex;
+			}
+			size_t targetTriangles = (size_t)(part.IndexCount / 3 * powf(options.Ratio, (float)level));
+
+			Level& result = results[task];
+			result.Indices.resize(source.size());
+			size_t count = SimplifyMesh(result.Indices.data(), source.data(), source.size(),
+				mesh.Vertices.data(), mesh.VertexStride, vertexCount, 3 * targetTriangles,
+				options.MaxError, &result.Error);
+			result.Indices.resize(count);
+			for (uint32_t& index : result.Indices) {
+				index -= part.BaseVertex;
+			}
+		}
+	});
+
+	LodChainStats stats;
+	stats.LevelTriangles.assign(levels + 1, 0);
+	stats.LevelErrors.assign(levels + 1, 0.0f);
+	mesh.Parts.clear();
+	for (size_t p = 0; p < parts.size(); ++p) {
+		mesh.Parts.push_back(parts[p]);
+		stats.LevelTriangles[0] += parts[p].IndexCount / 3;
+
+		size_t previousCount = parts[p].IndexCount;
+		float previousError = 0.0f;
+		for (uint32_t level = 1; level <= levels; ++level) {
+			Level& result = results[p * levels + level - 1];
+			if (result.Indices.empty() || result.Indices.size() > options.MinReduction * previousCount) {
+				break;
+			}
+
+			MeshPart lod;
+			lod.Name = parts[p].Name + "_lod" + std::to_string(level);
+			lod.IndexStart = (uint32_t)mesh.Indices.size();
+			lod.IndexCount = (uint32_t)result.Indices.size();
+			lod.BaseVertex = parts[p].BaseVertex;
+			lod.Lod = level;
+			lod.LodError = std::max(previousError, result.Error);
+			mesh.Indices.insert(mesh.Indices.end(), result.Indices.begin(), result.Indices.end());
+			mesh.Parts.push_back(lod);
+
+			stats.LevelTriangles[level] += lod.IndexCount / 3;
+			stats.LevelErrors[level] = std::max(stats.LevelErrors[level], lod.LodError);
+			previousCount = lod.IndexCount;
+			previousError = lod.LodError;
+		}
+	}
+	return stats;
+}
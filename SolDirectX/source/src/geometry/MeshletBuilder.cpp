@@ -0,0 +1,352 @@
+#include "../../header/Geometry/MeshletBuilder.h"
+#include "../../header/Common/ParallelFor.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+	//Normals of a meshlet spreading past this cosine get no cone.
+	const float MinConeDot = 0.1f;
+	//Unemitted triangles searched when a meshlet has no neighbour left to grow into.
+	const uint32_t FallbackWindow = 64;
+	//Weight of the normal deviation against one additional vertex.
+	const float ConeWeight = 0.5f;
+
+	struct Vector3
+	{
+		float X, Y, Z;
+	};
+
+	Vector3 LoadPosition(const MeshData& mesh, uint32_t vertex)
+	{
+		const float* p = mesh.Position(vertex);
+		return { p[0], p[1], p[2] };
+	}
+
+	Vector3 TriangleNormal(const Vector3& a, const Vector3& b, const Vector3& c)
+	{
+		float ux = b.X - a.X, uy = b.Y - a.Y, uz = b.Z - a.Z;
+		float vx = c.X - a.X, vy = c.Y - a.Y, vz = c.Z - a.Z;
+		Vector3 n = { uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx };
+		float length = sqrtf(n.X * n.X + n.Y * n.Y + n.Z * n.Z);
+		if (length == 0.0f) {
+			return { 0.0f, 0.0f, 0.0f };
+		}
+		return { n.X / length, n.Y / length, n.Z / length };
+	}
+
+	//Meshlets of one block of triangles, with block relative offsets.
+	struct BlockResult
+	{
+		std::vector<Meshlet> Meshlets;
+		std::vector<uint32_t> Vertices;
+		std::vector<uint8_t> Triangles;
+		std::vector<uint32_t> Indices;
+	};
+
+	class BlockBuilder
+	{
+	public:
+		BlockBuilder(const MeshData& mesh, const MeshPart& part, uint32_t firstTriangle, uint32_t triangleCount,
+			const MeshletOptions& options)
+			: mMesh(mesh), mOptions(options), mTriangleCount(triangleCount)
+		{
+			mIndices = mesh.Indices.data() + part.IndexStart + 3 * firstTriangle;
+			mBaseVertex = part.BaseVertex;
+
+			//Dense ids for the vertices of the block.
+			mUniqueVertices.assign(mIndices, mIndices + 3 * triangleCount);
+			std::sort(mUniqueVertices.begin(), mUniqueVertices.end());
+			mUniqueVertices.erase(std::unique(mUniqueVertices.begin(), mUniqueVertices.end()), mUniqueVertices.end());
+			mDense.resize(3 * triangleCount);
+			for (uint32_t i = 0; i < 3 * triangleCount; ++i) {
+				mDense[i] = (uint32_t)(std::lower_bound(mUniqueVertices.begin(), mUniqueVertices.end(), mIndices[i]) -
+					mUniqueVertices.begin());
+			}
+
+			const size_t vertexCount = mUniqueVertices.size();
+			mAdjacencyOffsets.assign(vertexCount + 1, 0);
+			for (uint32_t v : mDense) {
+				mAdjacencyOffsets[v + 1]++;
+			}
+			for (size_t v = 0; v < vertexCount; ++v) {
+				mAdjacencyOffsets[v + 1] += mAdjacencyOffsets[v];
+			}
+			mAdjacency.resize(mDense.size());
+			std::vector<uint32_t> cursor(mAdjacencyOffsets.begin(), mAdjacencyOffsets.end() - 1);
+			for (uint32_t i = 0; i < (uint32_t)mDense.size(); ++i) {
+				mAdjacency[cursor[mDense[i]]++] = i / 3;
+			}
+
+			mNormals.resize(triangleCount);
+			mCentroids.resize(triangleCount);
+			for (uint32_t t = 0; t < triangleCount; ++t) {
+				Vector3 a = Position(3 * t), b = Position(3 * t + 1), c = Position(3 * t + 2);
+				mNormals[t] = TriangleNormal(a, b, c);
+				mCentroids[t] = { (a.X + b.X + c.X) / 3.0f, (a.Y + b.Y + c.Y) / 3.0f, (a.Z + b.Z + c.Z) / 3.0f };
+			}
+			mLocalSlot.assign(vertexCount, UINT32_MAX);
+			mEmitted.assign(triangleCount, 0);
+		}
+
+		void Build(BlockResult& result)
+		{
+			uint32_t seedCursor = 0;
+			while (true) {
+				while (seedCursor < mTriangleCount && mEmitted[seedCursor]) {
+					++seedCursor;
+				}
+				if (seedCursor == mTriangleCount) {
+					break;
+				}
+				BuildMeshlet(seedCursor, result);
+			}
+		}
+
+	private:
+		Vector3 Position(uint32_t corner) const
+		{
+			return LoadPosition(mMesh, mIndices[corner] + mBaseVertex);
+		}
+
+		uint32_t NewVertexCount(uint32_t triangle) const
+		{
+			uint32_t count = 0;
+			for (int k = 0; k < 3; ++k) {
+				count += mLocalSlot[mDense[3 * triangle + k]] == UINT32_MAX ? 1 : 0;
+			}
+			return count;
+		}
+
+		//Closest unemitted triangle among the next ones in triangle order, which
+		//are close in space as well; picks up fragments left between meshlets.
+		uint32_t NearbyTriangle(uint32_t seedCursor, const Vector3& center) const
+		{
+			uint32_t best = UINT32_MAX;
+			float bestDistance = FLT_MAX;
+			uint32_t scanned = 0;
+			for (uint32_t t = seedCursor; t < mTriangleCount && scanned < FallbackWindow; ++t) {
+				if (mEmitted[t]) {
+					continue;
+				}
+				++scanned;
+				if (mMeshletVertices.size() + NewVertexCount(t) > mOptions.MaxVertices) {
+					continue;
+				}
+				const Vector3& c = mCentroids[t];
+				float dx = c.X - center.X, dy = c.Y - center.Y, dz = c.Z - center.Z;
+				float distance = dx * dx + dy * dy + dz * dz;
+				if (distance < bestDistance) {
+					bestDistance = distance;
+					best = t;
+				}
+			}
+			return best;
+		}
+
+		void BuildMeshlet(uint32_t seed, BlockResult& result)
+		{
+			Meshlet meshlet;
+			meshlet.IndexStart = (uint32_t)result.Indices.size();
+			meshlet.VertexStart = (uint32_t)result.Vertices.size();
+			meshlet.TriangleStart = (uint32_t)result.Triangles.size();
+			mMeshletVertices.clear();
+			mMeshletTriangles.clear();
+			Vector3 normalSum = { 0.0f, 0.0f, 0.0f };
+			Vector3 centroidSum = { 0.0f, 0.0f, 0.0f };
+
+			uint32_t triangle = seed;
+			while (triangle != UINT32_MAX) {
+				//Add the triangle.
+				mEmitted[triangle] = 1;
+				mMeshletTriangles.push_back(triangle);
+				for (int k = 0; k < 3; ++k) {
+					uint32_t v = mDense[3 * triangle + k];
+					if (mLocalSlot[v] == UINT32_MAX) {
+						mLocalSlot[v] = (uint32_t)mMeshletVertices.size();
+						mMeshletVertices.push_back(v);
+						result.Vertices.push_back(mUniqueVertices[v]);
+					}
+					result.Triangles.push_back((uint8_t)mLocalSlot[v]);
+					result.Indices.push_back(mIndices[3 * triangle + k]);
+				}
+				const Vector3& n = mNormals[triangle];
+				normalSum = { normalSum.X + n.X, normalSum.Y + n.Y, normalSum.Z + n.Z };
+				const Vector3& c = mCentroids[triangle];
+				centroidSum = { centroidSum.X + c.X, centroidSum.Y + c.Y, centroidSum.Z + c.Z };
+				meshlet.TriangleCount++;
+				if (meshlet.TriangleCount == mOptions.MaxTriangles) {
+					break;
+				}
+
+				//Next: the adjacent triangle adding the fewest vertices, then the one
+				//keeping the meshlet round and its normals together; ties go to the
+				//earlier triangle.
+				float length = sqrtf(normalSum.X * normalSum.X + normalSum.Y * normalSum.Y + normalSum.Z * normalSum.Z);
+				Vector3 axis = length > 0.0f ? Vector3{ normalSum.X / length, normalSum.Y / length, normalSum.Z / length }
+					: Vector3{ 0.0f, 0.0f, 0.0f };
+				float inverseCount = 1.0f / meshlet.TriangleCount;
+				Vector3 center = { centroidSum.X * inverseCount, centroidSum.Y * inverseCount, centroidSum.Z * inverseCount };
+				float bestScore = FLT_MAX;
+				float bestDistance = FLT_MAX;
+				triangle = UINT32_MAX;
+				for (uint32_t v : mMeshletVertices) {
+					for (uint32_t i = mAdjacencyOffsets[v]; i < mAdjacencyOffsets[v + 1]; ++i) {
+						uint32_t candidate = mAdjacency[i];
+						if (mEmitted[candidate]) {
+							continue;
+						}
+						uint32_t newVertices = NewVertexCount(candidate);
+						if (mMeshletVertices.size() + newVertices > mOptions.MaxVertices) {
+							continue;
+						}
+						const Vector3& cn = mNormals[candidate];
+						const Vector3& cc = mCentroids[candidate];
+						float dx = cc.X - center.X, dy = cc.Y - center.Y, dz = cc.Z - center.Z;
+						float distance = dx * dx + dy * dy + dz * dz;
+						float score = (float)newVertices + ConeWeight * (1.0f - (cn.X * axis.X + cn.Y * axis.Y + cn.Z * axis.Z));
+						if (score < bestScore || (score == bestScore && (distance < bestDistance ||
+							(distance == bestDistance && candidate < triangle)))) {
+							bestScore = score;
+							bestDistance = distance;
+							triangle = candidate;
+						}
+					}
+				}
+				if (triangle == UINT32_MAX) {
+					triangle = NearbyTriangle(seed, center);
+				}
+			}
+
+			meshlet.VertexCount = (uint32_t)mMeshletVertices.size();
+			ComputeBounds(meshlet);
+			for (uint32_t v : mMeshletVertices) {
+				mLocalSlot[v] = UINT32_MAX;
+			}
+			result.Meshlets.push_back(meshlet);
+		}
+
+		void ComputeBounds(Meshlet& meshlet) const
+		{
+			Vector3 boundsMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+			Vector3 boundsMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (uint32_t v : mMeshletVertices) {
+				Vector3 p = LoadPosition(mMesh, mUniqueVertices[v] + mBaseVertex);
+				boundsMin = { std::min(boundsMin.X, p.X), std::min(boundsMin.Y, p.Y), std::min(boundsMin.Z, p.Z) };
+				boundsMax = { std::max(boundsMax.X, p.X), std::max(boundsMax.Y, p.Y), std::max(boundsMax.Z, p.Z) };
+			}
+			Vector3 center = { 0.5f * (boundsMin.X + boundsMax.X), 0.5f * (boundsMin.Y + boundsMax.Y),
+				0.5f * (boundsMin.Z + boundsMax.Z) };
+			float radiusSq = 0.0f;
+			for (uint32_t v : mMeshletVertices) {
+				Vector3 p = LoadPosition(mMesh, mUniqueVertices[v] + mBaseVertex);
+				float dx = p.X - center.X, dy = p.Y - center.Y, dz = p.Z - center.Z;
+				radiusSq = std::max(radiusSq, dx * dx + dy * dy + dz * dz);
+			}
+			meshlet.Center[0] = center.X;
+			meshlet.Center[1] = center.Y;
+			meshlet.Center[2] = center.Z;
+			meshlet.Radius = sqrtf(radiusSq);
+
+			//Cone around the average normal, opened to the widest triangle normal.
+			Vector3 sum = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t t : mMeshletTriangles) {
+				const Vector3& n = mNormals[t];
+				sum = { sum.X + n.X, sum.Y + n.Y, sum.Z + n.Z };
+			}
+			float length = sqrtf(sum.X * sum.X + sum.Y * sum.Y + sum.Z * sum.Z);
+			if (length == 0.0f) {
+				return;
+			}
+			Vector3 axis = { sum.X / length, sum.Y / length, sum.Z / length };
+			float minDot = 1.0f;
+			for (uint32_t t : mMeshletTriangles) {
+				const Vector3& n = mNormals[t];
+				if (n.X == 0.0f && n.Y == 0.0f && n.Z == 0.0f) {
+					continue;
+				}
+				minDot = std::min(minDot, n.X * axis.X + n.Y * axis.Y + n.Z * axis.Z);
+			}
+			meshlet.ConeAxis[0] = axis.X;
+			meshlet.ConeAxis[1] = axis.Y;
+			meshlet.ConeAxis[2] = axis.Z;
+			//The test needs the sine of the half angle.
+			meshlet.ConeCutoff = minDot < MinConeDot ? 1.0f : sqrtf(1.0f - minDot * minDot);
+		}
+
+		const MeshData& mMesh;
+		const MeshletOptions& mOptions;
+		const uint32_t* mIndices;
+		int32_t mBaseVertex;
+		uint32_t mTriangleCount;
+
+		std::vector<uint32_t> mUniqueVertices;
+		std::vector<uint32_t> mDense;
+		std::vector<uint32_t> mAdjacencyOffsets;
+		std::vector<uint32_t> mAdjacency;
+		std::vector<Vector3> mNormals;
+		std::vector<Vector3> mCentroids;
+		std::vector<uint32_t> mLocalSlot;
+		std::vector<uint8_t> mEmitted;
+		std::vector<uint32_t> mMeshletVertices;
+		std::vector<uint32_t> mMeshletTriangles;
+	};
+}
+
+void BuildMeshlets(MeshData& mesh, const MeshletOptions& options)
+{
+	assert(options.MaxVertices <= 256 && options.MaxTriangles >= 1);
+	mesh.Meshlets.clear();
+	mesh.MeshletVertices.clear();
+	mesh.MeshletTriangles.clear();
+
+	//One task per block of every part; results are spliced in task order.
+	struct Task
+	{
+		uint32_t Part;
+		uint32_t FirstTriangle;
+		uint32_t TriangleCount;
+	};
+	std::vector<Task> tasks;
+	for (uint32_t p = 0; p < (uint32_t)mesh.Parts.size(); ++p) {
+		const uint32_t triangles = mesh.Parts[p].IndexCount / 3;
+		for (uint32_t first = 0; first < triangles; first += options.BlockTriangles) {
+			tasks.push_back({ p, first, std::min(options.BlockTriangles, triangles - first) });
+		}
+	}
+
+	std::vector<BlockResult> results(tasks.size());
+	ParallelFor(0, tasks.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const Task& task = tasks[i];
+			BlockBuilder builder(mesh, mesh.Parts[task.Part], task.FirstTriangle, task.TriangleCount, options);
+			builder.Build(results[i]);
+		}
+	});
+
+	for (MeshPart& part : mesh.Parts) {
+		part.MeshletStart = 0;
+		part.MeshletCount = 0;
+	}
+	for (size_t i = 0; i < tasks.size(); ++i) {
+		const Task& task = tasks[i];
+		MeshPart& part = mesh.Parts[task.Part];
+		BlockResult& result = results[i];
+		if (part.MeshletCount == 0) {
+			part.MeshletStart = (uint32_t)mesh.Meshlets.size();
+		}
+
+		const uint32_t indexBase = 3 * task.FirstTriangle;
+		for (Meshlet meshlet : result.Meshlets) {
+			meshlet.IndexStart += indexBase;
+			meshlet.VertexStart += (uint32_t)mesh.MeshletVertices.size();
+			meshlet.TriangleStart += (uint32_t)mesh.MeshletTriangles.size();
+			mesh.Meshlets.push_back(meshlet);
+		}
+		part.MeshletCount += (uint32_t)result.Meshlets.size();
+
+		mesh.MeshletVertices.insert(mesh.MeshletVertices.end(), result.Vertices.begin(), result.Vertices.end());
+		mesh.MeshletTriangles.insert(mesh.MeshletTriangles.end(), result.Triangles.begin(), result.Triangles.end());
+		std::copy(result.Indices.begin(), result.Indices.end(), mesh.Indices.begin() + part.IndexStart + indexBase);
+	}
+}
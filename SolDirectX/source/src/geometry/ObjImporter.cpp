@@ -0,0 +1,472 @@
+#include "../../header/Geometry/MeshImporter.h"
+#include "../../header/Geometry/MeshOptimizer.h"
+#include "../../header/Common/MappedFile.h"
+#include "../../header/Common/ParallelFor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	using Clock = std::chrono::high_resolution_clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool Fail(std::string* error, const std::string& message)
+	{
+		if (error != nullptr) {
+			*error = message;
+		}
+		return false;
+	}
+
+	const int64_t NoIndex = INT64_MIN;
+
+	struct ObjGroup
+	{
+		std::string Name;
+		//Local to the chunk until the chunks are joined.
+		size_t FirstTriangle;
+	};
+
+	struct ObjChunk
+	{
+		const char* Begin = nullptr;
+		const char* End = nullptr;
+
+		std::vector<float> Positions;
+		//rgb of every position, white where the file has none.
+		std::vector<float> Colors;
+		std::vector<float> Normals;
+		bool HasColors = false;
+		bool HasNormals = false;
+
+		//0-based references of every triangle corner. Negative (relative) OBJ
+		//indices are resolved against the counts local to the chunk and listed,
+		//so that the base of the chunk can be added once it is known.
+		std::vector<int64_t> CornerPositions;
+		std::vector<int64_t> CornerNormals;
+		std::vector<uint32_t> RelativePositions;
+		std::vector<uint32_t> RelativeNormals;
+
+		std::vector<ObjGroup> Groups;
+		const char* ErrorAt = nullptr;
+	};
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	void SkipSpaces(const char*& p, const char* end)
+	{
+		while (p < end && IsSpace(*p)) {
+			++p;
+		}
+	}
+
+	double Pow10(int exponent)
+	{
+		//Exact up to 1e22, which covers every realistic mantissa/exponent pair.
+		static const double table[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		if (exponent >= 0 && exponent <= 22) {
+			return table[exponent];
+		}
+		if (exponent < 0 && exponent >= -22) {
+			return 1.0 / table[-exponent];
+		}
+		return pow(10.0, exponent);
+	}
+
+	//Decimal float without locale lookups. The mantissa keeps 19 digits and
+	//is scaled in double precision, far below float rounding.
+	bool ParseFloat(const char*& p, const char* end, float& value)
+	{
+		SkipSpaces(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			++p;
+		}
+
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		int digits = 0;
+		bool any = false;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+			any = true;
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+				digits += mantissa != 0;
+			}
+			else {
+				++exponent;
+			}
+		}
+		if (p < end && *p == '.') {
+			for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+				any = true;
+				if (digits < 19) {
+					mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+					digits += mantissa != 0;
+					--exponent;
+				}
+			}
+		}
+		if (!any) {
+			return false;
+		}
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			++p;
+			bool negativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				negativeExponent = *p == '-';
+				++p;
+			}
+			int e = 0;
+			for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+				e = std::min(e * 10 + (*p - '0'), 10000);
+			}
+			exponent += negativeExponent ? -e : e;
+		}
+
+		double result = (double)mantissa * Pow10(exponent);
+		value = (float)(negative ? -result : result);
+		return true;
+	}
+
+	bool ParseIndex(const char*& p, const char* end, int64_t& value)
+	{
+		bool negative = false;
+		if (p < end && *p == '-') {
+			negative = true;
+			++p;
+		}
+		if (p == end || *p < '0' || *p > '9') {
+			return false;
+		}
+		int64_t result = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+			result = std::min<int64_t>(result * 10 + (*p - '0'), INT32_MAX);
+		}
+		value = negative ? -result : result;
+		return true;
+	}
+
+	//One corner reference of a face, resolved as far as the chunk allows.
+	bool ResolveIndex(int64_t index, size_t localCount, uint32_t corner, int64_t& resolved,
+		std::vector<uint32_t>& relative)
+	{
+		if (index > 0) {
+			resolved = index - 1;
+			return true;
+		}
+		if (index < 0) {
+			resolved = (int64_t)localCount + index;
+			relative.push_back(corner);
+			return true;
+		}
+		return false;
+	}
+
+	void ParseChunk(ObjChunk& chunk)
+	{
+		struct Corner
+		{
+			int64_t Position;
+			int64_t Normal;
+		};
+		std::vector<Corner> polygon;
+
+		const char* end = chunk.End;
+		for (const char* line = chunk.Begin; line < end;) {
+			const char* lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+			lineEnd = lineEnd != nullptr ? lineEnd : end;
+			const char* p = line;
+			const char* next = lineEnd + (lineEnd < end ? 1 : 0);
+			SkipSpaces(p, lineEnd);
+
+			if (lineEnd - p >= 2 && p[0] == 'v' && IsSpace(p[1])) {
+				p += 2;
+				float v[6];
+				if (!ParseFloat(p, lineEnd, v[0]) || !ParseFloat(p, lineEnd, v[1]) || !ParseFloat(p, lineEnd, v[2])) {
+					chunk.ErrorAt = line;
+					return;
+				}
+				chunk.Positions.insert(chunk.Positions.end(), v, v + 3);
+				//Vertex colors are an extension: three more numbers after the position.
+				const char* color = p;
+				if (ParseFloat(color, lineEnd, v[3]) && ParseFloat(color, lineEnd, v[4]) && ParseFloat(color, lineEnd, v[5])) {
+					chunk.Colors.insert(chunk.Colors.end(), v + 3, v + 6);
+					chunk.HasColors = true;
+				}
+				else {
+					chunk.Colors.insert(chunk.Colors.end(), { 1.0f, 1.0f, 1.0f });
+				}
+			}
+			else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n' && IsSpace(p[2])) {
+				p += 3;
+				float n[3];
+				if (!ParseFloat(p, lineEnd, n[0]) || !ParseFloat(p, lineEnd, n[1]) || !ParseFloat(p, lineEnd, n[2])) {
+					chunk.ErrorAt = line;
+					return;
+				}
+				chunk.Normals.insert(chunk.Normals.end(), n, n + 3);
+			}
+			else if (lineEnd - p >= 2 && p[0] == 'f' && IsSpace(p[1])) {
+				p += 2;
+				polygon.clear();
+				for (;;) {
+					SkipSpaces(p, lineEnd);
+					if (p == lineEnd) {
+						break;
+					}
+					//v, v/vt, v//vn or v/vt/vn.
+					int64_t position, texcoord, normal = 0;
+					if (!ParseIndex(p, lineEnd, position)) {
+						chunk.ErrorAt = line;
+						return;
+					}
+					if (p < lineEnd && *p == '/') {
+						++p;
+						if (p < lineEnd && *p != '/' && !ParseIndex(p, lineEnd, texcoord)) {
+							chunk.ErrorAt = line;
+							return;
+						}
+						if (p < lineEnd && *p == '/') {
+							++p;
+							if (!ParseIndex(p, lineEnd, normal)) {
+								chunk.ErrorAt = line;
+								return;
+							}
+						}
+					}
+					polygon.push_back({ position, normal });
+				}
+				if (polygon.size() < 3) {
+					chunk.ErrorAt = line;
+					return;
+				}
+
+				//Fan the polygon around its first corner.
+				for (size_t k = 1; k + 1 < polygon.size(); ++k) {
+					const Corner* triangle[3] = { &polygon[0], &polygon[k], &polygon[k + 1] };
+					for (const Corner* corner : triangle) {
+						uint32_t cornerIndex = (uint32_t)chunk.CornerPositions.size();
+						int64_t position, normal = NoIndex;
+						if (!ResolveIndex(corner->Position, chunk.Positions.size() / 3, cornerIndex, position, chunk.RelativePositions) ||
+							(corner->Normal != 0 &&
+								!ResolveIndex(corner->Normal, chunk.Normals.size() / 3, cornerIndex, normal, chunk.RelativeNormals))) {
+							chunk.ErrorAt = line;
+							return;
+						}
+						chunk.CornerPositions.push_back(position);
+						chunk.CornerNormals.push_back(normal);
+						chunk.HasNormals |= normal != NoIndex;
+					}
+				}
+			}
+			else if (lineEnd - p >= 2 && (p[0] == 'o' || p[0] == 'g') && IsSpace(p[1])) {
+				p += 2;
+				SkipSpaces(p, lineEnd);
+				const char* nameEnd = lineEnd;
+				while (nameEnd > p && IsSpace(nameEnd[-1])) {
+					--nameEnd;
+				}
+				chunk.Groups.push_back({ std::string(p, nameEnd), chunk.CornerPositions.size() / 3 });
+			}
+			line = next;
+		}
+	}
+
+	std::string FileStem(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		size_t begin = slash == std::string::npos ? 0 : slash + 1;
+		size_t dot = path.find_last_of('.');
+		return path.substr(begin, dot != std::string::npos && dot > begin ? dot - begin : std::string::npos);
+	}
+}
+
+bool ImportObj(const std::string& path, MeshData& mesh, const MeshImportOptions& options,
+	MeshImportStats* stats, std::string* error)
+{
+	auto start = Clock::now();
+	std::shared_ptr<MappedFile> file = MappedFile::Open(path, error);
+	if (file == nullptr) {
+		return false;
+	}
+	const char* text = reinterpret_cast<const char*>(file->Data());
+	const char* textEnd = text + file->Size();
+
+	//Chunks end after a line break, so no line is split.
+	std::vector<ObjChunk> chunks;
+	for (const char* begin = text; begin < textEnd;) {
+		const char* end = begin + std::min<size_t>(std::max<size_t>(options.ChunkBytes, 1), textEnd - begin);
+		const char* lineEnd = static_cast<const char*>(memchr(end - 1, '\n', textEnd - (end - 1)));
+		end = lineEnd != nullptr ? lineEnd + 1 : textEnd;
+		chunks.emplace_back();
+		chunks.back().Begin = begin;
+		chunks.back().End = end;
+		begin = end;
+	}
+	ParallelFor(0, chunks.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; ++c) {
+			ParseChunk(chunks[c]);
+		}
+	});
+
+	//Offsets of every chunk in the joined arrays.
+	std::vector<size_t> positionBase(chunks.size() + 1, 0);
+	std::vector<size_t> normalBase(chunks.size() + 1, 0);
+	std::vector<size_t> cornerBase(chunks.size() + 1, 0);
+	bool hasColors = false, hasNormals = false;
+	for (size_t c = 0; c < chunks.size(); ++c) {
+		const ObjChunk& chunk = chunks[c];
+		if (chunk.ErrorAt != nullptr) {
+			return Fail(error, path + ": malformed line at byte " + std::to_string(chunk.ErrorAt - text));
+		}
+		positionBase[c + 1] = positionBase[c] + chunk.Positions.size() / 3;
+		normalBase[c + 1] = normalBase[c] + chunk.Normals.size() / 3;
+		cornerBase[c + 1] = cornerBase[c] + chunk.CornerPositions.size();
+		hasColors |= chunk.HasColors;
+		hasNormals |= chunk.HasNormals;
+	}
+	const size_t positionCount = positionBase.back();
+	const size_t normalCount = normalBase.back();
+	const size_t cornerCount = cornerBase.back();
+	if (cornerCount == 0) {
+		return Fail(error, path + ": no triangles");
+	}
+
+	std::vector<float> positions(3 * positionCount);
+	std::vector<float> colors(hasColors ? 3 * positionCount : 0);
+	std::vector<float> normals(3 * normalCount);
+	ParallelFor(0, chunks.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; ++c) {
+			ObjChunk& chunk = chunks[c];
+			std::copy(chunk.Positions.begin(), chunk.Positions.end(), positions.begin() + 3 * positionBase[c]);
+			if (hasColors) {
+				std::copy(chunk.Colors.begin(), chunk.Colors.end(), colors.begin() + 3 * positionBase[c]);
+			}
+			std::copy(chunk.Normals.begin(), chunk.Normals.end(), normals.begin() + 3 * normalBase[c]);
+			for (uint32_t corner : chunk.RelativePositions) {
+				chunk.CornerPositions[corner] += positionBase[c];
+			}
+			for (uint32_t corner : chunk.RelativeNormals) {
+				chunk.CornerNormals[corner] += normalBase[c];
+			}
+		}
+	});
+
+	//One vertex per corner, welded below. OBJ is right-handed with counter-
+	//clockwise front faces. Negating z makes it left-handed, but a mirror keeps
+	//the triangles counter-clockwise on screen, so the second and third corner
+	//of every triangle swap places as well to get the renderer's clockwise fronts.
+	mesh = MeshData();
+	mesh.Name = FileStem(path);
+	mesh.Format = { PositionFormat::Float3, hasNormals ? NormalFormat::Float3 : NormalFormat::None,
+		hasColors ? ColorFormat::Float4 : ColorFormat::None };
+	mesh.VertexStride = mesh.Format.Stride();
+	const size_t stride = mesh.VertexStride;
+	mesh.Vertices.resize(cornerCount * stride);
+	std::vector<uint8_t> rangeErrors(chunks.size(), 0);
+	ParallelFor(0, chunks.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; ++c) {
+			const ObjChunk& chunk = chunks[c];
+			for (size_t i = 0; i < chunk.CornerPositions.size(); ++i) {
+				const int64_t position = chunk.CornerPositions[i];
+				const int64_t normal = chunk.CornerNormals[i];
+				if (position < 0 || position >= (int64_t)positionCount ||
+					(normal != NoIndex && (normal < 0 || normal >= (int64_t)normalCount))) {
+					rangeErrors[c] = 1;
+					break;
+				}
+				float vertex[10];
+				const float* p = &positions[3 * position];
+				vertex[0] = p[0];
+				vertex[1] = p[1];
+				vertex[2] = -p[2];
+				float* attribute = vertex + 3;
+				if (hasNormals) {
+					if (normal != NoIndex) {
+						const float* n = &normals[3 * normal];
+						attribute[0] = n[0];
+						attribute[1] = n[1];
+						attribute[2] = -n[2];
+					}
+					else {
+						attribute[0] = 0.0f;
+						attribute[1] = 0.0f;
+						attribute[2] = 1.0f;
+					}
+					attribute += 3;
+				}
+				if (hasColors) {
+					memcpy(attribute, &colors[3 * position], 3 * sizeof(float));
+					attribute[3] = 1.0f;
+				}
+				const size_t slot = i - i % 3 + (3 - i % 3) % 3;
+				memcpy(mesh.Vertices.data() + (cornerBase[c] + slot) * stride, vertex, stride);
+			}
+		}
+	});
+	for (uint8_t rangeError : rangeErrors) {
+		if (rangeError) {
+			return Fail(error, path + ": face index out of range");
+		}
+	}
+	const double parseMilliseconds = MillisecondsSince(start);
+
+	//Parts start at every o/g; names are made unique because they key the DrawArgs.
+	std::vector<ObjGroup> groups(1, { mesh.Name, 0 });
+	for (size_t c = 0; c < chunks.size(); ++c) {
+		for (const ObjGroup& group : chunks[c].Groups) {
+			groups.push_back({ group.Name, cornerBase[c] / 3 + group.FirstTriangle });
+		}
+	}
+	for (size_t g = 0; g < groups.size(); ++g) {
+		const size_t firstTriangle = groups[g].FirstTriangle;
+		const size_t endTriangle = g + 1 < groups.size() ? groups[g + 1].FirstTriangle : cornerCount / 3;
+		if (endTriangle == firstTriangle) {
+			continue;
+		}
+		MeshPart part;
+		part.Name = groups[g].Name;
+		part.IndexStart = (uint32_t)(3 * firstTriangle);
+		part.IndexCount = (uint32_t)(3 * (endTriangle - firstTriangle));
+		mesh.Parts.push_back(part);
+	}
+	MakePartNamesUnique(mesh);
+
+	auto weldStart = Clock::now();
+	mesh.Indices.resize(cornerCount);
+	size_t vertexCount = cornerCount;
+	if (options.Weld) {
+		vertexCount = WeldVertices(mesh.Vertices.data(), stride, cornerCount, mesh.Indices.data());
+		mesh.Vertices.resize(vertexCount * stride);
+		mesh.Vertices.shrink_to_fit();
+	}
+	else {
+		for (size_t i = 0; i < cornerCount; ++i) {
+			mesh.Indices[i] = (uint32_t)i;
+		}
+	}
+
+	if (stats != nullptr) {
+		stats->FileBytes = file->Size();
+		stats->Triangles = cornerCount / 3;
+		stats->SourceVertices = cornerCount;
+		stats->Vertices = vertexCount;
+		stats->ParseMilliseconds = parseMilliseconds;
+		stats->WeldMilliseconds = MillisecondsSince(weldStart);
+		stats->Milliseconds = MillisecondsSince(start);
+	}
+	return true;
+}
@@ -0,0 +1,260 @@
+#include "../../header/Geometry/StaticMerger.h"
+#include "../../header/Common/ParallelFor.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+namespace {
+	//The vertices a part references, in first use order, and its indices
+	//rewritten against that list. Shared by every instance of the part.
+	struct SourcePart
+	{
+		const MeshData* Mesh = nullptr;
+		std::vector<uint32_t> Vertices;
+		std::vector<uint32_t> Indices;
+		float Center[3] = { 0.0f, 0.0f, 0.0f };
+	};
+
+	struct Placement
+	{
+		uint32_t Source = 0;
+		float Center[3] = { 0.0f, 0.0f, 0.0f };
+	};
+
+	struct Batch
+	{
+		//Range of the batch in the placement order.
+		uint32_t First = 0;
+		uint32_t Count = 0;
+		uint32_t VertexStart = 0;
+		uint32_t VertexCount = 0;
+		uint32_t IndexStart = 0;
+		uint32_t IndexCount = 0;
+	};
+
+	void BuildSourcePart(const MeshData& mesh, const MeshPart& part, SourcePart& source)
+	{
+		source.Mesh = &mesh;
+		std::vector<uint32_t> remap(mesh.VertexCount(), UINT32_MAX);
+		source.Indices.resize(part.IndexCount);
+		float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t i = 0; i < part.IndexCount; ++i) {
+			uint32_t vertex = mesh.Indices[part.IndexStart + i] + part.BaseVertex;
+			if (remap[vertex] == UINT32_MAX) {
+				remap[vertex] = (uint32_t)source.Vertices.size();
+				source.Vertices.push_back(vertex);
+
+				const float* p = mesh.Position(vertex);
+				for (int k = 0; k < 3; ++k) {
+					boundsMin[k] = std::min(boundsMin[k], p[k]);
+					boundsMax[k] = std::max(boundsMax[k], p[k]);
+				}
+			}
+			source.Indices[i] = remap[vertex];
+		}
+		for (int k = 0; k < 3 && part.IndexCount != 0; ++k) {
+			source.Center[k] = 0.5f * (boundsMin[k] + boundsMax[k]);
+		}
+	}
+
+	void TransformPoint(const float m[16], const float p[3], float out[3])
+	{
+		for (int k = 0; k < 3; ++k) {
+			out[k] = p[0] * m[k] + p[1] * m[4 + k] + p[2] * m[8 + k] + m[12 + k];
+		}
+	}
+
+	//Median cuts along the longest axis of the instance centers until the
+	//batch fits the limits. Ties are broken by index so the cut is stable.
+	void SplitBatches(const std::vector<Placement>& placements, const std::vector<SourcePart>& sources,
+		std::vector<uint32_t>& order, uint32_t first, uint32_t count, const StaticMergeOptions& options,
+		std::vector<Batch>& batches)
+	{
+		uint64_t triangles = 0;
+		uint64_t vertices = 0;
+		float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t i = first; i < first + count; ++i) {
+			const Placement& placement = placements[order[i]];
+			triangles += sources[placement.Source].Indices.size() / 3;
+			vertices += sources[placement.Source].Vertices.size();
+			for (int k = 0; k < 3; ++k) {
+				boundsMin[k] = std::min(boundsMin[k], placement.Center[k]);
+				boundsMax[k] = std::max(boundsMax[k], placement.Center[k]);
+			}
+		}
+
+		int axis = 0;
+		for (int k = 1; k < 3; ++k) {
+			if (boundsMax[k] - boundsMin[k] > boundsMax[axis] - boundsMin[axis]) {
+				axis = k;
+			}
+		}
+		const bool fits = triangles <= options.MaxBatchTriangles && vertices <= options.MaxBatchVertices &&
+			(options.MaxBatchExtent <= 0.0f || boundsMax[axis] - boundsMin[axis] <= options.MaxBatchExtent);
+		if (count == 1 || fits) {
+			Batch batch;
+			batch.First = first;
+			batch.Count = count;
+			batch.VertexCount = (uint32_t)vertices;
+			batch.IndexCount = (uint32_t)triangles * 3;
+			batches.push_back(batch);
+			return;
+		}
+
+		const uint32_t half = count / 2;
+		std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+			[&placements, axis](uint32_t a, uint32_t b) {
+				float ca = placements[a].Center[axis];
+				float cb = placements[b].Center[axis];
+				return ca < cb || (ca == cb && a < b);
+			});
+		SplitBatches(placements, sources, order, first, half, options, batches);
+		SplitBatches(placements, sources, order, first + half, count - half, options, batches);
+	}
+
+	//Appends the vertices and indices of one instance. Indices are relative
+	//to the start of the batch.
+	void WriteInstance(const SourcePart& source, const float world[16], uint32_t batchVertex,
+		uint8_t* vertices, uint32_t* indices)
+	{
+		const MeshData& mesh = *source.Mesh;
+		const uint32_t stride = mesh.VertexStride;
+		const bool hasNormal = mesh.Format.Normal == NormalFormat::Float3;
+		const uint32_t normalOffset = mesh.Format.NormalOffset();
+
+		//Normals go through the inverse transpose of the upper 3x3, which is
+		//the cofactor matrix up to a scale that renormalizing removes.
+		const float* m = world;
+		float cofactor[9] = {
+			m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10], m[4] * m[9] - m[5] * m[8],
+			m[2] * m[9] - m[1] * m[10], m[0] * m[10] - m[2] * m[8], m[1] * m[8] - m[0] * m[9],
+			m[1] * m[6] - m[2] * m[5], m[2] * m[4] - m[0] * m[6], m[0] * m[5] - m[1] * m[4],
+		};
+		const float det = m[0] * cofactor[0] + m[1] * cofactor[1] + m[2] * cofactor[2];
+
+		for (size_t v = 0; v < source.Vertices.size(); ++v) {
+			uint8_t* dst = vertices + v * stride;
+			const uint8_t* src = mesh.Vertices.data() + (size_t)source.Vertices[v] * stride;
+			memcpy(dst, src, stride);
+
+			float position[3];
+			TransformPoint(world, reinterpret_cast<const float*>(src), position);
+			memcpy(dst, position, sizeof(position));
+
+			if (hasNormal) {
+				float n[3];
+				memcpy(n, src + normalOffset, sizeof(n));
+				float t[3];
+				for (int k = 0; k < 3; ++k) {
+					t[k] = n[0] * cofactor[k] + n[1] * cofactor[3 + k] + n[2] * cofactor[6 + k];
+				}
+				float length = sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+				float scale = length > 0.0f ? (det < 0.0f ? -1.0f : 1.0f) / length : 0.0f;
+				for (int k = 0; k < 3; ++k) {
+					t[k] *= scale;
+				}
+				memcpy(dst + normalOffset, t, sizeof(t));
+			}
+		}
+
+		//镜像变换会把三角形翻成逆时针,交换两个顶点恢复顺时针
+		const bool mirrored = det < 0.0f;
+		for (size_t i = 0; i < source.Indices.size(); i += 3) {
+			indices[i] = source.Indices[i] + batchVertex;
+			indices[i + 1] = source.Indices[i + (mirrored ? 2 : 1)] + batchVertex;
+			indices[i + 2] = source.Indices[i + (mirrored ? 1 : 2)] + batchVertex;
+		}
+	}
+}
+
+StaticMergeStats MergeStaticMeshes(const StaticInstance* instances, size_t count, const StaticMergeOptions& options,
+	MeshData& result)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	result = MeshData();
+	result.Name = options.PartPrefix + "Geo";
+	StaticMergeStats stats;
+	stats.Instances = (uint32_t)count;
+	if (count == 0) {
+		return stats;
+	}
+	result.Format = instances[0].Mesh->Format;
+	result.VertexStride = instances[0].Mesh->VertexStride;
+	assert(result.Format.IsFloat() && "static meshes are merged before quantizing");
+
+	//Every distinct part is scanned once, however many instances it has.
+	std::vector<SourcePart> sources;
+	std::map<std::pair<const MeshData*, uint32_t>, uint32_t> sourceLookup;
+	std::vector<Placement> placements(count);
+	for (size_t i = 0; i < count; ++i) {
+		const StaticInstance& instance = instances[i];
+		assert(instance.Mesh->Format == result.Format && instance.Part < instance.Mesh->Parts.size());
+
+		auto key = std::make_pair(instance.Mesh, instance.Part);
+		auto it = sourceLookup.find(key);
+		if (it == sourceLookup.end()) {
+			it = sourceLookup.emplace(key, (uint32_t)sources.size()).first;
+			sources.emplace_back();
+			BuildSourcePart(*instance.Mesh, instance.Mesh->Parts[instance.Part], sources.back());
+		}
+		placements[i].Source = it->second;
+		TransformPoint(instance.World, sources[it->second].Center, placements[i].Center);
+	}
+
+	std::vector<uint32_t> order(count);
+	for (uint32_t i = 0; i < (uint32_t)count; ++i) {
+		order[i] = i;
+	}
+	std::vector<Batch> batches;
+	SplitBatches(placements, sources, order, 0, (uint32_t)count, options, batches);
+
+	//Batches are laid out one after another; every one is a part of its own.
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	result.Parts.resize(batches.size());
+	for (size_t b = 0; b < batches.size(); ++b) {
+		Batch& batch = batches[b];
+		batch.VertexStart = vertexCount;
+		batch.IndexStart = indexCount;
+		vertexCount += batch.VertexCount;
+		indexCount += batch.IndexCount;
+
+		MeshPart& part = result.Parts[b];
+		part.Name = options.PartPrefix + std::to_string(b);
+		part.IndexStart = batch.IndexStart;
+		part.IndexCount = batch.IndexCount;
+		part.BaseVertex = (int32_t)batch.VertexStart;
+		stats.LargestBatchTriangles = std::max(stats.LargestBatchTriangles, batch.IndexCount / 3);
+	}
+	result.Vertices.resize((size_t)vertexCount * result.VertexStride);
+	result.Indices.resize(indexCount);
+
+	ParallelFor(0, batches.size(), 1, [&](size_t begin, size_t end) {
+		for (size_t b = begin; b < end; ++b) {
+			const Batch& batch = batches[b];
+			uint32_t batchVertex = 0;
+			uint32_t batchIndex = 0;
+			for (uint32_t i = batch.First; i < batch.First + batch.Count; ++i) {
+				const SourcePart& source = sources[placements[order[i]].Source];
+				WriteInstance(source, instances[order[i]].World, batchVertex,
+					result.Vertices.data() + (size_t)(batch.VertexStart + batchVertex) * result.VertexStride,
+					result.Indices.data() + batch.IndexStart + batchIndex);
+				batchVertex += (uint32_t)source.Vertices.size();
+				batchIndex += (uint32_t)source.Indices.size();
+			}
+		}
+	});
+
+	stats.Batches = (uint32_t)batches.size();
+	stats.Triangles = indexCount / 3;
+	stats.Vertices = vertexCount;
+	stats.Milliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+	return stats;
+}
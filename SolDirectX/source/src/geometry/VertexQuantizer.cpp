@@ -0,0 +1,521 @@
+#include "../../header/Geometry/VertexQuantizer.h"
+#include "../../header/Common/CpuFeatures.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace {
+	uint32_t AsUint(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	float AsFloat(uint32_t bits)
+	{
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	//Round-to-nearest-even float to half conversion (F. Giesen's float_to_half_fast3_rtne).
+	const uint32_t F32Infinity = 255u << 23;
+	const uint32_t F16Max = (127u + 16u) << 23;
+	const uint32_t DenormMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+	const uint32_t MinNormal = 113u << 23;
+	const uint32_t RebiasExponent = ((uint32_t)(15 - 127) << 23) + 0xFFFu;
+
+	__m128 LoadFloat3(const uint8_t* src, float w)
+	{
+		const float* p = reinterpret_cast<const float*>(src);
+		return _mm_setr_ps(p[0], p[1], p[2], w);
+	}
+
+	void StoreUint32(uint8_t* dst, uint32_t value)
+	{
+		memcpy(dst, &value, sizeof(value));
+	}
+
+	//Four floats to four halves in the low 64 bits, SSE2 only.
+	__m128i FloatToHalfSSE2(__m128 value)
+	{
+		__m128i f = _mm_castps_si128(value);
+		__m128i sign = _mm_and_si128(f, _mm_set1_epi32((int)0x80000000u));
+		f = _mm_xor_si128(f, sign);
+
+		__m128i isNaN = _mm_cmpgt_epi32(f, _mm_set1_epi32((int)F32Infinity));
+		__m128i special = _mm_or_si128(_mm_and_si128(isNaN, _mm_set1_epi32(0x7E00)),
+			_mm_andnot_si128(isNaN, _mm_set1_epi32(0x7C00)));
+
+		__m128 denormFloat = _mm_add_ps(_mm_castsi128_ps(f), _mm_castsi128_ps(_mm_set1_epi32((int)DenormMagic)));
+		__m128i denorm = _mm_sub_epi32(_mm_castps_si128(denormFloat), _mm_set1_epi32((int)DenormMagic));
+
+		__m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(f, 13), _mm_set1_epi32(1));
+		__m128i normal = _mm_add_epi32(_mm_add_epi32(f, _mm_set1_epi32((int)RebiasExponent)), mantissaOdd);
+		normal = _mm_srli_epi32(normal, 13);
+
+		__m128i isSpecial = _mm_cmpgt_epi32(f, _mm_set1_epi32((int)F16Max - 1));
+		__m128i isDenorm = _mm_cmplt_epi32(f, _mm_set1_epi32((int)MinNormal));
+		__m128i result = _mm_or_si128(_mm_and_si128(isDenorm, denorm), _mm_andnot_si128(isDenorm, normal));
+		result = _mm_or_si128(_mm_and_si128(isSpecial, special), _mm_andnot_si128(isSpecial, result));
+		result = _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+
+		//Sign extend so that the signed saturation of packs keeps the bits.
+		result = _mm_srai_epi32(_mm_slli_epi32(result, 16), 16);
+		return _mm_packs_epi32(result, result);
+	}
+
+	//Packs four non-negative int32 below 65536 into 16-bit lanes, SSE2 only.
+	__m128i PackUnsigned16SSE2(__m128i value)
+	{
+		__m128i biased = _mm_sub_epi32(value, _mm_set1_epi32(32768));
+		return _mm_xor_si128(_mm_packs_epi32(biased, biased), _mm_set1_epi16((short)0x8000));
+	}
+
+	struct PositionTransform
+	{
+		__m128 Bias;
+		__m128 Multiplier;
+	};
+
+	PositionTransform MakePositionTransform(const PositionDequantization& dq, float range, float w)
+	{
+		//w is the constant stored in the fourth component.
+		PositionTransform transform;
+		transform.Bias = _mm_setr_ps(dq.Bias[0], dq.Bias[1], dq.Bias[2], 0.0f);
+		transform.Multiplier = _mm_setr_ps(range / dq.Scale[0], range / dq.Scale[1], range / dq.Scale[2], w);
+		return transform;
+	}
+
+	void EncodePositionsUnorm16SSE2(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+		size_t count, const PositionDequantization& dq)
+	{
+		PositionTransform t = MakePositionTransform(dq, 65535.0f, 65535.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 maxValue = _mm_set1_ps(65535.0f);
+		for (size_t i = 0; i < count; ++i) {
+			__m128 v = _mm_mul_ps(_mm_sub_ps(LoadFloat3(src + i * srcStride, 1.0f), t.Bias), t.Multiplier);
+			v = _mm_min_ps(_mm_max_ps(_mm_add_ps(v, half), _mm_setzero_ps()), maxValue);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i * dstStride), PackUnsigned16SSE2(_mm_cvttps_epi32(v)));
+		}
+	}
+
+	SOL_TARGET_AVX2 void EncodePositionsUnorm16AVX2(const uint8_t* src, size_t srcStride, uint8_t* dst,
+		size_t dstStride, size_t count, const PositionDequantization& dq)
+	{
+		PositionTransform t = MakePositionTransform(dq, 65535.0f, 65535.0f);
+		const __m256 bias = _mm256_broadcast_ps(&t.Bias);
+		const __m256 multiplier = _mm256_broadcast_ps(&t.Multiplier);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 maxValue = _mm256_set1_ps(65535.0f);
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2) {
+			__m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(LoadFloat3(src + i * srcStride, 1.0f)),
+				LoadFloat3(src + (i + 1) * srcStride, 1.0f), 1);
+			v = _mm256_fmadd_ps(_mm256_sub_ps(v, bias), multiplier, half);
+			v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), maxValue);
+			__m256i packed = _mm256_cvttps_epi32(v);
+			packed = _mm256_packus_epi32(packed, packed);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i * dstStride), _mm256_castsi256_si128(packed));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i + 1) * dstStride), _mm256_extracti128_si256(packed, 1));
+		}
+		EncodePositionsUnorm16SSE2(src + i * srcStride, srcStride, dst + i * dstStride, dstStride, count - i, dq);
+	}
+
+	void EncodePositionsHalfSSE2(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+		size_t count, const PositionDequantization& dq)
+	{
+		PositionTransform t = MakePositionTransform(dq, 1.0f, 1.0f);
+		for (size_t i = 0; i < count; ++i) {
+			__m128 v = _mm_mul_ps(_mm_sub_ps(LoadFloat3(src + i * srcStride, 1.0f), t.Bias), t.Multiplier);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i * dstStride), FloatToHalfSSE2(v));
+		}
+	}
+
+	SOL_TARGET_AVX2 void EncodePositionsHalfF16C(const uint8_t* src, size_t srcStride, uint8_t* dst,
+		size_t dstStride, size_t count, const PositionDequantization& dq)
+	{
+		PositionTransform t = MakePositionTransform(dq, 1.0f, 1.0f);
+		const __m256 bias = _mm256_broadcast_ps(&t.Bias);
+		const __m256 multiplier = _mm256_broadcast_ps(&t.Multiplier);
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2) {
+			__m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(LoadFloat3(src + i * srcStride, 1.0f)),
+				LoadFloat3(src + (i + 1) * srcStride, 1.0f), 1);
+			v = _mm256_mul_ps(_mm256_sub_ps(v, bias), multiplier);
+			__m128i halves = _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i * dstStride), halves);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + (i + 1) * dstStride), _mm_unpackhi_epi64(halves, halves));
+		}
+		EncodePositionsHalfSSE2(src + i * srcStride, srcStride, dst + i * dstStride, dstStride, count - i, dq);
+	}
+
+	void EncodeColorsUnorm8SSE2(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t count)
+	{
+		const __m128 scale = _mm_set1_ps(255.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		for (size_t i = 0; i < count; ++i) {
+			__m128 v = _mm_loadu_ps(reinterpret_cast<const float*>(src + i * srcStride));
+			v = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(v, scale), half), _mm_setzero_ps()), scale);
+			__m128i packed = _mm_cvttps_epi32(v);
+			packed = _mm_packs_epi32(packed, packed);
+			packed = _mm_packus_epi16(packed, packed);
+			StoreUint32(dst + i * dstStride, (uint32_t)_mm_cvtsi128_si32(packed));
+		}
+	}
+
+	SOL_TARGET_AVX2 void EncodeColorsUnorm8AVX2(const uint8_t* src, size_t srcStride, uint8_t* dst,
+		size_t dstStride, size_t count)
+	{
+		const __m256 scale = _mm256_set1_ps(255.0f);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2) {
+			__m256 v = _mm256_insertf128_ps(
+				_mm256_castps128_ps256(_mm_loadu_ps(reinterpret_cast<const float*>(src + i * srcStride))),
+				_mm_loadu_ps(reinterpret_cast<const float*>(src + (i + 1) * srcStride)), 1);
+			v = _mm256_min_ps(_mm256_max_ps(_mm256_fmadd_ps(v, scale, half), _mm256_setzero_ps()), scale);
+			__m256i packed = _mm256_cvttps_epi32(v);
+			packed = _mm256_packs_epi32(packed, packed);
+			packed = _mm256_packus_epi16(packed, packed);
+			StoreUint32(dst + i * dstStride, (uint32_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(packed)));
+			StoreUint32(dst + (i + 1) * dstStride, (uint32_t)_mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1)));
+		}
+		EncodeColorsUnorm8SSE2(src + i * srcStride, srcStride, dst + i * dstStride, dstStride, count - i);
+	}
+
+	//Octahedral mapping of 4 normals given as x, y, z vectors, SSE2 only.
+	//Returns the snorm16 pairs of the 4 normals, one 32-bit lane each.
+	__m128i EncodeOct4SSE2(__m128 x, __m128 y, __m128 z)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		const __m128 one = _mm_set1_ps(1.0f);
+		__m128 absX = _mm_andnot_ps(signMask, x);
+		__m128 absY = _mm_andnot_ps(signMask, y);
+		__m128 absZ = _mm_andnot_ps(signMask, z);
+		__m128 invL1 = _mm_div_ps(one, _mm_max_ps(_mm_add_ps(_mm_add_ps(absX, absY), absZ), _mm_set1_ps(FLT_MIN)));
+		__m128 ox = _mm_mul_ps(x, invL1);
+		__m128 oy = _mm_mul_ps(y, invL1);
+
+		//The lower hemisphere is folded over the diagonals.
+		__m128 signX = _mm_or_ps(_mm_and_ps(ox, signMask), one);
+		__m128 signY = _mm_or_ps(_mm_and_ps(oy, signMask), one);
+		__m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, oy)), signX);
+		__m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, ox)), signY);
+		__m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+		ox = _mm_or_ps(_mm_and_ps(lower, foldedX), _mm_andnot_ps(lower, ox));
+		oy = _mm_or_ps(_mm_and_ps(lower, foldedY), _mm_andnot_ps(lower, oy));
+
+		const __m128 snormScale = _mm_set1_ps(32767.0f);
+		__m128i ix = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(ox, _mm_set1_ps(-1.0f)), one), snormScale));
+		__m128i iy = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(oy, _mm_set1_ps(-1.0f)), one), snormScale));
+		return _mm_unpacklo_epi16(_mm_packs_epi32(ix, ix), _mm_packs_epi32(iy, iy));
+	}
+
+	void EncodeNormalsOct16SSE2(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t count)
+	{
+		for (size_t i = 0; i < count; i += 4) {
+			size_t n = std::min<size_t>(4, count - i);
+			float x[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float y[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float z[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			for (size_t j = 0; j < n; ++j) {
+				const float* p = reinterpret_cast<const float*>(src + (i + j) * srcStride);
+				x[j] = p[0];
+				y[j] = p[1];
+				z[j] = p[2];
+			}
+			uint32_t encoded[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(encoded),
+				EncodeOct4SSE2(_mm_loadu_ps(x), _mm_loadu_ps(y), _mm_loadu_ps(z)));
+			for (size_t j = 0; j < n; ++j) {
+				StoreUint32(dst + (i + j) * dstStride, encoded[j]);
+			}
+		}
+	}
+
+	SOL_TARGET_AVX2 void EncodeNormalsOct16AVX2(const uint8_t* src, size_t srcStride, uint8_t* dst,
+		size_t dstStride, size_t count)
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 minusOne = _mm256_set1_ps(-1.0f);
+		const __m256 snormScale = _mm256_set1_ps(32767.0f);
+		//Interleaves x0..x3 y0..y3 into x0 y0 x1 y1 ... inside each 128-bit lane.
+		const __m256i interleave = _mm256_setr_epi8(
+			0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+			0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+		const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+			_mm256_set1_epi32((int)srcStride));
+
+		size_t i = 0;
+		//Gather offsets are 32-bit, so the batch must stay within 2 GB.
+		for (; i + 8 <= count && (i + 8) * srcStride < 0x7FFFFFFF; i += 8) {
+			const float* base = reinterpret_cast<const float*>(src + i * srcStride);
+			__m256 x = _mm256_i32gather_ps(base, offsets, 1);
+			__m256 y = _mm256_i32gather_ps(base + 1, offsets, 1);
+			__m256 z = _mm256_i32gather_ps(base + 2, offsets, 1);
+
+			__m256 absX = _mm256_andnot_ps(signMask, x);
+			__m256 absY = _mm256_andnot_ps(signMask, y);
+			__m256 absZ = _mm256_andnot_ps(signMask, z);
+			__m256 invL1 = _mm256_div_ps(one, _mm256_max_ps(_mm256_add_ps(_mm256_add_ps(absX, absY), absZ),
+				_mm256_set1_ps(FLT_MIN)));
+			__m256 ox = _mm256_mul_ps(x, invL1);
+			__m256 oy = _mm256_mul_ps(y, invL1);
+
+			__m256 signX = _mm256_or_ps(_mm256_and_ps(ox, signMask), one);
+			__m256 signY = _mm256_or_ps(_mm256_and_ps(oy, signMask), one);
+			__m256 foldedX = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signMask, oy)), signX);
+			__m256 foldedY = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signMask, ox)), signY);
+			__m256 lower = _mm256_cmp_ps(z, _mm256_setzero_ps(), _CMP_LT_OQ);
+			ox = _mm256_blendv_ps(ox, foldedX, lower);
+			oy = _mm256_blendv_ps(oy, foldedY, lower);
+
+			__m256i ix = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(ox, minusOne), one), snormScale));
+			__m256i iy = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(oy, minusOne), one), snormScale));
+			__m256i packed = _mm256_shuffle_epi8(_mm256_packs_epi32(ix, iy), interleave);
+
+			uint32_t encoded[8];
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(encoded), packed);
+			for (int j = 0; j < 8; ++j) {
+				StoreUint32(dst + (i + j) * dstStride, encoded[j]);
+			}
+		}
+		EncodeNormalsOct16SSE2(src + i * srcStride, srcStride, dst + i * dstStride, dstStride, count - i);
+	}
+
+	bool UseAVX2()
+	{
+		return CpuFeatures::Get().Avx2Target();
+	}
+
+	void CopyAttribute(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t count, size_t size)
+	{
+		for (size_t i = 0; i < count; ++i) {
+			memcpy(dst + i * dstStride, src + i * srcStride, size);
+		}
+	}
+}
+
+float HalfToFloat(uint16_t value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+	if (exponent == 0) {
+		//Zero or denormal: mantissa * 2^-24.
+		float magnitude = mantissa * 5.9604644775390625e-8f;
+		return sign ? -magnitude : magnitude;
+	}
+	if (exponent == 31) {
+		return AsFloat(sign | 0x7F800000u | (mantissa << 13));
+	}
+	return AsFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+uint16_t FloatToHalf(float value)
+{
+	uint32_t f = AsUint(value);
+	uint32_t sign = f & 0x80000000u;
+	f ^= sign;
+
+	uint16_t result;
+	if (f >= F16Max) {
+		result = f > F32Infinity ? 0x7E00 : 0x7C00;
+	}
+	else if (f < MinNormal) {
+		result = (uint16_t)(AsUint(AsFloat(f) + AsFloat(DenormMagic)) - DenormMagic);
+	}
+	else {
+		uint32_t mantissaOdd = (f >> 13) & 1;
+		f += RebiasExponent;
+		f += mantissaOdd;
+		result = (uint16_t)(f >> 13);
+	}
+	return (uint16_t)(result | (sign >> 16));
+}
+
+void EncodePositionsUnorm16(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+	size_t count, const PositionDequantization& dequantization)
+{
+	if (UseAVX2()) {
+		EncodePositionsUnorm16AVX2(src, srcStride, dst, dstStride, count, dequantization);
+	}
+	else {
+		EncodePositionsUnorm16SSE2(src, srcStride, dst, dstStride, count, dequantization);
+	}
+}
+
+void EncodePositionsHalf(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+	size_t count, const PositionDequantization& dequantization)
+{
+	if (UseAVX2()) {
+		EncodePositionsHalfF16C(src, srcStride, dst, dstStride, count, dequantization);
+	}
+	else {
+		EncodePositionsHalfSSE2(src, srcStride, dst, dstStride, count, dequantization);
+	}
+}
+
+void EncodeColorsUnorm8(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t count)
+{
+	if (UseAVX2()) {
+		EncodeColorsUnorm8AVX2(src, srcStride, dst, dstStride, count);
+	}
+	else {
+		EncodeColorsUnorm8SSE2(src, srcStride, dst, dstStride, count);
+	}
+}
+
+void EncodeNormalsOct16(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, size_t count)
+{
+	if (UseAVX2()) {
+		EncodeNormalsOct16AVX2(src, srcStride, dst, dstStride, count);
+	}
+	else {
+		EncodeNormalsOct16SSE2(src, srcStride, dst, dstStride, count);
+	}
+}
+
+PositionDequantization ComputeDequantization(const MeshData& mesh, PositionFormat format)
+{
+	PositionDequantization dequantization;
+	const uint32_t vertexCount = mesh.VertexCount();
+	if (format == PositionFormat::Float3 || vertexCount == 0) {
+		return dequantization;
+	}
+
+	float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		const float* p = mesh.Position(v);
+		for (int k = 0; k < 3; ++k) {
+			minimum[k] = std::min(minimum[k], p[k]);
+			maximum[k] = std::max(maximum[k], p[k]);
+		}
+	}
+	for (int k = 0; k < 3; ++k) {
+		float extent = maximum[k] - minimum[k];
+		if (format == PositionFormat::Unorm16x4) {
+			//[0,1] covers the bounds.
+			dequantization.Scale[k] = extent > 0.0f ? extent : 1.0f;
+			dequantization.Bias[k] = minimum[k];
+		}
+		else {
+			//[-1,1] covers the bounds, so halves keep their precision near 0.
+			dequantization.Scale[k] = extent > 0.0f ? 0.5f * extent : 1.0f;
+			dequantization.Bias[k] = 0.5f * (minimum[k] + maximum[k]);
+		}
+	}
+	return dequantization;
+}
+
+void QuantizeMesh(const MeshData& src, const VertexFormat& format, MeshData& dst)
+{
+	assert(src.Format.IsFloat() && src.VertexStride == src.Format.Stride());
+	const size_t count = src.VertexCount();
+	const size_t stride = format.Stride();
+
+	dst.Name = src.Name;
+	dst.Format = format;
+	dst.VertexStride = (uint32_t)stride;
+	dst.Dequantization = ComputeDequantization(src, format.Position);
+	dst.Indices = src.Indices;
+	dst.Parts = src.Parts;
+	dst.Meshlets = src.Meshlets;
+	dst.MeshletVertices = src.MeshletVertices;
+	dst.MeshletTriangles = src.MeshletTriangles;
+	dst.Vertices.assign(count * stride, 0);
+
+	const uint8_t* in = src.Vertices.data();
+	uint8_t* out = dst.Vertices.data();
+
+	const uint8_t* position = in + src.Format.PositionOffset();
+	switch (format.Position) {
+	case PositionFormat::Float3:
+		CopyAttribute(position, src.VertexStride, out, stride, count, 12);
+		break;
+	case PositionFormat::Half4:
+		EncodePositionsHalf(position, src.VertexStride, out, stride, count, dst.Dequantization);
+		break;
+	case PositionFormat::Unorm16x4:
+		EncodePositionsUnorm16(position, src.VertexStride, out, stride, count, dst.Dequantization);
+		break;
+	}
+
+	if (format.Normal != NormalFormat::None) {
+		const float defaultNormal[3] = { 0.0f, 0.0f, 1.0f };
+		bool hasNormal = src.Format.Normal != NormalFormat::None;
+		const uint8_t* normal = hasNormal ? in + src.Format.NormalOffset() : reinterpret_cast<const uint8_t*>(defaultNormal);
+		size_t normalStride = hasNormal ? src.VertexStride : 0;
+		if (format.Normal == NormalFormat::Oct16) {
+			EncodeNormalsOct16(normal, normalStride, out + format.NormalOffset(), stride, count);
+		}
+		else {
+			CopyAttribute(normal, normalStride, out + format.NormalOffset(), stride, count, 12);
+		}
+	}
+
+	if (format.Color != ColorFormat::None) {
+		const float defaultColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		bool hasColor = src.Format.Color != ColorFormat::None;
+		const uint8_t* color = hasColor ? in + src.Format.ColorOffset() : reinterpret_cast<const uint8_t*>(defaultColor);
+		size_t colorStride = hasColor ? src.VertexStride : 0;
+		if (format.Color == ColorFormat::Unorm8x4) {
+			EncodeColorsUnorm8(color, colorStride, out + format.ColorOffset(), stride, count);
+		}
+		else {
+			CopyAttribute(color, colorStride, out + format.ColorOffset(), stride, count, 16);
+		}
+	}
+}
+
+void DecodePosition(const MeshData& mesh, uint32_t vertex, float position[3])
+{
+	const uint8_t* p = mesh.Vertices.data() + (size_t)vertex * mesh.VertexStride + mesh.Format.PositionOffset();
+	const PositionDequantization& dq = mesh.Dequantization;
+	switch (mesh.Format.Position) {
+	case PositionFormat::Float3:
+		memcpy(position, p, 3 * sizeof(float));
+		return;
+	case PositionFormat::Half4:
+		for (int k = 0; k < 3; ++k) {
+			uint16_t value;
+			memcpy(&value, p + 2 * k, sizeof(value));
+			position[k] = HalfToFloat(value) * dq.Scale[k] + dq.Bias[k];
+		}
+		return;
+	case PositionFormat::Unorm16x4:
+		for (int k = 0; k < 3; ++k) {
+			uint16_t value;
+			memcpy(&value, p + 2 * k, sizeof(value));
+			position[k] = value * (1.0f / 65535.0f) * dq.Scale[k] + dq.Bias[k];
+		}
+		return;
+	default:
+		assert(!"unknown position format");
+		position[0] = position[1] = position[2] = 0.0f;
+		return;
+	}
+}
+
+void ComputePartBounds(const MeshData& mesh, const MeshPart& part, float boundsMin[3], float boundsMax[3])
+{
+	for (int k = 0; k < 3; ++k) {
+		boundsMin[k] = part.IndexCount != 0 ? FLT_MAX : 0.0f;
+		boundsMax[k] = part.IndexCount != 0 ? -FLT_MAX : 0.0f;
+	}
+	for (uint32_t i = 0; i < part.IndexCount; ++i) {
+		float position[3];
+		DecodePosition(mesh, mesh.Indices[part.IndexStart + i] + part.BaseVertex, position);
+		for (int k = 0; k < 3; ++k) {
+			boundsMin[k] = std::min(boundsMin[k], position[k]);
+			boundsMax[k] = std::max(boundsMax[k], position[k]);
+		}
+	}
+}
@@ -0,0 +1,157 @@
+#include "../../header/Render/ClusterCuller.h"
+#include "../../header/Common/MathHelper.h"
+#include <immintrin.h>
+#include <cfloat>
+#include <chrono>
+
+using namespace DirectX;
+
+namespace {
+	const UINT LaneCount = 4;
+}
+
+void ClusterCuller::AddMesh(const MeshData& mesh, const MeshGeometry& geo)
+{
+	for (const MeshPart& part : mesh.Parts) {
+		AddPart(geo, part.Name, mesh.Meshlets.data() + part.MeshletStart, part.MeshletCount);
+	}
+}
+
+void ClusterCuller::AddMesh(const MeshFileView& file, const MeshGeometry& geo)
+{
+	for (uint32_t i = 0; i < file.PartCount(); ++i) {
+		const MeshFilePart& part = file.Parts()[i];
+		AddPart(geo, file.Part(i).Name, file.Meshlets() + part.MeshletStart, part.MeshletCount);
+	}
+}
+
+void ClusterCuller::AddPart(const MeshGeometry& geo, const std::string& name, const Meshlet* meshlets, UINT meshletCount)
+{
+	auto it = geo.DrawArgs.find(name);
+	if (meshletCount == 0 || it == geo.DrawArgs.end()) {
+		return;
+	}
+
+	ClusterBlock block;
+	block.First = (UINT)mRadius.size();
+	block.Count = meshletCount;
+	UINT paddedCount = (meshletCount + LaneCount - 1) / LaneCount * LaneCount;
+	for (UINT i = 0; i < paddedCount; ++i) {
+		Meshlet meshlet;
+		meshlet.Radius = -FLT_MAX;
+		if (i < meshletCount) {
+			meshlet = meshlets[i];
+		}
+		mCenterX.push_back(meshlet.Center[0]);
+		mCenterY.push_back(meshlet.Center[1]);
+		mCenterZ.push_back(meshlet.Center[2]);
+		mRadius.push_back(meshlet.Radius);
+		mAxisX.push_back(meshlet.ConeAxis[0]);
+		mAxisY.push_back(meshlet.ConeAxis[1]);
+		mAxisZ.push_back(meshlet.ConeAxis[2]);
+		mCutoff.push_back(meshlet.ConeCutoff);
+		mIndexStart.push_back(meshlet.IndexStart);
+		mIndexCount.push_back(3 * meshlet.TriangleCount);
+	}
+	mBlocks[&it->second] = block;
+}
+
+UINT ClusterCuller::ClusterCount(const SubmeshGeometry* submesh) const
+{
+	auto it = mBlocks.find(submesh);
+	return it != mBlocks.end() ? it->second.Count : 0;
+}
+
+void ClusterCuller::BeginFrame()
+{
+	mStats = ClusterCullStats();
+}
+
+void ClusterCuller::Cull(const SubmeshGeometry& submesh, FXMMATRIX world, CXMMATRIX viewProj,
+	FXMVECTOR eyePosition, std::vector<IndexRange>& ranges)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	const ClusterBlock& block = mBlocks.at(&submesh);
+
+	//Planes of world * viewProj are the frustum in object space.
+	XMFLOAT4 planes[6];
+	MathHelper::ExtractFrustumPlanes(XMMatrixMultiply(world, viewProj), planes);
+	XMVECTOR det = XMMatrixDeterminant(world);
+	XMFLOAT3 eye;
+	XMStoreFloat3(&eye, XMVector3TransformCoord(eyePosition, XMMatrixInverse(&det, world)));
+	//A mirroring transform turns the triangles around, their cones no longer apply.
+	const bool coneTest = XMVectorGetX(det) > 0.0f;
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 eyeX = _mm_set1_ps(eye.x);
+	const __m128 eyeY = _mm_set1_ps(eye.y);
+	const __m128 eyeZ = _mm_set1_ps(eye.z);
+
+	const size_t firstRange = ranges.size();
+	UINT frustumCulled = 0;
+	UINT backfaceCulled = 0;
+	UINT64 triangles = 0;
+	UINT64 visibleTriangles = 0;
+	const UINT end = block.First + block.Count;
+	for (UINT i = block.First; i < end; i += LaneCount) {
+		__m128 cx = _mm_loadu_ps(&mCenterX[i]);
+		__m128 cy = _mm_loadu_ps(&mCenterY[i]);
+		__m128 cz = _mm_loadu_ps(&mCenterZ[i]);
+		__m128 radius = _mm_loadu_ps(&mRadius[i]);
+
+		int inside = 0xF;
+		for (int p = 0; p < 6 && inside != 0; ++p) {
+			__m128 d = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].x), cx), _mm_mul_ps(_mm_set1_ps(planes[p].y), cy)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[p].z), cz), _mm_set1_ps(planes[p].w)));
+			inside &= _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(d, radius), zero));
+		}
+
+		int frontFacing = 0xF;
+		if (coneTest && inside != 0) {
+			__m128 vx = _mm_sub_ps(cx, eyeX);
+			__m128 vy = _mm_sub_ps(cy, eyeY);
+			__m128 vz = _mm_sub_ps(cz, eyeZ);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+			__m128 along = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(vx, _mm_loadu_ps(&mAxisX[i])), _mm_mul_ps(vy, _mm_loadu_ps(&mAxisY[i]))),
+				_mm_mul_ps(vz, _mm_loadu_ps(&mAxisZ[i])));
+			__m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&mCutoff[i]), length), radius);
+			frontFacing = _mm_movemask_ps(_mm_cmplt_ps(along, limit));
+		}
+
+		const UINT lanes = std::min(LaneCount, end - i);
+		for (UINT lane = 0; lane < lanes; ++lane) {
+			UINT cluster = i + lane;
+			triangles += mIndexCount[cluster] / 3;
+			if ((inside & (1 << lane)) == 0) {
+				++frustumCulled;
+				continue;
+			}
+			if ((frontFacing & (1 << lane)) == 0) {
+				++backfaceCulled;
+				continue;
+			}
+			visibleTriangles += mIndexCount[cluster] / 3;
+
+			//Meshlets lie back to back in the index buffer, neighbours become one draw.
+			UINT startIndex = submesh.StartIndexLocation + mIndexStart[cluster];
+			if (ranges.size() > firstRange && ranges.back().StartIndex + ranges.back().IndexCount == startIndex) {
+				ranges.back().IndexCount += mIndexCount[cluster];
+			}
+			else {
+				ranges.push_back({ startIndex, mIndexCount[cluster] });
+				++mStats.Ranges;
+			}
+		}
+	}
+
+	mStats.Objects++;
+	mStats.Clusters += block.Count;
+	mStats.FrustumCulled += frustumCulled;
+	mStats.BackfaceCulled += backfaceCulled;
+	mStats.Triangles += triangles;
+	mStats.VisibleTriangles += visibleTriangles;
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	mStats.Milliseconds += elapsed.count();
+}
@@ -0,0 +1,254 @@
+#include "../../header/Render/CpuGeometryCache.h"
+#include "../../header/Common/LzCodec.h"
+#include "../../header/Geometry/GeometryCodec.h"
+
+namespace {
+	//Triangle lists and vertex layouts the geometry codec takes go through it,
+	//anything else through the general purpose LZ codec.
+	bool UseVertexCodec(const MeshGeometry& geo, size_t size)
+	{
+		return geo.VertexByteStride != 0 && geo.VertexByteStride <= VertexCodecMaxStride && size % geo.VertexByteStride == 0;
+	}
+
+	size_t IndexSize(const MeshGeometry& geo)
+	{
+		return geo.IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
+
+	bool UseIndexCodec(const MeshGeometry& geo, size_t size)
+	{
+		return size % IndexSize(geo) == 0 && size / IndexSize(geo) % 3 == 0;
+	}
+
+	void CompressVertices(const MeshGeometry& geo, ID3DBlob* blob, std::vector<uint8_t>& compressed)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(blob->GetBufferPointer());
+		const size_t size = blob->GetBufferSize();
+		if (UseVertexCodec(geo, size)) {
+			const size_t count = size / geo.VertexByteStride;
+			compressed.resize(VertexCodecBound(count, geo.VertexByteStride));
+			compressed.resize(EncodeVertexBuffer(data, count, geo.VertexByteStride, compressed.data()));
+		}
+		else {
+			compressed.resize(LzCompressBound(size));
+			compressed.resize(LzCompress(data, size, compressed.data()));
+		}
+		compressed.shrink_to_fit();
+	}
+
+	void CompressIndices(const MeshGeometry& geo, ID3DBlob* blob, std::vector<uint8_t>& compressed)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(blob->GetBufferPointer());
+		const size_t size = blob->GetBufferSize();
+		if (UseIndexCodec(geo, size)) {
+			const size_t count = size / IndexSize(geo);
+			std::vector<uint32_t> indices(count);
+			if (IndexSize(geo) == sizeof(uint16_t)) {
+				const uint16_t* indices16 = reinterpret_cast<const uint16_t*>(data);
+				indices.assign(indices16, indices16 + count);
+			}
+			else {
+				memcpy(indices.data(), data, size);
+			}
+			compressed.resize(IndexCodecBound(count));
+			compressed.resize(EncodeIndexBuffer(indices.data(), count, compressed.data()));
+		}
+		else {
+			compressed.resize(LzCompressBound(size));
+			compressed.resize(LzCompress(data, size, compressed.data()));
+		}
+		compressed.shrink_to_fit();
+	}
+
+	ComPtr<ID3DBlob> DecompressVertices(const MeshGeometry& geo, const std::vector<uint8_t>& compressed, UINT64 size)
+	{
+		ComPtr<ID3DBlob> blob;
+		ThrowIfFailed(D3DCreateBlob((SIZE_T)size, &blob));
+		uint8_t* data = static_cast<uint8_t*>(blob->GetBufferPointer());
+		bool valid = UseVertexCodec(geo, (size_t)size) ?
+			DecodeVertexBuffer(compressed.data(), compressed.size(), data, (size_t)size / geo.VertexByteStride, geo.VertexByteStride) :
+			LzDecompress(compressed.data(), compressed.size(), data, (size_t)size);
+		assert(valid && "compressed geometry is written by Retain only");
+		(void)valid;
+		return blob;
+	}
+
+	ComPtr<ID3DBlob> DecompressIndices(const MeshGeometry& geo, const std::vector<uint8_t>& compressed, UINT64 size)
+	{
+		ComPtr<ID3DBlob> blob;
+		ThrowIfFailed(D3DCreateBlob((SIZE_T)size, &blob));
+		void* data = blob->GetBufferPointer();
+		const size_t count = (size_t)size / IndexSize(geo);
+		bool valid;
+		if (!UseIndexCodec(geo, (size_t)size)) {
+			valid = LzDecompress(compressed.data(), compressed.size(), static_cast<uint8_t*>(data), (size_t)size);
+		}
+		else if (IndexSize(geo) == sizeof(uint16_t)) {
+			valid = DecodeIndexBuffer(compressed.data(), compressed.size(), static_cast<uint16_t*>(data), count);
+		}
+		else {
+			valid = DecodeIndexBuffer(compressed.data(), compressed.size(), static_cast<uint32_t*>(data), count);
+		}
+		assert(valid && "compressed geometry is written by Retain only");
+		(void)valid;
+		return blob;
+	}
+}
+
+CpuGeometryCache::CpuGeometryCache(UINT64 budgetBytes) :
+	mBudgetBytes(budgetBytes)
+{
+}
+
+void CpuGeometryCache::Retain(MeshGeometry& geo, CpuRetention policy)
+{
+	assert(geo.VertexBufferCPU != nullptr && geo.IndexBufferCPU != nullptr);
+	Remove(geo);
+
+	Entry entry;
+	entry.Policy = policy;
+	entry.VertexBytes = geo.VertexBufferCPU->GetBufferSize();
+	entry.IndexBytes = geo.IndexBufferCPU->GetBufferSize();
+	const UINT64 bytes = entry.VertexBytes + entry.IndexBytes;
+
+	//Compress outside the lock, it is the expensive part.
+	if (policy == CpuRetention::Keep) {
+		entry.Kept.Vertices = geo.VertexBufferCPU;
+		entry.Kept.Indices = geo.IndexBufferCPU;
+	}
+	else {
+		if (policy == CpuRetention::Compressed) {
+			CompressVertices(geo, geo.VertexBufferCPU.Get(), entry.CompressedVertices);
+			CompressIndices(geo, geo.IndexBufferCPU.Get(), entry.CompressedIndices);
+		}
+		geo.VertexBufferCPU = nullptr;
+		geo.IndexBufferCPU = nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	switch (policy) {
+	case CpuRetention::Keep:
+		++mStats.KeptMeshes;
+		mStats.KeptBytes += bytes;
+		break;
+	case CpuRetention::Compressed:
+		++mStats.CompressedMeshes;
+		mStats.CompressedBytes += entry.CompressedVertices.size() + entry.CompressedIndices.size();
+		mStats.UncompressedBytes += bytes;
+		mStats.ReleasedBytes += bytes;
+		break;
+	case CpuRetention::Drop:
+		++mStats.DroppedMeshes;
+		mStats.ReleasedBytes += bytes;
+		break;
+	}
+	mEntries.emplace(&geo, std::move(entry));
+}
+
+void CpuGeometryCache::Remove(const MeshGeometry& geo)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto it = mEntries.find(&geo);
+	if (it == mEntries.end()) {
+		return;
+	}
+	Entry& entry = it->second;
+	Uncache(entry);
+	const UINT64 bytes = entry.VertexBytes + entry.IndexBytes;
+	switch (entry.Policy) {
+	case CpuRetention::Keep:
+		--mStats.KeptMeshes;
+		mStats.KeptBytes -= bytes;
+		break;
+	case CpuRetention::Compressed:
+		--mStats.CompressedMeshes;
+		mStats.CompressedBytes -= entry.CompressedVertices.size() + entry.CompressedIndices.size();
+		mStats.UncompressedBytes -= bytes;
+		mStats.ReleasedBytes -= bytes;
+		break;
+	case CpuRetention::Drop:
+		--mStats.DroppedMeshes;
+		mStats.ReleasedBytes -= bytes;
+		break;
+	}
+	mEntries.erase(it);
+}
+
+CpuGeometry CpuGeometryCache::Acquire(const MeshGeometry& geo)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	auto it = mEntries.find(&geo);
+	if (it == mEntries.end() || it->second.Policy == CpuRetention::Drop) {
+		return CpuGeometry();
+	}
+	Entry& entry = it->second;
+	if (entry.Policy == CpuRetention::Keep) {
+		return entry.Kept;
+	}
+	if (entry.InCache) {
+		++mStats.CacheHits;
+		mLru.splice(mLru.begin(), mLru, entry.Lru);
+		return entry.Cached;
+	}
+	++mStats.CacheMisses;
+
+	//Decompressing does not need the lock; the entry stays put until Remove,
+	//which must not race with the use of the mesh anyway.
+	lock.unlock();
+	CpuGeometry copy;
+	copy.Vertices = DecompressVertices(geo, entry.CompressedVertices, entry.VertexBytes);
+	copy.Indices = DecompressIndices(geo, entry.CompressedIndices, entry.IndexBytes);
+	lock.lock();
+
+	const UINT64 bytes = entry.VertexBytes + entry.IndexBytes;
+	if (!entry.InCache && bytes <= mBudgetBytes) {
+		Evict(mBudgetBytes - bytes);
+		entry.Cached = copy;
+		entry.InCache = true;
+		mLru.push_front(&geo);
+		entry.Lru = mLru.begin();
+		mStats.CacheBytes += bytes;
+	}
+	return copy;
+}
+
+CpuRetention CpuGeometryCache::Policy(const MeshGeometry& geo) const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto it = mEntries.find(&geo);
+	return it != mEntries.end() ? it->second.Policy : CpuRetention::Keep;
+}
+
+void CpuGeometryCache::SetBudget(UINT64 budgetBytes)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mBudgetBytes = budgetBytes;
+	Evict(budgetBytes);
+}
+
+CpuGeometryStats CpuGeometryCache::Stats() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	CpuGeometryStats stats = mStats;
+	stats.CacheBudgetBytes = mBudgetBytes;
+	return stats;
+}
+
+void CpuGeometryCache::Evict(UINT64 budgetBytes)
+{
+	while (mStats.CacheBytes > budgetBytes && !mLru.empty()) {
+		Uncache(mEntries.at(mLru.back()));
+		++mStats.Evictions;
+	}
+}
+
+void CpuGeometryCache::Uncache(Entry& entry)
+{
+	if (!entry.InCache) {
+		return;
+	}
+	mStats.CacheBytes -= entry.VertexBytes + entry.IndexBytes;
+	mLru.erase(entry.Lru);
+	entry.Cached = CpuGeometry();
+	entry.InCache = false;
+}
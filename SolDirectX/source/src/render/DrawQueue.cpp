@@ -0,0 +1,181 @@
+#include "../../header/Render/DrawQueue.h"
+#include "../../header/Common/ParallelFor.h"
+#include <chrono>
+#include <immintrin.h>
+
+namespace {
+	const UINT64 IndexMask = DrawQueue::MaxPackets - 1;
+
+	//Packets are read in key order, so their indices are known in advance:
+	//fetching a few ahead hides most of the cost of the scattered reads.
+	const size_t PrefetchDistance = 16;
+}
+
+UINT64 DrawQueue::MakeKey(UINT pass, UINT pipeline, UINT material, UINT mesh, float depth)
+{
+	const UINT64 depthMax = (1ull << DepthBits) - 1;
+	depth = std::min(std::max(depth, 0.0f), 1.0f);
+
+	UINT64 key = pass & ((1u << PassBits) - 1);
+	key = (key << PipelineBits) | (pipeline & ((1u << PipelineBits) - 1));
+	key = (key << MaterialBits) | (material & ((1u << MaterialBits) - 1));
+	key = (key << MeshBits) | (mesh & ((1u << MeshBits) - 1));
+	key = (key << DepthBits) | (UINT64)(depth * depthMax);
+	return key << IndexBits;
+}
+
+UINT DrawQueue::InternId(std::unordered_map<const void*, UINT>& ids, const void* object, UINT bits)
+{
+	auto it = ids.find(object);
+	if (it != ids.end()) {
+		return it->second;
+	}
+	//Ids that do not fit in the key wrap around: sorting gets worse, not wrong.
+	UINT id = (UINT)ids.size() & ((1u << bits) - 1);
+	ids.emplace(object, id);
+	return id;
+}
+
+UINT DrawQueue::PipelineId(const ID3D12PipelineState* pso)
+{
+	return InternId(mPipelineIds, pso, PipelineBits);
+}
+
+UINT DrawQueue::MaterialId(D3D12_GPU_DESCRIPTOR_HANDLE table)
+{
+	return InternId(mMaterialIds, reinterpret_cast<const void*>(table.ptr), MaterialBits);
+}
+
+UINT DrawQueue::MeshId(const MeshGeometry* geo)
+{
+	//Meshes sharing the buffers of a geometry pool share an id, so their
+	//draws stay next to each other and keep the same VB/IB binding.
+	return InternId(mMeshIds, geo->VertexBufferGPU.Get(), MeshBits);
+}
+
+void DrawQueue::Reset()
+{
+	mKeys.clear();
+	mPackets.clear();
+	mStats = DrawQueueStats();
+}
+
+void DrawQueue::Push(UINT64 key, const DrawPacket& packet)
+{
+	if (mKeys.size() == MaxPackets) {
+		mStats.DroppedPackets++;
+		return;
+	}
+	mKeys.push_back((key & ~IndexMask) | mKeys.size());
+	mPackets.push_back(packet);
+}
+
+size_t DrawQueue::Append(size_t count)
+{
+	size_t first = mKeys.size();
+	size_t granted = std::min(count, MaxPackets - first);
+	mStats.DroppedPackets += (UINT)(count - granted);
+	mKeys.resize(first + granted);
+	mPackets.resize(first + granted);
+	return first;
+}
+
+void DrawQueue::Set(size_t index, UINT64 key, const DrawPacket& packet)
+{
+	if (index >= mKeys.size()) {
+		return;
+	}
+	mKeys[index] = (key & ~IndexMask) | index;
+	mPackets[index] = packet;
+}
+
+void DrawQueue::Sort()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Only the keys move; the packet indices ride along in their low bits.
+	//Push() and Set() store every key at the position of its index, so the
+	//index bits are already in order and need no passes of their own.
+	RadixSort64(mKeys.data(), mKeys.size(), mSortScratch, IndexBits);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.SortMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+UINT DrawQueue::SubmitListCount(UINT maxLists) const
+{
+	size_t lists = std::min<size_t>(maxLists, mKeys.size() / MinPacketsPerList);
+	return (UINT)std::max<size_t>(1, lists);
+}
+
+void DrawQueue::Submit(ID3D12GraphicsCommandList* const* cmdLists, UINT listCount,
+	UINT materialRootParameter, UINT instanceRootParameter)
+{
+	const size_t count = mKeys.size();
+	std::vector<DrawQueueStats> listStats(listCount);
+
+	ParallelFor(0, listCount, 1, [&](size_t firstList, size_t lastList) {
+		for (size_t list = firstList; list < lastList; ++list) {
+			ID3D12GraphicsCommandList* cmdList = cmdLists[list];
+			DrawQueueStats& stats = listStats[list];
+			const size_t begin = count * list / listCount;
+			const size_t end = count * (list + 1) / listCount;
+
+			ID3D12PipelineState* currentPSO = nullptr;
+			D3D12_VERTEX_BUFFER_VIEW currentVbv = {};
+			D3D12_INDEX_BUFFER_VIEW currentIbv = {};
+			D3D12_GPU_DESCRIPTOR_HANDLE currentTable = {};
+
+			for (size_t i = begin; i < end; ++i) {
+				if (i + PrefetchDistance < end) {
+					_mm_prefetch(reinterpret_cast<const char*>(&mPackets[mKeys[i + PrefetchDistance] & IndexMask]), _MM_HINT_T0);
+				}
+				const DrawPacket& packet = mPackets[mKeys[i] & IndexMask];
+
+				if (packet.PSO != currentPSO) {
+					cmdList->SetPipelineState(packet.PSO);
+					currentPSO = packet.PSO;
+					stats.PipelineStateChanges++;
+				}
+
+				//Compare the views rather than the meshes: meshes sharing a buffer need no rebinding.
+				D3D12_VERTEX_BUFFER_VIEW vbv = packet.Geo->VertexBufferView();
+				if (vbv.BufferLocation != currentVbv.BufferLocation || vbv.SizeInBytes != currentVbv.SizeInBytes ||
+					vbv.StrideInBytes != currentVbv.StrideInBytes) {
+					cmdList->IASetVertexBuffers(0, 1, &vbv);
+					currentVbv = vbv;
+					stats.VertexBufferChanges++;
+				}
+				D3D12_INDEX_BUFFER_VIEW ibv = packet.Geo->IndexBufferView();
+				if (ibv.BufferLocation != currentIbv.BufferLocation || ibv.SizeInBytes != currentIbv.SizeInBytes ||
+					ibv.Format != currentIbv.Format) {
+					cmdList->IASetIndexBuffer(&ibv);
+					currentIbv = ibv;
+					stats.IndexBufferChanges++;
+				}
+
+				if (packet.MaterialTable.ptr != currentTable.ptr) {
+					cmdList->SetGraphicsRootDescriptorTable(materialRootParameter, packet.MaterialTable);
+					currentTable = packet.MaterialTable;
+					stats.DescriptorTableChanges++;
+				}
+
+				if (packet.InstanceData != 0) {
+					cmdList->SetGraphicsRootShaderResourceView(instanceRootParameter, packet.InstanceData);
+				}
+
+				cmdList->DrawIndexedInstanced(packet.IndexCount, packet.InstanceCount,
+					packet.StartIndexLocation, packet.BaseVertexLocation, 0);
+			}
+		}
+	});
+
+	mStats.Packets = (UINT)count;
+	mStats.CommandLists = listCount;
+	for (const DrawQueueStats& stats : listStats) {
+		mStats.PipelineStateChanges += stats.PipelineStateChanges;
+		mStats.VertexBufferChanges += stats.VertexBufferChanges;
+		mStats.IndexBufferChanges += stats.IndexBufferChanges;
+		mStats.DescriptorTableChanges += stats.DescriptorTableChanges;
+	}
+}
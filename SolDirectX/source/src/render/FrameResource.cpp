@@ -0,0 +1,20 @@
+#include "../../header/Render/FrameResource.h"
+
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT instanceCount,
+	UINT drawListCount)
+{
+	ThrowIfFailed(device->CreateCommandAllocator(
+		D3D12_COMMAND_LIST_TYPE_DIRECT,
+		IID_PPV_ARGS(CmdListAlloc.GetAddressOf())));
+	DrawListAllocs.resize(drawListCount);
+	for (auto& alloc : DrawListAllocs) {
+		ThrowIfFailed(device->CreateCommandAllocator(
+			D3D12_COMMAND_LIST_TYPE_DIRECT,
+			IID_PPV_ARGS(alloc.GetAddressOf())));
+	}
+
+	PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
+	//对象和实例数据不是常量缓冲区,按结构化缓冲区紧密排列
+	ObjectBuffer = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, false);
+	InstanceBuffer = std::make_unique<UploadBuffer<InstanceData>>(device, instanceCount, false);
+}
@@ -0,0 +1,212 @@
+#include "../../header/Render/FrustumCuller.h"
+#include "../../header/Common/CpuFeatures.h"
+#include "../../header/Common/MathHelper.h"
+#include "../../header/Common/ParallelFor.h"
+#include <immintrin.h>
+#include <cfloat>
+#include <chrono>
+
+using namespace DirectX;
+
+namespace {
+	const UINT LaneCount = 8;
+	//Objects per parallel block, a multiple of LaneCount.
+	const UINT CullBlockSize = 16 * 1024;
+
+	struct FrustumPlanes
+	{
+		float Nx[6], Ny[6], Nz[6], D[6];
+		float AbsNx[6], AbsNy[6], AbsNz[6];
+	};
+
+	FrustumPlanes ExtractPlanes(FXMMATRIX viewProj)
+	{
+		XMFLOAT4 planes[6];
+		MathHelper::ExtractFrustumPlanes(viewProj, planes);
+
+		FrustumPlanes result;
+		for (int p = 0; p < 6; ++p) {
+			result.Nx[p] = planes[p].x;
+			result.Ny[p] = planes[p].y;
+			result.Nz[p] = planes[p].z;
+			result.D[p] = planes[p].w;
+			result.AbsNx[p] = fabsf(planes[p].x);
+			result.AbsNy[p] = fabsf(planes[p].y);
+			result.AbsNz[p] = fabsf(planes[p].z);
+		}
+		return result;
+	}
+
+	struct BoundsArrays
+	{
+		const float* Cx;
+		const float* Cy;
+		const float* Cz;
+		const float* Ex;
+		const float* Ey;
+		const float* Ez;
+		const float* Radius;
+	};
+
+	//An object is outside as soon as either of its volumes is behind one plane:
+	//d + min(boxRadius, sphereRadius) < 0, where boxRadius is the AABB's
+	//projected half size on the plane normal.
+	SOL_TARGET_AVX2 UINT CullBlockAVX2(const BoundsArrays& b, const FrustumPlanes& planes,
+		UINT begin, UINT end, UINT* visible)
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		UINT count = 0;
+		for (UINT i = begin; i < end; i += 8) {
+			__m256 cx = _mm256_loadu_ps(b.Cx + i);
+			__m256 cy = _mm256_loadu_ps(b.Cy + i);
+			__m256 cz = _mm256_loadu_ps(b.Cz + i);
+			__m256 ex = _mm256_loadu_ps(b.Ex + i);
+			__m256 ey = _mm256_loadu_ps(b.Ey + i);
+			__m256 ez = _mm256_loadu_ps(b.Ez + i);
+			__m256 radius = _mm256_loadu_ps(b.Radius + i);
+
+			int mask = 0xFF;
+			for (int p = 0; p < 6 && mask != 0; ++p) {
+				__m256 d = _mm256_fmadd_ps(_mm256_set1_ps(planes.Nx[p]), cx,
+					_mm256_fmadd_ps(_mm256_set1_ps(planes.Ny[p]), cy,
+						_mm256_fmadd_ps(_mm256_set1_ps(planes.Nz[p]), cz, _mm256_set1_ps(planes.D[p]))));
+				__m256 r = _mm256_fmadd_ps(_mm256_set1_ps(planes.AbsNx[p]), ex,
+					_mm256_fmadd_ps(_mm256_set1_ps(planes.AbsNy[p]), ey,
+						_mm256_mul_ps(_mm256_set1_ps(planes.AbsNz[p]), ez)));
+				r = _mm256_min_ps(r, radius);
+				mask &= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(d, r), zero, _CMP_GE_OQ));
+			}
+
+			while (mask != 0) {
+				visible[count++] = i + CountTrailingZeros((uint32_t)mask);
+				mask &= mask - 1;
+			}
+		}
+		return count;
+	}
+
+	UINT CullBlockSSE(const BoundsArrays& b, const FrustumPlanes& planes,
+		UINT begin, UINT end, UINT* visible)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		UINT count = 0;
+		for (UINT i = begin; i < end; i += 4) {
+			__m128 cx = _mm_loadu_ps(b.Cx + i);
+			__m128 cy = _mm_loadu_ps(b.Cy + i);
+			__m128 cz = _mm_loadu_ps(b.Cz + i);
+			__m128 ex = _mm_loadu_ps(b.Ex + i);
+			__m128 ey = _mm_loadu_ps(b.Ey + i);
+			__m128 ez = _mm_loadu_ps(b.Ez + i);
+			__m128 radius = _mm_loadu_ps(b.Radius + i);
+
+			int mask = 0xF;
+			for (int p = 0; p < 6 && mask != 0; ++p) {
+				__m128 d = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.Nx[p]), cx), _mm_mul_ps(_mm_set1_ps(planes.Ny[p]), cy)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.Nz[p]), cz), _mm_set1_ps(planes.D[p])));
+				__m128 r = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes.AbsNx[p]), ex), _mm_mul_ps(_mm_set1_ps(planes.AbsNy[p]), ey)),
+					_mm_mul_ps(_mm_set1_ps(planes.AbsNz[p]), ez));
+				r = _mm_min_ps(r, radius);
+				mask &= _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(d, r), zero));
+			}
+
+			while (mask != 0) {
+				visible[count++] = i + CountTrailingZeros((uint32_t)mask);
+				mask &= mask - 1;
+			}
+		}
+		return count;
+	}
+}
+
+void FrustumCuller::Resize(UINT objectCount)
+{
+	mObjectCount = objectCount;
+	UINT paddedCount = (objectCount + LaneCount - 1) / LaneCount * LaneCount;
+
+	//Padding objects have a negative radius, so d + r is never >= 0.
+	mCenterX.assign(paddedCount, 0.0f);
+	mCenterY.assign(paddedCount, 0.0f);
+	mCenterZ.assign(paddedCount, 0.0f);
+	mExtentX.assign(paddedCount, 0.0f);
+	mExtentY.assign(paddedCount, 0.0f);
+	mExtentZ.assign(paddedCount, 0.0f);
+	mRadius.assign(paddedCount, -FLT_MAX);
+}
+
+void FrustumCuller::SetBounds(UINT index, const XMFLOAT3& center, const XMFLOAT3& extents, float radius)
+{
+	assert(index < mObjectCount);
+	mCenterX[index] = center.x;
+	mCenterY[index] = center.y;
+	mCenterZ[index] = center.z;
+	mExtentX[index] = extents.x;
+	mExtentY[index] = extents.y;
+	mExtentZ[index] = extents.z;
+	mRadius[index] = radius;
+}
+
+void FrustumCuller::SetBounds(UINT index, const BoundingBox& localBounds, FXMMATRIX world)
+{
+	BoundingBox worldBounds;
+	localBounds.Transform(worldBounds, world);
+
+	//The sphere around the local box, scaled by the largest axis scale, is
+	//tighter than the sphere around the world AABB once the box is rotated.
+	float maxScale = std::max(std::max(
+		XMVectorGetX(XMVector3LengthSq(world.r[0])),
+		XMVectorGetX(XMVector3LengthSq(world.r[1]))),
+		XMVectorGetX(XMVector3LengthSq(world.r[2])));
+	float localRadius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&localBounds.Extents)));
+
+	SetBounds(index, worldBounds.Center, worldBounds.Extents, localRadius * sqrtf(maxScale));
+}
+
+void FrustumCuller::SetBounds(UINT index, const BoundingBox& worldBounds)
+{
+	float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&worldBounds.Extents)));
+	SetBounds(index, worldBounds.Center, worldBounds.Extents, radius);
+}
+
+void FrustumCuller::Cull(FXMMATRIX viewProj, std::vector<UINT>& visible)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	FrustumPlanes planes = ExtractPlanes(viewProj);
+	BoundsArrays bounds = {
+		mCenterX.data(), mCenterY.data(), mCenterZ.data(),
+		mExtentX.data(), mExtentY.data(), mExtentZ.data(),
+		mRadius.data()
+	};
+	bool useAVX2 = CpuFeatures::Get().Avx2Target();
+
+	UINT paddedCount = (UINT)mRadius.size();
+	UINT blockCount = (paddedCount + CullBlockSize - 1) / CullBlockSize;
+	mBlockVisible.resize(paddedCount);
+	mBlockCounts.resize(blockCount);
+
+	//Every block writes its visible indices at its own offset, then the
+	//blocks are packed together in order.
+	ParallelFor(0, blockCount, 1, [&](size_t firstBlock, size_t lastBlock) {
+		for (size_t block = firstBlock; block < lastBlock; ++block) {
+			UINT begin = (UINT)block * CullBlockSize;
+			UINT end = std::min(paddedCount, begin + CullBlockSize);
+			UINT* out = mBlockVisible.data() + begin;
+			mBlockCounts[block] = useAVX2 ?
+				CullBlockAVX2(bounds, planes, begin, end, out) :
+				CullBlockSSE(bounds, planes, begin, end, out);
+		}
+	});
+
+	visible.clear();
+	for (UINT block = 0; block < blockCount; ++block) {
+		const UINT* blockVisible = mBlockVisible.data() + block * CullBlockSize;
+		visible.insert(visible.end(), blockVisible, blockVisible + mBlockCounts[block]);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.Tested = mObjectCount;
+	mStats.Visible = (UINT)visible.size();
+	mStats.Milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
@@ -0,0 +1,327 @@
+#include "../../header/Render/GeometryPool.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace {
+	UINT IndexSize(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_R32_UINT ? 4 : 2;
+	}
+}
+
+GeometryPool::GeometryPool(ID3D12Device* device, UINT64 vertexArenaBytes, UINT64 indexArenaBytes) :
+	mDevice(device),
+	mVertexArenaBytes(vertexArenaBytes),
+	mIndexArenaBytes(indexArenaBytes)
+{
+}
+
+void GeometryPool::AddMesh(MeshGeometry& geo, ID3D12GraphicsCommandList* cmdList)
+{
+	assert(mMeshes.find(&geo) == mMeshes.end());
+	assert(geo.VertexBufferCPU != nullptr && geo.IndexBufferCPU != nullptr);
+
+	const UINT indexSize = IndexSize(geo.IndexFormat);
+	const UINT64 vertexCount = geo.VertexBufferByteSize / geo.VertexByteStride;
+	const UINT64 indexCount = geo.IndexBufferByteSize / indexSize;
+
+	MeshEntry entry;
+	entry.Vertices = Allocate(false, geo.VertexByteStride, DXGI_FORMAT_UNKNOWN, vertexCount, cmdList);
+	entry.Indices = Allocate(true, indexSize, geo.IndexFormat, indexCount, cmdList);
+
+	//Stage both copies in upload buffers and copy them into the arenas.
+	auto upload = [&](const Allocation& allocation, ID3DBlob* data, UINT64 byteSize, ComPtr<ID3D12Resource>& uploader) {
+		Arena& arena = mArenas[allocation.Arena];
+		ThrowIfFailed(mDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(byteSize),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(uploader.ReleaseAndGetAddressOf())
+		));
+		void* mapped = nullptr;
+		ThrowIfFailed(uploader->Map(0, nullptr, &mapped));
+		memcpy(mapped, data->GetBufferPointer(), (size_t)byteSize);
+		uploader->Unmap(0, nullptr);
+
+		Transition(arena, D3D12_RESOURCE_STATE_COPY_DEST, cmdList);
+		cmdList->CopyBufferRegion(arena.Buffer.Get(), allocation.Offset * arena.Stride,
+			uploader.Get(), 0, byteSize);
+		Transition(arena, ReadState(arena), cmdList);
+	};
+	upload(entry.Vertices, geo.VertexBufferCPU.Get(), geo.VertexBufferByteSize, geo.VertexBufferUploader);
+	upload(entry.Indices, geo.IndexBufferCPU.Get(), geo.IndexBufferByteSize, geo.IndexBufferUploader);
+
+	mMeshes[&geo] = entry;
+	RebaseSubmeshes(geo, (INT64)entry.Vertices.Offset, (INT64)entry.Indices.Offset);
+	BindMesh(geo, entry);
+}
+
+void GeometryPool::RemoveMesh(MeshGeometry& geo)
+{
+	auto it = mMeshes.find(&geo);
+	if (it == mMeshes.end()) {
+		return;
+	}
+	const MeshEntry& entry = it->second;
+
+	RebaseSubmeshes(geo, -(INT64)entry.Vertices.Offset, -(INT64)entry.Indices.Offset);
+	geo.VertexBufferByteSize = (UINT)(entry.Vertices.Count * geo.VertexByteStride);
+	geo.IndexBufferByteSize = (UINT)(entry.Indices.Count * IndexSize(geo.IndexFormat));
+	geo.VertexBufferGPU = nullptr;
+	geo.IndexBufferGPU = nullptr;
+	geo.PoolBaseVertex = 0;
+	geo.PoolStartIndex = 0;
+
+	Free(entry.Vertices);
+	Free(entry.Indices);
+	mMeshes.erase(it);
+}
+
+GeometryPool::Allocation GeometryPool::Allocate(bool isIndex, UINT stride, DXGI_FORMAT indexFormat,
+	UINT64 count, ID3D12GraphicsCommandList* cmdList)
+{
+	Allocation allocation;
+	std::vector<UINT> compatible;
+	for (UINT i = 0; i < (UINT)mArenas.size(); ++i) {
+		const Arena& arena = mArenas[i];
+		if (arena.IsIndex == isIndex && arena.Stride == stride && arena.IndexFormat == indexFormat) {
+			compatible.push_back(i);
+		}
+	}
+
+	for (UINT i : compatible) {
+		if (AllocateFromArena(i, count, allocation)) {
+			return allocation;
+		}
+	}
+	//Enough space in total but no single range large enough: pack one arena.
+	for (UINT i : compatible) {
+		if (mArenas[i].Capacity - mArenas[i].Used >= count) {
+			CompactArena(i, cmdList);
+			bool allocated = AllocateFromArena(i, count, allocation);
+			assert(allocated);
+			return allocation;
+		}
+	}
+
+	//Meshes larger than an arena get an arena of their own size.
+	UINT64 arenaBytes = isIndex ? mIndexArenaBytes : mVertexArenaBytes;
+	UINT64 capacity = std::max(arenaBytes / stride, count);
+	UINT arenaIndex = CreateArena(isIndex, stride, indexFormat, capacity);
+	bool allocated = AllocateFromArena(arenaIndex, count, allocation);
+	assert(allocated);
+	return allocation;
+}
+
+bool GeometryPool::AllocateFromArena(UINT arenaIndex, UINT64 count, Allocation& allocation)
+{
+	//First fit keeps the live data packed towards the start of the arena.
+	Arena& arena = mArenas[arenaIndex];
+	for (size_t i = 0; i < arena.FreeRanges.size(); ++i) {
+		FreeRange& range = arena.FreeRanges[i];
+		if (range.Count < count) {
+			continue;
+		}
+		allocation.Arena = arenaIndex;
+		allocation.Offset = range.Offset;
+		allocation.Count = count;
+		range.Offset += count;
+		range.Count -= count;
+		if (range.Count == 0) {
+			arena.FreeRanges.erase(arena.FreeRanges.begin() + i);
+		}
+		arena.Used += count;
+		return true;
+	}
+	return false;
+}
+
+void GeometryPool::Free(const Allocation& allocation)
+{
+	Arena& arena = mArenas[allocation.Arena];
+	std::vector<FreeRange>& ranges = arena.FreeRanges;
+	auto next = std::lower_bound(ranges.begin(), ranges.end(), allocation.Offset,
+		[](const FreeRange& range, UINT64 offset) { return range.Offset < offset; });
+	auto it = ranges.insert(next, { allocation.Offset, allocation.Count });
+
+	//Merge with the following and the preceding range.
+	if (it + 1 != ranges.end() && it->Offset + it->Count == (it + 1)->Offset) {
+		it->Count += (it + 1)->Count;
+		ranges.erase(it + 1);
+	}
+	if (it != ranges.begin() && (it - 1)->Offset + (it - 1)->Count == it->Offset) {
+		(it - 1)->Count += it->Count;
+		ranges.erase(it);
+	}
+	arena.Used -= allocation.Count;
+}
+
+UINT GeometryPool::CreateArena(bool isIndex, UINT stride, DXGI_FORMAT indexFormat, UINT64 capacity)
+{
+	Arena arena;
+	arena.IsIndex = isIndex;
+	arena.Stride = stride;
+	arena.IndexFormat = indexFormat;
+	arena.Capacity = capacity;
+	arena.FreeRanges.push_back({ 0, capacity });
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(capacity * stride),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(arena.Buffer.GetAddressOf())
+	));
+	mArenas.push_back(std::move(arena));
+	return (UINT)mArenas.size() - 1;
+}
+
+UINT GeometryPool::Compact(ID3D12GraphicsCommandList* cmdList, float minFragmentation)
+{
+	UINT compacted = 0;
+	for (UINT i = 0; i < (UINT)mArenas.size(); ++i) {
+		const Arena& arena = mArenas[i];
+		UINT64 freeCount = arena.Capacity - arena.Used;
+		if (freeCount == 0 || arena.FreeRanges.size() < 2) {
+			continue;
+		}
+		UINT64 largest = 0;
+		for (const FreeRange& range : arena.FreeRanges) {
+			largest = std::max(largest, range.Count);
+		}
+		if ((float)(freeCount - largest) / freeCount >= minFragmentation) {
+			CompactArena(i, cmdList);
+			compacted++;
+		}
+	}
+	return compacted;
+}
+
+void GeometryPool::CompactArena(UINT arenaIndex, ID3D12GraphicsCommandList* cmdList)
+{
+	Arena& arena = mArenas[arenaIndex];
+
+	//Live ranges of this arena in address order.
+	struct Live
+	{
+		MeshGeometry* Geo;
+		Allocation* Range;
+	};
+	std::vector<Live> live;
+	for (auto& mesh : mMeshes) {
+		Allocation& range = arena.IsIndex ? mesh.second.Indices : mesh.second.Vertices;
+		if (range.Arena == arenaIndex) {
+			live.push_back({ mesh.first, &range });
+		}
+	}
+	std::sort(live.begin(), live.end(), [](const Live& a, const Live& b) { return a.Range->Offset < b.Range->Offset; });
+
+	//Copies within one buffer must not overlap, so the survivors are packed
+	//into a new buffer and the old one is retired.
+	ComPtr<ID3D12Resource> oldBuffer = arena.Buffer;
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(arena.Capacity * arena.Stride),
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(arena.Buffer.ReleaseAndGetAddressOf())
+	));
+	if (arena.State != D3D12_RESOURCE_STATE_COPY_SOURCE) {
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(oldBuffer.Get(),
+			arena.State, D3D12_RESOURCE_STATE_COPY_SOURCE));
+	}
+	arena.State = D3D12_RESOURCE_STATE_COPY_DEST;
+
+	UINT64 offset = 0;
+	for (const Live& entry : live) {
+		Allocation& range = *entry.Range;
+		cmdList->CopyBufferRegion(arena.Buffer.Get(), offset * arena.Stride,
+			oldBuffer.Get(), range.Offset * arena.Stride, range.Count * arena.Stride);
+		mBytesMoved += range.Count * arena.Stride;
+
+		INT64 delta = (INT64)offset - (INT64)range.Offset;
+		if (arena.IsIndex) {
+			RebaseSubmeshes(*entry.Geo, 0, delta);
+		}
+		else {
+			RebaseSubmeshes(*entry.Geo, delta, 0);
+		}
+		range.Offset = offset;
+		offset += range.Count;
+	}
+	Transition(arena, ReadState(arena), cmdList);
+
+	arena.FreeRanges.clear();
+	if (offset < arena.Capacity) {
+		arena.FreeRanges.push_back({ offset, arena.Capacity - offset });
+	}
+	for (const Live& entry : live) {
+		BindMesh(*entry.Geo, mMeshes[entry.Geo]);
+	}
+
+	mRetiredBuffers.push_back(oldBuffer);
+	mCompactions++;
+}
+
+void GeometryPool::ReleaseRetiredBuffers()
+{
+	mRetiredBuffers.clear();
+}
+
+void GeometryPool::Transition(Arena& arena, D3D12_RESOURCE_STATES state, ID3D12GraphicsCommandList* cmdList)
+{
+	if (arena.State == state) {
+		return;
+	}
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(arena.Buffer.Get(), arena.State, state));
+	arena.State = state;
+}
+
+D3D12_RESOURCE_STATES GeometryPool::ReadState(const Arena& arena)
+{
+	return arena.IsIndex ? D3D12_RESOURCE_STATE_INDEX_BUFFER : D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+}
+
+void GeometryPool::BindMesh(MeshGeometry& geo, const MeshEntry& entry)
+{
+	//The views cover whole arenas so that every mesh in them binds identically.
+	const Arena& vertexArena = mArenas[entry.Vertices.Arena];
+	const Arena& indexArena = mArenas[entry.Indices.Arena];
+	geo.VertexBufferGPU = vertexArena.Buffer;
+	geo.IndexBufferGPU = indexArena.Buffer;
+	geo.VertexBufferByteSize = (UINT)(vertexArena.Capacity * vertexArena.Stride);
+	geo.IndexBufferByteSize = (UINT)(indexArena.Capacity * indexArena.Stride);
+	geo.PoolBaseVertex = (INT)entry.Vertices.Offset;
+	geo.PoolStartIndex = (UINT)entry.Indices.Offset;
+}
+
+void GeometryPool::RebaseSubmeshes(MeshGeometry& geo, INT64 vertexDelta, INT64 indexDelta)
+{
+	for (auto& submesh : geo.DrawArgs) {
+		submesh.second.BaseVertexLocation = (INT)(submesh.second.BaseVertexLocation + vertexDelta);
+		submesh.second.StartIndexLocation = (UINT)(submesh.second.StartIndexLocation + indexDelta);
+	}
+}
+
+GeometryPoolStats GeometryPool::Stats() const
+{
+	GeometryPoolStats stats;
+	stats.Arenas = (UINT)mArenas.size();
+	stats.Meshes = (UINT)mMeshes.size();
+	for (const Arena& arena : mArenas) {
+		UINT64 largest = 0;
+		for (const FreeRange& range : arena.FreeRanges) {
+			largest = std::max(largest, range.Count);
+		}
+		stats.CapacityBytes += arena.Capacity * arena.Stride;
+		stats.UsedBytes += arena.Used * arena.Stride;
+		stats.FreeBytes += (arena.Capacity - arena.Used) * arena.Stride;
+		stats.FragmentedBytes += (arena.Capacity - arena.Used - largest) * arena.Stride;
+	}
+	stats.Compactions = mCompactions;
+	stats.BytesMoved = mBytesMoved;
+	return stats;
+}
@@ -0,0 +1,126 @@
+#include "../../header/Render/InstanceBatcher.h"
+
+using namespace DirectX;
+
+void InstanceBatcher::Begin()
+{
+	mItems.clear();
+	mItemSubmeshes.clear();
+	mItemRanges.clear();
+	mRanges.clear();
+	mBatches.clear();
+	mBatchLookup.clear();
+	mStats = InstanceBatchStats();
+}
+
+void InstanceBatcher::Add(const RenderItem& item, const SubmeshGeometry* submesh)
+{
+	assert(item.Geo != nullptr && item.Submesh != nullptr && item.PSO != nullptr);
+	mItems.push_back(&item);
+	mItemSubmeshes.push_back(submesh != nullptr ? submesh : item.Submesh);
+	mItemRanges.emplace_back(0, 0);
+}
+
+void InstanceBatcher::AddRanges(const RenderItem& item, const SubmeshGeometry* submesh, const IndexRange* ranges,
+	UINT rangeCount)
+{
+	assert(item.Geo != nullptr && submesh != nullptr && item.PSO != nullptr && rangeCount != 0);
+	mItems.push_back(&item);
+	mItemSubmeshes.push_back(submesh);
+	mItemRanges.emplace_back((UINT)mRanges.size(), rangeCount);
+	mRanges.insert(mRanges.end(), ranges, ranges + rangeCount);
+}
+
+void InstanceBatcher::Build(UploadBuffer<InstanceData>& instanceBuffer)
+{
+	//First pass: find the batch of every item and count its instances.
+	mItemBatch.resize(mItems.size());
+	for (size_t i = 0; i < mItems.size(); ++i) {
+		const RenderItem* item = mItems[i];
+		const SubmeshGeometry* submesh = mItemSubmeshes[i];
+		BatchKey key = { item->Geo, submesh, item->PSO };
+		const bool partial = mItemRanges[i].second != 0;
+
+		auto it = partial ? mBatchLookup.end() : mBatchLookup.find(key);
+		UINT batchIndex = 0;
+		if (it == mBatchLookup.end()) {
+			batchIndex = (UINT)mBatches.size();
+			if (!partial) {
+				mBatchLookup.emplace(key, batchIndex);
+			}
+
+			InstanceBatch batch;
+			batch.Geo = item->Geo;
+			batch.Submesh = submesh;
+			batch.PSO = item->PSO;
+			batch.FirstRange = mItemRanges[i].first;
+			batch.RangeCount = mItemRanges[i].second;
+			mBatches.push_back(batch);
+		}
+		else {
+			batchIndex = it->second;
+		}
+		mBatches[batchIndex].InstanceCount++;
+		mItemBatch[i] = batchIndex;
+	}
+
+	//Lay the batches out one after another in the instance buffer.
+	mBatchCursor.resize(mBatches.size());
+	UINT instanceCount = 0;
+	for (size_t b = 0; b < mBatches.size(); ++b) {
+		mBatches[b].StartInstance = instanceCount;
+		mBatchCursor[b] = instanceCount;
+		instanceCount += mBatches[b].InstanceCount;
+	}
+	assert(instanceCount <= instanceBuffer.ElementCount() && "instance buffer is too small");
+
+	//Second pass: every instance is written exactly once, straight to its slot.
+	//Scattered 4 byte writes would be slow on the write-combined upload heap,
+	//so the slots are filled in system memory and streamed over together.
+	mInstanceData.resize(instanceCount);
+	for (size_t i = 0; i < mItems.size(); ++i) {
+		mInstanceData[mBatchCursor[mItemBatch[i]]++].ObjectIndex = mItems[i]->ObjCBIndex;
+	}
+	instanceBuffer.CopyData(0, mInstanceData.data(), (int)instanceCount);
+
+	mStats.Instances = instanceCount;
+	mStats.DrawsRequested = (UINT)mItems.size();
+	mStats.DrawsIssued = 0;
+	for (const InstanceBatch& batch : mBatches) {
+		mStats.DrawsIssued += std::max(batch.RangeCount, 1u);
+	}
+	mStats.DrawsSaved = mStats.DrawsRequested > mStats.DrawsIssued ? mStats.DrawsRequested - mStats.DrawsIssued : 0;
+}
+
+void InstanceBatcher::Submit(DrawQueue& queue, D3D12_GPU_DESCRIPTOR_HANDLE materialTable,
+	D3D12_GPU_VIRTUAL_ADDRESS instanceBufferAddress) const
+{
+	UINT materialId = queue.MaterialId(materialTable);
+
+	for (const InstanceBatch& batch : mBatches) {
+		DrawPacket packet;
+		packet.PSO = batch.PSO;
+		packet.Geo = batch.Geo;
+		packet.MaterialTable = materialTable;
+		//SV_InstanceID always starts at 0, so the batch's range is selected by
+		//offsetting the root SRV instead of using StartInstanceLocation.
+		packet.InstanceData = instanceBufferAddress + (UINT64)batch.StartInstance * sizeof(InstanceData);
+		packet.IndexCount = batch.Submesh->IndexCount;
+		packet.InstanceCount = batch.InstanceCount;
+		packet.StartIndexLocation = batch.Submesh->StartIndexLocation;
+		packet.BaseVertexLocation = batch.Submesh->BaseVertexLocation;
+
+		UINT64 key = DrawQueue::MakeKey(0, queue.PipelineId(batch.PSO), materialId,
+			queue.MeshId(batch.Geo), 0.0f);
+		if (batch.RangeCount == 0) {
+			queue.Push(key, packet);
+			continue;
+		}
+		for (UINT r = 0; r < batch.RangeCount; ++r) {
+			const IndexRange& range = mRanges[batch.FirstRange + r];
+			packet.IndexCount = range.IndexCount;
+			packet.StartIndexLocation = range.StartIndex;
+			queue.Push(key, packet);
+		}
+	}
+}
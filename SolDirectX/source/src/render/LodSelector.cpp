@@ -0,0 +1,114 @@
+#include "../../header/Render/LodSelector.h"
+#include "../../header/Common/ParallelFor.h"
+#include <atomic>
+#include <chrono>
+
+using namespace DirectX;
+
+namespace {
+	//Objects per parallel chunk.
+	const size_t SelectGrain = 2048;
+	//Distances are clamped so that a camera inside a bounding sphere gets full detail.
+	const float MinDistance = 1e-4f;
+}
+
+void LodSelector::Resize(UINT objectCount)
+{
+	mSubmeshes.assign(objectCount, nullptr);
+	mSpheres.assign(objectCount, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	mScales.assign(objectCount, 1.0f);
+	mLevels.assign(objectCount, 0);
+}
+
+void LodSelector::SetObject(UINT index, const SubmeshGeometry& submesh, FXMMATRIX world)
+{
+	assert(submesh.Lods.size() < LodSelectStats::MaxLevels);
+	mSubmeshes[index] = &submesh;
+	mLevels[index] = 0;
+
+	BoundingSphere localSphere, worldSphere;
+	BoundingSphere::CreateFromBoundingBox(localSphere, submesh.Bounds);
+	localSphere.Transform(worldSphere, world);
+	mSpheres[index] = XMFLOAT4(worldSphere.Center.x, worldSphere.Center.y, worldSphere.Center.z, worldSphere.Radius);
+
+	float scaleX = XMVectorGetX(XMVector3Length(world.r[0]));
+	float scaleY = XMVectorGetX(XMVector3Length(world.r[1]));
+	float scaleZ = XMVectorGetX(XMVector3Length(world.r[2]));
+	mScales[index] = std::max(scaleX, std::max(scaleY, scaleZ));
+}
+
+void LodSelector::SetProjection(float fovY, UINT viewportHeight)
+{
+	mPixelsPerUnit = viewportHeight / (2.0f * tanf(0.5f * fovY));
+}
+
+void LodSelector::Select(FXMVECTOR eyePosition, const std::vector<UINT>& objects)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	XMFLOAT3 eye;
+	XMStoreFloat3(&eye, eyePosition);
+	const float threshold = ErrorThreshold;
+	const float coarsenThreshold = ErrorThreshold * (1.0f - Hysteresis);
+
+	std::atomic<UINT> switches(0);
+	ParallelFor(0, objects.size(), SelectGrain, [&](size_t begin, size_t end) {
+		UINT chunkSwitches = 0;
+		for (size_t i = begin; i < end; ++i) {
+			UINT index = objects[i];
+			const SubmeshGeometry* submesh = mSubmeshes[index];
+			const UINT levelCount = (UINT)submesh->Lods.size() + 1;
+			if (levelCount == 1) {
+				continue;
+			}
+
+			const XMFLOAT4& sphere = mSpheres[index];
+			float dx = sphere.x - eye.x;
+			float dy = sphere.y - eye.y;
+			float dz = sphere.z - eye.z;
+			float distance = std::max(sqrtf(dx * dx + dy * dy + dz * dz) - sphere.w, MinDistance);
+			//Pixels per object space unit of error.
+			float errorToPixels = mScales[index] * mPixelsPerUnit / distance;
+
+			auto levelError = [submesh](UINT level) {
+				return level == 0 ? 0.0f : submesh->Lods[level - 1]->LodError;
+			};
+			auto coarsestWithin = [&](float limit) {
+				UINT level = 0;
+				while (level + 1 < levelCount && levelError(level + 1) * errorToPixels <= limit) {
+					++level;
+				}
+				return level;
+			};
+
+			//Refine as soon as the current level is too coarse, coarsen only with margin.
+			UINT current = mLevels[index];
+			UINT level = current;
+			if (levelError(current) * errorToPixels > threshold) {
+				level = coarsestWithin(threshold);
+			}
+			else {
+				level = std::max(current, coarsestWithin(coarsenThreshold));
+			}
+			mLevels[index] = (BYTE)level;
+			chunkSwitches += level != current ? 1 : 0;
+		}
+		switches += chunkSwitches;
+	});
+
+	//Statistics in a serial pass, it is cheap next to the selection.
+	mStats.Objects = (UINT)objects.size();
+	mStats.Switches = switches;
+	mStats.FullDetailTriangles = 0;
+	mStats.DrawnTriangles = 0;
+	std::fill(std::begin(mStats.ObjectsPerLevel), std::end(mStats.ObjectsPerLevel), 0);
+	for (UINT index : objects) {
+		UINT level = mLevels[index];
+		mStats.ObjectsPerLevel[level]++;
+		mStats.FullDetailTriangles += mSubmeshes[index]->IndexCount / 3;
+		mStats.DrawnTriangles += Submesh(index)->IndexCount / 3;
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	mStats.Milliseconds = elapsed.count();
+}
@@ -0,0 +1,206 @@
+#include "../../header/Render/MeshBuilder.h"
+#include "../../header/Geometry/VertexQuantizer.h"
+#include <atomic>
+
+using namespace DirectX;
+
+namespace {
+	//A range of a mapped file exposed as a blob. Holding the blob holds the mapping.
+	class MappedBlob : public ID3DBlob
+	{
+	public:
+		MappedBlob(std::shared_ptr<MappedFile> file, size_t offset, size_t size) :
+			mFile(std::move(file)),
+			mOffset(offset),
+			mSize(size)
+		{
+		}
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object) override
+		{
+			if (object == nullptr) {
+				return E_POINTER;
+			}
+			if (riid == __uuidof(IUnknown) || riid == __uuidof(ID3D10Blob)) {
+				AddRef();
+				*object = static_cast<ID3DBlob*>(this);
+				return S_OK;
+			}
+			*object = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef() override
+		{
+			return ++mRefCount;
+		}
+
+		ULONG STDMETHODCALLTYPE Release() override
+		{
+			ULONG count = --mRefCount;
+			if (count == 0) {
+				delete this;
+			}
+			return count;
+		}
+
+		LPVOID STDMETHODCALLTYPE GetBufferPointer() override
+		{
+			return mFile->Data() + mOffset;
+		}
+
+		SIZE_T STDMETHODCALLTYPE GetBufferSize() override
+		{
+			return mSize;
+		}
+
+	private:
+		virtual ~MappedBlob() = default;
+
+		std::atomic<ULONG> mRefCount{ 1 };
+		std::shared_ptr<MappedFile> mFile;
+		size_t mOffset;
+		size_t mSize;
+	};
+
+	//Adds the DrawArgs entry of part. Levels of detail are linked to the full
+	//detail part before them; map entries keep their address, so they can
+	//point at each other.
+	void AddSubmesh(MeshGeometry& geo, const MeshPart& part, const float boundsMin[3], const float boundsMax[3],
+		SubmeshGeometry*& fullDetail)
+	{
+		SubmeshGeometry& entry = geo.DrawArgs[part.Name];
+		entry.IndexCount = part.IndexCount;
+		entry.StartIndexLocation = part.IndexStart;
+		entry.BaseVertexLocation = part.BaseVertex;
+		BoundingBox::CreateFromPoints(entry.Bounds,
+			XMVectorSet(boundsMin[0], boundsMin[1], boundsMin[2], 0.0f),
+			XMVectorSet(boundsMax[0], boundsMax[1], boundsMax[2], 0.0f));
+		entry.LodError = part.LodError;
+
+		if (part.Lod == 0) {
+			fullDetail = &entry;
+		}
+		else {
+			assert(fullDetail != nullptr && "levels of detail follow their full detail part");
+			fullDetail->Lods.push_back(&entry);
+		}
+	}
+
+	void SetPositionFormat(MeshGeometry& geo, PositionFormat format, const PositionDequantization& dq)
+	{
+		geo.PositionFormat = ToDxgiFormat(format);
+		geo.PositionScale = XMFLOAT3(dq.Scale[0], dq.Scale[1], dq.Scale[2]);
+		geo.PositionBias = XMFLOAT3(dq.Bias[0], dq.Bias[1], dq.Bias[2]);
+	}
+}
+
+DXGI_FORMAT ToDxgiFormat(PositionFormat format)
+{
+	switch (format) {
+	case PositionFormat::Half4: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	case PositionFormat::Unorm16x4: return DXGI_FORMAT_R16G16B16A16_UNORM;
+	default: return DXGI_FORMAT_R32G32B32_FLOAT;
+	}
+}
+
+DXGI_FORMAT ToDxgiFormat(NormalFormat format)
+{
+	return format == NormalFormat::Oct16 ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT;
+}
+
+DXGI_FORMAT ToDxgiFormat(ColorFormat format)
+{
+	return format == ColorFormat::Unorm8x4 ? DXGI_FORMAT_R8G8B8A8_UNORM : DXGI_FORMAT_R32G32B32A32_FLOAT;
+}
+
+void BuildInputLayout(const VertexFormat& format, std::vector<D3D12_INPUT_ELEMENT_DESC>& layout)
+{
+	layout.clear();
+	layout.push_back({ "POSITION", 0, ToDxgiFormat(format.Position), 0, format.PositionOffset(),
+		D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	if (format.Normal != NormalFormat::None) {
+		layout.push_back({ "NORMAL", 0, ToDxgiFormat(format.Normal), 0, format.NormalOffset(),
+			D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
+	if (format.Color != ColorFormat::None) {
+		layout.push_back({ "COLOR", 0, ToDxgiFormat(format.Color), 0, format.ColorOffset(),
+			D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
+}
+
+std::unique_ptr<MeshGeometry> BuildMeshGeometry(const MeshData& mesh)
+{
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = mesh.Name;
+
+	const bool use16Bit = mesh.Fits16BitIndices();
+	const UINT vbByteSize = (UINT)mesh.Vertices.size();
+	const UINT ibByteSize = (UINT)mesh.Indices.size() * (use16Bit ? sizeof(uint16_t) : sizeof(uint32_t));
+
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), mesh.Vertices.data(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	if (use16Bit) {
+		uint16_t* indices = reinterpret_cast<uint16_t*>(geo->IndexBufferCPU->GetBufferPointer());
+		for (size_t i = 0; i < mesh.Indices.size(); ++i) {
+			indices[i] = (uint16_t)mesh.Indices[i];
+		}
+	}
+	else {
+		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), mesh.Indices.data(), ibByteSize);
+	}
+
+	geo->VertexByteStride = mesh.VertexStride;
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexFormat = use16Bit ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	geo->IndexBufferByteSize = ibByteSize;
+	SetPositionFormat(*geo, mesh.Format.Position, mesh.Dequantization);
+
+	SubmeshGeometry* fullDetail = nullptr;
+	for (const MeshPart& part : mesh.Parts) {
+		float boundsMin[3], boundsMax[3];
+		ComputePartBounds(mesh, part, boundsMin, boundsMax);
+		AddSubmesh(*geo, part, boundsMin, boundsMax, fullDetail);
+	}
+	return geo;
+}
+
+std::unique_ptr<MeshGeometry> LoadMeshGeometry(const std::shared_ptr<MappedFile>& file, const MeshFileView& view)
+{
+	const MeshFileHeader& header = view.Header();
+	assert(reinterpret_cast<const uint8_t*>(&header) == file->Data());
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = view.Name();
+
+	if (view.Compressed()) {
+		ThrowIfFailed(D3DCreateBlob((SIZE_T)view.VertexBytes(), &geo->VertexBufferCPU));
+		ThrowIfFailed(D3DCreateBlob((SIZE_T)view.IndexBytes(), &geo->IndexBufferCPU));
+		if (!view.ReadVertices(geo->VertexBufferCPU->GetBufferPointer()) ||
+			!view.ReadIndices(geo->IndexBufferCPU->GetBufferPointer())) {
+			return nullptr;
+		}
+	}
+	else {
+		//The blobs alias the mapping, nothing is read until the uploader touches the pages.
+		const MeshFileRange& vertices = view.Stream(MeshFileStreamVertices);
+		const MeshFileRange& indices = view.Stream(MeshFileStreamIndices);
+		geo->VertexBufferCPU.Attach(new MappedBlob(file, (size_t)vertices.Offset, (size_t)vertices.Size));
+		geo->IndexBufferCPU.Attach(new MappedBlob(file, (size_t)indices.Offset, (size_t)indices.Size));
+	}
+
+	geo->VertexByteStride = header.VertexStride;
+	geo->VertexBufferByteSize = (UINT)view.VertexBytes();
+	geo->IndexFormat = header.IndexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	geo->IndexBufferByteSize = (UINT)view.IndexBytes();
+	SetPositionFormat(*geo, view.Format().Position, view.Dequantization());
+
+	SubmeshGeometry* fullDetail = nullptr;
+	for (uint32_t i = 0; i < view.PartCount(); ++i) {
+		const MeshFilePart& filePart = view.Parts()[i];
+		AddSubmesh(*geo, view.Part(i), filePart.BoundsMin, filePart.BoundsMax, fullDetail);
+	}
+	return geo;
+}
@@ -0,0 +1,300 @@
+#include "../../header/Render/OcclusionCuller.h"
+#include "../../header/Common/ParallelFor.h"
+#include <immintrin.h>
+#include <cfloat>
+#include <chrono>
+
+using namespace DirectX;
+
+namespace {
+	//Keeps numerical noise in the interpolated depth from letting an
+	//occluder hide itself.
+	const float DepthBias = 1e-6f;
+	const UINT TestGrain = 64;
+}
+
+void OcclusionCuller::SetResolution(UINT width, UINT height)
+{
+	mTilesX = (std::max(width, 1u) + TileSize - 1) / TileSize;
+	mTilesY = (std::max(height, 1u) + TileSize - 1) / TileSize;
+	mWidth = mTilesX * TileSize;
+	mHeight = mTilesY * TileSize;
+	mDepth.assign((size_t)mWidth * mHeight, 1.0f);
+	mTileMaxDepth.assign((size_t)mTilesX * mTilesY, 1.0f);
+}
+
+void OcclusionCuller::Resize(UINT objectCount)
+{
+	mWorldBounds.resize(objectCount);
+}
+
+void OcclusionCuller::SetBounds(UINT index, const BoundingBox& localBounds, FXMMATRIX world)
+{
+	localBounds.Transform(mWorldBounds[index], world);
+}
+
+void OcclusionCuller::SelectOccluders(const std::vector<UINT>& candidates, FXMVECTOR eyePos,
+	UINT maxCount, std::vector<UINT>& occluders) const
+{
+	std::vector<std::pair<float, UINT>> scored;
+	scored.reserve(candidates.size());
+	for (UINT index : candidates) {
+		const BoundingBox& box = mWorldBounds[index];
+		float sizeSq = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&box.Extents)));
+		float distSq = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&box.Center), eyePos)));
+		scored.push_back({ sizeSq / std::max(distSq, 1e-6f), index });
+	}
+
+	UINT count = std::min(maxCount, (UINT)scored.size());
+	std::partial_sort(scored.begin(), scored.begin() + count, scored.end(),
+		[](const std::pair<float, UINT>& a, const std::pair<float, UINT>& b) { return a.first > b.first; });
+	occluders.clear();
+	for (UINT i = 0; i < count; ++i) {
+		occluders.push_back(scored[i].second);
+	}
+}
+
+void OcclusionCuller::BeginFrame(FXMMATRIX viewProj)
+{
+	XMStoreFloat4x4(&mViewProj, viewProj);
+	mTriangles.clear();
+	mStats = OcclusionCullStats();
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3* positions, UINT triangleCount, FXMMATRIX world)
+{
+	XMMATRIX worldViewProj = XMMatrixMultiply(world, XMLoadFloat4x4(&mViewProj));
+	const float width = (float)mWidth;
+	const float height = (float)mHeight;
+
+	for (UINT t = 0; t < triangleCount; ++t) {
+		float x[3], y[3], z[3];
+		bool clipped = false;
+		for (int v = 0; v < 3; ++v) {
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&positions[3 * t + v]), worldViewProj));
+			//遮挡体只会让结果更保守,跨过近平面的三角形直接丢掉,不做裁剪
+			if (clip.z < 0.0f || clip.w <= 0.0f) {
+				clipped = true;
+				break;
+			}
+			float invW = 1.0f / clip.w;
+			x[v] = (clip.x * invW * 0.5f + 0.5f) * width;
+			y[v] = (0.5f - clip.y * invW * 0.5f) * height;
+			z[v] = clip.z * invW;
+		}
+		if (clipped) {
+			continue;
+		}
+
+		//Screen y points down, so clockwise front faces have a positive area.
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area <= 0.0f) {
+			continue;
+		}
+
+		Triangle tri;
+		float minX = std::min(x[0], std::min(x[1], x[2]));
+		float maxX = std::max(x[0], std::max(x[1], x[2]));
+		float minY = std::min(y[0], std::min(y[1], y[2]));
+		float maxY = std::max(y[0], std::max(y[1], y[2]));
+		//Pixels whose centers lie inside the bounding rectangle.
+		tri.MinX = std::max((int)ceilf(minX - 0.5f), 0);
+		tri.MaxX = std::min((int)floorf(maxX - 0.5f), (int)mWidth - 1);
+		tri.MinY = std::max((int)ceilf(minY - 0.5f), 0);
+		tri.MaxY = std::min((int)floorf(maxY - 0.5f), (int)mHeight - 1);
+		if (tri.MinX > tri.MaxX || tri.MinY > tri.MaxY) {
+			continue;
+		}
+
+		//E(a,b,p) = (b.x-a.x)(p.y-a.y) - (b.y-a.y)(p.x-a.x), positive inside for all three edges.
+		for (int e = 0; e < 3; ++e) {
+			int a = e;
+			int b = (e + 1) % 3;
+			tri.EdgeA[e] = -(y[b] - y[a]);
+			tri.EdgeB[e] = x[b] - x[a];
+			tri.EdgeC[e] = (y[b] - y[a]) * x[a] - (x[b] - x[a]) * y[a];
+		}
+
+		//z = z0 + b1(z1-z0) + b2(z2-z0), b1 = E(v2,v0,p)/area, b2 = E(v0,v1,p)/area.
+		float invArea = 1.0f / area;
+		float dz1 = (z[1] - z[0]) * invArea;
+		float dz2 = (z[2] - z[0]) * invArea;
+		tri.ZA = dz1 * tri.EdgeA[2] + dz2 * tri.EdgeA[0];
+		tri.ZB = dz1 * tri.EdgeB[2] + dz2 * tri.EdgeB[0];
+		tri.ZC = z[0] + dz1 * tri.EdgeC[2] + dz2 * tri.EdgeC[0];
+
+		mTriangles.push_back(tri);
+	}
+	mStats.Occluders++;
+}
+
+void OcclusionCuller::RasterizeTileRow(UINT tileRow)
+{
+	const int rowBegin = (int)(tileRow * TileSize);
+	const int rowEnd = rowBegin + (int)TileSize;
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (int y = rowBegin; y < rowEnd; ++y) {
+		float* row = mDepth.data() + (size_t)y * mWidth;
+		for (UINT x = 0; x < mWidth; ++x) {
+			row[x] = 1.0f;
+		}
+	}
+
+	for (const Triangle& tri : mTriangles) {
+		int yBegin = std::max(tri.MinY, rowBegin);
+		int yEnd = std::min(tri.MaxY + 1, rowEnd);
+		if (yBegin >= yEnd) {
+			continue;
+		}
+
+		const __m128 a0 = _mm_set1_ps(tri.EdgeA[0]);
+		const __m128 a1 = _mm_set1_ps(tri.EdgeA[1]);
+		const __m128 a2 = _mm_set1_ps(tri.EdgeA[2]);
+		const __m128 za = _mm_set1_ps(tri.ZA);
+		//The width is a multiple of the tile size, so 4-wide steps never leave the row.
+		const int xBegin = tri.MinX & ~3;
+
+		for (int y = yBegin; y < yEnd; ++y) {
+			float py = y + 0.5f;
+			__m128 r0 = _mm_set1_ps(tri.EdgeB[0] * py + tri.EdgeC[0]);
+			__m128 r1 = _mm_set1_ps(tri.EdgeB[1] * py + tri.EdgeC[1]);
+			__m128 r2 = _mm_set1_ps(tri.EdgeB[2] * py + tri.EdgeC[2]);
+			__m128 rz = _mm_set1_ps(tri.ZB * py + tri.ZC);
+			float* row = mDepth.data() + (size_t)y * mWidth;
+
+			for (int x = xBegin; x <= tri.MaxX; x += 4) {
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffsets);
+				__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), r0);
+				__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), r1);
+				__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), r2);
+				__m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+					_mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+				if (_mm_movemask_ps(inside) == 0) {
+					continue;
+				}
+				__m128 z = _mm_add_ps(_mm_mul_ps(za, px), rz);
+				__m128 depth = _mm_loadu_ps(row + x);
+				__m128 nearer = _mm_min_ps(depth, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, depth)));
+			}
+		}
+	}
+
+	//Farthest depth of every tile in this row.
+	for (UINT tileX = 0; tileX < mTilesX; ++tileX) {
+		__m128 tileMax = _mm_setzero_ps();
+		for (int y = rowBegin; y < rowEnd; ++y) {
+			const float* p = mDepth.data() + (size_t)y * mWidth + tileX * TileSize;
+			tileMax = _mm_max_ps(tileMax, _mm_max_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4)));
+		}
+		tileMax = _mm_max_ps(tileMax, _mm_shuffle_ps(tileMax, tileMax, _MM_SHUFFLE(1, 0, 3, 2)));
+		tileMax = _mm_max_ps(tileMax, _mm_shuffle_ps(tileMax, tileMax, _MM_SHUFFLE(2, 3, 0, 1)));
+		mTileMaxDepth[tileRow * mTilesX + tileX] = _mm_cvtss_f32(tileMax);
+	}
+}
+
+void OcclusionCuller::RasterizeOccluders()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//Every tile row is owned by one thread, so no depth write is shared.
+	ParallelFor(0, mTilesY, 1, [this](size_t first, size_t last) {
+		for (size_t tileRow = first; tileRow < last; ++tileRow) {
+			RasterizeTileRow((UINT)tileRow);
+		}
+	});
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.OccluderTriangles = (UINT)mTriangles.size();
+	mStats.RasterMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+bool OcclusionCuller::IsOccluded(const BoundingBox& worldBounds) const
+{
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	worldBounds.GetCorners(corners);
+	XMMATRIX viewProj = XMLoadFloat4x4(&mViewProj);
+
+	float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+	for (UINT i = 0; i < BoundingBox::CORNER_COUNT; ++i) {
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corners[i]), viewProj));
+		//Boxes reaching through the near plane cover the camera; keep them.
+		if (clip.z < 0.0f || clip.w <= 0.0f) {
+			return false;
+		}
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * mWidth;
+		float y = (0.5f - clip.y * invW * 0.5f) * mHeight;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minZ = std::min(minZ, clip.z * invW);
+	}
+
+	//Every pixel the screen rectangle touches has to be covered by something nearer.
+	int x0 = std::max((int)floorf(minX), 0);
+	int x1 = std::min((int)floorf(maxX), (int)mWidth - 1);
+	int y0 = std::max((int)floorf(minY), 0);
+	int y1 = std::min((int)floorf(maxY), (int)mHeight - 1);
+	if (x0 > x1 || y0 > y1) {
+		return false;
+	}
+	const float threshold = minZ - DepthBias;
+	const __m128 threshold4 = _mm_set1_ps(threshold);
+
+	for (int tileY = y0 / (int)TileSize; tileY <= y1 / (int)TileSize; ++tileY) {
+		for (int tileX = x0 / (int)TileSize; tileX <= x1 / (int)TileSize; ++tileX) {
+			if (mTileMaxDepth[tileY * mTilesX + tileX] < threshold) {
+				continue;
+			}
+			int px0 = std::max(x0, tileX * (int)TileSize);
+			int px1 = std::min(x1, tileX * (int)TileSize + (int)TileSize - 1);
+			int py0 = std::max(y0, tileY * (int)TileSize);
+			int py1 = std::min(y1, tileY * (int)TileSize + (int)TileSize - 1);
+			for (int y = py0; y <= py1; ++y) {
+				const float* row = mDepth.data() + (size_t)y * mWidth;
+				int x = px0;
+				for (; x + 3 <= px1; x += 4) {
+					if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), threshold4)) != 0) {
+						return false;
+					}
+				}
+				for (; x <= px1; ++x) {
+					if (row[x] >= threshold) {
+						return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+void OcclusionCuller::Cull(const std::vector<UINT>& candidates, std::vector<UINT>& visible)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	mVisibleFlags.resize(candidates.size());
+	ParallelFor(0, candidates.size(), TestGrain, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) {
+			mVisibleFlags[i] = IsOccluded(mWorldBounds[candidates[i]]) ? 0 : 1;
+		}
+	});
+
+	visible.clear();
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		if (mVisibleFlags[i]) {
+			visible.push_back(candidates[i]);
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mStats.Tested = (UINT)candidates.size();
+	mStats.Occluded = mStats.Tested - (UINT)visible.size();
+	mStats.TestMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
@@ -0,0 +1,72 @@
+#include "../../header/Render/StaticBatches.h"
+#include "../../header/Render/MeshBuilder.h"
+#include <chrono>
+
+using namespace DirectX;
+
+void StaticBatches::Build(ID3D12Device* device, const MeshData& mesh, ID3D12PipelineState* pso, GeometryPool& pool,
+	ID3D12GraphicsCommandList* cmdList, UINT objectIndex)
+{
+	mGeo = BuildMeshGeometry(mesh);
+	mPSO = pso;
+	pool.AddMesh(*mGeo, cmdList);
+
+	//顶点已经在世界空间,包围盒直接用于剔除
+	mBatches.clear();
+	mStats = StaticBatchStats();
+	mCuller.Resize((UINT)mesh.Parts.size());
+	for (const MeshPart& part : mesh.Parts) {
+		const SubmeshGeometry* submesh = &mGeo->DrawArgs.at(part.Name);
+		mCuller.SetBounds((UINT)mBatches.size(), submesh->Bounds);
+		mBatches.push_back(submesh);
+		mStats.Triangles += submesh->IndexCount / 3;
+	}
+	mStats.Batches = (UINT)mBatches.size();
+
+	//The only transform left is the dequantization, it comes with the geometry.
+	mItem = RenderItem();
+	mItem.Geo = mGeo.get();
+	mItem.PSO = pso;
+	mItem.ObjCBIndex = objectIndex;
+	InstanceData data;
+	data.ObjectIndex = objectIndex;
+	mInstance = std::make_unique<UploadBuffer<InstanceData>>(device, 1, false);
+	mInstance->CopyData(0, data);
+}
+
+void StaticBatches::Cull(CXMMATRIX viewProj)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	mCuller.Cull(viewProj, mVisible);
+
+	mStats.Visible = (UINT)mVisible.size();
+	mStats.VisibleTriangles = 0;
+	for (UINT index : mVisible) {
+		mStats.VisibleTriangles += mBatches[index]->IndexCount / 3;
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	mStats.Milliseconds = elapsed.count();
+}
+
+void StaticBatches::Submit(DrawQueue& queue, D3D12_GPU_DESCRIPTOR_HANDLE materialTable) const
+{
+	if (mGeo == nullptr) {
+		return;
+	}
+	UINT64 key = DrawQueue::MakeKey(0, queue.PipelineId(mPSO), queue.MaterialId(materialTable),
+		queue.MeshId(mGeo.get()), 0.0f);
+
+	DrawPacket packet;
+	packet.PSO = mPSO;
+	packet.Geo = mGeo.get();
+	packet.MaterialTable = materialTable;
+	packet.InstanceData = mInstance->Resource()->GetGPUVirtualAddress();
+	for (UINT index : mVisible) {
+		const SubmeshGeometry& submesh = *mBatches[index];
+		packet.IndexCount = submesh.IndexCount;
+		packet.StartIndexLocation = submesh.StartIndexLocation;
+		packet.BaseVertexLocation = submesh.BaseVertexLocation;
+		queue.Push(key, packet);
+	}
+}
@@ -0,0 +1,496 @@
+#include "../../header/Scene/Bvh.h"
+#include "../../header/Common/MathHelper.h"
+#include "../../header/Common/ParallelFor.h"
+#include <mutex>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace {
+	const UINT BinCount = 16;
+	const UINT MaxLeafSize = 4;
+	//Leaves may hold more primitives when splitting is not worth it by SAH.
+	const UINT MaxSahLeafSize = 16;
+	//Ranges this large are binned in parallel and split at the top level;
+	//smaller ones become subtrees built by a single thread each.
+	const UINT ParallelBuildThreshold = 32 * 1024;
+	const UINT ParallelGrain = 8 * 1024;
+
+	struct Aabb
+	{
+		float Min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float Max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		void Grow(const XMFLOAT3& mn, const XMFLOAT3& mx)
+		{
+			Min[0] = std::min(Min[0], mn.x); Min[1] = std::min(Min[1], mn.y); Min[2] = std::min(Min[2], mn.z);
+			Max[0] = std::max(Max[0], mx.x); Max[1] = std::max(Max[1], mx.y); Max[2] = std::max(Max[2], mx.z);
+		}
+		void Grow(const XMFLOAT3& p)
+		{
+			Grow(p, p);
+		}
+		void Grow(const Aabb& box)
+		{
+			for (int i = 0; i < 3; ++i) {
+				Min[i] = std::min(Min[i], box.Min[i]);
+				Max[i] = std::max(Max[i], box.Max[i]);
+			}
+		}
+		float Area() const
+		{
+			float dx = Max[0] - Min[0], dy = Max[1] - Min[1], dz = Max[2] - Min[2];
+			if (dx < 0.0f || dy < 0.0f || dz < 0.0f) {
+				return 0.0f;
+			}
+			return 2.0f * (dx * dy + dy * dz + dz * dx);
+		}
+	};
+
+	struct Bin
+	{
+		Aabb Bounds;
+		UINT Count = 0;
+	};
+
+	float NodeArea(const BvhNode& node)
+	{
+		Aabb box;
+		box.Grow(node.BoundsMin, node.BoundsMax);
+		return box.Area();
+	}
+
+	UINT BinIndex(float centroid, float binMin, float binScale)
+	{
+		int bin = (int)((centroid - binMin) * binScale);
+		return (UINT)std::min(std::max(bin, 0), (int)BinCount - 1);
+	}
+}
+
+void Bvh::Build(const BoundingBox* primBounds, UINT primCount)
+{
+	mNodes.clear();
+	mParents.clear();
+	mDirtyPrims.clear();
+	mPrimMin.resize(primCount);
+	mPrimMax.resize(primCount);
+	mPrimCentroid.resize(primCount);
+	mPrimIndices.resize(primCount);
+	mPrimLeaf.resize(primCount);
+	if (primCount == 0) {
+		mBuildCost = 0.0f;
+		return;
+	}
+
+	ParallelFor(0, primCount, ParallelGrain, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			const BoundingBox& b = primBounds[i];
+			mPrimMin[i] = XMFLOAT3(b.Center.x - b.Extents.x, b.Center.y - b.Extents.y, b.Center.z - b.Extents.z);
+			mPrimMax[i] = XMFLOAT3(b.Center.x + b.Extents.x, b.Center.y + b.Extents.y, b.Center.z + b.Extents.z);
+			mPrimCentroid[i] = b.Center;
+		}
+	});
+	std::iota(mPrimIndices.begin(), mPrimIndices.end(), 0u);
+
+	//Top levels: split the large ranges one after another, binning each in parallel.
+	mNodes.reserve(2 * primCount);
+	mNodes.push_back(BvhNode());
+	std::vector<BuildTask> work = { { 0, 0, primCount, 0 } };
+	std::vector<BuildTask> subtrees;
+	while (!work.empty()) {
+		BuildTask task = work.back();
+		work.pop_back();
+		if (task.End - task.Begin < ParallelBuildThreshold) {
+			subtrees.push_back(task);
+			continue;
+		}
+		BuildRange(mNodes, task, true, work);
+	}
+
+	//Bottom levels: every subtree is built on one thread into its own array...
+	std::vector<std::vector<BvhNode>> localNodes(subtrees.size());
+	ParallelFor(0, subtrees.size(), 1, [&](size_t first, size_t last) {
+		for (size_t s = first; s < last; ++s) {
+			std::vector<BvhNode>& nodes = localNodes[s];
+			nodes.reserve(2 * (subtrees[s].End - subtrees[s].Begin));
+			nodes.push_back(BvhNode());
+			std::vector<BuildTask> stack = { { 0, subtrees[s].Begin, subtrees[s].End, subtrees[s].Depth } };
+			while (!stack.empty()) {
+				BuildTask task = stack.back();
+				stack.pop_back();
+				BuildRange(nodes, task, false, stack);
+			}
+		}
+	});
+
+	//...and appended in task order, so the layout does not depend on the thread count.
+	for (size_t s = 0; s < subtrees.size(); ++s) {
+		const std::vector<BvhNode>& nodes = localNodes[s];
+		UINT offset = (UINT)mNodes.size() - 1;
+		auto relocate = [offset](BvhNode node) {
+			if (!node.IsLeaf()) {
+				node.LeftFirst += offset;
+			}
+			return node;
+		};
+		mNodes[subtrees[s].Node] = relocate(nodes[0]);
+		for (size_t i = 1; i < nodes.size(); ++i) {
+			mNodes.push_back(relocate(nodes[i]));
+		}
+	}
+
+	//Parents for the refit, leaves of every primitive for incremental updates.
+	mParents.assign(mNodes.size(), UINT_MAX);
+	for (UINT i = 0; i < (UINT)mNodes.size(); ++i) {
+		const BvhNode& node = mNodes[i];
+		if (node.IsLeaf()) {
+			for (UINT p = 0; p < node.PrimCount; ++p) {
+				mPrimLeaf[mPrimIndices[node.LeftFirst + p]] = i;
+			}
+		}
+		else {
+			mParents[node.LeftFirst] = i;
+			mParents[node.LeftFirst + 1] = i;
+		}
+	}
+
+	mBuildCost = SahCost();
+}
+
+void Bvh::BuildRange(std::vector<BvhNode>& nodes, const BuildTask& task, bool parallel,
+	std::vector<BuildTask>& pending)
+{
+	const UINT count = task.End - task.Begin;
+
+	//Bounds of the primitives and of their centroids.
+	Aabb bounds, centroidBounds;
+	auto accumulateBounds = [&](size_t begin, size_t end, Aabb& b, Aabb& c) {
+		for (size_t i = begin; i < end; ++i) {
+			UINT prim = mPrimIndices[i];
+			b.Grow(mPrimMin[prim], mPrimMax[prim]);
+			c.Grow(mPrimCentroid[prim]);
+		}
+	};
+	if (parallel) {
+		std::mutex mergeMutex;
+		ParallelFor(task.Begin, task.End, ParallelGrain, [&](size_t begin, size_t end) {
+			Aabb b, c;
+			accumulateBounds(begin, end, b, c);
+			std::lock_guard<std::mutex> lock(mergeMutex);
+			bounds.Grow(b);
+			centroidBounds.Grow(c);
+		});
+	}
+	else {
+		accumulateBounds(task.Begin, task.End, bounds, centroidBounds);
+	}
+
+	BvhNode& node = nodes[task.Node];
+	node.BoundsMin = XMFLOAT3(bounds.Min[0], bounds.Min[1], bounds.Min[2]);
+	node.BoundsMax = XMFLOAT3(bounds.Max[0], bounds.Max[1], bounds.Max[2]);
+	node.LeftFirst = task.Begin;
+	node.PrimCount = count;
+
+	if (count <= MaxLeafSize || task.Depth + 1 >= MaxDepth) {
+		return;
+	}
+
+	//Bin the centroids along every axis with some extent.
+	Bin bins[3][BinCount];
+	float binScale[3];
+	for (int axis = 0; axis < 3; ++axis) {
+		float extent = centroidBounds.Max[axis] - centroidBounds.Min[axis];
+		binScale[axis] = extent > 0.0f ? BinCount / extent * 0.9999f : 0.0f;
+	}
+	if (binScale[0] == 0.0f && binScale[1] == 0.0f && binScale[2] == 0.0f) {
+		//All centroids coincide: no split can separate them.
+		return;
+	}
+
+	auto accumulateBins = [&](size_t begin, size_t end, Bin (&b)[3][BinCount]) {
+		for (size_t i = begin; i < end; ++i) {
+			UINT prim = mPrimIndices[i];
+			const XMFLOAT3& c = mPrimCentroid[prim];
+			const float centroid[3] = { c.x, c.y, c.z };
+			for (int axis = 0; axis < 3; ++axis) {
+				if (binScale[axis] == 0.0f) {
+					continue;
+				}
+				Bin& bin = b[axis][BinIndex(centroid[axis], centroidBounds.Min[axis], binScale[axis])];
+				bin.Bounds.Grow(mPrimMin[prim], mPrimMax[prim]);
+				bin.Count++;
+			}
+		}
+	};
+	if (parallel) {
+		std::mutex mergeMutex;
+		ParallelFor(task.Begin, task.End, ParallelGrain, [&](size_t begin, size_t end) {
+			Bin localBins[3][BinCount];
+			accumulateBins(begin, end, localBins);
+			std::lock_guard<std::mutex> lock(mergeMutex);
+			for (int axis = 0; axis < 3; ++axis) {
+				for (UINT i = 0; i < BinCount; ++i) {
+					bins[axis][i].Bounds.Grow(localBins[axis][i].Bounds);
+					bins[axis][i].Count += localBins[axis][i].Count;
+				}
+			}
+		});
+	}
+	else {
+		accumulateBins(task.Begin, task.End, bins);
+	}
+
+	//Sweep the bins from both sides and keep the cheapest plane.
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	UINT bestSplit = 0;
+	for (int axis = 0; axis < 3; ++axis) {
+		if (binScale[axis] == 0.0f) {
+			continue;
+		}
+		float leftArea[BinCount - 1];
+		UINT leftCount[BinCount - 1];
+		Aabb leftBox;
+		UINT leftSum = 0;
+		for (UINT i = 0; i < BinCount - 1; ++i) {
+			leftBox.Grow(bins[axis][i].Bounds);
+			leftSum += bins[axis][i].Count;
+			leftArea[i] = leftBox.Area();
+			leftCount[i] = leftSum;
+		}
+		Aabb rightBox;
+		UINT rightSum = 0;
+		for (UINT i = BinCount - 1; i > 0; --i) {
+			rightBox.Grow(bins[axis][i].Bounds);
+			rightSum += bins[axis][i].Count;
+			if (leftCount[i - 1] == 0 || rightSum == 0) {
+				continue;
+			}
+			float cost = leftArea[i - 1] * leftCount[i - 1] + rightBox.Area() * rightSum;
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	//SAH with traversal cost 1 and intersection cost 1, relative to this node.
+	float nodeArea = bounds.Area();
+	float splitCost = nodeArea > 0.0f ? 1.0f + bestCost / nodeArea : FLT_MAX;
+	if (bestAxis < 0 || (splitCost >= (float)count && count <= MaxSahLeafSize)) {
+		return;
+	}
+
+	UINT* first = mPrimIndices.data() + task.Begin;
+	UINT* last = mPrimIndices.data() + task.End;
+	float binMin = centroidBounds.Min[bestAxis];
+	float scale = binScale[bestAxis];
+	UINT* middle = std::partition(first, last, [&](UINT prim) {
+		const XMFLOAT3& c = mPrimCentroid[prim];
+		float centroid = bestAxis == 0 ? c.x : (bestAxis == 1 ? c.y : c.z);
+		return BinIndex(centroid, binMin, scale) < bestSplit;
+	});
+	UINT split = (UINT)(middle - mPrimIndices.data());
+	if (split == task.Begin || split == task.End) {
+		return;
+	}
+
+	//Siblings are allocated together; `node` is invalid after the resize.
+	UINT left = (UINT)nodes.size();
+	nodes.resize(nodes.size() + 2);
+	nodes[task.Node].LeftFirst = left;
+	nodes[task.Node].PrimCount = 0;
+
+	pending.push_back({ left + 1, split, task.End, task.Depth + 1 });
+	pending.push_back({ left, task.Begin, split, task.Depth + 1 });
+}
+
+void Bvh::UpdatePrimitive(UINT prim, const BoundingBox& bounds)
+{
+	assert(prim < PrimCount());
+	const XMFLOAT3& c = bounds.Center;
+	const XMFLOAT3& e = bounds.Extents;
+	mPrimMin[prim] = XMFLOAT3(c.x - e.x, c.y - e.y, c.z - e.z);
+	mPrimMax[prim] = XMFLOAT3(c.x + e.x, c.y + e.y, c.z + e.z);
+	mPrimCentroid[prim] = c;
+	mDirtyPrims.push_back(prim);
+}
+
+void Bvh::RefitNode(UINT nodeIndex)
+{
+	BvhNode& node = mNodes[nodeIndex];
+	Aabb box;
+	if (node.IsLeaf()) {
+		for (UINT i = 0; i < node.PrimCount; ++i) {
+			UINT prim = mPrimIndices[node.LeftFirst + i];
+			box.Grow(mPrimMin[prim], mPrimMax[prim]);
+		}
+	}
+	else {
+		const BvhNode& left = mNodes[node.LeftFirst];
+		const BvhNode& right = mNodes[node.LeftFirst + 1];
+		box.Grow(left.BoundsMin, left.BoundsMax);
+		box.Grow(right.BoundsMin, right.BoundsMax);
+	}
+	node.BoundsMin = XMFLOAT3(box.Min[0], box.Min[1], box.Min[2]);
+	node.BoundsMax = XMFLOAT3(box.Max[0], box.Max[1], box.Max[2]);
+}
+
+void Bvh::Refit()
+{
+	if (mDirtyPrims.empty()) {
+		return;
+	}
+
+	//Collect the paths from the touched leaves to the root. Children always
+	//come after their parent in the array, so refitting the collected nodes
+	//from the highest index down updates children before parents.
+	std::vector<UINT> dirtyNodes;
+	std::vector<bool> marked(mNodes.size(), false);
+	for (UINT prim : mDirtyPrims) {
+		for (UINT node = mPrimLeaf[prim]; node != UINT_MAX && !marked[node]; node = mParents[node]) {
+			marked[node] = true;
+			dirtyNodes.push_back(node);
+		}
+	}
+	std::sort(dirtyNodes.begin(), dirtyNodes.end(), std::greater<UINT>());
+	for (UINT node : dirtyNodes) {
+		RefitNode(node);
+	}
+	mDirtyPrims.clear();
+}
+
+bool Bvh::RefitOrRebuild()
+{
+	if (mDirtyPrims.empty()) {
+		return false;
+	}
+	Refit();
+	if (SahCost() <= RebuildCostRatio * mBuildCost) {
+		return false;
+	}
+
+	std::vector<BoundingBox> bounds(mPrimMin.size());
+	for (size_t i = 0; i < bounds.size(); ++i) {
+		BoundingBox::CreateFromPoints(bounds[i], XMLoadFloat3(&mPrimMin[i]), XMLoadFloat3(&mPrimMax[i]));
+	}
+	Build(bounds.data(), (UINT)bounds.size());
+	return true;
+}
+
+float Bvh::SahCost() const
+{
+	if (mNodes.empty()) {
+		return 0.0f;
+	}
+	float rootArea = NodeArea(mNodes[0]);
+	if (rootArea <= 0.0f) {
+		return 0.0f;
+	}
+	double cost = 0.0;
+	for (const BvhNode& node : mNodes) {
+		cost += NodeArea(node) * (node.IsLeaf() ? node.PrimCount : 1u);
+	}
+	return (float)(cost / rootArea);
+}
+
+bool Bvh::RayBox(const BvhNode& node, const float origin[3], const float invDir[3], float maxDistance, float& tNear) const
+{
+	const float mn[3] = { node.BoundsMin.x, node.BoundsMin.y, node.BoundsMin.z };
+	const float mx[3] = { node.BoundsMax.x, node.BoundsMax.y, node.BoundsMax.z };
+	float tMin = 0.0f;
+	float tMax = maxDistance;
+	for (int axis = 0; axis < 3; ++axis) {
+		float t0 = (mn[axis] - origin[axis]) * invDir[axis];
+		float t1 = (mx[axis] - origin[axis]) * invDir[axis];
+		if (t0 > t1) {
+			std::swap(t0, t1);
+		}
+		tMin = std::max(tMin, t0);
+		tMax = std::min(tMax, t1);
+	}
+	tNear = tMin;
+	return tMin <= tMax;
+}
+
+void Bvh::QueryFrustum(FXMMATRIX viewProj, std::vector<UINT>& result) const
+{
+	if (mNodes.empty()) {
+		return;
+	}
+	XMFLOAT4 planes[6];
+	MathHelper::ExtractFrustumPlanes(viewProj, planes);
+
+	//Each stack entry carries the planes its box still straddles; once a box is
+	//fully inside all of them its whole subtree is accepted without tests.
+	struct Entry
+	{
+		UINT Node;
+		UINT PlaneMask;
+	};
+	Entry stack[MaxDepth * 2];
+	UINT stackSize = 0;
+	stack[stackSize++] = { 0, 0x3F };
+
+	while (stackSize != 0) {
+		Entry entry = stack[--stackSize];
+		const BvhNode& node = mNodes[entry.Node];
+
+		UINT mask = entry.PlaneMask;
+		bool outside = false;
+		float cx = 0.5f * (node.BoundsMin.x + node.BoundsMax.x);
+		float cy = 0.5f * (node.BoundsMin.y + node.BoundsMax.y);
+		float cz = 0.5f * (node.BoundsMin.z + node.BoundsMax.z);
+		float ex = 0.5f * (node.BoundsMax.x - node.BoundsMin.x);
+		float ey = 0.5f * (node.BoundsMax.y - node.BoundsMin.y);
+		float ez = 0.5f * (node.BoundsMax.z - node.BoundsMin.z);
+		for (UINT p = 0; p < 6 && !outside; ++p) {
+			if ((mask & (1u << p)) == 0) {
+				continue;
+			}
+			const XMFLOAT4& plane = planes[p];
+			float d = plane.x * cx + plane.y * cy + plane.z * cz + plane.w;
+			float r = fabsf(plane.x) * ex + fabsf(plane.y) * ey + fabsf(plane.z) * ez;
+			if (d + r < 0.0f) {
+				outside = true;
+			}
+			else if (d - r >= 0.0f) {
+				mask &= ~(1u << p);
+			}
+		}
+		if (outside) {
+			continue;
+		}
+
+		if (node.IsLeaf()) {
+			for (UINT i = 0; i < node.PrimCount; ++i) {
+				UINT prim = mPrimIndices[node.LeftFirst + i];
+				if (mask == 0) {
+					result.push_back(prim);
+					continue;
+				}
+				//Straddling leaves test their primitives individually.
+				const XMFLOAT3& mn = mPrimMin[prim];
+				const XMFLOAT3& mx = mPrimMax[prim];
+				bool primOutside = false;
+				for (UINT p = 0; p < 6 && !primOutside; ++p) {
+					if ((mask & (1u << p)) == 0) {
+						continue;
+					}
+					const XMFLOAT4& plane = planes[p];
+					float d = plane.x * 0.5f * (mn.x + mx.x) + plane.y * 0.5f * (mn.y + mx.y) + plane.z * 0.5f * (mn.z + mx.z) + plane.w;
+					float r = fabsf(plane.x) * 0.5f * (mx.x - mn.x) + fabsf(plane.y) * 0.5f * (mx.y - mn.y) + fabsf(plane.z) * 0.5f * (mx.z - mn.z);
+					primOutside = d + r < 0.0f;
+				}
+				if (!primOutside) {
+					result.push_back(prim);
+				}
+			}
+		}
+		else {
+			stack[stackSize++] = { node.LeftFirst + 1, mask };
+			stack[stackSize++] = { node.LeftFirst, mask };
+		}
+	}
+}
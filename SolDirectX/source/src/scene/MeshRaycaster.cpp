@@ -0,0 +1,44 @@
+#include "../../header/Scene/MeshRaycaster.h"
+
+using namespace DirectX;
+
+void MeshRaycaster::Build(const MeshGeometry& geo, const SubmeshGeometry& submesh)
+{
+	Build(geo, submesh, geo.VertexBufferCPU.Get(), geo.IndexBufferCPU.Get());
+}
+
+void MeshRaycaster::Build(const MeshGeometry& geo, const SubmeshGeometry& submesh, ID3DBlob* vertexBlob, ID3DBlob* indexBlob)
+{
+	assert(vertexBlob != nullptr && indexBlob != nullptr);
+	const void* vertices = vertexBlob->GetBufferPointer();
+	const void* indices = indexBlob->GetBufferPointer();
+	const bool index32 = geo.IndexFormat == DXGI_FORMAT_R32_UINT;
+
+	const UINT triangleCount = submesh.IndexCount / 3;
+	mPositions.resize(3 * triangleCount);
+	std::vector<BoundingBox> bounds(triangleCount);
+	for (UINT i = 0; i < 3 * triangleCount; ++i) {
+		UINT location = submesh.StartIndexLocation - geo.PoolStartIndex + i;
+		UINT index = index32 ? static_cast<const uint32_t*>(indices)[location]
+			: static_cast<const uint16_t*>(indices)[location];
+		index += submesh.BaseVertexLocation - geo.PoolBaseVertex;
+		XMStoreFloat3(&mPositions[i], geo.LoadPosition(vertices, index));
+	}
+	for (UINT t = 0; t < triangleCount; ++t) {
+		BoundingBox::CreateFromPoints(bounds[t], 3, &mPositions[3 * t], sizeof(XMFLOAT3));
+	}
+	mBvh.Build(bounds.data(), triangleCount);
+}
+
+bool MeshRaycaster::Raycast(FXMVECTOR origin, FXMVECTOR dir, float maxDistance, float& distance) const
+{
+	BvhRayHit hit = mBvh.Raycast(origin, dir, maxDistance,
+		[this](UINT triangle, FXMVECTOR o, FXMVECTOR d, float maxDist, float& dist) {
+			XMVECTOR v0 = XMLoadFloat3(&mPositions[3 * triangle + 0]);
+			XMVECTOR v1 = XMLoadFloat3(&mPositions[3 * triangle + 1]);
+			XMVECTOR v2 = XMLoadFloat3(&mPositions[3 * triangle + 2]);
+			return TriangleTests::Intersects(o, d, v0, v1, v2, dist) && dist < maxDist;
+		});
+	distance = hit.Distance;
+	return hit.Hit();
+}
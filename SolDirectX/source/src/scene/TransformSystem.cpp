@@ -0,0 +1,411 @@
+#include "../../header/Scene/TransformSystem.h"
+#include "../../header/Common/ParallelFor.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <type_traits>
+
+namespace {
+	//SoA arrays are padded so that the last group of 4 can always be loaded.
+	const size_t LanePadding = 3;
+	//Nodes per parallel chunk while updating a level, and matrices per chunk while writing.
+	const size_t UpdateGrain = 2048;
+	const size_t WriteGrain = 4096;
+
+	const float Identity[12] = { 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f };
+}
+
+TransformSystem::TransformSystem()
+{
+	//The hidden root: identity world, never dirty.
+	mIdOfSlot.push_back(InvalidTransform);
+	for (auto* values : { &mTx, &mTy, &mTz, &mQx, &mQy, &mQz, &mSx, &mSy, &mSz, &mQw }) {
+		values->assign(1 + LanePadding, 0.0f);
+	}
+	for (int k = 0; k < 12; ++k) {
+		mWorld[k].assign(1 + LanePadding, Identity[k]);
+	}
+	mParent.assign(1 + LanePadding, 0);
+	mDirty.assign(1 + LanePadding, 0);
+	mChanged.assign(1 + LanePadding, 0);
+	mLevelStart = { 0, 1 };
+	mLevelDirty.assign(1, 0);
+	mLevelChanged.assign(1, 0);
+}
+
+TransformId TransformSystem::Create(TransformId parent)
+{
+	assert(parent == InvalidTransform || IsAlive(parent));
+	TransformId id;
+	if (!mFreeIds.empty()) {
+		id = mFreeIds.back();
+		mFreeIds.pop_back();
+	}
+	else {
+		id = (TransformId)mSlotOfId.size();
+		mSlotOfId.push_back(InvalidTransform);
+		mDepthOfId.push_back(0);
+		mDestroyed.push_back(0);
+	}
+
+	//New nodes are appended. That keeps the depth order only if the node
+	//is at least as deep as the last one; otherwise the next Update() sorts.
+	const uint32_t slot = (uint32_t)mIdOfSlot.size();
+	const uint32_t depth = parent == InvalidTransform ? 1 : mDepthOfId[parent] + 1;
+	const uint32_t lastDepth = (uint32_t)mLevelStart.size() - 2;
+	if (!mOrderStale && depth == lastDepth) {
+		mLevelStart.back()++;
+	}
+	else if (!mOrderStale && depth == lastDepth + 1) {
+		mLevelStart.push_back(slot + 1);
+	}
+	else {
+		mOrderStale = true;
+	}
+
+	mSlotOfId[id] = slot;
+	mDepthOfId[id] = depth;
+	mDestroyed[id] = 0;
+	mIdOfSlot.push_back(id);
+
+	const size_t size = mIdOfSlot.size() + LanePadding;
+	for (auto* values : { &mTx, &mTy, &mTz, &mQx, &mQy, &mQz, &mSx, &mSy, &mSz, &mQw }) {
+		values->resize(size, 0.0f);
+	}
+	for (int k = 0; k < 12; ++k) {
+		mWorld[k].resize(size, 0.0f);
+		mWorld[k][slot] = Identity[k];
+	}
+	mParent.resize(size, 0);
+	mDirty.resize(size, 0);
+	mChanged.resize(size, 0);
+
+	mQw[slot] = 1.0f;
+	mSx[slot] = mSy[slot] = mSz[slot] = 1.0f;
+	mParent[slot] = parent == InvalidTransform ? 0 : mSlotOfId[parent];
+	if (mLevelDirty.size() <= depth) {
+		mLevelDirty.resize(depth + 1, 0);
+		mLevelChanged.resize(depth + 1, 0);
+	}
+	MarkDirty(slot, id);
+	return id;
+}
+
+void TransformSystem::Destroy(TransformId id)
+{
+	assert(IsAlive(id));
+	mDestroyed[id] = 1;
+	mOrderStale = true;
+}
+
+bool TransformSystem::IsAlive(TransformId id) const
+{
+	return id < mSlotOfId.size() && mSlotOfId[id] != InvalidTransform && !mDestroyed[id];
+}
+
+void TransformSystem::SetLocal(TransformId id, const float translation[3], const float rotation[4], const float scale[3])
+{
+	assert(IsAlive(id));
+	const uint32_t slot = mSlotOfId[id];
+	mTx[slot] = translation[0];
+	mTy[slot] = translation[1];
+	mTz[slot] = translation[2];
+	mQx[slot] = rotation[0];
+	mQy[slot] = rotation[1];
+	mQz[slot] = rotation[2];
+	mQw[slot] = rotation[3];
+	mSx[slot] = scale[0];
+	mSy[slot] = scale[1];
+	mSz[slot] = scale[2];
+	MarkDirty(slot, id);
+}
+
+void TransformSystem::SetTranslation(TransformId id, const float translation[3])
+{
+	assert(IsAlive(id));
+	const uint32_t slot = mSlotOfId[id];
+	mTx[slot] = translation[0];
+	mTy[slot] = translation[1];
+	mTz[slot] = translation[2];
+	MarkDirty(slot, id);
+}
+
+void TransformSystem::MarkDirty(uint32_t slot, TransformId id)
+{
+	if (!mDirty[slot]) {
+		mDirty[slot] = 1;
+		mLevelDirty[mDepthOfId[id]]++;
+	}
+}
+
+void TransformSystem::SortByDepth()
+{
+	const uint32_t slotCount = (uint32_t)mIdOfSlot.size();
+
+	//Counting sort of the slots by depth, stable so that siblings keep their order.
+	uint32_t levelCount = 1;
+	for (uint32_t s = 1; s < slotCount; ++s) {
+		levelCount = std::max(levelCount, mDepthOfId[mIdOfSlot[s]] + 1);
+	}
+	std::vector<uint32_t> levelStart(levelCount + 1, 0);
+	for (uint32_t s = 1; s < slotCount; ++s) {
+		levelStart[mDepthOfId[mIdOfSlot[s]] + 1]++;
+	}
+	levelStart[1] = 1;
+	for (uint32_t d = 1; d < levelCount; ++d) {
+		levelStart[d + 1] += levelStart[d];
+	}
+	std::vector<uint32_t> order(slotCount);
+	std::vector<uint32_t> cursor(levelStart.begin(), levelStart.end() - 1);
+	order[0] = 0;
+	for (uint32_t s = 1; s < slotCount; ++s) {
+		order[cursor[mDepthOfId[mIdOfSlot[s]]]++] = s;
+	}
+
+	//Parents come first in depth order, so a destroyed node takes its whole subtree along.
+	std::vector<uint8_t> dead(slotCount, 0);
+	std::vector<uint32_t> newSlot(slotCount, InvalidTransform);
+	newSlot[0] = 0;
+	uint32_t aliveCount = 1;
+	std::fill(levelStart.begin() + 1, levelStart.end(), 0);
+	for (uint32_t n = 1; n < slotCount; ++n) {
+		const uint32_t s = order[n];
+		const TransformId id = mIdOfSlot[s];
+		dead[s] = mDestroyed[id] || dead[mParent[s]];
+		if (dead[s]) {
+			mSlotOfId[id] = InvalidTransform;
+			mDestroyed[id] = 0;
+			mFreeIds.push_back(id);
+			continue;
+		}
+		order[aliveCount] = s;
+		newSlot[s] = aliveCount++;
+		levelStart[mDepthOfId[id] + 1] = aliveCount;
+	}
+	//Levels emptied by destruction collapse onto the previous end.
+	levelStart[1] = std::max(levelStart[1], 1u);
+	for (uint32_t d = 1; d < levelCount; ++d) {
+		levelStart[d + 1] = std::max(levelStart[d + 1], levelStart[d]);
+	}
+	while (levelStart.size() > 2 && levelStart[levelStart.size() - 1] == levelStart[levelStart.size() - 2]) {
+		levelStart.pop_back();
+	}
+
+	auto permute = [&order, aliveCount](auto& values) {
+		typename std::decay<decltype(values)>::type sorted(aliveCount + LanePadding);
+		for (uint32_t n = 0; n < aliveCount; ++n) {
+			sorted[n] = values[order[n]];
+		}
+		values.swap(sorted);
+	};
+	for (auto* values : { &mTx, &mTy, &mTz, &mQx, &mQy, &mQz, &mSx, &mSy, &mSz, &mQw }) {
+		permute(*values);
+	}
+	for (int k = 0; k < 12; ++k) {
+		permute(mWorld[k]);
+	}
+	permute(mParent);
+	permute(mDirty);
+	permute(mChanged);
+	for (uint32_t n = 1; n < aliveCount; ++n) {
+		mParent[n] = newSlot[mParent[n]];
+	}
+
+	std::vector<uint32_t> idOfSlot(aliveCount);
+	for (uint32_t n = 0; n < aliveCount; ++n) {
+		idOfSlot[n] = mIdOfSlot[order[n]];
+		if (n != 0) {
+			mSlotOfId[idOfSlot[n]] = n;
+		}
+	}
+	mIdOfSlot.swap(idOfSlot);
+	mLevelStart.swap(levelStart);
+	mOrderStale = false;
+}
+
+void TransformSystem::Update()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (mOrderStale) {
+		SortByDepth();
+	}
+
+	uint32_t updated = 0;
+	bool parentLevelChanged = false;
+	const uint32_t levelCount = (uint32_t)mLevelStart.size() - 1;
+	for (uint32_t level = 1; level < levelCount; ++level) {
+		//没有节点被修改且上一层也没变,整层跳过,只需清掉上次留下的标记
+		if (mLevelDirty[level] == 0 && !parentLevelChanged) {
+			if (mLevelChanged[level]) {
+				std::fill(mChanged.begin() + mLevelStart[level], mChanged.begin() + mLevelStart[level + 1], 0);
+				mLevelChanged[level] = 0;
+			}
+			continue;
+		}
+
+		std::atomic<uint32_t> levelUpdated(0);
+		ParallelFor(mLevelStart[level], mLevelStart[level + 1], UpdateGrain, [this, &levelUpdated](size_t begin, size_t end) {
+			uint32_t count = 0;
+			for (size_t i = begin; i < end; i += 4) {
+				const size_t lanes = std::min<size_t>(4, end - i);
+
+				//A node changes when it was set or its parent changed in this update.
+				uint32_t parents[4] = { 0, 0, 0, 0 };
+				uint8_t changed[4] = { 0, 0, 0, 0 };
+				bool any = false;
+				for (size_t j = 0; j < lanes; ++j) {
+					parents[j] = mParent[i + j];
+					changed[j] = mDirty[i + j] | mChanged[parents[j]];
+					any = any || changed[j];
+				}
+				for (size_t j = 0; j < lanes; ++j) {
+					mChanged[i + j] = changed[j];
+					mDirty[i + j] = 0;
+					count += changed[j];
+				}
+				//整组都是静态的,直接跳过
+				if (!any) {
+					continue;
+				}
+
+				//Local rotation * scale from the quaternions of 4 nodes.
+				//Unchanged lanes are recomputed from the same inputs and keep their value.
+				const __m128 one = _mm_set1_ps(1.0f);
+				const __m128 two = _mm_set1_ps(2.0f);
+				__m128 qx = _mm_loadu_ps(&mQx[i]), qy = _mm_loadu_ps(&mQy[i]);
+				__m128 qz = _mm_loadu_ps(&mQz[i]), qw = _mm_loadu_ps(&mQw[i]);
+				__m128 sx = _mm_loadu_ps(&mSx[i]), sy = _mm_loadu_ps(&mSy[i]), sz = _mm_loadu_ps(&mSz[i]);
+				__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+				__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+				__m128 xw = _mm_mul_ps(qx, qw), yw = _mm_mul_ps(qy, qw), zw = _mm_mul_ps(qz, qw);
+				__m128 local[9] = {
+					_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+					_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, zw)), sx),
+					_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, yw)), sx),
+					_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, zw)), sy),
+					_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+					_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, xw)), sy),
+					_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, yw)), sz),
+					_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, xw)), sz),
+					_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+				};
+				__m128 translation[3] = { _mm_loadu_ps(&mTx[i]), _mm_loadu_ps(&mTy[i]), _mm_loadu_ps(&mTz[i]) };
+
+				//Parents are scattered over the level above, gather their worlds per lane.
+				__m128 parent[12];
+				for (int k = 0; k < 12; ++k) {
+					const float* world = mWorld[k].data();
+					parent[k] = _mm_setr_ps(world[parents[0]], world[parents[1]], world[parents[2]], world[parents[3]]);
+				}
+
+				//world = local * parentWorld, row by row.
+				__m128 result[12];
+				for (int r = 0; r < 3; ++r) {
+					for (int c = 0; c < 3; ++c) {
+						result[3 * r + c] = _mm_add_ps(_mm_add_ps(
+							_mm_mul_ps(local[3 * r], parent[c]),
+							_mm_mul_ps(local[3 * r + 1], parent[3 + c])),
+							_mm_mul_ps(local[3 * r + 2], parent[6 + c]));
+					}
+				}
+				for (int c = 0; c < 3; ++c) {
+					result[9 + c] = _mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(translation[0], parent[c]),
+						_mm_mul_ps(translation[1], parent[3 + c])),
+						_mm_add_ps(_mm_mul_ps(translation[2], parent[6 + c]), parent[9 + c]));
+				}
+
+				if (lanes == 4) {
+					for (int k = 0; k < 12; ++k) {
+						_mm_storeu_ps(&mWorld[k][i], result[k]);
+					}
+				}
+				else {
+					//The slots after a partial group belong to another chunk or level.
+					for (int k = 0; k < 12; ++k) {
+						float values[4];
+						_mm_storeu_ps(values, result[k]);
+						std::copy(values, values + lanes, &mWorld[k][i]);
+					}
+				}
+			}
+			levelUpdated += count;
+		});
+		mLevelDirty[level] = 0;
+		mLevelChanged[level] = levelUpdated != 0;
+		parentLevelChanged = levelUpdated != 0;
+		updated += levelUpdated;
+	}
+
+	mStats.Nodes = (uint32_t)Size();
+	mStats.Levels = levelCount - 1;
+	mStats.Updated = updated;
+	mStats.Milliseconds = std::chrono::duration<double, std::milli>(
+		std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void TransformSystem::GetWorld(TransformId id, float world[16]) const
+{
+	assert(IsAlive(id));
+	const uint32_t slot = mSlotOfId[id];
+	for (int r = 0; r < 4; ++r) {
+		for (int c = 0; c < 3; ++c) {
+			world[4 * r + c] = mWorld[3 * r + c][slot];
+		}
+		world[4 * r + 3] = r == 3 ? 1.0f : 0.0f;
+	}
+}
+
+void TransformSystem::WriteWorldViewProj(const float viewProj[16], const TransformId* ids, size_t count,
+	void* dst, size_t stride) const
+{
+	WriteMatrices(viewProj, ids, count, dst, stride);
+}
+
+void TransformSystem::WriteWorld(const TransformId* ids, size_t count, void* dst, size_t stride) const
+{
+	WriteMatrices(nullptr, ids, count, dst, stride);
+}
+
+void TransformSystem::WriteMatrices(const float* viewProj, const TransformId* ids, size_t count,
+	void* dst, size_t stride) const
+{
+	static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	const float* m = viewProj != nullptr ? viewProj : identity;
+
+	ParallelFor(0, count, WriteGrain, [&](size_t begin, size_t end) {
+		const __m128 v0 = _mm_loadu_ps(m), v1 = _mm_loadu_ps(m + 4);
+		const __m128 v2 = _mm_loadu_ps(m + 8), v3 = _mm_loadu_ps(m + 12);
+		for (size_t n = begin; n < end; ++n) {
+			assert(IsAlive(ids[n]));
+			const uint32_t slot = mSlotOfId[ids[n]];
+			float w[12];
+			for (int k = 0; k < 12; ++k) {
+				w[k] = mWorld[k][slot];
+			}
+
+			//Row r of world * viewProj combines the rows of viewProj.
+			__m128 rows[4];
+			for (int r = 0; r < 3; ++r) {
+				rows[r] = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_set1_ps(w[3 * r]), v0),
+					_mm_mul_ps(_mm_set1_ps(w[3 * r + 1]), v1)),
+					_mm_mul_ps(_mm_set1_ps(w[3 * r + 2]), v2));
+			}
+			rows[3] = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_set1_ps(w[9]), v0),
+				_mm_mul_ps(_mm_set1_ps(w[10]), v1)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(w[11]), v2), v3));
+			_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+
+			float* out = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(dst) + n * stride);
+			_mm_storeu_ps(out, rows[0]);
+			_mm_storeu_ps(out + 4, rows[1]);
+			_mm_storeu_ps(out + 8, rows[2]);
+			_mm_storeu_ps(out + 12, rows[3]);
+		}
+	});
+}
@@ -4,7 +4,11 @@
 #define DEFAULT_WIDTH 600
 #define DEFAULT_HEIGHT 600
 
+LittleWindow* LittleWindow::mMainWindow = nullptr;
+
 bool LittleWindow::Initialize(const wchar_t* title_) {
+	//The window receives messages while it is being created, so set this first.
+	mMainWindow = this;
 	title = title_;
 	width = DEFAULT_WIDTH;
 	height = DEFAULT_HEIGHT;
@@ -24,7 +28,27 @@ LRESULT CALLBACK WindowProcedure(HWND window, UINT msg, WPARAM wp, LPARAM lp)
 		PostQuitMessage(0);
 		return 0L;
 	case WM_LBUTTONDOWN:
-		std::cout << "mouse left button down at (" << LOWORD(lp) << ',' << HIWORD(lp) << ")\n";
+	case WM_MBUTTONDOWN:
+	case WM_RBUTTONDOWN:
+		if (msg == WM_LBUTTONDOWN) {
+			std::cout << "mouse left button down at (" << LOWORD(lp) << ',' << HIWORD(lp) << ")\n";
+		}
+		if (LittleWindow::mMainWindow) {
+			LittleWindow::mMainWindow->OnMouseDown(wp, (short)LOWORD(lp), (short)HIWORD(lp));
+		}
+		return 0L;
+	case WM_LBUTTONUP:
+	case WM_MBUTTONUP:
+	case WM_RBUTTONUP:
+		if (LittleWindow::mMainWindow) {
+			LittleWindow::mMainWindow->OnMouseUp(wp, (short)LOWORD(lp), (short)HIWORD(lp));
+		}
+		return 0L;
+	case WM_MOUSEMOVE:
+		if (LittleWindow::mMainWindow) {
+			LittleWindow::mMainWindow->OnMouseMove(wp, (short)LOWORD(lp), (short)HIWORD(lp));
+		}
+		return 0L;
 	default:
 		return DefWindowProc(window, msg, wp, lp);
 	}
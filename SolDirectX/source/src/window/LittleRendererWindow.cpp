@@ -1,6 +1,7 @@
 #include "../../header/Window/LittleRendererWindow.h"
 
 #include <iostream>
+#include <chrono>
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 using namespace DirectX::PackedVector;
@@ -14,51 +15,96 @@ bool LittleRendererWindow::Initialize(const wchar_t* title, LittleGFXDevice* dev
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
 	BuildDescriptorHeaps();
-	BuildConstantBuffers();
+	BuildFrameResources();
 	BuildRootSignature();
 	BuildShadersAndInputLayout();
+	mGeometryPool = std::make_unique<GeometryPool>(md3dDevice.Get());
 	BuildBoxGeometry();
 	BuildPSO();
+	BuildRenderItems();
+	BuildStaticScenery();
 
 	//Execute the initialization commands.
 	ThrowIfFailed(mCommandList->Close());
 	ID3D12CommandList* cmdLists[] = { mCommandList.Get() };
 	mCommandQueue->ExecuteCommandLists(_countof(cmdLists), cmdLists);
 
-	//Wait until initialization is complete.
-	FlushCommandQueue();
+	//Instead of waiting until initialization is complete, mark its end with a
+	//fence; the first frames are queued behind it on the GPU anyway.
+	mScheduler.SetFenceSource([this]() { return mFence->GetCompletedValue(); });
+	mCurrentFence++;
+	ThrowIfFailed(mCommandQueue->Signal(mFence.Get(), mCurrentFence));
+	mScheduler.Spawn(FinishInitialUploads(mCurrentFence));
+
+	//从这里开始Draw()只在渲染线程上执行,命令列表,交换链和栅栏值都归它所有;
+	//渲染线程固定在作业系统留出的核上,不和工作线程争抢
+	const std::vector<uint32_t>& reservedCpus = DefaultJobSystem().ReservedCpus();
+	const LogicalCpu* renderCpu = reservedCpus.empty() ? nullptr : &CpuTopology::Get().Cpus[reservedCpus[0]];
+	mPipeline = std::make_unique<FramePipeline>(NumFrameResources, [this](uint32_t index) {
+		mDrawFrameResource = mFrameResources[index].get();
+		Draw();
+	}, renderCpu);
+
+	//加载花的时间不算进第一帧
+	mClock.Reset();
 
 	return true;
 }
 
+Task<void> LittleRendererWindow::FinishInitialUploads(UINT64 fence) {
+	co_await WaitForFence(fence);
+
+	mBoxGeo->DIsposeUploaders();
+	mStaticBatches.Geometry()->DIsposeUploaders();
+	mGeometryPool->ReleaseRetiredBuffers();
+	//The raycasters keep their own positions, nothing else reads the box on the CPU.
+	//Dropping the copies also unmaps the mesh file.
+	mCpuGeometry.Retain(*mBoxGeo, CpuRetention::Drop);
+	//The scenery is only read by RaycastScenery(), when a click misses the boxes.
+	mCpuGeometry.Retain(*mStaticBatches.Geometry(), CpuRetention::Compressed);
+
+	GeometryPoolStats poolStats = mGeometryPool->Stats();
+	std::cout << "geometry pool: " << poolStats.Meshes << " meshes in " << poolStats.Arenas << " arenas, "
+		<< poolStats.UsedBytes << "/" << poolStats.CapacityBytes << " bytes used, uploads finished "
+		<< mScheduler.FrameIndex() << " frames after initialization" << std::endl;
+	LogCpuGeometryStats();
+}
+
 void LittleRendererWindow::BuildDescriptorHeaps() {
+	//Each frame resource has its own pass constant buffer and view.
 	D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc;
-	cbvHeapDesc.NumDescriptors = 1;
+	cbvHeapDesc.NumDescriptors = NumFrameResources;
 	cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	cbvHeapDesc.NodeMask = 0;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&cbvHeapDesc, IID_PPV_ARGS(&mCbvHeap)));
 }
 
-void LittleRendererWindow::BuildConstantBuffers()
+void LittleRendererWindow::BuildFrameResources()
 {
-	mObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(md3dDevice.Get(), 1, true);
-
-	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-
-	D3D12_GPU_VIRTUAL_ADDRESS cbAddress = mObjectCB->Resource()->GetGPUVirtualAddress();
-	//Offset to the ith object constant buffer in the buffer;
-	int boxCBufIndex = 0;
-	cbAddress += boxCBufIndex * objCBByteSize;
-
-	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
-	cbvDesc.BufferLocation = cbAddress;
-	cbvDesc.SizeInBytes = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	const UINT drawListCount = std::min(ParallelWorkerCount(), MaxDrawLists);
+	for (int i = 0; i < NumFrameResources; ++i) {
+		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(), 1, MaxObjectCount, MaxInstanceCount,
+			drawListCount));
+
+		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
+		cbvDesc.BufferLocation = mFrameResources[i]->PassCB->Resource()->GetGPUVirtualAddress();
+		cbvDesc.SizeInBytes = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
+
+		//Frame i's view is the i-th descriptor in the heap.
+		CD3DX12_CPU_DESCRIPTOR_HANDLE handle(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
+		handle.Offset(i, mCbvSrvUavDescriptorSize);
+		md3dDevice->CreateConstantBufferView(&cbvDesc, handle);
+	}
 
-	md3dDevice->CreateConstantBufferView(
-		&cbvDesc,
-		mCbvHeap->GetCPUDescriptorHandleForHeapStart()
-	);
+	//Created closed, Draw() resets them with the allocators of its frame resource.
+	mDrawLists.resize(drawListCount);
+	for (auto& drawList : mDrawLists) {
+		ThrowIfFailed(md3dDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+			mFrameResources[0]->DrawListAllocs[0].Get(), nullptr, IID_PPV_ARGS(drawList.GetAddressOf())));
+		ThrowIfFailed(drawList->Close());
+	}
+	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
 }
 
 void LittleRendererWindow::BuildRootSignature() {
@@ -68,14 +114,18 @@ void LittleRendererWindow::BuildRootSignature() {
 	//as function parameters，then the root signature can be thought of as defining the 
 	//function signature.
 	//可以把RootSignature看做是准备shader里的一系列数据
-	CD3DX12_ROOT_PARAMETER slotRootParameter[1];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[3];
 
 	CD3DX12_DESCRIPTOR_RANGE cbvTable;
 	cbvTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
 	slotRootParameter[0].InitAsDescriptorTable(1, &cbvTable);
+	//实例数据(t0)直接作为根描述符,每个批次只需要偏移地址
+	slotRootParameter[1].InitAsShaderResourceView(0);
+	//对象数据(t1)每帧绑定一次,实例数据里只有对象的下标
+	slotRootParameter[2].InitAsShaderResourceView(1);
 
 	//A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(1, slotRootParameter, 0, nullptr,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3, slotRootParameter, 0, nullptr,
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT
 	);
 
@@ -107,82 +157,57 @@ void LittleRendererWindow::BuildShadersAndInputLayout()
 	mvsByteCode = d3dUtil::CompileShader(L"D:\\Github\\SolDirectx_Demo\\SolDirectX\\res\\color.hlsl", nullptr, "VS", "vs_5_0");
 	mpsByteCode = d3dUtil::CompileShader(L"D:\\Github\\SolDirectx_Demo\\SolDirectX\\res\\color.hlsl", nullptr, "PS", "ps_5_0");
 
-	mInputLayout =
-	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-	};
+	BuildInputLayout(mVertexFormat, mInputLayout);
 }
 
 void LittleRendererWindow::BuildBoxGeometry() {
-	std::array<Vertex, 8> vertices = {
-		Vertex({XMFLOAT3(-1.0f,-1.0f,-1.0f),XMFLOAT4(Colors::White)}),
-		Vertex({ XMFLOAT3(-1.0f, +1.0f, -1.0f), XMFLOAT4(Colors::Black) }),
-		Vertex({ XMFLOAT3(+1.0f, +1.0f, -1.0f), XMFLOAT4(Colors::Red) }),
-		Vertex({ XMFLOAT3(+1.0f, -1.0f, -1.0f), XMFLOAT4(Colors::Green) }),
-		Vertex({ XMFLOAT3(-1.0f, -1.0f, +1.0f), XMFLOAT4(Colors::Blue) }),
-		Vertex({ XMFLOAT3(-1.0f, +1.0f, +1.0f), XMFLOAT4(Colors::Yellow) }),
-		Vertex({ XMFLOAT3(+1.0f, +1.0f, +1.0f), XMFLOAT4(Colors::Cyan) }),
-		Vertex({ XMFLOAT3(+1.0f, -1.0f, +1.0f), XMFLOAT4(Colors::Magenta) })
-	};
-
-	std::array<std::uint16_t, 36> indices =
-	{
-		// front face
-		0, 1, 2,
-		0, 2, 3,
-
-		// back face
-		4, 6, 5,
-		4, 7, 6,
-
-		// left face
-		4, 5, 1,
-		4, 1, 0,
-
-		// right face
-		3, 2, 6,
-		3, 6, 7,
-
-		// top face
-		1, 5, 6,
-		1, 6, 2,
-
-		// bottom face
-		4, 0, 3,
-		4, 3, 7
-	};
+	//优先映射预处理好的网格文件,顶点/索引直接从映射页拷进上传缓冲
+	auto loadStart = std::chrono::high_resolution_clock::now();
+	std::string error;
+	std::shared_ptr<MappedFile> boxFile = MappedFile::Open(BoxMeshPath, &error);
+	MeshFileView boxView;
+	if (boxFile != nullptr && boxView.Open(boxFile->Data(), boxFile->Size(), &error)) {
+		if (boxView.Format() != mVertexFormat) {
+			error = "vertex format differs from the pipeline";
+		}
+		else if ((mBoxGeo = LoadMeshGeometry(boxFile, boxView)) == nullptr) {
+			error = "corrupt compressed geometry";
+		}
+		else {
+			mClusterCuller.AddMesh(boxView, *mBoxGeo);
+			mGeometryPool->AddMesh(*mBoxGeo, mCommandList.Get());
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
-
-	mBoxGeo = std::make_unique<MeshGeometry>();
-	mBoxGeo->Name = "boxGeo";
-	
-	//创建顶点与片元的缓冲区并拷贝数据
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &mBoxGeo->VertexBufferCPU));
-	CopyMemory(mBoxGeo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &mBoxGeo->IndexBufferCPU));
-	CopyMemory(mBoxGeo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-	//上传到GPU的命令
-	mBoxGeo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-			mCommandList.Get(), vertices.data(), vbByteSize, mBoxGeo->VertexBufferUploader);
-	mBoxGeo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, mBoxGeo->IndexBufferUploader);
-	
-	mBoxGeo->VertexByteStride = sizeof(Vertex);
-	mBoxGeo->VertexBufferByteSize = vbByteSize;
-	mBoxGeo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	mBoxGeo->IndexBufferByteSize = ibByteSize;
-
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
-
-	mBoxGeo->DrawArgs["box"] = submesh;
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loadStart).count();
+			std::cout << "box mesh: mapped " << boxFile->Size() << " bytes" << (boxView.Compressed() ? " (compressed)" : "")
+				<< " in " << seconds * 1000.0 << " ms (" << boxFile->Size() / seconds * 1e-9 << " GB/s)" << std::endl;
+			return;
+		}
+	}
+	std::cout << "box mesh file not used (" << error << "), building it" << std::endl;
+
+	//LOD链,顶点缓存优化,按64个顶点/124个三角形切分成簇,最后量化顶点格式
+	MeshData box = CreateBox();
+	MeshData quantizedBox;
+	MeshProcessOptions options;
+	options.Format = mVertexFormat;
+	MeshProcessStats stats = ProcessMesh(box, options, quantizedBox);
+
+	std::cout << "box mesh LODs:";
+	for (size_t level = 0; level < stats.Lods.LevelTriangles.size() && stats.Lods.LevelTriangles[level] != 0; ++level) {
+		std::cout << " " << stats.Lods.LevelTriangles[level] << " triangles (error " << stats.Lods.LevelErrors[level] << ")";
+	}
+	std::cout << std::endl;
+	std::cout << "box mesh: ACMR " << stats.Optimize.Before.Acmr << " -> " << stats.Optimize.After.Acmr
+		<< ", ATVR " << stats.Optimize.Before.Atvr << " -> " << stats.Optimize.After.Atvr << std::endl;
+	std::cout << "box mesh: " << stats.SourceStride << " -> " << stats.Stride
+		<< " bytes per vertex" << std::endl;
+
+	//位置的反量化由实例的世界矩阵完成
+	mBoxGeo = BuildMeshGeometry(quantizedBox);
+	mClusterCuller.AddMesh(quantizedBox, *mBoxGeo);
+
+	//上传到GPU的命令,顶点与索引放进共享的几何缓冲池
+	mGeometryPool->AddMesh(*mBoxGeo, mCommandList.Get());
 }
 
 void LittleRendererWindow::BuildPSO() {
@@ -213,10 +238,233 @@ void LittleRendererWindow::BuildPSO() {
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&mPSO)));
 }
 
-void LittleRendererWindow::Update(){
-	float x = mRadius * sinf(mPhi) * cosf(mTheta);
-	float z = mRadius * sinf(mPhi) * sinf(mTheta);
-	float y = mRadius * cosf(mPhi);
+void LittleRendererWindow::BuildRenderItems() {
+	//一个由BoxGridSize^3个盒子组成的网格,全部共用同一个网格与PSO
+	const float spacing = 4.0f;
+	const float offset = 0.5f * spacing * (BoxGridSize - 1);
+	const SubmeshGeometry* boxSubmesh = &mBoxGeo->DrawArgs["box"];
+
+	//每个盒子是网格根节点下的一个变换节点,世界矩阵由变换系统按层级算出
+	mGridTransform = mTransforms.Create();
+	mRitems.reserve(MaxInstanceCount);
+	mBoxTransforms.reserve(MaxInstanceCount);
+	for (UINT i = 0; i < BoxGridSize; ++i) {
+		for (UINT j = 0; j < BoxGridSize; ++j) {
+			for (UINT k = 0; k < BoxGridSize; ++k) {
+				TransformId box = mTransforms.Create(mGridTransform);
+				float translation[3] = { i * spacing - offset, j * spacing - offset, k * spacing - offset };
+				mTransforms.SetTranslation(box, translation);
+				mBoxTransforms.push_back(box);
+
+				RenderItem ritem;
+				ritem.ObjCBIndex = (UINT)mRitems.size();
+				ritem.Geo = mBoxGeo.get();
+				ritem.Submesh = boxSubmesh;
+				ritem.PSO = mPSO.Get();
+				mRitems.push_back(ritem);
+			}
+		}
+	}
+	mTransforms.Update();
+	for (UINT i = 0; i < (UINT)mRitems.size(); ++i) {
+		mTransforms.GetWorld(mBoxTransforms[i], &mRitems[i].World.m[0][0]);
+	}
+
+	//盒子都是静态的,包围盒只需要在这里算一次
+	std::vector<BoundingBox> localBounds(mRitems.size());
+	std::vector<BoundingBox> worldBounds(mRitems.size());
+	mFrustumCuller.Resize((UINT)mRitems.size());
+	mOcclusionCuller.Resize((UINT)mRitems.size());
+	mLodSelector.Resize((UINT)mRitems.size());
+	for (UINT i = 0; i < (UINT)mRitems.size(); ++i) {
+		const RenderItem& ritem = mRitems[i];
+		mFrustumCuller.SetBounds(i, ritem.Submesh->Bounds, XMLoadFloat4x4(&ritem.World));
+		mOcclusionCuller.SetBounds(i, ritem.Submesh->Bounds, XMLoadFloat4x4(&ritem.World));
+		mLodSelector.SetObject(i, *ritem.Submesh, XMLoadFloat4x4(&ritem.World));
+		localBounds[i] = ritem.Submesh->Bounds;
+
+		if (mMeshRaycasters.find(ritem.Submesh) == mMeshRaycasters.end()) {
+			mMeshRaycasters[ritem.Submesh].Build(*ritem.Geo, *ritem.Submesh);
+		}
+	}
+	MathHelper::TransformBoxes(localBounds.data(), sizeof(BoundingBox), &mRitems[0].World, sizeof(RenderItem),
+		worldBounds.data(), mRitems.size());
+	mSceneBvh.Build(worldBounds.data(), (UINT)worldBounds.size());
+}
+
+void LittleRendererWindow::BuildStaticScenery() {
+	//盒子网格下方的地砖和柱子都不会动,预先变换到世界空间后合并成少数几个批次
+	MeshData tile = CreateGrid(1.0f, 1.0f, 2, 2);
+	MeshData pillar = CreateSphere(1.0f, 12, 6);
+	const float spacing = 8.0f;
+	const float offset = 0.5f * spacing * (SceneryGridSize - 1);
+	const float groundY = -0.5f * 4.0f * BoxGridSize - 10.0f;
+
+	std::vector<StaticInstance> instances;
+	instances.reserve(2 * SceneryGridSize * SceneryGridSize);
+	auto addInstance = [&instances](const MeshData& mesh, FXMMATRIX world) {
+		StaticInstance instance;
+		instance.Mesh = &mesh;
+		XMFLOAT4X4 stored;
+		XMStoreFloat4x4(&stored, world);
+		memcpy(instance.World, &stored, sizeof(instance.World));
+		instances.push_back(instance);
+	};
+	for (UINT i = 0; i < SceneryGridSize; ++i) {
+		for (UINT k = 0; k < SceneryGridSize; ++k) {
+			float x = i * spacing - offset;
+			float z = k * spacing - offset;
+			addInstance(tile, XMMatrixScaling(spacing, 1.0f, spacing) * XMMatrixTranslation(x, groundY, z));
+
+			//柱子高度和朝向随位置变化,拉伸过的法线由合并时的逆转置矩阵修正
+			float height = 2.0f + (float)((i * 7 + k * 13) % 5);
+			addInstance(pillar, XMMatrixScaling(1.2f, height, 1.2f) * XMMatrixRotationY(0.3f * (i + k)) *
+				XMMatrixTranslation(x, groundY + height, z));
+		}
+	}
+
+	MeshData merged;
+	StaticMergeOptions mergeOptions;
+	mergeOptions.MaxBatchExtent = 8.0f * spacing;
+	StaticMergeStats mergeStats = MergeStaticMeshes(instances.data(), instances.size(), mergeOptions, merged);
+
+	//合并后的批次只做顶点缓存优化和量化,LOD和簇对整块场景没有意义
+	MeshData quantized;
+	MeshProcessOptions options;
+	options.GenerateLods = false;
+	options.BuildMeshlets = false;
+	options.Format = mVertexFormat;
+	ProcessMesh(merged, options, quantized);
+
+	//场景只占对象缓冲区里盒子后面的一个位置
+	assert(mRitems.size() < MaxObjectCount);
+	mStaticBatches.Build(md3dDevice.Get(), quantized, mPSO.Get(), *mGeometryPool, mCommandList.Get(),
+		(UINT)mRitems.size());
+	std::cout << "static scenery: " << mergeStats.Instances << " objects merged into " << mergeStats.Batches
+		<< " batches (" << mergeStats.Triangles << " triangles, " << mergeStats.Vertices << " vertices, largest batch "
+		<< mergeStats.LargestBatchTriangles << " triangles) in " << mergeStats.Milliseconds << " ms" << std::endl;
+}
+
+void LittleRendererWindow::OnResize() {
+	//The render thread presents to the swap chain being resized.
+	if (mPipeline) {
+		mPipeline->Drain();
+	}
+	LittleGFXWindow::OnResize();
+
+	//The window resized, so update the aspect ratio and recompute the projection matrix.
+	float aspectRatio = static_cast<float>(mClientWidth) / mClientHeight;
+	XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f * XM_PI, aspectRatio, 1.0f, 1000.0f);
+	XMStoreFloat4x4(&mProj, P);
+	mCameraDirty = true;
+	mLodSelector.SetProjection(0.25f * XM_PI, mClientHeight);
+
+	//遮挡测试只需要低分辨率的深度
+	mOcclusionCuller.SetResolution(mClientWidth / OcclusionBufferDownscale, mClientHeight / OcclusionBufferDownscale);
+}
+
+void LittleRendererWindow::OnMouseDown(WPARAM btnState, int x, int y) {
+	if ((btnState & MK_LBUTTON) == 0) {
+		return;
+	}
+
+	//用客户区大小把鼠标坐标换算到NDC
+	RECT clientRect;
+	GetClientRect(hWnd, &clientRect);
+	float clientWidth = (float)std::max(clientRect.right - clientRect.left, 1L);
+	float clientHeight = (float)std::max(clientRect.bottom - clientRect.top, 1L);
+	float ndcX = 2.0f * x / clientWidth - 1.0f;
+	float ndcY = 1.0f - 2.0f * y / clientHeight;
+
+	//Unproject the cursor onto the near and far planes to get the picking ray in world space.
+	XMMATRIX viewProj = XMLoadFloat4x4(&mView) * XMLoadFloat4x4(&mProj);
+	XMVECTOR det = XMMatrixDeterminant(viewProj);
+	XMMATRIX invViewProj = XMMatrixInverse(&det, viewProj);
+	XMVECTOR rayNear = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), invViewProj);
+	XMVECTOR rayFar = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), invViewProj);
+	XMVECTOR rayDir = XMVector3Normalize(XMVectorSubtract(rayFar, rayNear));
+	float rayLength = XMVectorGetX(XMVector3Length(XMVectorSubtract(rayFar, rayNear)));
+
+	//The scene BVH finds the candidate boxes, the triangles are tested in the local space of each box.
+	BvhRayHit hit = mSceneBvh.Raycast(rayNear, rayDir, rayLength,
+		[this](UINT index, FXMVECTOR origin, FXMVECTOR dir, float maxDistance, float& distance) {
+			const RenderItem& ritem = mRitems[index];
+			XMMATRIX world = XMLoadFloat4x4(&ritem.World);
+			XMVECTOR worldDet = XMMatrixDeterminant(world);
+			XMMATRIX invWorld = XMMatrixInverse(&worldDet, world);
+
+			XMVECTOR localOrigin = XMVector3TransformCoord(origin, invWorld);
+			XMVECTOR localDir = XMVector3TransformNormal(dir, invWorld);
+			//局部空间的距离要按方向的缩放换算回世界空间
+			float scale = XMVectorGetX(XMVector3Length(localDir));
+			localDir = XMVectorScale(localDir, 1.0f / scale);
+
+			float localDistance;
+			if (!mMeshRaycasters.at(ritem.Submesh).Raycast(localOrigin, localDir, maxDistance * scale, localDistance)) {
+				return false;
+			}
+			distance = localDistance / scale;
+			return true;
+		});
+
+	float sceneryDistance;
+	if (hit.Hit()) {
+		UINT k = hit.Primitive % BoxGridSize;
+		UINT j = hit.Primitive / BoxGridSize % BoxGridSize;
+		UINT i = hit.Primitive / (BoxGridSize * BoxGridSize);
+		std::cout << "picked box " << hit.Primitive << " (" << i << ',' << j << ',' << k
+			<< ") at distance " << hit.Distance << std::endl;
+	}
+	else if (RaycastScenery(rayNear, rayDir, rayLength, sceneryDistance)) {
+		std::cout << "picked the scenery at distance " << sceneryDistance << std::endl;
+	}
+	else {
+		std::cout << "picked nothing" << std::endl;
+	}
+}
+
+bool LittleRendererWindow::RaycastScenery(FXMVECTOR origin, FXMVECTOR dir, float maxDistance, float& distance) {
+	const MeshGeometry* geo = mStaticBatches.Geometry();
+	if (geo == nullptr) {
+		return false;
+	}
+	//Clicks are rare, so the copies stay compressed between them. Acquire()
+	//decompresses them into the LRU cache, repeated clicks hit the cache.
+	CpuGeometry copy = mCpuGeometry.Acquire(*geo);
+	if (!copy) {
+		return false;
+	}
+
+	//The batches are baked into world space, the ray needs no transform.
+	bool hit = false;
+	distance = maxDistance;
+	for (const auto& [name, submesh] : geo->DrawArgs) {
+		float boundsDistance;
+		if (!submesh.Bounds.Intersects(origin, dir, boundsDistance) || boundsDistance > distance) {
+			continue;
+		}
+		MeshRaycaster raycaster;
+		raycaster.Build(*geo, submesh, copy.Vertices.Get(), copy.Indices.Get());
+		float batchDistance;
+		if (raycaster.Raycast(origin, dir, distance, batchDistance)) {
+			distance = batchDistance;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+void LittleRendererWindow::UpdateCamera() {
+	if (!mCameraDirty) {
+		return;
+	}
+	mCameraDirty = false;
+
+	const OrbitState& orbit = mRenderOrbit;
+	float x = orbit.Radius * sinf(orbit.Phi) * cosf(orbit.Theta);
+	float z = orbit.Radius * sinf(orbit.Phi) * sinf(orbit.Theta);
+	float y = orbit.Radius * cosf(orbit.Phi);
+	mEyePos = XMFLOAT3(x, y, z);
 
 	// Build the view matrix.
 	XMVECTOR pos = XMVectorSet(x, y, z, 1.0f);
@@ -225,24 +473,212 @@ void LittleRendererWindow::Update(){
 
 	XMMATRIX view = XMMatrixLookAtLH(pos, target, up);
 	XMStoreFloat4x4(&mView, view);
+	XMStoreFloat4x4(&mViewProj, view * XMLoadFloat4x4(&mProj));
+
+	//Every frame resource needs the new pass constants.
+	mPassFramesDirty = NumFrameResources;
+}
 
-	XMMATRIX world = XMLoadFloat4x4(&mWorld);
-	XMMATRIX proj = XMLoadFloat4x4(&mProj);
-	XMMATRIX worldViewProj = world * view * proj;
+void LittleRendererWindow::UpdateObjectConstants() {
+	UploadBuffer<ObjectConstants>& objectBuffer = *mCurrFrameResource->ObjectBuffer;
+	auto flushRun = [this, &objectBuffer]() {
+		if (!mObjectRun.empty()) {
+			objectBuffer.CopyData((int)mObjectRunStart, mObjectRun.data(), (int)mObjectRun.size());
+			mUploadStats.ObjectsWritten += (UINT)mObjectRun.size();
+			mObjectRun.clear();
+		}
+	};
+	auto update = [this, &flushRun](RenderItem& ritem) {
+		mUploadStats.Objects++;
+		//Only update the buffer data if the constants have changed.
+		//This needs to be tracked per frame resource.
+		if (ritem.NumFramesDirty <= 0) {
+			return;
+		}
 
-	// Update the constant buffer with the latest worldViewProj matrix.
-	ObjectConstants objConstants;
-	XMStoreFloat4x4(&objConstants.WorldViewProj, XMMatrixTranspose(worldViewProj));
-	mObjectCB->CopyData(0, objConstants);
+		//Quantized positions are dequantized by the object's world matrix itself.
+		const MeshGeometry* geo = ritem.Geo;
+		XMMATRIX dequantize = XMMatrixScaling(geo->PositionScale.x, geo->PositionScale.y, geo->PositionScale.z) *
+			XMMatrixTranslation(geo->PositionBias.x, geo->PositionBias.y, geo->PositionBias.z);
+		ObjectConstants constants;
+		XMStoreFloat4x4(&constants.World, XMMatrixTranspose(dequantize * XMLoadFloat4x4(&ritem.World)));
+		if (!mObjectRun.empty() && mObjectRunStart + (UINT)mObjectRun.size() != ritem.ObjCBIndex) {
+			flushRun();
+		}
+		if (mObjectRun.empty()) {
+			mObjectRunStart = ritem.ObjCBIndex;
+		}
+		mObjectRun.push_back(constants);
+
+		//Next FrameResource need to be updated too.
+		ritem.NumFramesDirty--;
+	};
+	for (RenderItem& ritem : mRitems) {
+		update(ritem);
+	}
+	update(mStaticBatches.Item());
+	flushRun();
+
+	mUploadStats.BytesWritten += (UINT64)mUploadStats.ObjectsWritten * sizeof(ObjectConstants);
+	mUploadStats.BytesWithoutTracking += (UINT64)mUploadStats.Objects * sizeof(ObjectConstants);
+}
+
+void LittleRendererWindow::UpdatePassConstants() {
+	mUploadStats.BytesWithoutTracking += sizeof(PassConstants);
+	if (mPassFramesDirty <= 0) {
+		return;
+	}
+
+	PassConstants passConstants;
+	XMStoreFloat4x4(&passConstants.ViewProj, XMMatrixTranspose(XMLoadFloat4x4(&mViewProj)));
+	mCurrFrameResource->PassCB->CopyData(0, passConstants);
+
+	mPassFramesDirty--;
+	mUploadStats.PassesWritten++;
+	mUploadStats.BytesWritten += sizeof(PassConstants);
+}
+
+void LittleRendererWindow::StepSimulation(float stepSeconds) {
+	mOrbit.Theta += OrbitSpeed * stepSeconds;
+	//Wrap both states together, so the interpolation between them does not jump.
+	if (mOrbit.Theta >= XM_2PI) {
+		mOrbit.Theta -= XM_2PI;
+		mPrevOrbit.Theta -= XM_2PI;
+	}
+}
+
+void LittleRendererWindow::Update(double elapsedSeconds){
+	//Take back the oldest frame resource once the render thread recorded it,
+	//which cycles through them like the circular array did.
+	mCurrFrameResourceIndex = (int)mPipeline->Acquire();
+	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
+
+	//Has the GPU finished processing the commands of the current frame resource?
+	//If not, wait until the GPU has completed commands up to this fence point.
+	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence) {
+		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
+		WaitForSingleObject(eventHandle, INFINITE);
+		CloseHandle(eventHandle);
+	}
+
+	//Resume the tasks waiting for this frame or for a fence the GPU has passed.
+	mScheduler.Tick();
+
+	//The last frame is complete here, and so are the draw packets of this frame resource.
+	if (mFrameCount != 0 && mFrameCount % StatsLogInterval == 0) {
+		LogRenderStats();
+	}
+
+	//Simulate in fixed steps whatever the frame rate, then place the camera
+	//between the last two simulated states by the time left over.
+	const uint32_t steps = mFixedStep.Advance(elapsedSeconds);
+	for (uint32_t i = 0; i < steps; ++i) {
+		mPrevOrbit = mOrbit;
+		StepSimulation((float)mFixedStep.StepSeconds());
+	}
+	const float alpha = (float)mFixedStep.Alpha();
+	OrbitState orbit;
+	orbit.Theta = mPrevOrbit.Theta + (mOrbit.Theta - mPrevOrbit.Theta) * alpha;
+	orbit.Phi = mPrevOrbit.Phi + (mOrbit.Phi - mPrevOrbit.Phi) * alpha;
+	orbit.Radius = mPrevOrbit.Radius + (mOrbit.Radius - mPrevOrbit.Radius) * alpha;
+	if (orbit.Theta != mRenderOrbit.Theta || orbit.Phi != mRenderOrbit.Phi || orbit.Radius != mRenderOrbit.Radius) {
+		mRenderOrbit = orbit;
+		mCameraDirty = true;
+	}
+
+	UpdateCamera();
+	XMVECTOR pos = XMVectorSetW(XMLoadFloat3(&mEyePos), 1.0f);
+	XMMATRIX viewProj = XMLoadFloat4x4(&mViewProj);
+
+	//Nothing below the grid moves yet, so the static levels are skipped. A box
+	//that does move gets its world copied and its constants marked dirty.
+	mTransforms.Update();
+	for (UINT i = 0; i < (UINT)mRitems.size(); ++i) {
+		if (mTransforms.Changed(mBoxTransforms[i])) {
+			mTransforms.GetWorld(mBoxTransforms[i], &mRitems[i].World.m[0][0]);
+			mRitems[i].NumFramesDirty = NumFrameResources;
+		}
+	}
+
+	//Only dirty objects and a changed camera are written into this frame's
+	//buffers, they still hold everything else. The writes run as a job next
+	//to the culling below, which only reads the render items.
+	JobSystem& jobs = DefaultJobSystem();
+	JobCounter constantsWritten;
+	jobs.Run([this]() {
+		auto uploadStart = std::chrono::high_resolution_clock::now();
+		mUploadStats = ConstantUploadStats();
+		UpdateObjectConstants();
+		UpdatePassConstants();
+		mUploadStats.Milliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - uploadStart).count();
+	}, &constantsWritten);
+
+	//Only the boxes inside the view frustum are drawn.
+	mFrustumCuller.Cull(viewProj, mVisibleRitems);
+
+	//The boxes nearest to the camera hide much of the grid behind them.
+	mOcclusionCuller.SelectOccluders(mVisibleRitems, pos, MaxOccluderCount, mOccluders);
+	mOcclusionCuller.BeginFrame(viewProj);
+	for (UINT index : mOccluders) {
+		const RenderItem& ritem = mRitems[index];
+		const MeshRaycaster& mesh = mMeshRaycasters.at(ritem.Submesh);
+		mOcclusionCuller.AddOccluder(mesh.Positions().data(), mesh.TriangleCount(), XMLoadFloat4x4(&ritem.World));
+	}
+	mOcclusionCuller.RasterizeOccluders();
+	mOcclusionCuller.Cull(mVisibleRitems, mUnoccludedRitems);
+
+	//Distant boxes are drawn with fewer triangles.
+	mLodSelector.Select(pos, mUnoccludedRitems);
+
+	//Group the boxes into instanced draws and write their transforms. Meshes
+	//made of several clusters are drawn on their own, with the visible clusters only.
+	mInstanceBatcher.Begin();
+	mClusterCuller.BeginFrame();
+	for (UINT index : mUnoccludedRitems) {
+		const RenderItem& ritem = mRitems[index];
+		const SubmeshGeometry* submesh = mLodSelector.Submesh(index);
+		if (mClusterCuller.ClusterCount(submesh) <= 1) {
+			mInstanceBatcher.Add(ritem, submesh);
+			continue;
+		}
+		mClusterRanges.clear();
+		mClusterCuller.Cull(*submesh, XMLoadFloat4x4(&ritem.World), viewProj, pos, mClusterRanges);
+		if (!mClusterRanges.empty()) {
+			mInstanceBatcher.AddRanges(ritem, submesh, mClusterRanges.data(), (UINT)mClusterRanges.size());
+		}
+	}
+	jobs.Wait(constantsWritten);
+	mInstanceBatcher.Build(*mCurrFrameResource->InstanceBuffer);
+	mUploadStats.Instances = mInstanceBatcher.Stats().Instances;
+	mUploadStats.BytesWritten += (UINT64)mUploadStats.Instances * sizeof(InstanceData);
+	mUploadStats.BytesWithoutTracking += (UINT64)mUploadStats.Instances * sizeof(InstanceData);
+
+	//The static batches only need culling, their transform was written once.
+	mStaticBatches.Cull(viewProj);
+
+	//Turn the batches into draw packets and sort them by state.
+	//The pass constants of this frame resource are behind its own descriptor.
+	CD3DX12_GPU_DESCRIPTOR_HANDLE passTable(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
+	passTable.Offset(mCurrFrameResourceIndex, mCbvSrvUavDescriptorSize);
+	DrawQueue& drawQueue = mCurrFrameResource->Draws;
+	drawQueue.Reset();
+	mInstanceBatcher.Submit(drawQueue, passTable, mCurrFrameResource->InstanceBuffer->Resource()->GetGPUVirtualAddress());
+	mStaticBatches.Submit(drawQueue, passTable);
+	drawQueue.Sort();
+
+	mFrameCount++;
 }
 
 void LittleRendererWindow::Draw() {
-	ThrowIfFailed(mDirectCmdListAlloc->Reset());
+	auto cmdListAlloc = mDrawFrameResource->CmdListAlloc;
 
-	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), mPSO.Get()));
+	//Reuse the memory associated with command recording.
+	//We can only reset when the associated command lists have finished execution on the GPU.
+	ThrowIfFailed(cmdListAlloc->Reset());
 
-	mCommandList->RSSetViewports(1, &mScreenViewport);
-	mCommandList->RSSetScissorRects(1, &mScissorRect);
+	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSO.Get()));
 
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
 		CurrentBackBuffer(),
@@ -254,44 +690,142 @@ void LittleRendererWindow::Draw() {
 	mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
 	mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
 
-	//Specify the buffers we are going to render to
-	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+	ThrowIfFailed(mCommandList->Close());
 
+	//Record the sorted packets into one list per range, skipping state that
+	//is already bound. Command list state does not carry over between lists,
+	//so each of them specifies the buffers we render to, the heaps and the
+	//root signature again.
 	ID3D12DescriptorHeap* descriptorHeaps[] = { mCbvHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-
-	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
-
-	mCommandList->IASetVertexBuffers(0, 1, &mBoxGeo->VertexBufferView());
-	mCommandList->IASetIndexBuffer(&mBoxGeo->IndexBufferView());
-	mCommandList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-	mCommandList->SetGraphicsRootDescriptorTable(0, mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-
-	mCommandList->DrawIndexedInstanced(
-		mBoxGeo->DrawArgs["box"].IndexCount,
-		1, 0, 0, 0
-	);
+	DrawQueue& draws = mDrawFrameResource->Draws;
+	const UINT drawListCount = draws.SubmitListCount((UINT)mDrawLists.size());
+	ID3D12GraphicsCommandList* drawLists[MaxDrawLists];
+	ID3D12CommandList* cmdsLists[1 + MaxDrawLists] = { mCommandList.Get() };
+	for (UINT i = 0; i < drawListCount; ++i) {
+		ID3D12CommandAllocator* alloc = mDrawFrameResource->DrawListAllocs[i].Get();
+		ID3D12GraphicsCommandList* drawList = mDrawLists[i].Get();
+		ThrowIfFailed(alloc->Reset());
+		ThrowIfFailed(drawList->Reset(alloc, mPSO.Get()));
+		drawList->RSSetViewports(1, &mScreenViewport);
+		drawList->RSSetScissorRects(1, &mScissorRect);
+		drawList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
+		drawList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+		drawList->SetGraphicsRootSignature(mRootSignature.Get());
+		drawList->SetGraphicsRootShaderResourceView(2, mDrawFrameResource->ObjectBuffer->Resource()->GetGPUVirtualAddress());
+		drawList->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		drawLists[i] = drawList;
+		cmdsLists[1 + i] = drawList;
+	}
+	draws.Submit(drawLists, drawListCount, 0, 1);
 
 	//Indicate a state transition on the resource usage
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
+	ID3D12GraphicsCommandList* lastList = drawLists[drawListCount - 1];
+	lastList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
 
 	//Done recording commands.
-	ThrowIfFailed(mCommandList->Close());
+	for (UINT i = 0; i < drawListCount; ++i) {
+		ThrowIfFailed(drawLists[i]->Close());
+	}
 
-	//Add the command list to the queue for execution
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	//Add the command lists to the queue for execution, in recording order
+	mCommandQueue->ExecuteCommandLists(1 + drawListCount, cmdsLists);
 
 	//swap the back and front buffers.
 	ThrowIfFailed(mSwapChain->Present(0, 0));
 	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
 
-	//Wait until frame commands are complete. This waiting is infficient
-	//and is done for simplicity. Later we will show how to organize our rendering code
-	//so we do not have to wait per frame.
-	FlushCommandQueue();
+	//Advance the fence value to mark commands up to this fence point.
+	mDrawFrameResource->Fence = ++mCurrentFence;
+
+	//Add an instruction to the command queue to set a new fence point.
+	//Because we are on the GPU timeline, the new fence point won't be
+	//set until the GPU finishes processing all the commands prior to this Signal().
+	//不再每帧等待GPU,下次用到这个帧资源时才在Update()里等它的栅栏
+	ThrowIfFailed(mCommandQueue->Signal(mFence.Get(), mCurrentFence));
+}
+
+void LittleRendererWindow::LogRenderStats() {
+	const FrustumCullStats& cullStats = mFrustumCuller.Stats();
+	std::cout << "[frame " << mFrameCount << "] frustum culling: " << cullStats.Visible << "/"
+		<< cullStats.Tested << " visible, " << cullStats.Milliseconds << " ms" << std::endl;
+
+	const OcclusionCullStats& occlusionStats = mOcclusionCuller.Stats();
+	std::cout << "[frame " << mFrameCount << "] occlusion culling: " << occlusionStats.Occluded << "/"
+		<< occlusionStats.Tested << " occluded (" << occlusionStats.CulledPercent() << "%), "
+		<< occlusionStats.Occluders << " occluders, " << occlusionStats.OccluderTriangles << " triangles, raster "
+		<< occlusionStats.RasterMilliseconds << " ms, test " << occlusionStats.TestMilliseconds << " ms" << std::endl;
+
+	const LodSelectStats& lodStats = mLodSelector.Stats();
+	std::cout << "[frame " << mFrameCount << "] lod: " << lodStats.DrawnTriangles << "/"
+		<< lodStats.FullDetailTriangles << " triangles drawn, " << lodStats.SavedTriangles() << " saved ("
+		<< lodStats.SavedPercent() << "%), objects per level";
+	for (UINT level = 0; level < LodSelectStats::MaxLevels; ++level) {
+		if (lodStats.ObjectsPerLevel[level] != 0) {
+			std::cout << " L" << level << ":" << lodStats.ObjectsPerLevel[level];
+		}
+	}
+	std::cout << ", " << lodStats.Switches << " switches, " << lodStats.Milliseconds << " ms" << std::endl;
+
+	const ClusterCullStats& clusterStats = mClusterCuller.Stats();
+	if (clusterStats.Objects != 0) {
+		std::cout << "[frame " << mFrameCount << "] cluster culling: " << clusterStats.Objects << " objects, "
+			<< clusterStats.Clusters << " clusters, " << clusterStats.FrustumCulled << " outside, "
+			<< clusterStats.BackfaceCulled << " backfacing (" << clusterStats.CulledPercent() << "%), "
+			<< clusterStats.VisibleTriangles << "/" << clusterStats.Triangles << " triangles in "
+			<< clusterStats.Ranges << " ranges, " << clusterStats.Milliseconds << " ms" << std::endl;
+	}
+
+	const InstanceBatchStats& batchStats = mInstanceBatcher.Stats();
+	std::cout << "[frame " << mFrameCount << "] draws: " << batchStats.DrawsRequested
+		<< " requested, " << batchStats.DrawsIssued << " issued, "
+		<< batchStats.DrawsSaved << " saved by instancing" << std::endl;
+
+	std::cout << "[frame " << mFrameCount << "] constants: " << mUploadStats.ObjectsWritten << "/"
+		<< mUploadStats.Objects << " objects and " << mUploadStats.PassesWritten << "/1 pass written, "
+		<< mUploadStats.Instances << " instances, " << mUploadStats.BytesWritten << " bytes written ("
+		<< mUploadStats.BytesWithoutTracking << " without tracking), " << mUploadStats.Milliseconds << " ms" << std::endl;
+
+	const TransformUpdateStats& transformStats = mTransforms.Stats();
+	std::cout << "[frame " << mFrameCount << "] transforms: " << transformStats.Updated << "/"
+		<< transformStats.Nodes << " nodes updated in " << transformStats.Levels << " levels, "
+		<< transformStats.Milliseconds << " ms" << std::endl;
+
+	const StaticBatchStats& staticStats = mStaticBatches.Stats();
+	std::cout << "[frame " << mFrameCount << "] static batches: " << staticStats.Visible << "/"
+		<< staticStats.Batches << " visible, " << staticStats.VisibleTriangles << "/" << staticStats.Triangles
+		<< " triangles, " << staticStats.Milliseconds << " ms" << std::endl;
+
+	const DrawQueueStats& queueStats = mCurrFrameResource->Draws.Stats();
+	std::cout << "[frame " << mFrameCount << "] draw queue: " << queueStats.Packets << " packets, "
+		<< queueStats.StateChanges() << " state changes (pso " << queueStats.PipelineStateChanges
+		<< ", vb " << queueStats.VertexBufferChanges << ", ib " << queueStats.IndexBufferChanges
+		<< ", table " << queueStats.DescriptorTableChanges << "), sort "
+		<< queueStats.SortMilliseconds << " ms" << std::endl;
+
+	const FramePipelineStats& pipelineStats = mPipeline->Stats();
+	std::cout << "[frame " << mFrameCount << "] pipeline: " << pipelineStats.Frames << " frames rendered, latency "
+		<< pipelineStats.MeanLatencyMilliseconds() << " ms mean, " << pipelineStats.MaxLatencyMilliseconds
+		<< " ms max, at most " << pipelineStats.MaxFramesAhead << "/" << mPipeline->SnapshotCount()
+		<< " frames ahead, update waited " << pipelineStats.UpdateWaitMilliseconds << " ms, render thread idle "
+		<< pipelineStats.RenderIdleMilliseconds << " ms" << std::endl;
+	mPipeline->ResetStats();
+
+	std::cout << "[frame " << mFrameCount << "] simulation: " << mFixedStep.Steps() << " steps of "
+		<< mFixedStep.StepSeconds() * 1000.0 << " ms in " << mClock.TotalSeconds() << " s, "
+		<< mFixedStep.DroppedSteps() << " dropped by the clamp, alpha " << mFixedStep.Alpha() << std::endl;
+
+	LogCpuGeometryStats();
+}
+
+void LittleRendererWindow::LogCpuGeometryStats() {
+	CpuGeometryStats cpuStats = mCpuGeometry.Stats();
+	std::cout << "cpu geometry: " << cpuStats.TotalBytes() << " bytes (" << cpuStats.KeptMeshes << " kept, "
+		<< cpuStats.KeptBytes << " bytes; " << cpuStats.CompressedMeshes << " compressed, "
+		<< cpuStats.CompressedBytes << "/" << cpuStats.UncompressedBytes << " bytes; " << cpuStats.DroppedMeshes
+		<< " dropped), " << cpuStats.ReleasedBytes << " bytes released, cache " << cpuStats.CacheBytes << "/"
+		<< cpuStats.CacheBudgetBytes << " bytes, " << cpuStats.CacheHits << " hits, " << cpuStats.CacheMisses
+		<< " misses, " << cpuStats.Evictions << " evictions" << std::endl;
 }
 
 void LittleRendererWindow::Run() {
@@ -304,12 +838,13 @@ void LittleRendererWindow::Run() {
 		}
 		//在空闲时进行我们自己的逻辑
 		else {
-			//暂时什么都不做
-			//Sleep 1~2ms,避免被while独占
-			Update();
-			Draw();
+			//主线程写好一帧的快照就交给渲染线程录制和提交,自己接着更新下一帧;
+			//所有快照都在渲染线程手里时Acquire()会等待,主线程最多领先NumFrameResources帧
+			Update(mClock.Tick());
+			mPipeline->Publish((uint32_t)mCurrFrameResourceIndex);
 		}
 	}
-	//如果收到了WM_QUIT消息,直接退出函数
+	//如果收到了WM_QUIT消息,等渲染线程画完已提交的帧再退出
+	mPipeline->Stop();
 	return;
 }
\ No newline at end of file
@@ -0,0 +1,2000 @@
+//EngineBench: measures the D3D-free core modules of the renderer (scene
+//transforms and the Common helpers) and checks their results against
+//straightforward reference code. Builds on Linux as well.
+#include "../../source/header/Common/CpuTopology.h"
+#include "../../source/header/Common/FramePipeline.h"
+#include "../../source/header/Common/GameClock.h"
+#include "../../source/header/Common/JobSystem.h"
+#include "../../source/header/Common/MatrixBatch.h"
+#include "../../source/header/Common/ParallelFor.h"
+#include "../../source/header/Common/RadixSort.h"
+#include "../../source/header/Common/Random.h"
+#include "../../source/header/Common/SpscQueue.h"
+#include "../../source/header/Common/StreamCopy.h"
+#include "../../source/header/Common/Task.h"
+#include "../../source/header/Scene/TransformSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+	using Clock = std::chrono::high_resolution_clock;
+
+	double SecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	void PrintUsage()
+	{
+		std::cout <<
+			"usage:\n"
+			"  EngineBench transforms [nodes] [iterations]\n"
+			"  EngineBench matrices [count] [iterations]\n"
+			"  EngineBench random [count] [iterations]\n"
+			"  EngineBench stream [megabytes] [iterations]\n"
+			"  EngineBench jobs [max threads] [iterations]\n"
+			"  EngineBench tasks [count] [iterations]\n"
+			"  EngineBench affinity [frames] [noise threads]\n"
+			"  EngineBench pipeline [frames] [stage milliseconds]\n"
+			"  EngineBench timestep [seconds] [step hz]\n"
+			"  EngineBench drawqueue [packets] [iterations]\n";
+	}
+
+	//c = a * b for 4x4 row-major matrices.
+	void Multiply(const float* a, const float* b, float* c)
+	{
+		for (int r = 0; r < 4; ++r) {
+			for (int k = 0; k < 4; ++k) {
+				float sum = 0.0f;
+				for (int i = 0; i < 4; ++i) {
+					sum += a[4 * r + i] * b[4 * i + k];
+				}
+				c[4 * r + k] = sum;
+			}
+		}
+	}
+
+	struct LocalTransform
+	{
+		float Translation[3];
+		float Rotation[4];
+		float Scale[3];
+	};
+
+	//S * R * T with the rotation matrix of a unit quaternion, as DirectXMath builds it.
+	void ComposeLocal(const LocalTransform& local, float m[16])
+	{
+		const float x = local.Rotation[0], y = local.Rotation[1], z = local.Rotation[2], w = local.Rotation[3];
+		const float rotation[9] = {
+			1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w),
+			2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+			2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y),
+		};
+		for (int r = 0; r < 3; ++r) {
+			for (int c = 0; c < 3; ++c) {
+				m[4 * r + c] = rotation[3 * r + c] * local.Scale[r];
+			}
+			m[4 * r + 3] = 0.0f;
+			m[12 + r] = local.Translation[r];
+		}
+		m[15] = 1.0f;
+	}
+
+	LocalTransform RandomLocal(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+		std::uniform_real_distribution<float> scale(0.8f, 1.25f);
+		std::normal_distribution<float> gaussian;
+		LocalTransform local;
+		float length = 0.0f;
+		for (int k = 0; k < 4; ++k) {
+			local.Rotation[k] = gaussian(random);
+			length += local.Rotation[k] * local.Rotation[k];
+		}
+		for (int k = 0; k < 4; ++k) {
+			local.Rotation[k] /= sqrtf(length);
+		}
+		for (int k = 0; k < 3; ++k) {
+			local.Translation[k] = position(random);
+			local.Scale[k] = scale(random);
+		}
+		return local;
+	}
+
+	//Largest difference between the world matrices of the system and ones
+	//composed node by node, relative to the size of the values.
+	float CompareWorlds(const TransformSystem& transforms, const std::vector<TransformId>& ids,
+		const std::vector<uint32_t>& parents, const std::vector<LocalTransform>& locals,
+		const std::vector<uint8_t>* alive = nullptr)
+	{
+		std::vector<float> reference(ids.size() * 16);
+		float worst = 0.0f;
+		for (size_t n = 0; n < ids.size(); ++n) {
+			float local[16];
+			ComposeLocal(locals[n], local);
+			if (parents[n] == UINT32_MAX) {
+				memcpy(&reference[16 * n], local, sizeof(local));
+			}
+			else {
+				Multiply(local, &reference[16 * parents[n]], &reference[16 * n]);
+			}
+			if (alive != nullptr && !(*alive)[n]) {
+				continue;
+			}
+			float world[16];
+			transforms.GetWorld(ids[n], world);
+			for (int k = 0; k < 16; ++k) {
+				float expected = reference[16 * n + k];
+				worst = std::max(worst, fabsf(world[k] - expected) / std::max(1.0f, fabsf(expected)));
+			}
+		}
+		return worst;
+	}
+
+	//A forest of nodes whose parents are picked among the recent ones, a few
+	//levels deep like real scenes. Measures a full update, updates with a
+	//share of the nodes moved, the static case and the transposed
+	//world-view-projection write, then checks them against the reference.
+	int RunTransformBenchmark(size_t nodeCount, int iterations)
+	{
+		std::mt19937 random(1);
+		TransformSystem transforms;
+		std::vector<TransformId> ids(nodeCount);
+		std::vector<uint32_t> parents(nodeCount);
+		std::vector<uint32_t> depths(nodeCount);
+		std::vector<LocalTransform> locals(nodeCount);
+		auto start = Clock::now();
+		for (size_t n = 0; n < nodeCount; ++n) {
+			//Every 64th node is a root, the others hang below a node created shortly before.
+			parents[n] = n % 64 == 0 ? UINT32_MAX : (uint32_t)(n - 1 - random() % std::min<size_t>(n, 32));
+			depths[n] = parents[n] == UINT32_MAX ? 1 : depths[parents[n]] + 1;
+			if (depths[n] > 8) {
+				parents[n] = UINT32_MAX;
+				depths[n] = 1;
+			}
+			ids[n] = transforms.Create(parents[n] == UINT32_MAX ? InvalidTransform : ids[parents[n]]);
+			locals[n] = RandomLocal(random);
+			transforms.SetLocal(ids[n], locals[n].Translation, locals[n].Rotation, locals[n].Scale);
+		}
+		double createSeconds = SecondsSince(start);
+		start = Clock::now();
+		transforms.Update();
+		double firstSeconds = SecondsSince(start);
+		float worst = CompareWorlds(transforms, ids, parents, locals);
+
+		//Moving a node moves its whole subtree; the rest is skipped.
+		double best[3] = { 1e30, 1e30, 1e30 };
+		const size_t moved[3] = { nodeCount, nodeCount / 100, 0 };
+		uint32_t updated[3] = { 0, 0, 0 };
+		for (int test = 0; test < 3; ++test) {
+			for (int i = 0; i < iterations; ++i) {
+				for (size_t m = 0; m < moved[test]; ++m) {
+					size_t n = moved[test] == nodeCount ? m : random() % nodeCount;
+					locals[n].Translation[1] += 0.01f;
+					transforms.SetTranslation(ids[n], locals[n].Translation);
+				}
+				start = Clock::now();
+				transforms.Update();
+				best[test] = std::min(best[test], SecondsSince(start));
+				updated[test] = transforms.Stats().Updated;
+			}
+		}
+		worst = std::max(worst, CompareWorlds(transforms, ids, parents, locals));
+
+		//Transposed world * viewProj straight into a buffer laid out like constants (256 bytes apart).
+		const size_t stride = 256;
+		std::vector<uint8_t> constants(nodeCount * stride);
+		float viewProj[16];
+		for (int k = 0; k < 16; ++k) {
+			viewProj[k] = std::uniform_real_distribution<float>(-1.0f, 1.0f)(random);
+		}
+		double bestWrite = 1e30;
+		for (int i = 0; i < iterations; ++i) {
+			start = Clock::now();
+			transforms.WriteWorldViewProj(viewProj, ids.data(), ids.size(), constants.data(), stride);
+			bestWrite = std::min(bestWrite, SecondsSince(start));
+		}
+		float worstWrite = 0.0f;
+		for (size_t n = 0; n < nodeCount; n += 97) {
+			float world[16], expected[16];
+			transforms.GetWorld(ids[n], world);
+			Multiply(world, viewProj, expected);
+			const float* written = reinterpret_cast<const float*>(constants.data() + n * stride);
+			for (int r = 0; r < 4; ++r) {
+				for (int c = 0; c < 4; ++c) {
+					float e = expected[4 * c + r];
+					worstWrite = std::max(worstWrite, fabsf(written[4 * r + c] - e) / std::max(1.0f, fabsf(e)));
+				}
+			}
+		}
+
+		//Destroying a node takes its subtree along and leaves the others untouched.
+		std::vector<uint8_t> alive(nodeCount, 1);
+		for (size_t n = 0; n < nodeCount; ++n) {
+			if (n % 50 == 7) {
+				transforms.Destroy(ids[n]);
+				alive[n] = 0;
+			}
+			else if (parents[n] != UINT32_MAX && !alive[parents[n]]) {
+				alive[n] = 0;
+			}
+		}
+		transforms.Update();
+		size_t aliveCount = 0;
+		bool aliveMatches = true;
+		for (size_t n = 0; n < nodeCount; ++n) {
+			aliveCount += alive[n];
+			aliveMatches = aliveMatches && transforms.IsAlive(ids[n]) == (alive[n] != 0);
+		}
+		aliveMatches = aliveMatches && transforms.Size() == aliveCount;
+		worst = std::max(worst, CompareWorlds(transforms, ids, parents, locals, &alive));
+
+		const bool passed = worst < 1e-4f && worstWrite < 1e-4f && aliveMatches;
+		std::cout << "transforms: " << nodeCount << " nodes in " << transforms.Stats().Levels << " levels, "
+			<< ParallelWorkerCount() << " threads, created in " << createSeconds * 1000.0 << " ms, first update "
+			<< firstSeconds * 1000.0 << " ms\n";
+		const char* names[3] = { "all moved", "1% moved ", "static   " };
+		for (int test = 0; test < 3; ++test) {
+			std::cout << "  update, " << names[test] << ": " << best[test] * 1000.0 << " ms, " << updated[test]
+				<< " nodes recomputed (" << best[test] * 1e9 / nodeCount << " ns per node)\n";
+		}
+		std::cout << "  world * viewProj, transposed: " << bestWrite * 1000.0 << " ms ("
+			<< bestWrite * 1e9 / nodeCount << " ns per node)\n"
+			<< "  destroyed " << nodeCount - aliveCount << " nodes with their subtrees: "
+			<< (aliveMatches ? "consistent" : "INCONSISTENT") << "\n"
+			<< "  largest error " << worst << " (worlds), " << worstWrite << " (world * viewProj): "
+			<< (passed ? "passed" : "FAILED") << std::endl;
+		return passed ? 0 : 1;
+	}
+
+	//Largest relative difference of the first floats values every stride bytes.
+	float CompareRows(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, size_t stride, size_t count,
+		int floats)
+	{
+		float worst = 0.0f;
+		for (size_t i = 0; i < count; ++i) {
+			const float* x = reinterpret_cast<const float*>(a.data() + i * stride);
+			const float* y = reinterpret_cast<const float*>(b.data() + i * stride);
+			for (int k = 0; k < floats; ++k) {
+				worst = std::max(worst, fabsf(x[k] - y[k]) / std::max(1.0f, fabsf(y[k])));
+			}
+		}
+		return worst;
+	}
+
+	//Affine matrices as scenes have them (see ComposeLocal), some of them
+	//mirrored and every 1000th singular, packed like RenderItem::World
+	//inside a larger structure. Every kernel level the CPU supports runs
+	//each batch operation into buffers with the 256-byte stride of
+	//constants; the scalar level is checked against the reference code of
+	//this file, the others against the scalar one. The count is odd by
+	//default so the remainders of the SIMD loops get exercised as well.
+	int RunMatrixBenchmark(size_t count, int iterations)
+	{
+		std::mt19937 random(3);
+		const size_t srcStride = 96;
+		const size_t boxStride = 28;
+		const size_t dstStride = 256;
+		std::vector<uint8_t> worlds(count * srcStride);
+		std::vector<uint8_t> boxes(count * boxStride);
+		for (size_t i = 0; i < count; ++i) {
+			LocalTransform local = RandomLocal(random);
+			if (i % 3 == 1) {
+				local.Scale[i % 2] = -local.Scale[i % 2];
+			}
+			if (i % 1000 == 999) {
+				local.Scale[2] = 0.0f;
+			}
+			float* world = reinterpret_cast<float*>(worlds.data() + i * srcStride);
+			ComposeLocal(local, world);
+			float* box = reinterpret_cast<float*>(boxes.data() + i * boxStride);
+			for (int k = 0; k < 3; ++k) {
+				box[k] = std::uniform_real_distribution<float>(-2.0f, 2.0f)(random);
+				box[3 + k] = std::uniform_real_distribution<float>(0.1f, 2.0f)(random);
+			}
+		}
+		float viewProj[16];
+		for (int k = 0; k < 16; ++k) {
+			viewProj[k] = std::uniform_real_distribution<float>(-1.0f, 1.0f)(random);
+		}
+		const float* src = reinterpret_cast<const float*>(worlds.data());
+		const float* box = reinterpret_cast<const float*>(boxes.data());
+
+		//Reference results: transpose(world * viewProj) and the other operations.
+		float worstReference = 0.0f;
+		std::vector<uint8_t> out(count * dstStride);
+		float* dst = reinterpret_cast<float*>(out.data());
+		const MatrixKernels& scalar = GetMatrixKernels(MatrixKernelLevel::Scalar);
+		scalar.Multiply(src, srcStride, viewProj, dst, dstStride, count, true);
+		for (size_t i = 0; i < count; i += 7) {
+			float expected[16];
+			Multiply(reinterpret_cast<const float*>(worlds.data() + i * srcStride), viewProj, expected);
+			const float* written = reinterpret_cast<const float*>(out.data() + i * dstStride);
+			for (int k = 0; k < 16; ++k) {
+				float e = expected[4 * (k & 3) + (k >> 2)];
+				worstReference = std::max(worstReference, fabsf(written[k] - e) / std::max(1.0f, fabsf(e)));
+			}
+		}
+		//The transpose of the normal matrix times the 3x3 part is the identity.
+		scalar.InverseTranspose(src, srcStride, dst, dstStride, count, true);
+		for (size_t i = 0; i < count; i += 7) {
+			const float* world = reinterpret_cast<const float*>(worlds.data() + i * srcStride);
+			const float* normal = reinterpret_cast<const float*>(out.data() + i * dstStride);
+			bool singular = i % 1000 == 999;
+			for (int r = 0; r < 3; ++r) {
+				for (int c = 0; c < 3; ++c) {
+					float sum = 0.0f;
+					for (int k = 0; k < 3; ++k) {
+						sum += world[4 * r + k] * normal[4 * k + c];
+					}
+					float e = singular ? 0.0f : (r == c ? 1.0f : 0.0f);
+					worstReference = std::max(worstReference, fabsf(sum - e));
+				}
+			}
+		}
+		//A box through its matrix holds its eight transformed corners, touching them on every side.
+		scalar.TransformAabbs(box, boxStride, src, srcStride, dst, dstStride, count);
+		for (size_t i = 0; i < count; i += 7) {
+			const float* b = reinterpret_cast<const float*>(boxes.data() + i * boxStride);
+			const float* m = reinterpret_cast<const float*>(worlds.data() + i * srcStride);
+			const float* result = reinterpret_cast<const float*>(out.data() + i * dstStride);
+			float lo[3] = { 1e30f, 1e30f, 1e30f }, hi[3] = { -1e30f, -1e30f, -1e30f };
+			for (int corner = 0; corner < 8; ++corner) {
+				float p[3];
+				for (int k = 0; k < 3; ++k) {
+					p[k] = b[k] + ((corner >> k) & 1 ? b[3 + k] : -b[3 + k]);
+				}
+				for (int k = 0; k < 3; ++k) {
+					float t = p[0] * m[k] + p[1] * m[4 + k] + p[2] * m[8 + k] + m[12 + k];
+					lo[k] = std::min(lo[k], t);
+					hi[k] = std::max(hi[k], t);
+				}
+			}
+			for (int k = 0; k < 3; ++k) {
+				worstReference = std::max(worstReference, fabsf(result[k] - result[3 + k] - lo[k]) / std::max(1.0f, fabsf(lo[k])));
+				worstReference = std::max(worstReference, fabsf(result[k] + result[3 + k] - hi[k]) / std::max(1.0f, fabsf(hi[k])));
+			}
+		}
+
+		const char* names[3] = { "scalar", "AVX2  ", "AVX-512" };
+		const char* operations[6] = {
+			"world * viewProj, transposed",
+			"world * viewProj            ",
+			"transpose                   ",
+			"normal matrix, transposed   ",
+			"AABB, own matrices          ",
+			"AABB, shared matrix         ",
+		};
+		const int levels = (int)BestMatrixKernelLevel() + 1;
+		double best[3][6];
+		float worst[3] = { 0.0f, 0.0f, 0.0f };
+		std::vector<uint8_t> expected[6];
+		for (int level = 0; level < levels; ++level) {
+			const MatrixKernels& kernels = GetMatrixKernels((MatrixKernelLevel)level);
+			for (int op = 0; op < 6; ++op) {
+				best[level][op] = 1e30;
+				std::fill(out.begin(), out.end(), (uint8_t)0);
+				for (int i = 0; i < iterations; ++i) {
+					auto start = Clock::now();
+					switch (op) {
+					case 0: kernels.Multiply(src, srcStride, viewProj, dst, dstStride, count, true); break;
+					case 1: kernels.Multiply(src, srcStride, viewProj, dst, dstStride, count, false); break;
+					case 2: kernels.Transpose(src, srcStride, dst, dstStride, count); break;
+					case 3: kernels.InverseTranspose(src, srcStride, dst, dstStride, count, true); break;
+					case 4: kernels.TransformAabbs(box, boxStride, src, srcStride, dst, dstStride, count); break;
+					case 5: kernels.TransformAabbs(box, boxStride, src, 0, dst, dstStride, count); break;
+					}
+					best[level][op] = std::min(best[level][op], SecondsSince(start));
+				}
+				if (level == 0) {
+					expected[op] = out;
+				}
+				else {
+					worst[level] = std::max(worst[level], CompareRows(out, expected[op], dstStride, count,
+						op >= 4 ? 6 : 16));
+				}
+			}
+		}
+
+		const bool passed = worstReference < 1e-4f && worst[1] < 1e-5f && worst[2] < 1e-5f;
+		std::cout << "matrices: " << count << ", best of " << iterations << ", ns per matrix\n"
+			<< "                                ";
+		for (int level = 0; level < levels; ++level) {
+			std::cout << "  " << names[level];
+		}
+		std::cout << "\n";
+		char line[128];
+		for (int op = 0; op < 6; ++op) {
+			std::cout << "  " << operations[op];
+			for (int level = 0; level < levels; ++level) {
+				snprintf(line, sizeof(line), "  %6.2f ", best[level][op] * 1e9 / count);
+				std::cout << line;
+			}
+			std::cout << "\n";
+		}
+		std::cout << "  largest error " << worstReference << " (scalar against reference), " << worst[1]
+			<< " (AVX2), " << worst[2] << " (AVX-512): " << (passed ? "passed" : "FAILED") << std::endl;
+		return passed ? 0 : 1;
+	}
+	//Chi-square statistic of the top byte of values in 256 buckets; about
+	//255 +- 23 for uniform values.
+	double ChiSquare256(const std::vector<uint32_t>& values)
+	{
+		std::vector<double> buckets(256, 0.0);
+		for (uint32_t value : values) {
+			buckets[value >> 24] += 1.0;
+		}
+		const double expected = values.size() / 256.0;
+		double chi = 0.0;
+		for (double bucket : buckets) {
+			chi += (bucket - expected) * (bucket - expected) / expected;
+		}
+		return chi;
+	}
+
+	//The fills give the same values however a range is split: every thread
+	//count in turn fills its own uneven share of the range, the result has to
+	//match one call over all of it bit for bit. The AVX2 fills have to match
+	//the scalar ones bit for bit as well, also across a 2^32 block of
+	//counters, and the values have to look uniform. Then the
+	//throughput of rand(), of the sequential generator and of the fills.
+	int RunRandomBenchmark(size_t count, int iterations)
+	{
+		const uint64_t seed = 42;
+		bool passed = true;
+		auto fail = [&passed](const char* what) {
+			std::cout << "  FAILED: " << what << "\n";
+			passed = false;
+		};
+
+		std::vector<uint32_t> bits(count);
+		std::vector<float> floats(count);
+		std::vector<float> unitVectors(3 * count);
+		FillRandomUint32(bits.data(), count, seed);
+		FillRandomFloats(floats.data(), count, -1.0f, 3.0f, seed);
+		FillRandomUnitVectors(unitVectors.data(), count, seed);
+
+		const int threadCounts[] = { 1, 2, 3, 4, 8, 16, 64 };
+		for (int threads : threadCounts) {
+			std::vector<uint32_t> splitBits(count);
+			std::vector<float> splitFloats(count);
+			std::vector<float> splitVectors(3 * count);
+			std::vector<std::thread> workers;
+			for (int t = 0; t < threads; ++t) {
+				//Shares of different sizes, not multiples of 8.
+				size_t begin = count * t * (t + 1) / (threads * (threads + 1));
+				size_t end = count * (t + 1) * (t + 2) / (threads * (threads + 1));
+				workers.emplace_back([&, begin, end]() {
+					FillRandomUint32(splitBits.data() + begin, end - begin, seed, begin);
+					FillRandomFloats(splitFloats.data() + begin, end - begin, -1.0f, 3.0f, seed, begin);
+					FillRandomUnitVectors(splitVectors.data() + 3 * begin, end - begin, seed, begin);
+				});
+			}
+			for (std::thread& worker : workers) {
+				worker.join();
+			}
+			if (splitBits != bits || memcmp(splitFloats.data(), floats.data(), count * sizeof(float)) != 0 ||
+				memcmp(splitVectors.data(), unitVectors.data(), 3 * count * sizeof(float)) != 0) {
+				fail("fills split among threads differ from a single fill");
+			}
+		}
+
+		//Scalar against the dispatched versions, starting shortly before the
+		//high half of the counter changes.
+		const uint64_t firsts[2] = { 0, (1ull << 32) - 45 };
+		for (uint64_t first : firsts) {
+			const size_t n = std::min<size_t>(count, 4099);
+			std::vector<uint32_t> a(n), b(n);
+			FillRandomUint32(a.data(), n, seed, first);
+			RandomScalar::FillUint32(b.data(), n, seed, first);
+			bool same = a == b;
+			std::vector<float> fa(3 * n), fb(3 * n);
+			FillRandomFloats(fa.data(), n, 0.0f, 1.0f, seed, first);
+			RandomScalar::FillFloats(fb.data(), n, 0.0f, 1.0f, seed, first);
+			same = same && memcmp(fa.data(), fb.data(), n * sizeof(float)) == 0;
+			for (size_t i = 0; i < n; ++i) {
+				same = same && b[i] == RandomHash(seed, first + i);
+			}
+			if (!same) {
+				fail("AVX2 and scalar fills differ");
+			}
+			const float lo[3] = { -1.0f, 0.0f, 10.0f }, hi[3] = { 1.0f, 5.0f, 20.0f };
+			FillRandomVectors(fa.data(), n, lo, hi, seed, first);
+			RandomScalar::FillVectors(fb.data(), n, lo, hi, seed, first);
+			same = memcmp(fa.data(), fb.data(), 3 * n * sizeof(float)) == 0;
+			for (size_t i = 0; i < 3 * n; ++i) {
+				same = same && fa[i] >= lo[i % 3] && fa[i] <= hi[i % 3];
+			}
+			FillRandomUnitVectors(fa.data(), n, seed, first);
+			RandomScalar::FillUnitVectors(fb.data(), n, seed, first);
+			same = same && memcmp(fa.data(), fb.data(), 3 * n * sizeof(float)) == 0;
+			if (!same) {
+				fail("AVX2 and scalar vectors differ");
+			}
+		}
+
+		//Uniformity: moments of the floats, the top byte of the bits and of
+		//the sequential generator, and the unit vectors.
+		double sum = 0.0, sumSquares = 0.0;
+		for (float value : floats) {
+			double u = (value + 1.0) / 4.0;
+			sum += u;
+			sumSquares += u * u;
+		}
+		const double mean = sum / count;
+		const double variance = sumSquares / count - mean * mean;
+		const double chiHash = ChiSquare256(bits);
+		Random random(seed, 0);
+		std::vector<uint32_t> sequential(count);
+		for (uint32_t& value : sequential) {
+			value = random.NextU32();
+		}
+		const double chiSequential = ChiSquare256(sequential);
+		double worstLength = 0.0, zSquares = 0.0;
+		double center[3] = { 0.0, 0.0, 0.0 };
+		for (size_t i = 0; i < count; ++i) {
+			const float* v = &unitVectors[3 * i];
+			worstLength = std::max(worstLength, fabs(sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]) - 1.0));
+			for (int k = 0; k < 3; ++k) {
+				center[k] += v[k] / count;
+			}
+			zSquares += v[2] * v[2] / count;
+		}
+		const double tolerance = 5.0 / sqrt((double)count);
+		if (fabs(mean - 0.5) > tolerance || fabs(variance - 1.0 / 12.0) > tolerance) {
+			fail("floats are not uniform");
+		}
+		if (chiHash > 400.0 || chiSequential > 400.0) {
+			fail("top bytes are not uniform");
+		}
+		if (worstLength > 1e-5 || fabs(center[0]) > tolerance || fabs(center[1]) > tolerance ||
+			fabs(center[2]) > tolerance || fabs(zSquares - 1.0 / 3.0) > tolerance) {
+			fail("unit vectors are not uniform on the sphere");
+		}
+		//Streams and jumps lead to different sequences.
+		Random stream1(seed, 1), jumped(seed, 0);
+		jumped.Jump();
+		Random first(seed, 0);
+		if (stream1.NextU64() == first.NextU64() || jumped.NextU64() == Random(seed, 0).NextU64()) {
+			fail("streams coincide");
+		}
+
+		//Throughput, best of the iterations.
+		double best[7];
+		const char* names[7] = {
+			"rand()                  ",
+			"Random::NextFloat       ",
+			"fill floats, scalar     ",
+			"fill floats             ",
+			"fill unit vectors, scalar",
+			"fill unit vectors       ",
+			"fill floats, all threads",
+		};
+		volatile float sink = 0.0f;
+		for (int test = 0; test < 7; ++test) {
+			best[test] = 1e30;
+			for (int i = 0; i < iterations; ++i) {
+				auto start = Clock::now();
+				switch (test) {
+				case 0: {
+					float acc = 0.0f;
+					for (size_t k = 0; k < count; ++k) {
+						acc += (float)rand() / (float)RAND_MAX;
+					}
+					sink = acc;
+					break;
+				}
+				case 1: {
+					float acc = 0.0f;
+					for (size_t k = 0; k < count; ++k) {
+						acc += random.NextFloat();
+					}
+					sink = acc;
+					break;
+				}
+				case 2: RandomScalar::FillFloats(floats.data(), count, 0.0f, 1.0f, seed, 0); break;
+				case 3: FillRandomFloats(floats.data(), count, 0.0f, 1.0f, seed); break;
+				case 4: RandomScalar::FillUnitVectors(unitVectors.data(), count, seed, 0); break;
+				case 5: FillRandomUnitVectors(unitVectors.data(), count, seed); break;
+				case 6:
+					ParallelFor(0, count, 8192, [&](size_t begin, size_t end) {
+						FillRandomFloats(floats.data() + begin, end - begin, 0.0f, 1.0f, seed, begin);
+					});
+					break;
+				}
+				best[test] = std::min(best[test], SecondsSince(start));
+			}
+		}
+		(void)sink;
+
+		std::cout << "random: " << count << " values, best of " << iterations << ", " << ParallelWorkerCount()
+			<< " threads\n";
+		for (int test = 0; test < 7; ++test) {
+			std::cout << "  " << names[test] << "  " << best[test] * 1e9 / count << " ns per value\n";
+		}
+		std::cout << "  mean " << mean << ", variance " << variance << " (1/12 = " << 1.0 / 12.0 << "), chi-square "
+			<< chiHash << " (fills), " << chiSequential << " (sequential), unit vector length error " << worstLength
+			<< ": " << (passed ? "passed" : "FAILED") << std::endl;
+		return passed ? 0 : 1;
+	}
+
+	//A 64 byte aligned buffer of size bytes, kept alive by storage.
+	uint8_t* AlignedBuffer(std::vector<uint8_t>& storage, size_t size)
+	{
+		storage.assign(size + 64, 0);
+		return storage.data() + ((0 - (uintptr_t)storage.data()) & 63);
+	}
+
+	int RunStreamBenchmark(size_t megabytes, int iterations)
+	{
+		//Both kernels against memcpy, on every head and tail alignment.
+		std::mt19937 random(5);
+		std::vector<uint8_t> sourceStorage, targetStorage;
+		uint8_t* source = AlignedBuffer(sourceStorage, 4096);
+		uint8_t* target = AlignedBuffer(targetStorage, 4096);
+		for (size_t i = 0; i < 4096; ++i) {
+			source[i] = (uint8_t)random();
+		}
+		std::vector<uint8_t> expected(4096);
+		const int levels = (int)BestStreamCopyLevel() + 1;
+		bool copiesMatch = true;
+		for (int level = 0; level < levels; ++level) {
+			const StreamCopyKernels& kernels = GetStreamCopyKernels((StreamCopyLevel)level);
+			for (int trial = 0; trial < 4000; ++trial) {
+				size_t size = random() % 1100;
+				size_t srcOffset = random() % 64;
+				size_t dstOffset = 64 + random() % 64;
+				memset(target, 0xCD, 4096);
+				memcpy(expected.data(), target, 4096);
+				memcpy(expected.data() + dstOffset, source + srcOffset, size);
+				kernels.Copy(target + dstOffset, source + srcOffset, size);
+				copiesMatch = copiesMatch && memcmp(target, expected.data(), 4096) == 0;
+			}
+
+			//Strided elements: the last line of an element is zero padded only
+			//when the destination allows whole lines, nothing else is touched.
+			const size_t elementSizes[6] = { 4, 16, 64, 72, 200, 256 };
+			const size_t count = 7;
+			for (size_t elementSize : elementSizes) {
+				const size_t srcStride = elementSize + 8;
+				const size_t dstStrides[3] = { elementSize, 256, elementSize + 20 };
+				for (size_t dstStride : dstStrides) {
+					for (size_t dstOffset : { (size_t)0, (size_t)4 }) {
+						memset(target, 0xCD, 4096);
+						memcpy(expected.data(), target, 4096);
+						const size_t padded = (elementSize + 63) / 64 * 64;
+						const bool wholeLines = dstOffset % 64 == 0 && dstStride % 64 == 0 && padded <= dstStride;
+						for (size_t i = 0; i < count; ++i) {
+							uint8_t* element = expected.data() + dstOffset + i * dstStride;
+							if (wholeLines) {
+								memset(element, 0, padded);
+							}
+							memcpy(element, source + i * srcStride, elementSize);
+						}
+						kernels.CopyStrided(target + dstOffset, dstStride, source, srcStride, elementSize, count);
+						copiesMatch = copiesMatch && memcmp(target, expected.data(), 4096) == 0;
+					}
+				}
+			}
+		}
+
+		//The same copies in a buffer that stays in cache and one that does
+		//not. Plain memory only: a write-combined upload heap needs a D3D12
+		//driver to map it, and there the streaming copies gain the most.
+		const size_t sizes[2] = { (size_t)256 << 10, megabytes << 20 };
+		const size_t constantSize = 64;
+		const size_t constantStride = 256;
+		const char* names[5] = {
+			"memcpy                 ",
+			"stream, SSE2           ",
+			"stream, AVX2           ",
+			"constants, memcpy      ",
+			"constants, stream      ",
+		};
+		double best[5][2];
+		for (int buffer = 0; buffer < 2; ++buffer) {
+			const size_t size = sizes[buffer];
+			uint8_t* src = AlignedBuffer(sourceStorage, size);
+			uint8_t* dst = AlignedBuffer(targetStorage, size);
+			for (size_t i = 0; i < size; i += 64) {
+				src[i] = (uint8_t)i;
+			}
+			//Constants are packed in the source and padded to 256 bytes in the destination.
+			const size_t constants = size / constantStride;
+			for (int test = 0; test < 5; ++test) {
+				best[test][buffer] = 1e30;
+				if (test == 2 && levels < 2) {
+					continue;
+				}
+				//Enough repeats that the cached buffer runs for a while, too.
+				const int repeats = (int)std::max((size_t)1, ((size_t)16 << 20) / size);
+				for (int i = 0; i < iterations; ++i) {
+					auto start = Clock::now();
+					for (int r = 0; r < repeats; ++r) {
+						switch (test) {
+						case 0: memcpy(dst, src, size); break;
+						case 1: GetStreamCopyKernels(StreamCopyLevel::SSE2).Copy(dst, src, size); break;
+						case 2: GetStreamCopyKernels(StreamCopyLevel::AVX2).Copy(dst, src, size); break;
+						case 3:
+							for (size_t k = 0; k < constants; ++k) {
+								memcpy(dst + k * constantStride, src + k * constantSize, constantSize);
+							}
+							break;
+						case 4: StreamCopyStrided(dst, constantStride, src, constantSize, constantSize, constants); break;
+						}
+					}
+					best[test][buffer] = std::min(best[test][buffer], SecondsSince(start) / repeats);
+				}
+			}
+		}
+
+		std::cout << "stream: best of " << iterations << ", GB/s of data copied\n"
+			<< "                           cached " << (sizes[0] >> 10) << " KB  uncached " << megabytes << " MB\n";
+		char line[128];
+		for (int test = 0; test < 5; ++test) {
+			if (best[test][0] == 1e30) {
+				continue;
+			}
+			//The constant tests copy a quarter of the buffer.
+			const double share = test >= 3 ? (double)constantSize / constantStride : 1.0;
+			snprintf(line, sizeof(line), "  %s  %8.2f       %8.2f\n", names[test],
+				sizes[0] * share / best[test][0] * 1e-9, sizes[1] * share / best[test][1] * 1e-9);
+			std::cout << line;
+		}
+		std::cout << "  copies and strided copies match memcpy at every alignment: "
+			<< (copiesMatch ? "passed" : "FAILED") << std::endl;
+		return copiesMatch ? 0 : 1;
+	}
+
+	//Some floating point work whose cost grows with cost.
+	float Spin(uint32_t seed, uint32_t cost)
+	{
+		float x = (float)(seed & 1023) * (1.0f / 1024.0f);
+		for (uint32_t i = 0; i < cost; ++i) {
+			x = x * 0.999f + sqrtf(x + 0.5f) * 0.001f;
+		}
+		return x;
+	}
+
+	//Half of the leaves run inline and half as jobs, like a recursive algorithm would.
+	void ForkJoin(JobSystem& jobs, uint32_t depth, uint32_t id, std::atomic<uint32_t>& leaves,
+		std::atomic<uint32_t>& checksum)
+	{
+		if (depth == 0) {
+			checksum.fetch_add((uint32_t)(Spin(id, 64) * 1024.0f), std::memory_order_relaxed);
+			leaves.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		JobCounter counter;
+		jobs.Run([&jobs, depth, id, &leaves, &checksum]() { ForkJoin(jobs, depth - 1, 2 * id + 1, leaves, checksum); },
+			&counter);
+		ForkJoin(jobs, depth - 1, 2 * id, leaves, checksum);
+		jobs.Wait(counter);
+	}
+
+	int RunJobBenchmark(uint32_t maxThreads, int iterations)
+	{
+		const size_t count = 1 << 18;
+		const uint32_t forkDepth = 14;
+		const uint32_t chains = 64;
+		const uint32_t links = 64;
+
+		//Reference results of the loops, from a single thread.
+		std::vector<float> even(count), uneven(count), expectedEven(count), expectedUneven(count);
+		for (size_t i = 0; i < count; ++i) {
+			expectedEven[i] = Spin((uint32_t)i, 16);
+			//Cost from 0 to 255 in a sawtooth: equal chunks take very different time.
+			expectedUneven[i] = Spin((uint32_t)i, (uint32_t)(i >> 4) & 255);
+		}
+		uint32_t expectedChecksum = 0;
+		for (uint32_t id = 0; id < (1u << forkDepth); ++id) {
+			expectedChecksum += (uint32_t)(Spin(id, 64) * 1024.0f);
+		}
+
+		const char* names[4] = {
+			"parallel for, even     ",
+			"parallel for, uneven   ",
+			"fork-join tree         ",
+			"dependency chains      ",
+		};
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t threads = 1; threads <= maxThreads; threads *= 2) {
+			threadCounts.push_back(threads);
+		}
+		std::vector<std::vector<double>> best(4, std::vector<double>(threadCounts.size(), 1e30));
+		bool passed = true;
+		for (size_t t = 0; t < threadCounts.size(); ++t) {
+			JobSystem jobs(threadCounts[t]);
+			for (int i = 0; i < iterations; ++i) {
+				std::fill(even.begin(), even.end(), 0.0f);
+				std::fill(uneven.begin(), uneven.end(), 0.0f);
+				auto start = Clock::now();
+				jobs.ParallelFor(0, count, 256, [&](size_t begin, size_t end) {
+					for (size_t k = begin; k < end; ++k) {
+						even[k] = Spin((uint32_t)k, 16);
+					}
+				});
+				best[0][t] = std::min(best[0][t], SecondsSince(start));
+				passed = passed && memcmp(even.data(), expectedEven.data(), count * sizeof(float)) == 0;
+
+				start = Clock::now();
+				jobs.ParallelFor(0, count, 256, [&](size_t begin, size_t end) {
+					for (size_t k = begin; k < end; ++k) {
+						uneven[k] = Spin((uint32_t)k, (uint32_t)(k >> 4) & 255);
+					}
+				});
+				best[1][t] = std::min(best[1][t], SecondsSince(start));
+				passed = passed && memcmp(uneven.data(), expectedUneven.data(), count * sizeof(float)) == 0;
+
+				std::atomic<uint32_t> leaves{ 0 }, checksum{ 0 };
+				start = Clock::now();
+				ForkJoin(jobs, forkDepth, 0, leaves, checksum);
+				best[2][t] = std::min(best[2][t], SecondsSince(start));
+				passed = passed && leaves.load() == (1u << forkDepth) && checksum.load() == expectedChecksum;
+
+				//Every link starts after the one before it; the chains run side by side.
+				std::vector<JobCounter> linkDone(chains * links);
+				std::vector<uint32_t> progress(chains, 0);
+				std::atomic<bool> ordered{ true };
+				JobCounter allDone;
+				start = Clock::now();
+				for (uint32_t link = 0; link < links; ++link) {
+					for (uint32_t chain = 0; chain < chains; ++chain) {
+						JobCounter* done = link + 1 == links ? &allDone : &linkDone[chain * links + link];
+						auto work = [&progress, &ordered, chain, link]() {
+							if (progress[chain] != link) {
+								ordered = false;
+							}
+							Spin(link, 256);
+							progress[chain] = link + 1;
+						};
+						if (link == 0) {
+							jobs.Run(work, done);
+						}
+						else {
+							jobs.RunAfter(linkDone[chain * links + link - 1], work, done);
+						}
+					}
+				}
+				jobs.Wait(allDone);
+				best[3][t] = std::min(best[3][t], SecondsSince(start));
+				passed = passed && ordered.load();
+				for (uint32_t chain = 0; chain < chains; ++chain) {
+					passed = passed && progress[chain] == links;
+				}
+			}
+		}
+
+		std::cout << "jobs: best of " << iterations << ", ms (speedup over 1 thread), " << std::thread::hardware_concurrency()
+			<< " hardware threads\n                         ";
+		char line[128];
+		for (uint32_t threads : threadCounts) {
+			snprintf(line, sizeof(line), " %8u", threads);
+			std::cout << line;
+		}
+		std::cout << "\n";
+		for (int test = 0; test < 4; ++test) {
+			std::cout << "  " << names[test];
+			for (size_t t = 0; t < threadCounts.size(); ++t) {
+				snprintf(line, sizeof(line), " %8.2f", best[test][t] * 1000.0);
+				std::cout << line;
+			}
+			std::cout << "\n                         ";
+			for (size_t t = 0; t < threadCounts.size(); ++t) {
+				snprintf(line, sizeof(line), "  (%5.2fx)", best[test][0] / best[test][t]);
+				std::cout << line;
+			}
+			std::cout << "\n";
+		}
+		std::cout << "  loops, leaves and chain order match the single thread results: "
+			<< (passed ? "passed" : "FAILED") << std::endl;
+		return passed ? 0 : 1;
+	}
+
+	//Counts its destruction, to see which frames a cancel destroyed.
+	struct DestroyGuard
+	{
+		int* Destroyed;
+		~DestroyGuard() { (*Destroyed)++; }
+	};
+
+	Task<void> LogAfterFrame(std::vector<int>* log, int value)
+	{
+		co_await NextFrame();
+		log->push_back(value);
+	}
+
+	Task<void> LogAfterFence(std::vector<int>* log, int value, uint64_t fence)
+	{
+		co_await WaitForFence(fence);
+		log->push_back(value);
+	}
+
+	Task<void> LogTwoFrames(std::vector<int>* log, int first, int second)
+	{
+		co_await NextFrame();
+		log->push_back(first);
+		co_await NextFrame();
+		log->push_back(second);
+	}
+
+	Task<int> CountDown(int depth)
+	{
+		if (depth == 0) {
+			co_return 0;
+		}
+		int below = co_await CountDown(depth - 1);
+		co_return below + 1;
+	}
+
+	Task<int> DoubleNextFrame(int value)
+	{
+		co_await NextFrame();
+		co_return 2 * value;
+	}
+
+	Task<int> ThrowNextFrame()
+	{
+		co_await NextFrame();
+		throw std::runtime_error("task failed");
+	}
+
+	Task<void> AwaitChildren(std::vector<int>* log)
+	{
+		log->push_back(co_await CountDown(1000));
+		log->push_back(co_await DoubleNextFrame(21));
+		try {
+			co_await ThrowNextFrame();
+		}
+		catch (const std::runtime_error&) {
+			log->push_back(-1);
+		}
+	}
+
+	Task<void> ThrowAtRoot()
+	{
+		co_await NextFrame();
+		throw std::runtime_error("root failed");
+	}
+
+	Task<void> GuardedFence(int* destroyed, bool* resumed)
+	{
+		DestroyGuard guard{ destroyed };
+		co_await WaitForFence(1000000);
+		*resumed = true;
+	}
+
+	Task<int> GuardedChild(int* destroyed)
+	{
+		DestroyGuard guard{ destroyed };
+		co_await NextFrame();
+		co_return 1;
+	}
+
+	Task<void> GuardedParent(int* destroyed, bool* resumed)
+	{
+		DestroyGuard guard{ destroyed };
+		co_await GuardedChild(destroyed);
+		*resumed = true;
+	}
+
+	Task<void> CancelSelf(TaskScheduler* scheduler, const TaskId* self, int* destroyed, bool* resumed)
+	{
+		DestroyGuard guard{ destroyed };
+		co_await NextFrame();
+		scheduler->Cancel(*self);
+		co_await NextFrame();
+		*resumed = true;
+	}
+
+	Task<void> ReadInto(std::string path, FileData* file, bool* resumed)
+	{
+		*file = co_await ReadFileAsync(path);
+		*resumed = true;
+	}
+
+	Task<void> WaitFrames(int frames, uint64_t* resumes)
+	{
+		for (int i = 0; i < frames; ++i) {
+			co_await NextFrame();
+			(*resumes)++;
+		}
+		*resumes += co_await DoubleNextFrame(0) + 1;
+	}
+
+	//Ticks until the tasks are done, giving the file thread time.
+	void TickUntilFinished(TaskScheduler& scheduler, std::initializer_list<TaskId> ids)
+	{
+		for (int tick = 0; tick < 5000; ++tick) {
+			bool finished = true;
+			for (TaskId id : ids) {
+				finished = finished && scheduler.Finished(id);
+			}
+			if (finished) {
+				return;
+			}
+			scheduler.Tick();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	int RunTaskBenchmark(size_t count, int iterations)
+	{
+		uint64_t completedFence = 0;
+		bool passed = true;
+
+		//Resumption order: files, then fences by value, then frames; a task
+		//waiting again resumes a Tick later; a reached fence does not suspend.
+		bool orderPassed = true;
+		{
+			TaskScheduler scheduler;
+			scheduler.SetFenceSource([&completedFence]() { return completedFence; });
+			std::vector<int> log;
+			scheduler.Spawn(LogAfterFrame(&log, 1));
+			scheduler.Spawn(LogAfterFence(&log, 2, 5));
+			scheduler.Spawn(LogAfterFence(&log, 3, 3));
+			scheduler.Spawn(LogAfterFrame(&log, 4));
+			scheduler.Spawn(LogTwoFrames(&log, 5, 7));
+			scheduler.Spawn(LogAfterFence(&log, 6, 7));
+			scheduler.Spawn(LogAfterFence(&log, 0, 0));
+			orderPassed = orderPassed && log == std::vector<int>{ 0 };
+			completedFence = 6;
+			scheduler.Tick();
+			orderPassed = orderPassed && log == std::vector<int>{ 0, 3, 2, 1, 4, 5 };
+			completedFence = 7;
+			scheduler.Tick();
+			orderPassed = orderPassed && log == std::vector<int>{ 0, 3, 2, 1, 4, 5, 6, 7 } &&
+				scheduler.RunningTasks() == 0;
+
+			//Results and exceptions of awaited tasks; deep chains do not grow the stack.
+			log.clear();
+			TaskId children = scheduler.Spawn(AwaitChildren(&log));
+			TickUntilFinished(scheduler, { children });
+			orderPassed = orderPassed && log == std::vector<int>{ 1000, 42, -1 };
+			scheduler.Spawn(ThrowAtRoot());
+			bool rethrown = false;
+			try {
+				scheduler.Tick();
+			}
+			catch (const std::runtime_error&) {
+				rethrown = true;
+			}
+			orderPassed = orderPassed && rethrown && scheduler.RunningTasks() == 0;
+		}
+		passed = passed && orderPassed;
+
+		//Cancellation destroys the frames of the task and of what it awaits,
+		//and the task never resumes, whatever it was waiting for.
+		bool cancelPassed = true;
+		{
+			TaskScheduler scheduler;
+			scheduler.SetFenceSource([&completedFence]() { return completedFence; });
+			int destroyed = 0;
+			bool resumed = false;
+			TaskId fence = scheduler.Spawn(GuardedFence(&destroyed, &resumed));
+			TaskId nested = scheduler.Spawn(GuardedParent(&destroyed, &resumed));
+			TaskId self = 0;
+			self = scheduler.Spawn(CancelSelf(&scheduler, &self, &destroyed, &resumed));
+			scheduler.Cancel(fence);
+			scheduler.Cancel(nested);
+			cancelPassed = cancelPassed && destroyed == 3 && scheduler.Finished(fence) && scheduler.Finished(nested);
+			completedFence = 1000000;
+			scheduler.Tick();
+			scheduler.Tick();
+			cancelPassed = cancelPassed && destroyed == 4 && !resumed && scheduler.Finished(self);
+
+			//A read finishing after its task was cancelled is dropped.
+			FileData file;
+			TaskId read = scheduler.Spawn(ReadInto("/proc/self/status", &file, &resumed));
+			scheduler.Cancel(read);
+			TaskId other = scheduler.Spawn(ReadInto("/proc/self/status", &file, &resumed));
+			TickUntilFinished(scheduler, { other });
+			cancelPassed = cancelPassed && scheduler.RunningTasks() == 0;
+		}
+		passed = passed && cancelPassed;
+
+		//Whole files come back, missing ones with an error.
+		bool filePassed = false;
+		{
+			const char* path = "EngineBench_tasks.tmp";
+			std::vector<uint8_t> content(100000);
+			for (size_t i = 0; i < content.size(); ++i) {
+				content[i] = (uint8_t)(i * 7);
+			}
+			FILE* out = fopen(path, "wb");
+			if (out != nullptr) {
+				fwrite(content.data(), 1, content.size(), out);
+				fclose(out);
+				TaskScheduler scheduler;
+				FileData file, missing;
+				bool resumed = false;
+				TaskId first = scheduler.Spawn(ReadInto(path, &file, &resumed));
+				TaskId second = scheduler.Spawn(ReadInto("does/not/exist", &missing, &resumed));
+				TickUntilFinished(scheduler, { first, second });
+				filePassed = file.Ok && file.Bytes == content && !missing.Ok && !missing.Error.empty();
+				remove(path);
+			}
+		}
+		passed = passed && filePassed;
+
+		//Throughput: waves of count tasks waiting a few frames and for one
+		//child each; after the first wave the frames come from the pool.
+		const int frames = 4;
+		const int waves = 20;
+		double bestSpawn = 1e30, bestResume = 1e30;
+		bool resumesPassed = true;
+		CoroutineFrameStats before = GetCoroutineFrameStats();
+		for (int i = 0; i < iterations; ++i) {
+			TaskScheduler scheduler;
+			double spawn = 0.0, resume = 0.0;
+			for (int wave = 0; wave < waves; ++wave) {
+				uint64_t resumes = 0;
+				auto start = Clock::now();
+				for (size_t k = 0; k < count; ++k) {
+					scheduler.Spawn(WaitFrames(frames, &resumes));
+				}
+				spawn += SecondsSince(start);
+				start = Clock::now();
+				while (scheduler.RunningTasks() != 0) {
+					scheduler.Tick();
+				}
+				resume += SecondsSince(start);
+				resumesPassed = resumesPassed && resumes == count * (frames + 1);
+			}
+			bestSpawn = std::min(bestSpawn, spawn / waves);
+			bestResume = std::min(bestResume, resume / waves);
+		}
+		CoroutineFrameStats after = GetCoroutineFrameStats();
+		const uint64_t allocations = after.Allocations - before.Allocations;
+		const uint64_t reused = after.Reused - before.Reused;
+		passed = passed && resumesPassed;
+
+		std::cout << "tasks: " << waves << " waves of " << count << " tasks of " << frames << " frames and a child, best of "
+			<< iterations << "\n"
+			<< "  spawn " << bestSpawn * 1e9 / count << " ns per task, resume " << bestResume * 1e9 / (count * (frames + 1))
+			<< " ns per resume\n"
+			<< "  coroutine frames: " << allocations << " allocated, " << reused << " from the pool ("
+			<< (allocations != 0 ? 100.0 * reused / allocations : 0.0) << "%), " << after.Large - before.Large << " large\n"
+			<< "  resumption order " << (orderPassed ? "ok" : "wrong") << ", cancellation " << (cancelPassed ? "ok" : "wrong")
+			<< ", file reads " << (filePassed ? "ok" : "wrong") << ": " << (passed ? "passed" : "FAILED") << std::endl;
+		return passed ? 0 : 1;
+	}
+
+	//caches x coresPerCache x smt, numbered like Linux does: the SMT siblings
+	//of CPU n are n + cores, n + 2 * cores, ...
+	CpuTopology MakeTopology(uint32_t caches, uint32_t coresPerCache, uint32_t smt)
+	{
+		CpuTopology topology;
+		const uint32_t cores = caches * coresPerCache;
+		topology.Cores.resize(cores);
+		topology.Caches.resize(caches);
+		for (uint32_t thread = 0; thread < smt; ++thread) {
+			for (uint32_t core = 0; core < cores; ++core) {
+				LogicalCpu cpu;
+				cpu.Id = thread * cores + core;
+				cpu.Core = core;
+				cpu.Cache = core / coresPerCache;
+				cpu.SmtIndex = thread;
+				topology.Cores[core].Cpus.push_back((uint32_t)topology.Cpus.size());
+				topology.Caches[cpu.Cache].Cpus.push_back((uint32_t)topology.Cpus.size());
+				topology.Cpus.push_back(cpu);
+			}
+		}
+		for (CacheDomain& cache : topology.Caches) {
+			cache.Level = 3;
+			cache.Bytes = 32 << 20;
+		}
+		return topology;
+	}
+
+	//Plans on a made-up 2 L3 x 4 core x 2 SMT machine, whatever this one looks like.
+	bool CheckPlacementPlans()
+	{
+		const CpuTopology topology = MakeTopology(2, 4, 2);
+		bool passed = PlanThreadCpus(topology, ThreadPlacement::None, 8).empty() &&
+			PlacementThreadCount(topology, ThreadPlacement::Compact) == 8 &&
+			PlacementThreadCount(topology, ThreadPlacement::Spread) == 8 &&
+			PlacementThreadCount(topology, ThreadPlacement::AllLogical) == 16;
+
+		//Compact: the cores of the first L3, then those of the second.
+		std::vector<uint32_t> plan = PlanThreadCpus(topology, ThreadPlacement::Compact, 8);
+		std::vector<bool> coreUsed(8, false);
+		for (uint32_t i = 0; i < 8 && plan.size() == 8; ++i) {
+			const LogicalCpu& cpu = topology.Cpus[plan[i]];
+			passed = passed && !coreUsed[cpu.Core] && cpu.SmtIndex == 0 && cpu.Cache == i / 4;
+			coreUsed[cpu.Core] = true;
+		}
+		passed = passed && plan.size() == 8;
+
+		//Spread: the two L3s in turn.
+		plan = PlanThreadCpus(topology, ThreadPlacement::Spread, 8);
+		std::fill(coreUsed.begin(), coreUsed.end(), false);
+		for (uint32_t i = 0; i < 8 && plan.size() == 8; ++i) {
+			const LogicalCpu& cpu = topology.Cpus[plan[i]];
+			passed = passed && !coreUsed[cpu.Core] && cpu.SmtIndex == 0 && cpu.Cache == i % 2;
+			coreUsed[cpu.Core] = true;
+		}
+		passed = passed && plan.size() == 8;
+
+		//All logical: every core once, then the siblings in the same core order, then around again.
+		plan = PlanThreadCpus(topology, ThreadPlacement::AllLogical, 20);
+		std::vector<bool> cpuUsed(16, false);
+		for (uint32_t i = 0; i < 16 && plan.size() == 20; ++i) {
+			const LogicalCpu& cpu = topology.Cpus[plan[i]];
+			passed = passed && !cpuUsed[plan[i]] && cpu.SmtIndex == i / 8 && cpu.Core == topology.Cpus[plan[i % 8]].Core;
+			cpuUsed[plan[i]] = true;
+		}
+		passed = passed && plan.size() == 20 && plan[16] == plan[0] && plan[19] == plan[3];
+		return passed;
+	}
+
+	struct FrameStats
+	{
+		double Mean, Deviation, P50, P99, Max;
+	};
+
+	FrameStats Summarize(std::vector<double> times)
+	{
+		FrameStats stats = {};
+		for (double time : times) {
+			stats.Mean += time;
+		}
+		stats.Mean /= times.size();
+		for (double time : times) {
+			stats.Deviation += (time - stats.Mean) * (time - stats.Mean);
+		}
+		stats.Deviation = sqrt(stats.Deviation / times.size());
+		std::sort(times.begin(), times.end());
+		stats.P50 = times[times.size() / 2];
+		stats.P99 = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+		stats.Max = times.back();
+		return stats;
+	}
+
+	//Frames of a serial part on the calling thread, standing in for the
+	//render thread, and a ParallelFor over a last-level cache sized working
+	//set, once per placement. noiseThreads unpinned threads spin meanwhile,
+	//like the rest of the desktop would.
+	int RunAffinityBenchmark(int frames, uint32_t noiseThreads)
+	{
+		const CpuTopology& topology = CpuTopology::Get();
+		std::cout << "affinity: " << topology.Describe() << "\n";
+
+		const bool plansPassed = CheckPlacementPlans();
+		bool passed = plansPassed;
+
+		//Half of the last-level cache, at most 16 MB so a frame stays short.
+		const uint64_t cacheBytes = topology.Caches.empty() || topology.Caches[0].Bytes == 0 ? 8 << 20
+			: topology.Caches[0].Bytes;
+		const size_t count = (size_t)(std::min<uint64_t>(cacheBytes / 2, 16 << 20) / sizeof(float));
+		std::vector<float> input(count), output(count), expected(count);
+		for (size_t i = 0; i < count; ++i) {
+			input[i] = (float)(i % 1000) * 0.001f;
+		}
+		auto frameWork = [](float in, int frame) { return in * (float)(frame & 7) + 1.0f; };
+		const int warmup = 10;
+		for (size_t i = 0; i < count; ++i) {
+			expected[i] = frameWork(input[i], warmup + frames - 1);
+		}
+
+		std::atomic<bool> stop{ false };
+		std::vector<std::thread> noise;
+		for (uint32_t i = 0; i < noiseThreads; ++i) {
+			noise.emplace_back([&stop, i]() {
+				float sink = 0.0f;
+				while (!stop.load(std::memory_order_relaxed)) {
+					sink += Spin(i, 1024);
+				}
+				volatile float keep = sink;
+				(void)keep;
+			});
+		}
+
+		const ThreadPlacement placements[4] = {
+			ThreadPlacement::None, ThreadPlacement::Compact, ThreadPlacement::Spread, ThreadPlacement::AllLogical,
+		};
+		std::cout << "  " << frames << " frames over " << (count * sizeof(float) >> 10) << " KB, " << noiseThreads
+			<< " noise threads, frame time in ms\n"
+			"  placement     threads      mean    stddev       p50       p99       max      cv\n";
+		char line[160];
+		for (ThreadPlacement placement : placements) {
+			//Without placement as many threads as Compact, so only the pinning differs.
+			const uint32_t threads = PlacementThreadCount(topology,
+				placement == ThreadPlacement::None ? ThreadPlacement::Compact : placement);
+			std::vector<double> times;
+			times.reserve(frames);
+			float serialSum = 0.0f;
+			{
+				JobSystem jobs(threads, placement);
+				passed = passed && jobs.ThreadCount() == threads &&
+					jobs.ThreadCpus().size() == (placement == ThreadPlacement::None ? 0 : threads);
+				for (int frame = 0; frame < warmup + frames; ++frame) {
+					auto start = Clock::now();
+					serialSum += Spin((uint32_t)frame, 20000);
+					jobs.ParallelFor(0, count, 4096, [&](size_t begin, size_t end) {
+						for (size_t k = begin; k < end; ++k) {
+							output[k] = frameWork(input[k], frame);
+						}
+					});
+					if (frame >= warmup) {
+						times.push_back(SecondsSince(start) * 1000.0);
+					}
+				}
+			}
+			passed = passed && std::isfinite(serialSum) &&
+				memcmp(output.data(), expected.data(), count * sizeof(float)) == 0;
+
+			const FrameStats stats = Summarize(times);
+			snprintf(line, sizeof(line), "  %-12s %8u %9.3f %9.3f %9.3f %9.3f %9.3f %6.1f%%\n", ThreadPlacementName(placement),
+				threads, stats.Mean, stats.Deviation, stats.P50, stats.P99, stats.Max, 100.0 * stats.Deviation / stats.Mean);
+			std::cout << line;
+		}
+
+		stop = true;
+		for (std::thread& thread : noise) {
+			thread.join();
+		}
+
+		//The engine's setup: the job system leaves a core to the render thread,
+		//which pins itself to it.
+		bool reservedPassed;
+		{
+			const uint32_t cores = PlacementThreadCount(topology, ThreadPlacement::Compact);
+			JobSystem jobs(0, ThreadPlacement::Compact, 1);
+			const std::vector<uint32_t>& reserved = jobs.ReservedCpus();
+			reservedPassed = jobs.ThreadCount() == std::max(1u, cores - 1) && reserved.size() == 1 &&
+				(cores == 1 || std::find(jobs.ThreadCpus().begin(), jobs.ThreadCpus().end(), reserved[0]) ==
+					jobs.ThreadCpus().end());
+			int rendered = 0;
+			FramePipeline pipeline(2, [&rendered](uint32_t) { ++rendered; }, &topology.Cpus[reserved[0]]);
+			for (int frame = 0; frame < 8; ++frame) {
+				pipeline.Publish(pipeline.Acquire());
+			}
+			pipeline.Stop();
+			reservedPassed = reservedPassed && rendered == 8;
+		}
+		passed = passed && reservedPassed;
+		std::cout << "  placement plans " << (plansPassed ? "ok" : "wrong") << ", render thread core "
+			<< (reservedPassed ? "reserved" : "NOT reserved") << ", frame results match: "
+			<< (passed ? "passed" : "FAILED") << std::endl;
+		return passed ? 0 : 1;
+	}
+
+	//Busy work standing in for simulation and culling.
+	void SpinFor(double milliseconds)
+	{
+		auto start = Clock::now();
+		while (SecondsSince(start) * 1000.0 < milliseconds) {
+		}
+	}
+
+	struct PipelineSnapshot
+	{
+		//0 free, 1 written by the update thread, 2 read by the render thread.
+		std::atomic<int> Owner{ 0 };
+		uint64_t Frame = 0;
+	};
+
+	struct PipelineRun
+	{
+		double FrameMilliseconds = 0.0;
+		FramePipelineStats Stats;
+		bool Passed = true;
+	};
+
+	//frames frames of updateMilliseconds busy work on this thread and
+	//renderMilliseconds on the render thread, sleeping there like Present()
+	//and the driver do, so the overlap shows on a single core as well.
+	PipelineRun RunPipeline(uint32_t snapshotCount, int frames, double updateMilliseconds, double renderMilliseconds)
+	{
+		PipelineRun run;
+		std::vector<PipelineSnapshot> snapshots(snapshotCount);
+		uint64_t nextRendered = 0;
+		bool renderPassed = true;
+		auto start = Clock::now();
+		{
+			FramePipeline pipeline(snapshotCount, [&](uint32_t index) {
+				PipelineSnapshot& snapshot = snapshots[index];
+				renderPassed = renderPassed && snapshot.Owner.exchange(2) == 0 && snapshot.Frame == nextRendered;
+				nextRendered++;
+				std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(renderMilliseconds));
+				snapshot.Owner = 0;
+			});
+			for (int frame = 0; frame < frames; ++frame) {
+				uint32_t index = pipeline.Acquire();
+				PipelineSnapshot& snapshot = snapshots[index];
+				run.Passed = run.Passed && index < snapshotCount && snapshot.Owner.exchange(1) == 0;
+				snapshot.Frame = (uint64_t)frame;
+				SpinFor(updateMilliseconds);
+				snapshot.Owner = 0;
+				pipeline.Publish(index);
+			}
+			pipeline.Drain();
+			run.FrameMilliseconds = SecondsSince(start) * 1000.0 / frames;
+			run.Stats = pipeline.Stats();
+		}
+		run.Passed = run.Passed && renderPassed && nextRendered == (uint64_t)frames &&
+			run.Stats.Frames == (uint64_t)frames && run.Stats.MaxFramesAhead <= snapshotCount;
+		return run;
+	}
+
+	int RunPipelineBenchmark(int frames, double stageMilliseconds)
+	{
+		bool passed = true;
+
+		//Queue: full and empty at the edges, then a producer and a consumer
+		//thread passing a sequence through a small ring.
+		bool queuePassed = true;
+		double nanosecondsPerItem = 0.0;
+		{
+			auto queue = std::make_unique<SpscQueue<uint64_t, 64>>();
+			uint64_t value = 0;
+			for (uint64_t i = 0; i < 64; ++i) {
+				queuePassed = queuePassed && queue->TryPush(i);
+			}
+			queuePassed = queuePassed && !queue->TryPush(64) && queue->Size() == 64;
+			for (uint64_t i = 0; i < 64; ++i) {
+				queuePassed = queuePassed && queue->TryPop(value) && value == i;
+			}
+			queuePassed = queuePassed && !queue->TryPop(value) && queue->Size() == 0;
+
+			const uint64_t count = 1 << 21;
+			auto start = Clock::now();
+			std::thread producer([&queue, count]() {
+				for (uint64_t i = 0; i < count; ++i) {
+					queue->Push(i * 3 + 1);
+				}
+			});
+			for (uint64_t i = 0; i < count; ++i) {
+				queuePassed = queuePassed && queue->Pop() == i * 3 + 1;
+			}
+			producer.join();
+			nanosecondsPerItem = SecondsSince(start) * 1e9 / count;
+		}
+		passed = passed && queuePassed;
+
+		//An exception of the render callback comes out of Acquire() and the
+		//pipeline still shuts down.
+		bool failurePassed = false;
+		int rendered = 0;
+		try {
+			FramePipeline pipeline(3, [&rendered](uint32_t) {
+				if (++rendered == 5) {
+					throw std::runtime_error("render failed");
+				}
+			});
+			for (int frame = 0; frame < 100; ++frame) {
+				pipeline.Publish(pipeline.Acquire());
+			}
+		}
+		catch (const std::runtime_error&) {
+			failurePassed = true;
+		}
+		passed = passed && failurePassed;
+
+		//Serial reference: update then render on one thread, like Run() did.
+		auto start = Clock::now();
+		for (int frame = 0; frame < frames; ++frame) {
+			SpinFor(stageMilliseconds);
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(stageMilliseconds));
+		}
+		const double serial = SecondsSince(start) * 1000.0 / frames;
+
+		std::cout << "pipeline: " << frames << " frames, " << stageMilliseconds << " ms update and " << stageMilliseconds
+			<< " ms render\n"
+			<< "  spsc queue: " << nanosecondsPerItem << " ns per item between two threads\n";
+		char line[192];
+		snprintf(line, sizeof(line), "  serial             %7.3f ms per frame\n", serial);
+		std::cout << line;
+		const uint32_t snapshotCounts[2] = { 2, 3 };
+		for (uint32_t snapshotCount : snapshotCounts) {
+			PipelineRun run = RunPipeline(snapshotCount, frames, stageMilliseconds, stageMilliseconds);
+			passed = passed && run.Passed;
+			snprintf(line, sizeof(line), "  %u snapshots        %7.3f ms per frame (%.2fx), latency %.3f ms mean, %.3f ms max, "
+				"%u/%u ahead, update waited %.1f ms, render idle %.1f ms\n", snapshotCount, run.FrameMilliseconds,
+				serial / run.FrameMilliseconds, run.Stats.MeanLatencyMilliseconds(), run.Stats.MaxLatencyMilliseconds,
+				run.Stats.MaxFramesAhead, snapshotCount, run.Stats.UpdateWaitMilliseconds, run.Stats.RenderIdleMilliseconds);
+			std::cout << line;
+		}
+		std::cout << "  queue order " << (queuePassed ? "ok" : "wrong") << ", render failure "
+			<< (failurePassed ? "rethrown" : "lost") << ", snapshots in order and never shared: "
+			<< (passed ? "passed" : "FAILED") << std::endl;
+		return passed ? 0 : 1;
+	}
+
+	//A damped spring, integrated with semi-implicit Euler: its result depends
+	//on the step size, so any frame rate dependence shows.
+	struct SpringState
+	{
+		double Position = 1.0;
+		double Velocity = 0.0;
+	};
+
+	void StepSpring(SpringState& state, double seconds)
+	{
+		state.Velocity += (-40.0 * state.Position - 0.5 * state.Velocity) * seconds;
+		state.Position += state.Velocity * seconds;
+	}
+
+	//Frame times of a display running at hz, jittered by up to jitter of a frame.
+	std::vector<uint64_t> FrameTimes(double seconds, double hz, double jitter, uint64_t seed)
+	{
+		Random random(seed);
+		std::vector<uint64_t> times;
+		const double frame = 1e9 / hz;
+		for (double total = 0.0; total < seconds * 1e9;) {
+			double time = frame * (1.0 + jitter * (2.0 * random.NextFloat() - 1.0));
+			times.push_back((uint64_t)time);
+			total += time;
+		}
+		return times;
+	}
+
+	struct TimestepRun
+	{
+		//The state after every fixed step.
+		std::vector<double> History;
+		SpringState Variable;
+		//Frame to frame movement of the drawn position of something moving at a
+		//constant 1 unit per second, with and without interpolation.
+		double InterpolatedJudder = 0.0;
+		double SteppedJudder = 0.0;
+		//Largest distance of the interpolated position from where the mover was one step earlier.
+		double InterpolationError = 0.0;
+	};
+
+	double Judder(const std::vector<double>& positions, const std::vector<uint64_t>& times)
+	{
+		//Deviation of the drawn speed from the true one, relative.
+		double sum = 0.0;
+		for (size_t i = 1; i < positions.size(); ++i) {
+			double speed = (positions[i] - positions[i - 1]) / (times[i] * 1e-9);
+			sum += (speed - 1.0) * (speed - 1.0);
+		}
+		return positions.size() > 1 ? sqrt(sum / (positions.size() - 1)) : 0.0;
+	}
+
+	TimestepRun RunTimestep(const std::vector<uint64_t>& times, double stepSeconds)
+	{
+		TimestepRun run;
+		uint64_t now = 1000;
+		GameClock clock([&now]() { return now; });
+		FixedStepLoop loop(stepSeconds, 8);
+		SpringState spring;
+		double previous = 0.0, current = 0.0;
+		std::vector<double> interpolated, stepped;
+		for (uint64_t time : times) {
+			now += time;
+			const double elapsed = clock.Tick();
+			//The old way: one step of whatever the frame took.
+			StepSpring(run.Variable, elapsed);
+
+			const uint32_t steps = loop.Advance(elapsed);
+			for (uint32_t i = 0; i < steps; ++i) {
+				StepSpring(spring, stepSeconds);
+				run.History.push_back(spring.Position);
+				previous = current;
+				current += stepSeconds;
+			}
+			const double drawn = previous + (current - previous) * loop.Alpha();
+			interpolated.push_back(drawn);
+			stepped.push_back(current);
+			if (!run.History.empty()) {
+				run.InterpolationError = std::max(run.InterpolationError, fabs(drawn - (clock.TotalSeconds() - stepSeconds)));
+			}
+		}
+		//The first step only arrives after a step's worth of frames.
+		const size_t settled = (size_t)(2.0 * stepSeconds * 1e9 / times[0]) + 1;
+		std::vector<uint64_t> settledTimes(times.begin() + settled, times.end());
+		interpolated.erase(interpolated.begin(), interpolated.begin() + settled);
+		stepped.erase(stepped.begin(), stepped.begin() + settled);
+		run.InterpolatedJudder = Judder(interpolated, settledTimes);
+		run.SteppedJudder = Judder(stepped, settledTimes);
+		return run;
+	}
+
+	int RunTimestepBenchmark(double seconds, double stepHz)
+	{
+		const double stepSeconds = 1.0 / stepHz;
+		bool passed = true;
+
+		const double rates[5] = { 30.0, 60.0, 144.0, 240.0, 75.0 };
+		const double jitters[5] = { 0.0, 0.0, 0.0, 0.0, 0.5 };
+		std::vector<std::vector<uint64_t>> frameTimes;
+		std::vector<TimestepRun> runs;
+		size_t commonSteps = ~(size_t)0;
+		for (int r = 0; r < 5; ++r) {
+			frameTimes.push_back(FrameTimes(seconds, rates[r], jitters[r], 7));
+			runs.push_back(RunTimestep(frameTimes.back(), stepSeconds));
+			commonSteps = std::min(commonSteps, runs.back().History.size());
+		}
+
+		//The spring after the run with a step per frame, and after the steps
+		//every run got to with fixed steps.
+		std::cout << "timestep: " << seconds << " s at " << stepHz << " Hz steps on a scripted clock\n"
+			"  display        frames   variable dt spring   fixed step spring   judder stepped  interpolated   error\n";
+		char line[192];
+		for (int r = 0; r < 5; ++r) {
+			const TimestepRun& run = runs[r];
+			snprintf(line, sizeof(line), "  %5.0f Hz%s %8zu %20.9f %19.9f %16.4f %13.4f %7.1e\n", rates[r],
+				jitters[r] != 0.0 ? " +-50%" : "      ", frameTimes[r].size(), run.Variable.Position,
+				commonSteps != 0 ? run.History[commonSteps - 1] : 0.0, run.SteppedJudder, run.InterpolatedJudder,
+				run.InterpolationError);
+			std::cout << line;
+
+			//Interpolated motion is smooth and one step behind the clock.
+			passed = passed && run.InterpolationError < 1e-6 && run.InterpolatedJudder < 1e-3;
+		}
+
+		//Every frame rate computes the same states, step by step, bit for bit.
+		bool deterministic = true;
+		for (const TimestepRun& run : runs) {
+			const size_t common = std::min(run.History.size(), runs[0].History.size());
+			deterministic = deterministic && common + 8 >= runs[0].History.size() &&
+				memcmp(run.History.data(), runs[0].History.data(), common * sizeof(double)) == 0;
+		}
+		//And a replay of the jittered run with the same clock does too.
+		TimestepRun replay = RunTimestep(FrameTimes(seconds, rates[4], jitters[4], 7), stepSeconds);
+		deterministic = deterministic && replay.History == runs[4].History &&
+			replay.Variable.Position == runs[4].Variable.Position;
+		passed = passed && deterministic;
+
+		//Spiral of death: every step costs 1.5 steps of time. Without the clamp
+		//each frame would need half again the steps of the one before.
+		bool clampPassed = true;
+		{
+			uint64_t now = 0;
+			GameClock clock([&now]() { return now; });
+			FixedStepLoop loop(stepSeconds, 8);
+			now += (uint64_t)(stepSeconds * 1e9);
+			uint32_t maxSteps = 0;
+			double maxFrame = 0.0;
+			for (int frame = 0; frame < 200; ++frame) {
+				const double elapsed = clock.Tick();
+				if (frame > 0) {
+					maxFrame = std::max(maxFrame, elapsed);
+				}
+				const uint32_t steps = loop.Advance(elapsed);
+				maxSteps = std::max(maxSteps, steps);
+				now += (uint64_t)(steps * 1.5 * stepSeconds * 1e9) + 1000;
+				clampPassed = clampPassed && loop.Alpha() >= 0.0 && loop.Alpha() < 1.0;
+			}
+			clampPassed = clampPassed && maxSteps == 8 && loop.DroppedSteps() > 0 &&
+				maxFrame <= 8 * 1.5 * stepSeconds + 1e-5;
+			std::cout << "  slow simulation: at most " << maxSteps << " steps and " << maxFrame * 1000.0
+				<< " ms per frame, " << loop.DroppedSteps() << " of " << loop.Steps() + loop.DroppedSteps()
+				<< " steps dropped\n";
+
+			//A clock going backwards is no time, a long pause is clamped too.
+			clock.Tick();
+			now -= 5000000;
+			clampPassed = clampPassed && clock.Tick() == 0.0 && loop.Advance(0.0) == 0;
+			now += 3600ull * 1000000000ull;
+			clampPassed = clampPassed && loop.Advance(clock.Tick()) == 8;
+		}
+		passed = passed && clampPassed;
+
+		//The real counter: monotonic, its resolution and cost.
+		const int calls = 1000000;
+		uint64_t last = HighResolutionNanoseconds();
+		uint64_t smallest = ~0ull;
+		bool monotonic = true;
+		auto start = Clock::now();
+		for (int i = 0; i < calls; ++i) {
+			uint64_t now = HighResolutionNanoseconds();
+			monotonic = monotonic && now >= last;
+			if (now > last) {
+				smallest = std::min(smallest, now - last);
+			}
+			last = now;
+		}
+		const double callNanoseconds = SecondsSince(start) * 1e9 / calls;
+		passed = passed && monotonic;
+		std::cout << "  high resolution counter: " << callNanoseconds << " ns per read, smallest step " << smallest
+			<< " ns, " << (monotonic ? "monotonic" : "NOT monotonic") << "\n"
+			<< "  fixed steps identical at every frame rate " << (deterministic ? "ok" : "wrong") << ", clamp "
+			<< (clampPassed ? "ok" : "wrong") << ": " << (passed ? "passed" : "FAILED") << std::endl;
+		return passed ? 0 : 1;
+	}
+
+	//What DrawQueue::Submit reads of a packet, without D3D: the PSO, the
+	//buffer views of its MeshGeometry, the material table and the draw arguments.
+	struct BenchGeometry
+	{
+		uint64_t VertexBuffer = 0;
+		uint32_t VertexBytes = 0;
+		uint32_t VertexStride = 0;
+		uint64_t IndexBuffer = 0;
+		uint32_t IndexBytes = 0;
+		uint32_t IndexFormat = 0;
+	};
+
+	struct BenchPacket
+	{
+		const void* PSO = nullptr;
+		const BenchGeometry* Geo = nullptr;
+		uint64_t MaterialTable = 0;
+		uint64_t InstanceData = 0;
+		uint32_t IndexCount = 0;
+		uint32_t InstanceCount = 1;
+		uint32_t StartIndexLocation = 0;
+		int32_t BaseVertexLocation = 0;
+	};
+
+	struct BenchSubmitStats
+	{
+		uint32_t PipelineStateChanges = 0;
+		uint32_t VertexBufferChanges = 0;
+		uint32_t IndexBufferChanges = 0;
+		uint32_t DescriptorTableChanges = 0;
+
+		uint32_t StateChanges() const
+		{
+			return PipelineStateChanges + VertexBufferChanges + IndexBufferChanges + DescriptorTableChanges;
+		}
+	};
+
+	//Key layout of DrawQueue::MakeKey: pass 4, pipeline 10, material 12, mesh 8,
+	//depth 10 and the packet index in the low 20 bits.
+	const uint64_t DrawIndexMask = (1ull << 20) - 1;
+
+	uint64_t DrawKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth, size_t index)
+	{
+		const uint64_t depthMax = (1ull << 10) - 1;
+		depth = std::min(std::max(depth, 0.0f), 1.0f);
+		uint64_t key = pass & 0xF;
+		key = (key << 10) | (pipeline & 0x3FF);
+		key = (key << 12) | (material & 0xFFF);
+		key = (key << 8) | (mesh & 0xFF);
+		key = (key << 10) | (uint64_t)(depth * depthMax);
+		return (key << 20) | (index & DrawIndexMask);
+	}
+
+	//One command list's share of DrawQueue::Submit: every state is compared
+	//with the bound one and only recorded when it differs. Commands are
+	//appended to a stream the way a command list records them, a tag word
+	//and the arguments.
+	BenchSubmitStats SubmitPackets(const uint64_t* keys, size_t count, const BenchPacket* packets,
+		std::vector<uint64_t>& commands)
+	{
+		enum : uint64_t { SetPipelineState = 1, SetVertexBuffer, SetIndexBuffer, SetTable, SetInstances, Draw };
+
+		BenchSubmitStats stats;
+		const void* currentPSO = nullptr;
+		BenchGeometry current;
+		uint64_t currentTable = 0;
+		commands.clear();
+		for (size_t i = 0; i < count; ++i) {
+			if (i + 16 < count) {
+				_mm_prefetch(reinterpret_cast<const char*>(&packets[keys[i + 16] & DrawIndexMask]), _MM_HINT_T0);
+			}
+			const BenchPacket& packet = packets[keys[i] & DrawIndexMask];
+			if (packet.PSO != currentPSO) {
+				commands.insert(commands.end(), { SetPipelineState, (uint64_t)(uintptr_t)packet.PSO });
+				currentPSO = packet.PSO;
+				stats.PipelineStateChanges++;
+			}
+			const BenchGeometry& geo = *packet.Geo;
+			if (geo.VertexBuffer != current.VertexBuffer || geo.VertexBytes != current.VertexBytes ||
+				geo.VertexStride != current.VertexStride) {
+				commands.insert(commands.end(), { SetVertexBuffer, geo.VertexBuffer, (uint64_t)geo.VertexBytes << 32 | geo.VertexStride });
+				current.VertexBuffer = geo.VertexBuffer;
+				current.VertexBytes = geo.VertexBytes;
+				current.VertexStride = geo.VertexStride;
+				stats.VertexBufferChanges++;
+			}
+			if (geo.IndexBuffer != current.IndexBuffer || geo.IndexBytes != current.IndexBytes ||
+				geo.IndexFormat != current.IndexFormat) {
+				commands.insert(commands.end(), { SetIndexBuffer, geo.IndexBuffer, (uint64_t)geo.IndexBytes << 32 | geo.IndexFormat });
+				current.IndexBuffer = geo.IndexBuffer;
+				current.IndexBytes = geo.IndexBytes;
+				current.IndexFormat = geo.IndexFormat;
+				stats.IndexBufferChanges++;
+			}
+			if (packet.MaterialTable != currentTable) {
+				commands.insert(commands.end(), { SetTable, packet.MaterialTable });
+				currentTable = packet.MaterialTable;
+				stats.DescriptorTableChanges++;
+			}
+			if (packet.InstanceData != 0) {
+				commands.insert(commands.end(), { SetInstances, packet.InstanceData });
+			}
+			commands.insert(commands.end(), { Draw, (uint64_t)packet.IndexCount << 32 | packet.InstanceCount,
+				(uint64_t)packet.StartIndexLocation << 32 | (uint32_t)packet.BaseVertexLocation });
+		}
+		return stats;
+	}
+
+	//A frame of count draws as the renderer queues them: 90% opaque sorted
+	//front to back, 10% transparent back to front, 128 PSOs, 3000 materials
+	//each bound to one PSO, 2000 meshes in 48 geometry pools (the mesh field
+	//of the key is the pool, as in DrawQueue::MeshId) and a random depth.
+	//Times RadixSort64 on the keys and the state filtering of Submit, split
+	//into one command stream per thread as DrawQueue::SubmitListCount picks,
+	//and checks the order against std::sort.
+	int RunDrawQueueBenchmark(size_t count, int iterations)
+	{
+		count = std::min<size_t>(count, DrawIndexMask + 1);
+		const uint32_t psoCount = 128, materialCount = 3000, meshCount = 2000, poolCount = 48;
+		std::mt19937 random(27);
+
+		std::vector<uint8_t> psos(psoCount);
+		std::vector<BenchGeometry> pools(poolCount);
+		for (uint32_t p = 0; p < poolCount; ++p) {
+			pools[p].VertexBuffer = 0x100000000ull * (p + 1);
+			pools[p].VertexBytes = 64u << 20;
+			pools[p].VertexStride = p % 3 == 0 ? 16 : 32;
+			pools[p].IndexBuffer = 0x100000000ull * (p + 1) + (64u << 20);
+			pools[p].IndexBytes = 16u << 20;
+			pools[p].IndexFormat = p % 2 == 0 ? 42 : 57;
+		}
+		std::vector<uint32_t> materialPso(materialCount);
+		for (uint32_t& pso : materialPso) {
+			pso = random() % psoCount;
+		}
+		std::vector<uint32_t> meshPool(meshCount), meshMaterial(meshCount);
+		for (uint32_t m = 0; m < meshCount; ++m) {
+			meshPool[m] = random() % poolCount;
+			meshMaterial[m] = random() % materialCount;
+		}
+
+		std::vector<uint64_t> sourceKeys(count);
+		std::vector<BenchPacket> packets(count);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (size_t i = 0; i < count; ++i) {
+			uint32_t mesh = random() % meshCount;
+			//Most meshes keep their material, some instances override it.
+			uint32_t material = random() % 8 == 0 ? random() % materialCount : meshMaterial[mesh];
+			uint32_t pso = materialPso[material];
+			bool transparent = random() % 10 == 0;
+			float depth = unit(random);
+
+			BenchPacket& packet = packets[i];
+			packet.PSO = &psos[pso];
+			packet.Geo = &pools[meshPool[mesh]];
+			packet.MaterialTable = 0x10000ull + 64ull * material;
+			packet.InstanceData = random() % 4 == 0 ? 0x200000000000ull + 256ull * i : 0;
+			packet.IndexCount = 3 * (64 + random() % 4096);
+			packet.InstanceCount = packet.InstanceData != 0 ? 1 + random() % 64 : 1;
+			packet.StartIndexLocation = random() % (1u << 20);
+			packet.BaseVertexLocation = (int32_t)(random() % (1u << 18));
+			sourceKeys[i] = DrawKey(transparent ? 1 : 0, pso, material, meshPool[mesh], transparent ? 1.0f - depth : depth, i);
+		}
+
+		//The lists DrawQueue::SubmitListCount would ask for, 4096 packets or more each.
+		const size_t listCount = std::max<size_t>(1, std::min<size_t>(ParallelWorkerCount(), count / 4096));
+		std::vector<uint64_t> keys(count);
+		std::vector<std::vector<uint64_t>> commands(listCount);
+		for (std::vector<uint64_t>& list : commands) {
+			list.reserve(count / listCount * 8);
+		}
+		std::vector<BenchSubmitStats> listStats(listCount);
+		RadixSortScratch scratch;
+
+		//Unsorted, the order the culling pass appends the draws in.
+		BenchSubmitStats unsorted = SubmitPackets(sourceKeys.data(), count, packets.data(), commands[0]);
+
+		std::vector<uint64_t> reference(sourceKeys);
+		auto referenceStart = Clock::now();
+		std::sort(reference.begin(), reference.end());
+		double stdSortSeconds = SecondsSince(referenceStart);
+
+		double bestSort = 1e30, bestSubmit = 1e30, totalSort = 0.0, totalSubmit = 0.0;
+		BenchSubmitStats sorted;
+		bool orderMatches = true;
+		for (int iteration = 0; iteration < iterations; ++iteration) {
+			std::memcpy(keys.data(), sourceKeys.data(), count * sizeof(uint64_t));
+
+			auto start = Clock::now();
+			RadixSort64(keys.data(), count, scratch, 20);
+			double sortSeconds = SecondsSince(start);
+
+			start = Clock::now();
+			ParallelFor(0, listCount, 1, [&](size_t firstList, size_t lastList) {
+				for (size_t list = firstList; list < lastList; ++list) {
+					const size_t begin = count * list / listCount;
+					const size_t end = count * (list + 1) / listCount;
+					listStats[list] = SubmitPackets(keys.data() + begin, end - begin, packets.data(), commands[list]);
+				}
+			});
+			double submitSeconds = SecondsSince(start);
+
+			sorted = BenchSubmitStats();
+			for (const BenchSubmitStats& stats : listStats) {
+				sorted.PipelineStateChanges += stats.PipelineStateChanges;
+				sorted.VertexBufferChanges += stats.VertexBufferChanges;
+				sorted.IndexBufferChanges += stats.IndexBufferChanges;
+				sorted.DescriptorTableChanges += stats.DescriptorTableChanges;
+			}
+
+			bestSort = std::min(bestSort, sortSeconds);
+			bestSubmit = std::min(bestSubmit, submitSeconds);
+			totalSort += sortSeconds;
+			totalSubmit += submitSeconds;
+			orderMatches &= keys == reference;
+		}
+
+		size_t commandWords = 0;
+		for (const std::vector<uint64_t>& list : commands) {
+			commandWords += list.size();
+		}
+		const bool passed = orderMatches && sorted.StateChanges() < unsorted.StateChanges();
+		std::cout << "drawqueue: " << count << " packets, " << ParallelWorkerCount() << " threads, best (mean) of "
+			<< iterations << "\n"
+			<< "  RadixSort64:    " << bestSort * 1e3 << " ms (" << totalSort / iterations * 1e3 << "), std::sort "
+			<< stdSortSeconds * 1e3 << " ms\n"
+			<< "  state filter:   " << bestSubmit * 1e3 << " ms (" << totalSubmit / iterations * 1e3 << "), "
+			<< listCount << " lists, " << commandWords * sizeof(uint64_t) / (1 << 20) << " MB of commands\n"
+			<< "  sort + filter:  " << (bestSort + bestSubmit) * 1e3 << " ms, "
+			<< (bestSort + bestSubmit) * 1e9 / count << " ns per packet\n"
+			<< "  state changes:  " << unsorted.StateChanges() << " unsorted -> " << sorted.StateChanges()
+			<< " sorted (PSO " << sorted.PipelineStateChanges << ", VB " << sorted.VertexBufferChanges << ", IB "
+			<< sorted.IndexBufferChanges << ", tables " << sorted.DescriptorTableChanges << ")\n"
+			<< "  order matches std::sort: " << (passed ? "passed" : "FAILED") << std::endl;
+		return passed ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		PrintUsage();
+		return 1;
+	}
+
+	std::string first = argv[1];
+	if (first == "transforms" && argc <= 4) {
+		return RunTransformBenchmark(argc >= 3 ? std::max(1, atoi(argv[2])) : 200000,
+			argc == 4 ? std::max(1, atoi(argv[3])) : 10);
+	}
+	if (first == "random" && argc <= 4) {
+		return RunRandomBenchmark(argc >= 3 ? std::max(1, atoi(argv[2])) : 1000003,
+			argc == 4 ? std::max(1, atoi(argv[3])) : 10);
+	}
+	if (first == "matrices" && argc <= 4) {
+		return RunMatrixBenchmark(argc >= 3 ? std::max(1, atoi(argv[2])) : 100003,
+			argc == 4 ? std::max(1, atoi(argv[3])) : 10);
+	}
+	if (first == "jobs" && argc <= 4) {
+		return RunJobBenchmark(argc >= 3 ? std::max(1, atoi(argv[2])) : 64,
+			argc == 4 ? std::max(1, atoi(argv[3])) : 5);
+	}
+	if (first == "tasks" && argc <= 4) {
+		return RunTaskBenchmark(argc >= 3 ? std::max(1, atoi(argv[2])) : 500,
+			argc == 4 ? std::max(1, atoi(argv[3])) : 5);
+	}
+	if (first == "affinity" && argc <= 4) {
+		return RunAffinityBenchmark(argc >= 3 ? std::max(1, atoi(argv[2])) : 300,
+			argc == 4 ? std::max(0, atoi(argv[3])) : 0);
+	}
+	if (first == "pipeline" && argc <= 4) {
+		return RunPipelineBenchmark(argc >= 3 ? std::max(1, atoi(argv[2])) : 200,
+			argc == 4 ? std::max(0.0, atof(argv[3])) : 4.0);
+	}
+	if (first == "timestep" && argc <= 4) {
+		return RunTimestepBenchmark(argc >= 3 ? std::max(1.0, atof(argv[2])) : 10.0,
+			argc == 4 ? std::max(1.0, atof(argv[3])) : 60.0);
+	}
+	if (first == "drawqueue" && argc <= 4) {
+		return RunDrawQueueBenchmark(argc >= 3 ? std::max(1, atoi(argv[2])) : 1000000,
+			argc == 4 ? std::max(1, atoi(argv[3])) : 10);
+	}
+	if (first == "stream" && argc <= 4) {
+		return RunStreamBenchmark(argc >= 3 ? std::max(1, atoi(argv[2])) : 64,
+			argc == 4 ? std::max(1, atoi(argv[3])) : 10);
+	}
+
+	PrintUsage();
+	return 1;
+}
@@ -0,0 +1,841 @@
+//MeshConverter: prepares meshes offline and writes them as mesh files (see
+//Geometry/MeshFile.h) that the renderer maps and uploads without parsing.
+//Only depends on the D3D-free Geometry and Common modules.
+#include "../../source/header/Common/MappedFile.h"
+#include "../../source/header/Common/ParallelFor.h"
+#include "../../source/header/Geometry/GeometryCodec.h"
+#include "../../source/header/Geometry/MeshFile.h"
+#include "../../source/header/Geometry/MeshGenerator.h"
+#include "../../source/header/Geometry/MeshImporter.h"
+#include "../../source/header/Geometry/MeshPipeline.h"
+#include "../../source/header/Geometry/MeshSimplifier.h"
+#include "../../source/header/Geometry/StaticMerger.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+	using Clock = std::chrono::high_resolution_clock;
+
+	double SecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	void PrintUsage()
+	{
+		std::cout <<
+			"usage:\n"
+			"  MeshConverter <source> [options] -o <output.solmesh>\n"
+			"  MeshConverter --info <file.solmesh>\n"
+			"  MeshConverter --bench <file.solmesh> [iterations]\n"
+			"  MeshConverter --import-bench <file.obj|.gltf|.glb> [iterations]\n"
+			"  MeshConverter --codec-test [file.solmesh] [iterations]\n"
+			"  MeshConverter --merge-test [instances]\n"
+			"  MeshConverter --lod-test\n"
+			"  MeshConverter --import-test\n"
+			"sources:\n"
+			"  <file.obj|.gltf|.glb> mesh file to import\n"
+			"  --box                 the colored cube of the demo\n"
+			"  --sphere <slices>     UV sphere with slices x slices/2 quads\n"
+			"  --grid <cells>        grid of cells x cells quads\n"
+			"options:\n"
+			"  --positions float3|half4|unorm16   (default unorm16)\n"
+			"  --normals none|float3|oct16        (default oct16 if the source has normals)\n"
+			"  --colors none|float4|unorm8        (default unorm8 if the source has colors)\n"
+			"  --no-lods --no-optimize --no-meshlets --no-weld\n"
+			"  --compress                         store vertices and indices with the geometry codec\n";
+	}
+
+	bool ParsePositionFormat(const std::string& name, PositionFormat& format)
+	{
+		if (name == "float3") format = PositionFormat::Float3;
+		else if (name == "half4") format = PositionFormat::Half4;
+		else if (name == "unorm16") format = PositionFormat::Unorm16x4;
+		else return false;
+		return true;
+	}
+
+	bool ParseNormalFormat(const std::string& name, NormalFormat& format)
+	{
+		if (name == "none") format = NormalFormat::None;
+		else if (name == "float3") format = NormalFormat::Float3;
+		else if (name == "oct16") format = NormalFormat::Oct16;
+		else return false;
+		return true;
+	}
+
+	bool ParseColorFormat(const std::string& name, ColorFormat& format)
+	{
+		if (name == "none") format = ColorFormat::None;
+		else if (name == "float4") format = ColorFormat::Float4;
+		else if (name == "unorm8") format = ColorFormat::Unorm8x4;
+		else return false;
+		return true;
+	}
+
+	const char* FormatName(PositionFormat format)
+	{
+		const char* names[] = { "float3", "half4", "unorm16" };
+		return names[(int)format];
+	}
+
+	const char* FormatName(NormalFormat format)
+	{
+		const char* names[] = { "none", "float3", "oct16" };
+		return names[(int)format];
+	}
+
+	const char* FormatName(ColorFormat format)
+	{
+		const char* names[] = { "none", "float4", "unorm8" };
+		return names[(int)format];
+	}
+
+	int PrintInfo(const std::string& path)
+	{
+		std::string error;
+		std::shared_ptr<MappedFile> file = MappedFile::Open(path, &error);
+		MeshFileView view;
+		if (file == nullptr || !view.Open(file->Data(), file->Size(), &error)) {
+			std::cerr << path << ": " << error << std::endl;
+			return 1;
+		}
+
+		const MeshFileHeader& header = view.Header();
+		VertexFormat format = view.Format();
+		std::cout << path << ": mesh \"" << view.Name() << "\", " << file->Size() << " bytes\n"
+			<< "  vertices: " << header.VertexCount << " x " << header.VertexStride << " bytes ("
+			<< FormatName(format.Position) << ", " << FormatName(format.Normal) << ", " << FormatName(format.Color) << ")\n"
+			<< "  indices: " << header.IndexCount << " x " << (uint32_t)header.IndexSize << " bytes\n"
+			<< "  meshlets: " << header.MeshletCount << "\n";
+		if (view.Compressed()) {
+			std::cout << "  compressed: vertices " << view.VertexBytes() << " -> " << view.Stream(MeshFileStreamVertices).Size
+				<< " bytes, indices " << view.IndexBytes() << " -> " << view.Stream(MeshFileStreamIndices).Size << " bytes\n";
+		}
+		for (uint32_t i = 0; i < view.PartCount(); ++i) {
+			const MeshFilePart& part = view.Parts()[i];
+			std::cout << "  part " << view.Part(i).Name << ": " << part.IndexCount / 3 << " triangles, lod "
+				<< part.Lod << " (error " << part.LodError << "), " << part.MeshletCount << " meshlets, bounds ["
+				<< part.BoundsMin[0] << " " << part.BoundsMin[1] << " " << part.BoundsMin[2] << "] - ["
+				<< part.BoundsMax[0] << " " << part.BoundsMax[1] << " " << part.BoundsMax[2] << "]\n";
+		}
+		return 0;
+	}
+
+	//Compares the two ways of getting a mesh file into an upload buffer:
+	//reading it with file IO into a MeshData and narrowing/copying from there,
+	//against mapping it and copying (or decoding) the streams straight out of
+	//the mapping. Both end in the same staging copy, so the difference is the
+	//intermediate copies. The file is in the page cache after the first iteration.
+	int RunBenchmark(const std::string& path, int iterations)
+	{
+		std::string error;
+		MeshData mesh;
+		if (!ReadMeshFile(path, mesh, &error)) {
+			std::cerr << path << ": " << error << std::endl;
+			return 1;
+		}
+		const bool use16Bit = mesh.Fits16BitIndices();
+		const size_t indexBytes = mesh.Indices.size() * (use16Bit ? sizeof(uint16_t) : sizeof(uint32_t));
+		std::vector<uint8_t> staging(mesh.Vertices.size() + indexBytes, 0);
+
+		double bestCopy = 1e30, bestMapped = 1e30, totalCopy = 0.0, totalMapped = 0.0;
+		size_t fileBytes = 0;
+		bool compressed = false;
+		uint64_t checksum = 0;
+		for (int i = 0; i < iterations; ++i) {
+			auto start = Clock::now();
+			MeshData loaded;
+			ReadMeshFile(path, loaded);
+			memcpy(staging.data(), loaded.Vertices.data(), loaded.Vertices.size());
+			uint8_t* indices = staging.data() + loaded.Vertices.size();
+			if (use16Bit) {
+				uint16_t* indices16 = reinterpret_cast<uint16_t*>(indices);
+				for (size_t k = 0; k < loaded.Indices.size(); ++k) {
+					indices16[k] = (uint16_t)loaded.Indices[k];
+				}
+			}
+			else {
+				memcpy(indices, loaded.Indices.data(), indexBytes);
+			}
+			double copySeconds = SecondsSince(start);
+			checksum += staging[staging.size() / 2];
+
+			start = Clock::now();
+			std::shared_ptr<MappedFile> file = MappedFile::Open(path);
+			MeshFileView view;
+			view.Open(file->Data(), file->Size());
+			const MeshFileRange& vertices = view.Stream(MeshFileStreamVertices);
+			const MeshFileRange& indexStream = view.Stream(MeshFileStreamIndices);
+			file->Prefetch((size_t)vertices.Offset, (size_t)(indexStream.Offset + indexStream.Size - vertices.Offset));
+			view.ReadVertices(staging.data());
+			view.ReadIndices(staging.data() + view.VertexBytes());
+			double mappedSeconds = SecondsSince(start);
+			checksum += staging[staging.size() / 2];
+			fileBytes = file->Size();
+			compressed = view.Compressed();
+
+			bestCopy = std::min(bestCopy, copySeconds);
+			bestMapped = std::min(bestMapped, mappedSeconds);
+			totalCopy += copySeconds;
+			totalMapped += mappedSeconds;
+		}
+
+		auto gbps = [&](double seconds) { return fileBytes / seconds * 1e-9; };
+		std::cout << path << ": " << fileBytes << " bytes, " << mesh.Indices.size() / 3 << " triangles, "
+			<< iterations << " iterations (checksum " << checksum << ")\n"
+			<< "  read + copy:   best " << bestCopy * 1000.0 << " ms (" << gbps(bestCopy) << " GB/s), average "
+			<< totalCopy / iterations * 1000.0 << " ms (" << gbps(totalCopy / iterations) << " GB/s)\n"
+			<< (compressed ? "  mapped + decode: best " : "  mapped, zero copy: best ") << bestMapped * 1000.0 << " ms (" << gbps(bestMapped) << " GB/s), average "
+			<< totalMapped / iterations * 1000.0 << " ms (" << gbps(totalMapped / iterations) << " GB/s)\n";
+		return 0;
+	}
+
+	//Imports the file repeatedly and reports triangles per second. Only the
+	//first iteration may read from disk, the others hit the page cache.
+	int RunImportBenchmark(const std::string& path, int iterations)
+	{
+		double best = 1e30, total = 0.0;
+		MeshImportStats stats, bestStats;
+		for (int i = 0; i < iterations; ++i) {
+			MeshData mesh;
+			std::string error;
+			if (!ImportMesh(path, mesh, MeshImportOptions(), &stats, &error)) {
+				std::cerr << error << std::endl;
+				return 1;
+			}
+			total += stats.Milliseconds;
+			if (stats.Milliseconds < best) {
+				best = stats.Milliseconds;
+				bestStats = stats;
+			}
+		}
+
+		auto mtris = [&](double milliseconds) { return bestStats.Triangles / (milliseconds * 1000.0); };
+		std::cout << path << ": " << bestStats.FileBytes << " bytes, " << bestStats.Triangles << " triangles, "
+			<< bestStats.SourceVertices << " -> " << bestStats.Vertices << " vertices after welding, "
+			<< iterations << " iterations on " << ParallelWorkerCount() << " threads\n"
+			<< "  best " << best << " ms (parse " << bestStats.ParseMilliseconds << " ms, weld "
+			<< bestStats.WeldMilliseconds << " ms): " << mtris(best) << " Mtris/s, "
+			<< bestStats.FileBytes / (best * 1e6) << " GB/s\n"
+			<< "  average " << total / iterations << " ms: " << mtris(total / iterations) << " Mtris/s\n";
+		return 0;
+	}
+
+	//Round trips of random and structured buffers through the geometry codec;
+	//malformed input must be rejected without touching memory outside the buffers.
+	bool TestCodecRoundTrips()
+	{
+		std::mt19937 random(1);
+		int failures = 0;
+		for (int i = 0; i < 2000; ++i) {
+			const size_t stride = 1 + random() % 64;
+			const size_t count = i % 8 == 0 ? VertexCodecBlockSize * (random() % 4) + random() % 3 : random() % 1200;
+			std::vector<uint8_t> vertices(count * stride);
+			for (size_t b = 0; b < vertices.size(); ++b) {
+				switch (i % 3) {
+				case 0: vertices[b] = (uint8_t)random(); break;
+				case 1: vertices[b] = (uint8_t)(b / stride * 3 + random() % 3); break;
+				default: vertices[b] = (uint8_t)(b % stride); break;
+				}
+			}
+			std::vector<uint8_t> encoded(VertexCodecBound(count, stride));
+			encoded.resize(EncodeVertexBuffer(vertices.data(), count, stride, encoded.data()));
+			std::vector<uint8_t> decoded(vertices.size());
+			if (!DecodeVertexBuffer(encoded.data(), encoded.size(), decoded.data(), count, stride) || decoded != vertices) {
+				std::cerr << "vertex round trip failed: " << count << " x " << stride << " bytes" << std::endl;
+				++failures;
+			}
+			std::vector<uint8_t> truncated(encoded.begin(), encoded.begin() + random() % encoded.size());
+			if (DecodeVertexBuffer(truncated.data(), truncated.size(), decoded.data(), count, stride)) {
+				std::cerr << "truncated vertex data accepted" << std::endl;
+				++failures;
+			}
+			encoded[random() % encoded.size()] ^= (uint8_t)(1 << random() % 8);
+			DecodeVertexBuffer(encoded.data(), encoded.size(), decoded.data(), count, stride);
+
+			std::vector<uint32_t> indices((random() % 500) * 3);
+			bool fits16Bit = true;
+			for (size_t k = 0; k < indices.size(); ++k) {
+				switch (i % 3) {
+				case 0: indices[k] = (uint32_t)random(); break;
+				case 1: indices[k] = (uint32_t)(random() % 100); break;
+				default: indices[k] = (uint32_t)(k / 3 + k % 3); break;
+				}
+				fits16Bit = fits16Bit && indices[k] <= 0xFFFF;
+			}
+			encoded.resize(IndexCodecBound(indices.size()));
+			encoded.resize(EncodeIndexBuffer(indices.data(), indices.size(), encoded.data()));
+			std::vector<uint32_t> decodedIndices(indices.size());
+			std::vector<uint16_t> decodedIndices16(indices.size());
+			if (!DecodeIndexBuffer(encoded.data(), encoded.size(), decodedIndices.data(), indices.size()) ||
+				decodedIndices != indices ||
+				DecodeIndexBuffer(encoded.data(), encoded.size(), decodedIndices16.data(), indices.size()) != fits16Bit) {
+				std::cerr << "index round trip failed: " << indices.size() << " indices" << std::endl;
+				++failures;
+			}
+			truncated.assign(encoded.begin(), encoded.begin() + random() % encoded.size());
+			if (DecodeIndexBuffer(truncated.data(), truncated.size(), decodedIndices.data(), indices.size())) {
+				std::cerr << "truncated index data accepted" << std::endl;
+				++failures;
+			}
+			encoded[random() % encoded.size()] ^= (uint8_t)(1 << random() % 8);
+			DecodeIndexBuffer(encoded.data(), encoded.size(), decodedIndices.data(), indices.size());
+		}
+		std::cout << "codec round trips: " << (failures == 0 ? "passed" : "FAILED") << std::endl;
+		return failures == 0;
+	}
+
+	//Checks the codec and measures its single threaded decoding speed on a mesh
+	//file or, without one, a quantized sphere, against a plain copy.
+	int RunCodecTest(const std::string& path, int iterations)
+	{
+		if (!TestCodecRoundTrips()) {
+			return 1;
+		}
+
+		MeshData mesh;
+		if (!path.empty()) {
+			std::string error;
+			if (!ReadMeshFile(path, mesh, &error)) {
+				std::cerr << path << ": " << error << std::endl;
+				return 1;
+			}
+		}
+		else {
+			MeshProcessOptions options;
+			options.GenerateLods = false;
+			options.BuildMeshlets = false;
+			MeshData sphere = CreateSphere(1.0f, 1024, 512);
+			ProcessMesh(sphere, options, mesh);
+		}
+
+		const size_t vertexCount = mesh.VertexCount();
+		std::vector<uint8_t> vertices(VertexCodecBound(vertexCount, mesh.VertexStride));
+		vertices.resize(EncodeVertexBuffer(mesh.Vertices.data(), vertexCount, mesh.VertexStride, vertices.data()));
+		std::vector<uint8_t> indices(IndexCodecBound(mesh.Indices.size()));
+		indices.resize(EncodeIndexBuffer(mesh.Indices.data(), mesh.Indices.size(), indices.data()));
+
+		std::vector<uint8_t> decodedVertices(mesh.Vertices.size());
+		std::vector<uint32_t> decodedIndices(mesh.Indices.size());
+		double bestVertices = 1e30, bestIndices = 1e30, bestCopy = 1e30;
+		bool valid = true;
+		for (int i = 0; i < iterations; ++i) {
+			auto start = Clock::now();
+			valid = DecodeVertexBuffer(vertices.data(), vertices.size(), decodedVertices.data(), vertexCount, mesh.VertexStride) && valid;
+			bestVertices = std::min(bestVertices, SecondsSince(start));
+
+			start = Clock::now();
+			valid = DecodeIndexBuffer(indices.data(), indices.size(), decodedIndices.data(), mesh.Indices.size()) && valid;
+			bestIndices = std::min(bestIndices, SecondsSince(start));
+
+			start = Clock::now();
+			memcpy(decodedVertices.data(), mesh.Vertices.data(), mesh.Vertices.size());
+			bestCopy = std::min(bestCopy, SecondsSince(start));
+		}
+		DecodeVertexBuffer(vertices.data(), vertices.size(), decodedVertices.data(), vertexCount, mesh.VertexStride);
+		if (!valid || decodedVertices != mesh.Vertices || decodedIndices != mesh.Indices) {
+			std::cerr << mesh.Name << ": round trip FAILED" << std::endl;
+			return 1;
+		}
+
+		const size_t indexBytes = mesh.Indices.size() * sizeof(uint32_t);
+		std::cout << mesh.Name << ": " << vertexCount << " vertices x " << mesh.VertexStride << " bytes, "
+			<< mesh.Indices.size() / 3 << " triangles, round trip passed\n"
+			<< "  vertices: " << mesh.Vertices.size() << " -> " << vertices.size() << " bytes ("
+			<< 100.0 * vertices.size() / std::max<size_t>(mesh.Vertices.size(), 1) << "%), decode "
+			<< mesh.Vertices.size() / bestVertices * 1e-9 << " GB/s\n"
+			<< "  indices: " << indexBytes << " -> " << indices.size() << " bytes ("
+			<< 8.0 * indices.size() / std::max<size_t>(mesh.Indices.size() / 3, 1) << " bits per triangle), decode "
+			<< indexBytes / bestIndices * 1e-9 << " GB/s\n"
+			<< "  memcpy of the vertices: " << mesh.Vertices.size() / bestCopy * 1e-9 << " GB/s\n";
+		return 0;
+	}
+
+	//Sign of the face normal of a triangle against the average of its vertex
+	//normals, 0 for degenerate triangles. Needs float positions and normals.
+	int FacingSign(const MeshData& mesh, const uint32_t* triangle, int32_t baseVertex)
+	{
+		const uint32_t normalOffset = mesh.Format.NormalOffset();
+		float p[3][3], n[3] = { 0.0f, 0.0f, 0.0f };
+		for (int v = 0; v < 3; ++v) {
+			const uint8_t* vertex = mesh.Vertices.data() + (size_t)(triangle[v] + baseVertex) * mesh.VertexStride;
+			memcpy(p[v], vertex, sizeof(p[v]));
+			float normal[3];
+			memcpy(normal, vertex + normalOffset, sizeof(normal));
+			for (int k = 0; k < 3; ++k) {
+				n[k] += normal[k];
+			}
+		}
+		float u[3], w[3];
+		for (int k = 0; k < 3; ++k) {
+			u[k] = p[1][k] - p[0][k];
+			w[k] = p[2][k] - p[0][k];
+		}
+		float face[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+		float d = face[0] * n[0] + face[1] * n[1] + face[2] * n[2];
+		return d > 1e-12f ? 1 : (d < -1e-12f ? -1 : 0);
+	}
+
+	//Merges randomly placed spheres and tiles, some of them mirrored, and
+	//checks that every triangle still faces the way its normals do and that
+	//the batches stay within their limits.
+	int RunMergeTest(int instanceCount)
+	{
+		MeshData sphere = CreateSphere(1.0f, 16, 8);
+		MeshData tile = CreateGrid(1.0f, 1.0f, 2, 2);
+		const int reference = FacingSign(sphere, &sphere.Indices[3], 0);
+		if (reference == 0 || FacingSign(tile, &tile.Indices[0], 0) != reference) {
+			std::cerr << "generators disagree on the winding" << std::endl;
+			return 1;
+		}
+
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 3.0f);
+		std::normal_distribution<float> gaussian;
+		std::vector<StaticInstance> instances(instanceCount);
+		uint64_t sourceTriangles = 0;
+		for (StaticInstance& instance : instances) {
+			instance.Mesh = random() % 4 == 0 ? &tile : &sphere;
+			sourceTriangles += instance.Mesh->Indices.size() / 3;
+
+			//Random rotation from a unit quaternion, scaled per axis, every fifth one mirrored.
+			float q[4] = { gaussian(random), gaussian(random), gaussian(random), gaussian(random) };
+			float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+			float x = q[0] / length, y = q[1] / length, z = q[2] / length, w = q[3] / length;
+			float rotation[9] = {
+				1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y),
+				2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x),
+				2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y),
+			};
+			float axisScale[3] = { scale(random) * (random() % 5 == 0 ? -1.0f : 1.0f), scale(random), scale(random) };
+			for (int row = 0; row < 3; ++row) {
+				for (int k = 0; k < 3; ++k) {
+					instance.World[4 * row + k] = axisScale[row] * rotation[3 * row + k];
+				}
+				instance.World[12 + row] = position(random);
+			}
+		}
+
+		StaticMergeOptions options;
+		options.MaxBatchExtent = 250.0f;
+		MeshData merged;
+		StaticMergeStats stats = MergeStaticMeshes(instances.data(), instances.size(), options, merged);
+
+		int failures = 0;
+		if (stats.Triangles != sourceTriangles || merged.Parts.size() != stats.Batches) {
+			std::cerr << "triangles or batches lost" << std::endl;
+			++failures;
+		}
+		uint32_t flipped = 0;
+		for (const MeshPart& part : merged.Parts) {
+			//Every instance is far below the limits, so no batch may exceed them.
+			uint32_t batchVertices = 0;
+			for (uint32_t i = 0; i < part.IndexCount; ++i) {
+				batchVertices = std::max(batchVertices, merged.Indices[part.IndexStart + i] + 1);
+			}
+			if (part.IndexCount / 3 > options.MaxBatchTriangles || batchVertices > options.MaxBatchVertices) {
+				std::cerr << part.Name << " exceeds the batch limits" << std::endl;
+				++failures;
+			}
+			for (uint32_t i = 0; i < part.IndexCount; i += 3) {
+				int sign = FacingSign(merged, &merged.Indices[part.IndexStart + i], part.BaseVertex);
+				flipped += sign == -reference ? 1 : 0;
+			}
+		}
+		if (flipped != 0) {
+			std::cerr << flipped << " triangles face against their normals" << std::endl;
+			++failures;
+		}
+
+		std::cout << "static merge: " << stats.Instances << " instances -> " << stats.Batches << " batches ("
+			<< stats.Triangles << " triangles, " << stats.Vertices << " vertices, largest batch "
+			<< stats.LargestBatchTriangles << " triangles), " << stats.Milliseconds << " ms ("
+			<< stats.Triangles / std::max(stats.Milliseconds, 1e-6) * 1e-3 << " M triangles/s)\n"
+			<< "  draws " << stats.Instances << " -> " << stats.Batches << ", windings and normals "
+			<< (failures == 0 ? "passed" : "FAILED") << std::endl;
+		return failures == 0 ? 0 : 1;
+	}
+
+	//Edges of a part used by one triangle only once vertices at the same
+	//position count as one, i.e. the holes and cracks a viewer would see.
+	//Needs float positions.
+	std::vector<std::array<float, 6>> OpenEdges(const MeshData& mesh, const MeshPart& part)
+	{
+		std::map<std::array<float, 3>, uint32_t> welded;
+		std::vector<std::array<float, 3>> positions;
+		std::map<std::pair<uint32_t, uint32_t>, int> edges;
+		for (uint32_t i = 0; i < part.IndexCount; i += 3) {
+			uint32_t corner[3];
+			for (int v = 0; v < 3; ++v) {
+				std::array<float, 3> position;
+				memcpy(position.data(), mesh.Vertices.data() + (size_t)(mesh.Indices[part.IndexStart + i + v] + part.BaseVertex) * mesh.VertexStride, sizeof(position));
+				auto inserted = welded.emplace(position, (uint32_t)positions.size());
+				if (inserted.second) {
+					positions.push_back(position);
+				}
+				corner[v] = inserted.first->second;
+			}
+			for (int v = 0; v < 3; ++v) {
+				++edges[{ corner[v], corner[(v + 1) % 3] }];
+			}
+		}
+
+		std::vector<std::array<float, 6>> open;
+		for (const auto& edge : edges) {
+			auto reverse = edges.find({ edge.first.second, edge.first.first });
+			if (edge.first.first != edge.first.second && (reverse == edges.end() || reverse->second != edge.second)) {
+				const std::array<float, 3>& a = positions[edge.first.first];
+				const std::array<float, 3>& b = positions[edge.first.second];
+				open.push_back({ a[0], a[1], a[2], b[0], b[1], b[2] });
+			}
+		}
+		return open;
+	}
+
+	//Simplifies a sphere, whose seam column and poles are vertices sharing
+	//their position, and a grid with an open border, then checks every level:
+	//the error must be finite and below the size of the mesh, the sphere must
+	//stay closed and the grid border must keep its outline, so neither seam
+	//nor border vertices may have moved.
+	int RunLodTest()
+	{
+		MeshData meshes[] = { CreateSphere(1.0f, 32, 16), CreateGrid(2.0f, 2.0f, 24, 24) };
+		int failures = 0;
+		for (MeshData& mesh : meshes) {
+			const std::vector<std::array<float, 6>> sourceOpen = OpenEdges(mesh, mesh.Parts[0]);
+			std::vector<std::array<float, 3>> border;
+			float perimeter = 0.0f;
+			for (const std::array<float, 6>& edge : sourceOpen) {
+				border.push_back({ edge[0], edge[1], edge[2] });
+				perimeter += sqrtf((edge[3] - edge[0]) * (edge[3] - edge[0]) + (edge[4] - edge[1]) * (edge[4] - edge[1]) + (edge[5] - edge[2]) * (edge[5] - edge[2]));
+			}
+			std::sort(border.begin(), border.end());
+
+			const float size = 2.0f * sqrtf(3.0f);
+			LodChainStats stats = GenerateLodChain(mesh);
+			if (mesh.Parts.size() < 3) {
+				std::cerr << mesh.Parts[0].Name << ": only " << mesh.Parts.size() - 1 << " levels generated" << std::endl;
+				++failures;
+			}
+			for (const MeshPart& part : mesh.Parts) {
+				if (!std::isfinite(part.LodError) || part.LodError > size) {
+					std::cerr << part.Name << ": error " << part.LodError << std::endl;
+					++failures;
+				}
+
+				float length = 0.0f;
+				bool onBorder = true;
+				for (const std::array<float, 6>& edge : OpenEdges(mesh, part)) {
+					onBorder &= std::binary_search(border.begin(), border.end(), std::array<float, 3>{ edge[0], edge[1], edge[2] })
+						&& std::binary_search(border.begin(), border.end(), std::array<float, 3>{ edge[3], edge[4], edge[5] });
+					length += sqrtf((edge[3] - edge[0]) * (edge[3] - edge[0]) + (edge[4] - edge[1]) * (edge[4] - edge[1]) + (edge[5] - edge[2]) * (edge[5] - edge[2]));
+				}
+				if (!onBorder || fabsf(length - perimeter) > 1e-4f * std::max(perimeter, 1.0f)) {
+					std::cerr << part.Name << ": open edges of length " << length << " against " << perimeter
+						<< (onBorder ? "" : ", some off the source border") << std::endl;
+					++failures;
+				}
+			}
+
+			std::cout << mesh.Parts[0].Name << ":";
+			for (size_t level = 0; level < stats.LevelTriangles.size(); ++level) {
+				std::cout << " " << stats.LevelTriangles[level] << " (" << stats.LevelErrors[level] << ")";
+			}
+			std::cout << " triangles (error), border length " << perimeter << "\n";
+		}
+		std::cout << "  seams, borders and errors " << (failures == 0 ? "passed" : "FAILED") << std::endl;
+		return failures == 0 ? 0 : 1;
+	}
+
+	//Sign of the face normal of a triangle against the direction from center
+	//to the triangle, 1 for triangles wound outward on a convex mesh.
+	int OutwardSign(const MeshData& mesh, const uint32_t* triangle, int32_t baseVertex, const float center[3])
+	{
+		float p[3][3];
+		for (int v = 0; v < 3; ++v) {
+			memcpy(p[v], mesh.Vertices.data() + (size_t)(triangle[v] + baseVertex) * mesh.VertexStride, sizeof(p[v]));
+		}
+		float u[3], w[3], out[3];
+		for (int k = 0; k < 3; ++k) {
+			u[k] = p[1][k] - p[0][k];
+			w[k] = p[2][k] - p[0][k];
+			out[k] = (p[0][k] + p[1][k] + p[2][k]) / 3.0f - center[k];
+		}
+		float face[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+		float d = face[0] * out[0] + face[1] * out[1] + face[2] * out[2];
+		return d > 1e-12f ? 1 : (d < -1e-12f ? -1 : 0);
+	}
+
+	//Triangles of mesh wound outward and, when it has normals, facing the way
+	//its normals do. Needs a convex mesh around the origin with float positions.
+	uint32_t CountOutward(const MeshData& mesh, int reference)
+	{
+		const float center[3] = { 0.0f, 0.0f, 0.0f };
+		uint32_t outward = 0;
+		for (const MeshPart& part : mesh.Parts) {
+			for (uint32_t i = 0; i < part.IndexCount; i += 3) {
+				const uint32_t* triangle = &mesh.Indices[part.IndexStart + i];
+				bool facing = mesh.Format.Normal == NormalFormat::None || FacingSign(mesh, triangle, part.BaseVertex) == 1;
+				outward += OutwardSign(mesh, triangle, part.BaseVertex, center) == reference && facing ? 1 : 0;
+			}
+		}
+		return outward;
+	}
+
+	//Writes a right-handed cube with counter-clockwise front faces and face
+	//normals as OBJ and as GLB (two meshes of the same name), imports both
+	//and checks that every triangle is wound outward like CreateBox, i.e.
+	//clockwise in the renderer's left-handed space, and that the part names
+	//stay unique.
+	int RunImportTest()
+	{
+		//Quads counter-clockwise seen from outside, 1-based like OBJ.
+		const float corners[8][3] = {
+			{ -1, -1, -1 }, { 1, -1, -1 }, { 1, 1, -1 }, { -1, 1, -1 },
+			{ -1, -1, 1 }, { 1, -1, 1 }, { 1, 1, 1 }, { -1, 1, 1 }
+		};
+		const uint32_t quads[6][4] = {
+			{ 5, 6, 7, 8 }, { 1, 4, 3, 2 }, { 2, 3, 7, 6 }, { 1, 5, 8, 4 }, { 4, 8, 7, 3 }, { 1, 2, 6, 5 }
+		};
+		const float faceNormals[6][3] = {
+			{ 0, 0, 1 }, { 0, 0, -1 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }
+		};
+
+		const std::filesystem::path directory = std::filesystem::temp_directory_path();
+		const std::string objPath = (directory / "MeshConverter_import_test.obj").string();
+		const std::string glbPath = (directory / "MeshConverter_import_test.glb").string();
+		{
+			std::ofstream obj(objPath);
+			for (const float* corner : corners) {
+				obj << "v " << corner[0] << " " << corner[1] << " " << corner[2] << "\n";
+			}
+			for (const float* normal : faceNormals) {
+				obj << "vn " << normal[0] << " " << normal[1] << " " << normal[2] << "\n";
+			}
+			for (int f = 0; f < 6; ++f) {
+				obj << "f";
+				for (uint32_t corner : quads[f]) {
+					obj << " " << corner << "//" << f + 1;
+				}
+				obj << "\n";
+			}
+		}
+		{
+			//24 vertices (position, normal) and 36 indices in one buffer.
+			std::vector<float> vertices;
+			std::vector<uint16_t> indices;
+			for (int f = 0; f < 6; ++f) {
+				for (uint32_t corner : quads[f]) {
+					vertices.insert(vertices.end(), corners[corner - 1], corners[corner - 1] + 3);
+					vertices.insert(vertices.end(), faceNormals[f], faceNormals[f] + 3);
+				}
+				const uint16_t base = (uint16_t)(4 * f);
+				indices.insert(indices.end(), { base, (uint16_t)(base + 1), (uint16_t)(base + 2),
+					base, (uint16_t)(base + 2), (uint16_t)(base + 3) });
+			}
+			std::string bin(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(float));
+			bin.append(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint16_t));
+			const size_t vertexBytes = vertices.size() * sizeof(float);
+			std::string json =
+				"{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":" + std::to_string(bin.size()) + "}],"
+				"\"bufferViews\":[{\"buffer\":0,\"byteLength\":" + std::to_string(vertexBytes) + ",\"byteStride\":24},"
+				"{\"buffer\":0,\"byteOffset\":" + std::to_string(vertexBytes) + ",\"byteLength\":72}],"
+				"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":24,\"type\":\"VEC3\"},"
+				"{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":24,\"type\":\"VEC3\"},"
+				"{\"bufferView\":1,\"componentType\":5123,\"count\":36,\"type\":\"SCALAR\"}],"
+				"\"meshes\":[{\"name\":\"cube\",\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1},\"indices\":2}]},"
+				"{\"name\":\"cube\",\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1},\"indices\":2}]}]}";
+			json.resize((json.size() + 3) & ~(size_t)3, ' ');
+			bin.resize((bin.size() + 3) & ~(size_t)3, '\0');
+			const uint32_t header[5] = { 0x46546C67, 2, (uint32_t)(12 + 8 + json.size() + 8 + bin.size()),
+				(uint32_t)json.size(), 0x4E4F534A };
+			const uint32_t binHeader[2] = { (uint32_t)bin.size(), 0x004E4942 };
+			std::ofstream glb(glbPath, std::ios::binary);
+			glb.write(reinterpret_cast<const char*>(header), sizeof(header));
+			glb.write(json.data(), (std::streamsize)json.size());
+			glb.write(reinterpret_cast<const char*>(binHeader), sizeof(binHeader));
+			glb.write(bin.data(), (std::streamsize)bin.size());
+		}
+
+		int failures = 0;
+		const MeshData box = CreateBox(1.0f);
+		const uint32_t boxOutward = CountOutward(box, 1);
+		if (boxOutward != box.Indices.size() / 3) {
+			std::cerr << "CreateBox has " << boxOutward << " of " << box.Indices.size() / 3 << " triangles wound outward" << std::endl;
+			++failures;
+		}
+		std::cout << "import: CreateBox " << boxOutward << "/" << box.Indices.size() / 3;
+		for (const std::string& path : { objPath, glbPath }) {
+			MeshData mesh;
+			std::string error;
+			if (!ImportMesh(path, mesh, MeshImportOptions(), nullptr, &error)) {
+				std::cerr << error << std::endl;
+				++failures;
+				continue;
+			}
+			const uint32_t triangles = (uint32_t)(mesh.Indices.size() / 3);
+			const uint32_t outward = CountOutward(mesh, 1);
+			failures += outward == triangles ? 0 : 1;
+			for (size_t i = 0; i < mesh.Parts.size(); ++i) {
+				for (size_t j = 0; j < i; ++j) {
+					if (mesh.Parts[i].Name == mesh.Parts[j].Name) {
+						std::cerr << path << ": part name " << mesh.Parts[i].Name << " repeats" << std::endl;
+						++failures;
+					}
+				}
+			}
+			std::cout << ", " << std::filesystem::path(path).extension().string() << " " << outward << "/" << triangles;
+		}
+		std::cout << " triangles wound outward and facing their normals\n"
+			<< "  windings and part names " << (failures == 0 ? "passed" : "FAILED") << std::endl;
+		std::filesystem::remove(objPath);
+		std::filesystem::remove(glbPath);
+		return failures == 0 ? 0 : 1;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		PrintUsage();
+		return 1;
+	}
+
+	std::string first = argv[1];
+	if (first == "--info" && argc == 3) {
+		return PrintInfo(argv[2]);
+	}
+	if (first == "--bench" && (argc == 3 || argc == 4)) {
+		return RunBenchmark(argv[2], argc == 4 ? std::max(1, atoi(argv[3])) : 10);
+	}
+	if (first == "--import-bench" && (argc == 3 || argc == 4)) {
+		return RunImportBenchmark(argv[2], argc == 4 ? std::max(1, atoi(argv[3])) : 5);
+	}
+	if (first == "--codec-test" && argc <= 4) {
+		return RunCodecTest(argc >= 3 ? argv[2] : "", argc == 4 ? std::max(1, atoi(argv[3])) : 10);
+	}
+	if (first == "--merge-test" && argc <= 3) {
+		return RunMergeTest(argc == 3 ? std::max(1, atoi(argv[2])) : 100000);
+	}
+	if (first == "--lod-test" && argc == 2) {
+		return RunLodTest();
+	}
+	if (first == "--import-test" && argc == 2) {
+		return RunImportTest();
+	}
+
+	MeshData source;
+	std::string output;
+	MeshProcessOptions options;
+	MeshImportOptions importOptions;
+	std::string input;
+	bool positionsSet = false, normalsSet = false, colorsSet = false;
+	bool compress = false;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--box") {
+			source = CreateBox();
+		}
+		else if (arg == "--sphere" && hasValue) {
+			uint32_t slices = (uint32_t)std::max(3, atoi(argv[++i]));
+			source = CreateSphere(1.0f, slices, std::max(2u, slices / 2));
+		}
+		else if (arg == "--grid" && hasValue) {
+			uint32_t cells = (uint32_t)std::max(1, atoi(argv[++i]));
+			source = CreateGrid(10.0f, 10.0f, cells, cells);
+		}
+		else if (arg == "--positions" && hasValue && ParsePositionFormat(argv[i + 1], options.Format.Position)) {
+			positionsSet = true;
+			++i;
+		}
+		else if (arg == "--normals" && hasValue && ParseNormalFormat(argv[i + 1], options.Format.Normal)) {
+			normalsSet = true;
+			++i;
+		}
+		else if (arg == "--colors" && hasValue && ParseColorFormat(argv[i + 1], options.Format.Color)) {
+			colorsSet = true;
+			++i;
+		}
+		else if (arg == "--no-lods") {
+			options.GenerateLods = false;
+		}
+		else if (arg == "--no-optimize") {
+			options.Optimize = false;
+		}
+		else if (arg == "--no-meshlets") {
+			options.BuildMeshlets = false;
+		}
+		else if (arg == "--no-weld") {
+			importOptions.Weld = false;
+		}
+		else if (arg == "--compress") {
+			compress = true;
+		}
+		else if (arg == "-o" && hasValue) {
+			output = argv[++i];
+		}
+		else if (arg[0] != '-' && input.empty()) {
+			input = arg;
+		}
+		else {
+			std::cerr << "unknown or incomplete argument: " << arg << std::endl;
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (!input.empty()) {
+		MeshImportStats importStats;
+		std::string error;
+		if (!ImportMesh(input, source, importOptions, &importStats, &error)) {
+			std::cerr << error << std::endl;
+			return 1;
+		}
+		std::cout << "imported " << input << ": " << importStats.Triangles << " triangles, "
+			<< importStats.SourceVertices << " -> " << importStats.Vertices << " vertices in "
+			<< importStats.Milliseconds << " ms" << std::endl;
+	}
+	if (source.Parts.empty() || output.empty()) {
+		PrintUsage();
+		return 1;
+	}
+
+	//Attributes the source lacks are left out unless asked for.
+	if (!positionsSet) {
+		options.Format.Position = PositionFormat::Unorm16x4;
+	}
+	if (!normalsSet) {
+		options.Format.Normal = source.Format.Normal != NormalFormat::None ? NormalFormat::Oct16 : NormalFormat::None;
+	}
+	if (!colorsSet) {
+		options.Format.Color = source.Format.Color != ColorFormat::None ? ColorFormat::Unorm8x4 : ColorFormat::None;
+	}
+
+	MeshData result;
+	MeshProcessStats stats = ProcessMesh(source, options, result);
+	std::cout << source.Name << ": " << source.Indices.size() / 3 << " triangles in " << source.Parts.size()
+		<< " parts, " << stats.MeshletCount << " meshlets, " << stats.SourceStride << " -> " << stats.Stride
+		<< " bytes per vertex, processed in " << stats.Milliseconds << " ms" << std::endl;
+
+	auto start = Clock::now();
+	std::string error;
+	if (!WriteMeshFile(result, output, compress, &error)) {
+		std::cerr << error << std::endl;
+		return 1;
+	}
+	std::cout << "wrote " << output << " in " << SecondsSince(start) * 1000.0 << " ms" << std::endl;
+	return 0;
+}